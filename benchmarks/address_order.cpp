@@ -0,0 +1,162 @@
+// alloc8/benchmarks/address_order.cpp
+// Linked-structure traversal after heavy churn, LIFO vs address-ordered refill
+//
+// A heap that has been running for a while hands out freed slots in LIFO
+// free order, so nodes allocated one after another are scattered across
+// their spans. This benchmark churns a heap until its free lists are
+// scrambled, with a random quarter of the objects kept alive, and then
+// builds a linked list by allocating nodes one after another. It reports
+// how fast the list can be walked and how often the walk crosses to a
+// different page. Four heaps are compared:
+//
+//   lifo            ThreadCache over SpanHeap (in-band free lists)
+//   ordered         Same heap with address-ordered refill, applied both to
+//                   each span (AddressOrderedRefill) and to each cache batch
+//   lifo-oob        ThreadCache over SpanHeap with OutOfBandSlab
+//   ordered-oob     Same heap with address-ordered refill
+//
+// Usage: address_order [nodes] [churn-rounds] [walks]
+
+#include "bench_util.h"
+
+#include <alloc8/alloc_context.h>
+#include <alloc8/ansi_wrapper.h>
+#include <alloc8/page_source.h>
+#include <alloc8/size_classes.h>
+#include <alloc8/slab_layout.h>
+#include <alloc8/span_heap.h>
+#include <alloc8/thread_cache.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <vector>
+
+namespace {
+
+struct Node {
+  Node*    next;
+  uint64_t payload[5];
+};
+
+template<typename Layout, bool Ordered>
+using Heap = alloc8::ANSIWrapper<alloc8::ThreadCache<
+    alloc8::SpanHeap<alloc8::OSPageSource, alloc8::SizeClasses, Layout>,
+    alloc8::SizeClasses, 64 * 1024, Ordered>>;
+
+struct Result {
+  double nsPerNode;
+  double pageCrossPercent;
+  double buildSeconds;
+};
+
+template<typename H>
+Result runOnce(size_t nodes, size_t rounds, size_t walks) {
+  static H heap;
+  alloc8::AllocContext ctx = {};  // Fresh cache for every heap
+  alloc8::switch_context(&ctx);
+  std::mt19937_64 rng(42);
+
+  // Churn: a pool twice the list size, repeatedly half freed and refilled
+  // in random order. A quarter of the pool stays live for the whole run so
+  // spans are never released and their free lists stay scrambled.
+  std::vector<void*> pool(nodes * 2);
+  for (void*& p : pool) {
+    p = heap.malloc(sizeof(Node));
+  }
+  for (size_t r = 0; r < rounds; r++) {
+    std::shuffle(pool.begin(), pool.end(), rng);
+    for (size_t i = 0; i < pool.size() / 2; i++) {
+      heap.free(pool[i]);
+    }
+    for (size_t i = 0; i < pool.size() / 2; i++) {
+      pool[i] = heap.malloc(sizeof(Node));
+    }
+  }
+  std::shuffle(pool.begin(), pool.end(), rng);
+  size_t keep = pool.size() / 4;
+  for (size_t i = keep; i < pool.size(); i++) {
+    heap.free(pool[i]);
+  }
+  pool.resize(keep);
+
+  // Rebuild: a list allocated node after node
+  double t0 = bench::now();
+  Node* head = nullptr;
+  Node** tail = &head;
+  for (size_t i = 0; i < nodes; i++) {
+    Node* n = static_cast<Node*>(heap.malloc(sizeof(Node)));
+    n->next = nullptr;
+    n->payload[0] = i;
+    *tail = n;
+    tail = &n->next;
+  }
+  Result r;
+  r.buildSeconds = bench::now() - t0;
+
+  size_t crossings = 0;
+  for (Node* n = head; n && n->next; n = n->next) {
+    if (reinterpret_cast<uintptr_t>(n) / ALLOC8_PAGE_SIZE !=
+        reinterpret_cast<uintptr_t>(n->next) / ALLOC8_PAGE_SIZE) {
+      crossings++;
+    }
+  }
+  r.pageCrossPercent = 100.0 * crossings / double(nodes - 1);
+
+  uint64_t sum = 0;
+  double t1 = bench::now();
+  for (size_t w = 0; w < walks; w++) {
+    for (Node* n = head; n; n = n->next) {
+      sum += n->payload[0];
+    }
+  }
+  r.nsPerNode = (bench::now() - t1) * 1e9 / (double(nodes) * walks);
+  if (sum == 1) {
+    printf("unexpected\n");  // Keeps the walk from being optimized out
+  }
+
+  for (Node* n = head; n;) {
+    Node* next = n->next;
+    heap.free(n);
+    n = next;
+  }
+  for (void* p : pool) {
+    heap.free(p);
+  }
+  alloc8::switch_context(nullptr);
+  alloc8::release_context(&ctx);
+  return r;
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+  size_t nodes = (argc > 1) ? strtoul(argv[1], nullptr, 10) : 1000000;
+  size_t rounds = (argc > 2) ? strtoul(argv[2], nullptr, 10) : 10;
+  size_t walks = (argc > 3) ? strtoul(argv[3], nullptr, 10) : 10;
+  if (nodes < 2 || walks == 0) {
+    fprintf(stderr, "usage: %s [nodes] [churn-rounds] [walks]\n", argv[0]);
+    return 1;
+  }
+
+  printf("nodes=%zu (%zu bytes) churn-rounds=%zu walks=%zu\n\n",
+         nodes, sizeof(Node), rounds, walks);
+  printf("%-14s %12s %14s %12s\n", "heap", "ns/node", "page-cross", "build s");
+
+  auto report = [](const char* name, const Result& r) {
+    printf("%-14s %12.2f %13.1f%% %12.3f\n", name, r.nsPerNode,
+           r.pageCrossPercent, r.buildSeconds);
+  };
+  using alloc8::AddressOrderedRefill;
+  using alloc8::InBandFreeList;
+  using alloc8::OutOfBandSlab;
+  report("lifo", runOnce<Heap<InBandFreeList, false>>(nodes, rounds, walks));
+  report("ordered", runOnce<Heap<AddressOrderedRefill<InBandFreeList>, true>>(
+      nodes, rounds, walks));
+  report("lifo-oob", runOnce<Heap<OutOfBandSlab<>, false>>(nodes, rounds, walks));
+  report("ordered-oob", runOnce<Heap<AddressOrderedRefill<OutOfBandSlab<>>, true>>(
+      nodes, rounds, walks));
+  return 0;
+}
@@ -0,0 +1,69 @@
+// alloc8/benchmarks/bench_util.h
+// Shared measurement helpers for alloc8 benchmarks
+
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <cstdio>
+#include <cstdlib>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <sys/resource.h>
+#include <unistd.h>
+#endif
+
+namespace bench {
+
+// Wall-clock seconds since an arbitrary epoch
+inline double now() {
+  using namespace std::chrono;
+  return duration_cast<duration<double>>(
+      steady_clock::now().time_since_epoch()).count();
+}
+
+// Current resident set size in bytes (0 if unknown)
+inline size_t rssBytes() {
+#if defined(__linux__)
+  FILE* f = fopen("/proc/self/statm", "r");
+  if (!f) return 0;
+  unsigned long size = 0, resident = 0;
+  int n = fscanf(f, "%lu %lu", &size, &resident);
+  fclose(f);
+  return (n == 2) ? resident * (size_t)sysconf(_SC_PAGESIZE) : 0;
+#else
+  return 0;
+#endif
+}
+
+// Peak resident set size in bytes (0 if unknown)
+inline size_t peakRssBytes() {
+#if defined(__unix__) || defined(__APPLE__)
+  struct rusage ru;
+  if (getrusage(RUSAGE_SELF, &ru) != 0) return 0;
+#if defined(__APPLE__)
+  return (size_t)ru.ru_maxrss;          // bytes on macOS
+#else
+  return (size_t)ru.ru_maxrss * 1024;   // kilobytes on Linux
+#endif
+#else
+  return 0;
+#endif
+}
+
+// Minor page faults so far (includes copy-on-write faults), or -1
+inline long minorFaults() {
+#if defined(__unix__) || defined(__APPLE__)
+  struct rusage ru;
+  if (getrusage(RUSAGE_SELF, &ru) != 0) return -1;
+  return ru.ru_minflt;
+#else
+  return -1;
+#endif
+}
+
+inline double mb(double bytes) {
+  return bytes / (1024.0 * 1024.0);
+}
+
+} // namespace bench
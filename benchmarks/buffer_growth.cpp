@@ -0,0 +1,188 @@
+// alloc8/benchmarks/buffer_growth.cpp
+// Growing an append-only buffer: vector/realloc vs in-place growth
+//
+// Appends variable-size records (16..1024 bytes) until the buffer reaches
+// the target size, the way a log or column builder does. Each strategy runs
+// in a forked child so peak RSS is measured independently:
+//
+//   vector          std::vector<char>::insert (system allocator)
+//   realloc         manual doubling with the system realloc
+//   span-copy       doubling with SpanHeap realloc (allocate-copy-free)
+//   span-in-place   doubling with SpanHeap growable large objects
+//   virtual-buffer  alloc8::VirtualBuffer append
+//
+// Usage: buffer_growth [targetMB] [repeat]
+
+#include "bench_util.h"
+
+#include <alloc8/ansi_wrapper.h>
+#include <alloc8/span_heap.h>
+#include <alloc8/virtual_buffer.h>
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include <random>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <vector>
+
+namespace {
+
+struct Sample {
+  double seconds;
+  double peakMB;      // Peak RSS growth over the child's starting RSS
+};
+
+// Record sizes are generated once so every strategy appends the same stream.
+std::vector<uint16_t> g_records;
+
+template<typename Append>
+size_t appendAll(size_t target, Append&& append) {
+  static char payload[1024];
+  size_t total = 0;
+  for (size_t i = 0; total < target; i++) {
+    size_t n = g_records[i % g_records.size()];
+    payload[0] = static_cast<char>(i);
+    append(payload, n);
+    total += n;
+  }
+  return total;
+}
+
+// Doubling growth through a realloc-like function
+template<typename Realloc, typename Free>
+void reallocGrowth(size_t target, Realloc&& doRealloc, Free&& doFree) {
+  char* buf = nullptr;
+  size_t size = 0;
+  size_t cap = 0;
+  appendAll(target, [&](const char* src, size_t n) {
+    if (size + n > cap) {
+      cap = cap ? cap * 2 : 4096;
+      while (cap < size + n) cap *= 2;
+      buf = static_cast<char*>(doRealloc(buf, cap));
+      if (!buf) {
+        fprintf(stderr, "realloc failed\n");
+        _exit(1);
+      }
+    }
+    memcpy(buf + size, src, n);
+    size += n;
+  });
+  doFree(buf);
+}
+
+template<typename Heap>
+void spanGrowth(size_t target) {
+  alignas(Heap) static unsigned char storage[sizeof(Heap)];
+  Heap* heap = new (storage) Heap();
+  reallocGrowth(target,
+                [&](void* p, size_t n) { return heap->realloc(p, n); },
+                [&](void* p) { heap->free(p); });
+}
+
+using CopyHeap = alloc8::ANSIWrapper<alloc8::SpanHeap<>>;
+using InPlaceHeap = alloc8::ANSIWrapper<
+  alloc8::SpanHeap<alloc8::OSPageSource, alloc8::SizeClasses,
+                   alloc8::InBandFreeList, 1024 * 1024>>;
+
+void runStrategy(int which, size_t target) {
+  switch (which) {
+    case 0: {
+      std::vector<char> v;
+      appendAll(target, [&](const char* src, size_t n) {
+        v.insert(v.end(), src, src + n);
+      });
+      break;
+    }
+    case 1:
+      reallocGrowth(target, [](void* p, size_t n) { return realloc(p, n); },
+                    [](void* p) { free(p); });
+      break;
+    case 2:
+      spanGrowth<CopyHeap>(target);
+      break;
+    case 3:
+      spanGrowth<InPlaceHeap>(target);
+      break;
+    default: {
+      alloc8::VirtualBuffer buf(target * 2);
+      appendAll(target, [&](const char* src, size_t n) {
+        if (!buf.append(src, n)) {
+          fprintf(stderr, "VirtualBuffer full\n");
+          _exit(1);
+        }
+      });
+      break;
+    }
+  }
+}
+
+Sample measure(int which, size_t target) {
+  int fds[2];
+  if (pipe(fds) != 0) {
+    perror("pipe");
+    exit(1);
+  }
+  pid_t pid = fork();
+  if (pid == 0) {
+    close(fds[0]);
+    size_t base = bench::rssBytes();
+    double t0 = bench::now();
+    runStrategy(which, target);
+    Sample s;
+    s.seconds = bench::now() - t0;
+    size_t peak = bench::peakRssBytes();
+    s.peakMB = bench::mb(peak > base ? double(peak - base) : 0.0);
+    ssize_t n = write(fds[1], &s, sizeof(s));
+    (void)n;
+    _exit(0);
+  }
+  close(fds[1]);
+  Sample s = {-1, -1};
+  if (read(fds[0], &s, sizeof(s)) != sizeof(s)) {
+    s = {-1, -1};
+  }
+  close(fds[0]);
+  waitpid(pid, nullptr, 0);
+  return s;
+}
+
+} // anonymous namespace
+
+int main(int argc, char* argv[]) {
+  size_t targetMB = (argc > 1) ? strtoul(argv[1], nullptr, 10) : 256;
+  int repeat = (argc > 2) ? atoi(argv[2]) : 3;
+  if (targetMB == 0 || repeat <= 0) {
+    fprintf(stderr, "usage: %s [targetMB] [repeat]\n", argv[0]);
+    return 1;
+  }
+  size_t target = targetMB * 1024 * 1024;
+
+  std::mt19937 rng(7);
+  g_records.resize(1 << 16);
+  for (auto& r : g_records) {
+    r = static_cast<uint16_t>(16 + rng() % 1009);
+  }
+
+  static const char* const kNames[] = {
+    "vector", "realloc", "span-copy", "span-in-place", "virtual-buffer",
+  };
+  printf("target=%zu MB, best of %d\n\n", targetMB, repeat);
+  printf("%-16s %10s %14s\n", "strategy", "seconds", "peak RSS MB");
+  for (int which = 0; which < 5; which++) {
+    Sample best = {-1, -1};
+    for (int r = 0; r < repeat; r++) {
+      Sample s = measure(which, target);
+      if (best.seconds < 0 || (s.seconds >= 0 && s.seconds < best.seconds)) {
+        best.seconds = s.seconds;
+      }
+      if (best.peakMB < 0 || (s.peakMB >= 0 && s.peakMB < best.peakMB)) {
+        best.peakMB = s.peakMB;
+      }
+    }
+    printf("%-16s %10.3f %14.1f\n", kNames[which], best.seconds, best.peakMB);
+  }
+  return 0;
+}
@@ -0,0 +1,185 @@
+// alloc8/benchmarks/cache_budget.cpp
+// Skewed multi-threaded workload under a global thread-cache budget
+//
+// A few hot threads churn a working set of mixed-size objects for the whole
+// run. The remaining threads allocate and free a burst up front, which
+// fills their caches, and then sit idle. Without a budget each cache keeps
+// whatever it was left with; with one, all caches share a fixed number of
+// bytes and the hot threads have to win theirs from the idle ones. Three
+// heaps are compared:
+//
+//   unbudgeted      ThreadCache over SpanHeap, per-class limits only
+//   budget          Same with a global budget (hot threads steal capacity)
+//   budget+maint    Same, with the Maintenance thread draining idle caches
+//
+// Reports hot-thread throughput and the bytes held by all caches at the end,
+// then prints the per-cache stats of the last heap.
+//
+// Usage: cache_budget [threads] [hot-threads] [ops-per-hot-thread] [budget-KiB]
+
+#include "bench_util.h"
+
+#include <alloc8/ansi_wrapper.h>
+#include <alloc8/maintenance.h>
+#include <alloc8/span_heap.h>
+#include <alloc8/thread_cache.h>
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <thread>
+#include <vector>
+
+namespace {
+
+constexpr size_t kBudget = 1024 * 1024;
+constexpr size_t kWorkingSet = 4096;  // Live objects per hot thread
+constexpr size_t kBurst = 20000;      // Objects per idle thread's burst
+
+using Unbudgeted = alloc8::ANSIWrapper<alloc8::ThreadCache<alloc8::SpanHeap<>>>;
+using Budgeted = alloc8::ANSIWrapper<alloc8::ThreadCache<
+    alloc8::SpanHeap<>, alloc8::SizeClasses, 64 * 1024, false, kBudget>>;
+
+size_t randomSize(std::mt19937& rng) {
+  return 16u << (rng() % 8);  // 16 B .. 2 KiB
+}
+
+struct Result {
+  double hotMops;
+  size_t cachedBytes;
+  alloc8_cache_stats caches[64];  // Snapshot while every thread is alive
+  size_t numCaches;
+};
+
+void collect(const alloc8_cache_stats* s, void* ctx) {
+  Result& r = *static_cast<Result*>(ctx);
+  if (r.numCaches < sizeof(r.caches) / sizeof(r.caches[0])) {
+    r.caches[r.numCaches++] = *s;
+  }
+}
+
+template<typename H>
+Result runOnce(H& heap, size_t threads, size_t hot, size_t ops, bool maintain) {
+  std::atomic<size_t> burstsDone{0};
+  std::atomic<size_t> hotDone{0};
+  std::atomic<bool> exit{false};
+  std::vector<double> seconds(hot);
+  std::vector<std::thread> pool;
+
+  for (size_t t = hot; t < threads; t++) {
+    pool.emplace_back([&, t] {
+      std::mt19937 rng(static_cast<uint32_t>(t));
+      std::vector<void*> blocks(kBurst);
+      for (void*& p : blocks) {
+        p = heap.malloc(randomSize(rng));
+      }
+      for (void* p : blocks) {
+        heap.free(p);
+      }
+      burstsDone.fetch_add(1);
+      while (!exit.load()) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+      }
+      heap.threadCleanup();
+    });
+  }
+  while (burstsDone.load() < threads - hot) {
+    std::this_thread::yield();
+  }
+  if (maintain) {
+    alloc8::Maintenance::instance().start(std::chrono::milliseconds(10));
+  }
+
+  for (size_t t = 0; t < hot; t++) {
+    pool.emplace_back([&, t] {
+      std::mt19937 rng(static_cast<uint32_t>(1000 + t));
+      std::vector<void*> slots(kWorkingSet);
+      for (void*& p : slots) {
+        p = heap.malloc(randomSize(rng));
+      }
+      double t0 = bench::now();
+      for (size_t i = 0; i < ops; i++) {
+        size_t k = rng() % kWorkingSet;
+        heap.free(slots[k]);
+        slots[k] = heap.malloc(randomSize(rng));
+      }
+      seconds[t] = bench::now() - t0;
+      for (void* p : slots) {
+        heap.free(p);
+      }
+      hotDone.fetch_add(1);
+      while (!exit.load()) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+      }
+      heap.threadCleanup();
+    });
+  }
+  while (hotDone.load() < hot) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+
+  Result r = {};
+  double total = 0;
+  for (double s : seconds) {
+    total += s;
+  }
+  r.hotMops = double(ops) * hot / total / 1e6;
+  r.cachedBytes = heap.cachedBytes();
+  heap.cacheStats(collect, &r);
+  exit.store(true);
+  for (std::thread& t : pool) {
+    t.join();
+  }
+  if (maintain) {
+    alloc8::Maintenance::instance().stop();
+  }
+  return r;
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+  size_t threads = (argc > 1) ? strtoul(argv[1], nullptr, 10) : 16;
+  size_t hot = (argc > 2) ? strtoul(argv[2], nullptr, 10) : 2;
+  size_t ops = (argc > 3) ? strtoul(argv[3], nullptr, 10) : 4000000;
+  size_t budgetKiB = (argc > 4) ? strtoul(argv[4], nullptr, 10) : kBudget / 1024;
+  if (hot == 0 || hot > threads || ops == 0 || budgetKiB == 0) {
+    fprintf(stderr, "usage: %s [threads] [hot-threads] [ops-per-hot-thread] [budget-KiB]\n",
+            argv[0]);
+    return 1;
+  }
+
+  printf("threads=%zu hot=%zu ops/hot-thread=%zu budget=%zu KiB\n\n",
+         threads, hot, ops, budgetKiB);
+  printf("%-14s %14s %14s\n", "heap", "hot Mops/s", "cached KiB");
+  auto report = [](const char* name, const Result& r) {
+    printf("%-14s %14.2f %14.1f\n", name, r.hotMops, r.cachedBytes / 1024.0);
+  };
+
+  static Unbudgeted unbudgeted;
+  report("unbudgeted", runOnce(unbudgeted, threads, hot, ops, false));
+
+  static Budgeted budgeted;
+  budgeted.setBudget(budgetKiB * 1024);
+  report("budget", runOnce(budgeted, threads, hot, ops, false));
+
+  static Budgeted maintained;
+  maintained.setBudget(budgetKiB * 1024);
+  static Result last;
+  last = runOnce(maintained, threads, hot, ops, true);
+  report("budget+maint", last);
+
+  printf("\nbudget+maint caches when the hot threads finished "
+         "(ids 0-%zu burst then idle):\n", threads - hot - 1);
+  printf("%6s %12s %12s %12s %6s\n", "id", "bytes KiB", "cap KiB", "ops", "idle");
+  for (size_t i = 0; i < last.numCaches; i++) {
+    const alloc8_cache_stats& s = last.caches[i];
+    printf("%6u %12.1f %12.1f %12llu %6s\n", s.id, s.bytes / 1024.0,
+           s.capacity / 1024.0, static_cast<unsigned long long>(s.ops),
+           s.idle ? "yes" : "no");
+  }
+  return 0;
+}
@@ -0,0 +1,135 @@
+// alloc8/benchmarks/central_refill.cpp
+// Refill-heavy thread-cache workload over three shared tiers
+//
+// Each thread repeatedly allocates a run of objects larger than its
+// ThreadCache limit and frees them again, so nearly every run refills the
+// cache from the shared tier and flushes back to it. The ThreadCache front
+// end is the same in every case; only the tier below it changes:
+//
+//   one-lock    SpanHeap behind one mutex (simple_heap's std::mutex,
+//               DieHard's LockedHeap fallback)
+//   span-heap   SpanHeap's own per-class mutexes
+//   central     CentralFreeList over SpanHeap: lock-free batch stacks, the
+//               span heap only on the slow path
+//
+// Reports aggregate Mops/s (one malloc + one free per op) at each thread
+// count. Scaling past the lock ceiling needs as many cores as threads.
+//
+// Usage: central_refill [max-threads] [ops-per-thread]
+
+#include "bench_util.h"
+
+#include <alloc8/ansi_wrapper.h>
+#include <alloc8/central_free_list.h>
+#include <alloc8/span_heap.h>
+#include <alloc8/thread_cache.h>
+
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace {
+
+constexpr size_t kCacheBytes = 4096;  // Small per-class limit: refill often
+constexpr size_t kRun = 256;          // Objects per run, above every limit
+
+// The shared tier under a single lock
+template<typename Heap>
+class OneLock : public Heap {
+  std::mutex lock_;
+
+public:
+  void* malloc(size_t sz) {
+    std::lock_guard<std::mutex> guard(lock_);
+    return Heap::malloc(sz);
+  }
+  void free(void* ptr) {
+    std::lock_guard<std::mutex> guard(lock_);
+    Heap::free(ptr);
+  }
+  void* memalign(size_t alignment, size_t sz) {
+    std::lock_guard<std::mutex> guard(lock_);
+    return Heap::memalign(alignment, sz);
+  }
+  size_t mallocBatch(size_t sz, void** out, size_t n) {
+    std::lock_guard<std::mutex> guard(lock_);
+    return Heap::mallocBatch(sz, out, n);
+  }
+  void freeBatch(void** ptrs, size_t n) {
+    std::lock_guard<std::mutex> guard(lock_);
+    Heap::freeBatch(ptrs, n);
+  }
+};
+
+template<typename Tier>
+using Cached = alloc8::ANSIWrapper<alloc8::ThreadCache<Tier, alloc8::SizeClasses, kCacheBytes>>;
+
+using OneLockHeap = Cached<OneLock<alloc8::SpanHeap<>>>;
+using SpanHeapHeap = Cached<alloc8::SpanHeap<>>;
+using CentralHeap = Cached<alloc8::CentralFreeList<alloc8::SpanHeap<>>>;
+
+template<typename H>
+double runOnce(H& heap, size_t threads, size_t ops) {
+  std::atomic<size_t> ready{0};
+  std::atomic<bool> go{false};
+  std::vector<std::thread> pool;
+  for (size_t t = 0; t < threads; t++) {
+    pool.emplace_back([&, t] {
+      void* run[kRun];
+      size_t sz = 32u << (t % 3);  // 32, 64 or 128 bytes
+      ready.fetch_add(1);
+      while (!go.load(std::memory_order_acquire)) {
+        std::this_thread::yield();
+      }
+      for (size_t done = 0; done < ops; done += kRun) {
+        for (void*& p : run) {
+          p = heap.malloc(sz);
+          *static_cast<char*>(p) = 1;
+        }
+        for (void* p : run) {
+          heap.free(p);
+        }
+      }
+      heap.threadCleanup();
+    });
+  }
+  while (ready.load() < threads) {
+    std::this_thread::yield();
+  }
+  double t0 = bench::now();
+  go.store(true, std::memory_order_release);
+  for (std::thread& t : pool) {
+    t.join();
+  }
+  double seconds = bench::now() - t0;
+  return double(ops) * double(threads) / seconds / 1e6;
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+  size_t maxThreads = (argc > 1) ? strtoul(argv[1], nullptr, 10) : 64;
+  size_t ops = (argc > 2) ? strtoul(argv[2], nullptr, 10) : 2000000;
+  if (maxThreads == 0 || ops == 0) {
+    fprintf(stderr, "usage: %s [max-threads] [ops-per-thread]\n", argv[0]);
+    return 1;
+  }
+
+  printf("ops/thread=%zu run=%zu objects cache=%zu B/class cores=%u\n\n",
+         ops, kRun, kCacheBytes, std::thread::hardware_concurrency());
+  printf("%8s %12s %12s %12s\n", "threads", "one-lock", "span-heap", "central");
+  static OneLockHeap oneLock;
+  static SpanHeapHeap spanHeap;
+  static CentralHeap central;
+  for (size_t threads = 1; threads <= maxThreads; threads *= 2) {
+    double a = runOnce(oneLock, threads, ops);
+    double b = runOnce(spanHeap, threads, ops);
+    double c = runOnce(central, threads, ops);
+    printf("%8zu %12.2f %12.2f %12.2f\n", threads, a, b, c);
+    fflush(stdout);
+  }
+  return 0;
+}
@@ -0,0 +1,233 @@
+// alloc8/benchmarks/entry_cost.cpp
+// Per-entry-point cost of the system allocator API
+//
+// Calls each allocation entry point in a tight batch and reports user-mode
+// instructions retired per call (perf_event_open) and nanoseconds per call.
+// Linked against the system malloc, so any allocator can be injected with
+// LD_PRELOAD; alloc8_parity_bench runs it under a native build and an alloc8
+// build of the same allocator, where the instruction counts show exactly
+// what the interposition layer adds to each entry point.
+//
+// Output (one line per entry point, parsed by run_parity.cmake):
+//   ENTRY name=<entry> insns=<per call or -> ns=<per call>
+//
+// Usage: entry_cost [calls-per-batch] [batches]
+
+#include "bench_util.h"
+
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <malloc.h>
+#include <new>
+#include <vector>
+
+#if defined(__linux__)
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+namespace {
+
+// Retired user-mode instructions of this thread; valid() is false when the
+// kernel refuses (perf_event_paranoid, containers), and only time is reported
+class InstructionCounter {
+  int fd_ = -1;
+
+public:
+  InstructionCounter() {
+#if defined(__linux__)
+    perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = PERF_TYPE_HARDWARE;
+    attr.config = PERF_COUNT_HW_INSTRUCTIONS;
+    attr.disabled = 1;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    fd_ = static_cast<int>(syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0));
+#endif
+  }
+
+  ~InstructionCounter() {
+#if defined(__linux__)
+    if (fd_ >= 0) close(fd_);
+#endif
+  }
+
+  bool valid() const { return fd_ >= 0; }
+
+  void start() {
+#if defined(__linux__)
+    if (fd_ >= 0) {
+      ioctl(fd_, PERF_EVENT_IOC_RESET, 0);
+      ioctl(fd_, PERF_EVENT_IOC_ENABLE, 0);
+    }
+#endif
+  }
+
+  uint64_t stop() {
+    uint64_t count = 0;
+#if defined(__linux__)
+    if (fd_ >= 0) {
+      ioctl(fd_, PERF_EVENT_IOC_DISABLE, 0);
+      if (read(fd_, &count, sizeof(count)) != sizeof(count)) count = 0;
+    }
+#endif
+    return count;
+  }
+};
+
+// Keeps the compiler from pairing up or eliding allocation calls
+inline void escape(void* p) {
+  asm volatile("" : : "g"(p) : "memory");
+}
+
+struct Cost {
+  double insns;  // Per call (minimum over batches), or -1
+  double ns;     // Per call (minimum over batches)
+};
+
+// Entry point under test: `setup` prepares slots (untimed), `body` makes one
+// call per slot (timed), `teardown` releases whatever is left (untimed)
+struct Entry {
+  const char* name;
+  void (*setup)(void** slots, size_t n);
+  void (*body)(void** slots, size_t n);
+  void (*teardown)(void** slots, size_t n);
+};
+
+constexpr size_t kSmall = 64;
+constexpr size_t kAlign = 64;
+
+void none(void**, size_t) {}
+
+void mallocAll(void** slots, size_t n) {
+  for (size_t i = 0; i < n; i++) {
+    slots[i] = malloc(kSmall);
+    escape(slots[i]);
+  }
+}
+
+void freeAll(void** slots, size_t n) {
+  for (size_t i = 0; i < n; i++) {
+    escape(slots[i]);
+    free(slots[i]);
+  }
+}
+
+void callocAll(void** slots, size_t n) {
+  for (size_t i = 0; i < n; i++) {
+    slots[i] = calloc(1, kSmall);
+    escape(slots[i]);
+  }
+}
+
+void reallocAll(void** slots, size_t n) {
+  for (size_t i = 0; i < n; i++) {
+    slots[i] = realloc(slots[i], kSmall * 2);
+    escape(slots[i]);
+  }
+}
+
+void memalignAll(void** slots, size_t n) {
+  for (size_t i = 0; i < n; i++) {
+    if (posix_memalign(&slots[i], kAlign, kSmall) != 0) slots[i] = nullptr;
+    escape(slots[i]);
+  }
+}
+
+void newAll(void** slots, size_t n) {
+  for (size_t i = 0; i < n; i++) {
+    slots[i] = ::operator new(kSmall);
+    escape(slots[i]);
+  }
+}
+
+void deleteAll(void** slots, size_t n) {
+  for (size_t i = 0; i < n; i++) {
+    escape(slots[i]);
+    ::operator delete(slots[i]);
+  }
+}
+
+void usableSizeAll(void** slots, size_t n) {
+  for (size_t i = 0; i < n; i++) {
+    size_t sz = malloc_usable_size(slots[i]);
+    escape(reinterpret_cast<void*>(sz));
+  }
+}
+
+void mallocFreeAll(void** slots, size_t n) {
+  for (size_t i = 0; i < n; i++) {
+    void* p = malloc(kSmall);
+    escape(p);
+    free(p);
+  }
+  escape(slots);
+}
+
+const Entry kEntries[] = {
+  {"malloc",             none,      mallocAll,     freeAll},
+  {"free",               mallocAll, freeAll,       none},
+  {"calloc",             none,      callocAll,     freeAll},
+  {"realloc",            mallocAll, reallocAll,    freeAll},
+  {"posix_memalign",     none,      memalignAll,   freeAll},
+  {"operator_new",       none,      newAll,        deleteAll},
+  {"operator_delete",    newAll,    deleteAll,     none},
+  {"malloc_usable_size", mallocAll, usableSizeAll, freeAll},
+  {"malloc+free",        none,      mallocFreeAll, none},
+};
+
+Cost measure(const Entry& e, InstructionCounter& counter,
+             std::vector<void*>& slots, size_t batches) {
+  Cost best = {-1, 0};
+  size_t n = slots.size();
+  for (size_t b = 0; b <= batches; b++) {
+    e.setup(slots.data(), n);
+    counter.start();
+    double t0 = bench::now();
+    e.body(slots.data(), n);
+    double t1 = bench::now();
+    uint64_t insns = counter.stop();
+    e.teardown(slots.data(), n);
+    if (b == 0) {
+      continue;  // Warm-up: first touch of fresh memory
+    }
+    double ns = (t1 - t0) * 1e9 / n;
+    if (b == 1 || ns < best.ns) best.ns = ns;
+    if (counter.valid()) {
+      double per = double(insns) / n;
+      if (best.insns < 0 || per < best.insns) best.insns = per;
+    }
+  }
+  return best;
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+  size_t calls = (argc > 1) ? strtoul(argv[1], nullptr, 10) : 10000;
+  size_t batches = (argc > 2) ? strtoul(argv[2], nullptr, 10) : 20;
+  if (calls == 0 || batches == 0) {
+    fprintf(stderr, "usage: %s [calls-per-batch] [batches]\n", argv[0]);
+    return 1;
+  }
+
+  InstructionCounter counter;
+  std::vector<void*> slots(calls, nullptr);
+  printf("calls=%zu batches=%zu size=%zu instructions=%s\n\n", calls, batches,
+         kSmall, counter.valid() ? "perf_event" : "unavailable");
+  for (const Entry& e : kEntries) {
+    Cost c = measure(e, counter, slots, batches);
+    if (c.insns >= 0) {
+      printf("ENTRY name=%s insns=%.1f ns=%.2f\n", e.name, c.insns, c.ns);
+    } else {
+      printf("ENTRY name=%s insns=- ns=%.2f\n", e.name, c.ns);
+    }
+  }
+  return 0;
+}
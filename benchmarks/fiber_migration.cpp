@@ -0,0 +1,255 @@
+// alloc8/benchmarks/fiber_migration.cpp
+// ucontext fibers migrating between OS threads, with and without AllocContext
+//
+// Worker threads share one run queue of fibers. Each time a fiber runs it
+// allocates a burst of small objects, frees the oldest objects in its
+// working set, and yields; the next worker to pop it resumes it, so fibers
+// hop between threads constantly. "cross-cache" counts frees that return an
+// object to a different context than the one it was allocated from (objects
+// drifting between caches instead of staying with their fiber). Three heaps
+// are compared:
+//
+//   span-heap       SpanHeap with no cache (a lock per malloc/free)
+//   thread-context  ThreadCache using each OS thread's default context:
+//                   a fiber's objects scatter across whichever thread
+//                   caches it happened to run on
+//   fiber-context   ThreadCache with alloc8::switch_context() on every
+//                   resume: each fiber keeps its own cache as it migrates
+//
+// Usage: fiber_migration [threads] [fibers] [rounds]
+
+#include "bench_util.h"
+
+#include <alloc8/alloc_context.h>
+#include <alloc8/ansi_wrapper.h>
+#include <alloc8/os_memory.h>
+#include <alloc8/span_heap.h>
+#include <alloc8/thread_cache.h>
+
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <deque>
+#include <mutex>
+#include <random>
+#include <thread>
+#include <ucontext.h>
+#include <vector>
+
+namespace {
+
+constexpr size_t kStackSize = 64 * 1024;
+constexpr size_t kBurst = 32;        // Objects allocated per resume
+constexpr size_t kWorkingSet = 256;  // Live objects kept per fiber
+
+using PlainHeap = alloc8::ANSIWrapper<alloc8::SpanHeap<>>;
+using CachedHeap = alloc8::ANSIWrapper<alloc8::ThreadCache<alloc8::SpanHeap<>>>;
+
+struct Fiber {
+  ucontext_t uc;
+  ucontext_t* scheduler;
+  alloc8::AllocContext alloc;
+  void* stack;
+  void* live[kWorkingSet];
+  alloc8::AllocContext* from[kWorkingSet];  // Context each object came from
+  size_t crossFrees;
+  size_t next;
+  size_t roundsLeft;
+  std::minstd_rand rng;
+  int lastWorker;
+  bool done;
+};
+
+struct RunQueue {
+  std::mutex lock;
+  std::deque<Fiber*> fibers;
+
+  void push(Fiber* f) {
+    std::lock_guard<std::mutex> guard(lock);
+    fibers.push_back(f);
+  }
+
+  Fiber* pop() {
+    std::lock_guard<std::mutex> guard(lock);
+    if (fibers.empty()) {
+      return nullptr;
+    }
+    Fiber* f = fibers.front();
+    fibers.pop_front();
+    return f;
+  }
+};
+
+template<typename Heap>
+struct Run {
+  Heap heap;
+  RunQueue queue;
+  std::atomic<size_t> remaining{0};
+  std::atomic<size_t> migrations{0};
+};
+
+// One resume's worth of work. Kept out of line so nothing derived from
+// thread-local state is cached across a yield (the fiber may come back on a
+// different thread).
+template<typename Heap>
+ALLOC8_NOINLINE void fiberRound(Heap& heap, Fiber* f) {
+  alloc8::AllocContext* ctx = alloc8::current_context();
+  for (size_t i = 0; i < kBurst; i++) {
+    size_t index = f->next++ % kWorkingSet;
+    void*& slot = f->live[index];
+    if (slot && f->from[index] != ctx) {
+      f->crossFrees++;
+    }
+    heap.free(slot);
+    slot = heap.malloc(16 + (f->rng() % 32) * 16);
+    f->from[index] = ctx;
+    static_cast<char*>(slot)[0] = 1;
+  }
+}
+
+// Handed to a new fiber by runOnce() (makecontext only passes ints)
+template<typename Heap>
+Run<Heap>* g_run;
+Fiber* g_starting;
+
+template<typename Heap>
+void fiberMain() {
+  Run<Heap>* run = g_run<Heap>;
+  Fiber* self = g_starting;
+  swapcontext(&self->uc, self->scheduler);  // Started; wait to be scheduled
+  while (self->roundsLeft--) {
+    fiberRound(run->heap, self);
+    swapcontext(&self->uc, self->scheduler);
+  }
+  for (void*& p : self->live) {
+    run->heap.free(p);
+    p = nullptr;
+  }
+  self->done = true;
+  swapcontext(&self->uc, self->scheduler);
+}
+
+template<typename Heap, bool SwitchContexts>
+void worker(Run<Heap>* run, int id) {
+  ucontext_t scheduler;
+  while (run->remaining.load(std::memory_order_acquire) != 0) {
+    Fiber* f = run->queue.pop();
+    if (!f) {
+      std::this_thread::yield();
+      continue;
+    }
+    if (f->lastWorker != id) {
+      run->migrations.fetch_add(1, std::memory_order_relaxed);
+      f->lastWorker = id;
+    }
+    f->scheduler = &scheduler;
+    alloc8::AllocContext* saved = nullptr;
+    if constexpr (SwitchContexts) {
+      saved = alloc8::switch_context(&f->alloc);
+    }
+    swapcontext(&scheduler, &f->uc);
+    if constexpr (SwitchContexts) {
+      alloc8::switch_context(saved);
+    }
+    if (f->done) {
+      if constexpr (SwitchContexts) {
+        alloc8::release_context(&f->alloc);
+      }
+      run->remaining.fetch_sub(1, std::memory_order_release);
+    } else {
+      run->queue.push(f);
+    }
+  }
+  if constexpr (requires(Heap& h) { h.threadCleanup(); }) {
+    run->heap.threadCleanup();
+  }
+}
+
+struct Result {
+  double seconds;
+  size_t migrations;
+  double crossPercent;
+  double rssMB;
+};
+
+template<typename Heap, bool SwitchContexts>
+Result runOnce(int threads, size_t fibers, size_t rounds) {
+  auto* run = new Run<Heap>;
+  g_run<Heap> = run;
+
+  std::vector<Fiber*> all;
+  ucontext_t creator;
+  for (size_t i = 0; i < fibers; i++) {
+    Fiber* f = new Fiber();
+    f->stack = alloc8::osMap(kStackSize);
+    f->roundsLeft = rounds;
+    f->rng.seed(static_cast<unsigned>(i + 1));
+    f->lastWorker = -1;
+    f->scheduler = &creator;
+    getcontext(&f->uc);
+    f->uc.uc_stack.ss_sp = f->stack;
+    f->uc.uc_stack.ss_size = kStackSize;
+    f->uc.uc_link = nullptr;
+    makecontext(&f->uc, fiberMain<Heap>, 0);
+    g_starting = f;
+    swapcontext(&creator, &f->uc);
+    all.push_back(f);
+    run->queue.push(f);
+  }
+  run->remaining.store(fibers);
+
+  size_t rss0 = bench::rssBytes();
+  double start = bench::now();
+  std::vector<std::thread> workers;
+  for (int t = 0; t < threads; t++) {
+    workers.emplace_back(worker<Heap, SwitchContexts>, run, t);
+  }
+  for (auto& w : workers) {
+    w.join();
+  }
+  Result r;
+  r.seconds = bench::now() - start;
+  r.migrations = run->migrations.load();
+  size_t rss1 = bench::rssBytes();
+  r.rssMB = bench::mb(rss1 > rss0 ? rss1 - rss0 : 0);
+
+  size_t crossFrees = 0;
+  for (Fiber* f : all) {
+    crossFrees += f->crossFrees;
+  }
+  r.crossPercent = 100.0 * crossFrees / (double(fibers) * rounds * kBurst);
+
+  for (Fiber* f : all) {
+    alloc8::osUnmap(f->stack, kStackSize);
+    delete f;
+  }
+  // Heaps are leaked on purpose: their spans are simply unmapped at exit
+  return r;
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+  int threads = (argc > 1) ? atoi(argv[1]) : 4;
+  size_t fibers = (argc > 2) ? strtoul(argv[2], nullptr, 10) : 64;
+  size_t rounds = (argc > 3) ? strtoul(argv[3], nullptr, 10) : 2000;
+  if (threads <= 0 || fibers == 0 || rounds == 0) {
+    fprintf(stderr, "usage: %s [threads] [fibers] [rounds]\n", argv[0]);
+    return 1;
+  }
+
+  printf("threads=%d fibers=%zu rounds=%zu (%zu malloc+free per round)\n\n",
+         threads, fibers, rounds, kBurst);
+  printf("%-16s %10s %12s %12s %12s %10s\n",
+         "heap", "seconds", "Mops/sec", "migrations", "cross-cache", "RSS MB");
+
+  auto report = [&](const char* name, const Result& r) {
+    double ops = double(fibers) * rounds * kBurst;
+    printf("%-16s %10.3f %12.2f %12zu %11.1f%% %10.1f\n", name, r.seconds,
+           ops / r.seconds / 1e6, r.migrations, r.crossPercent, r.rssMB);
+  };
+  report("span-heap", runOnce<PlainHeap, false>(threads, fibers, rounds));
+  report("thread-context", runOnce<CachedHeap, false>(threads, fibers, rounds));
+  report("fiber-context", runOnce<CachedHeap, true>(threads, fibers, rounds));
+  return 0;
+}
@@ -0,0 +1,220 @@
+// alloc8/benchmarks/huge_pages.cpp
+// Huge-page coverage and TLB behaviour of three page sources under SpanHeap
+//
+// Builds a heap of mixed small and medium objects, frees a random half and
+// refills it (so every source has released memory at least once), then
+// reads one byte from random live objects. Three page sources are compared:
+//
+//   os          OSPageSource: one mapping per span, no huge-page hint
+//   thp         One MADV_HUGEPAGE region, first-fit, every freed run given
+//               straight back with MADV_DONTNEED (what a THP-unaware
+//               allocator does; each release splits a huge page)
+//   hugepage    HugePageSource (packs runs into huge pages, releases whole
+//               empty huge pages, never subreleases without pressure)
+//
+// Reports ns per random access, dTLB load misses per access (perf_event;
+// "-" where the kernel refuses), the share of resident anonymous memory the
+// kernel backs with huge pages (AnonHugePages / Rss from smaps_rollup), and
+// HugePageSource's own coverage ratio. Each source runs in a forked child so
+// the kernel counters are not shared. Huge pages need THP in "always" or
+// "madvise" mode (/sys/kernel/mm/transparent_hugepage/enabled).
+//
+// Usage: huge_pages [MiB] [accesses-in-millions]
+
+#include "bench_util.h"
+
+#include <alloc8/huge_page_source.h>
+#include <alloc8/page_source.h>
+#include <alloc8/span_heap.h>
+
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <vector>
+
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+namespace {
+
+// THP-unaware baseline: a huge-page-hinted region that returns every freed
+// run to the OS immediately
+class NaiveThpSource : public alloc8::RegionPageSource<size_t(4) << 30, size_t(1) << 30> {
+  using Base = alloc8::RegionPageSource<size_t(4) << 30, size_t(1) << 30>;
+
+public:
+  NaiveThpSource() {
+    if (base()) {
+      alloc8::osHugePageHint(base(), kRegionBytes);
+    }
+  }
+
+  void freePages(void* ptr, size_t npages) {
+    alloc8::osDecommit(ptr, npages * ALLOC8_PAGE_SIZE);
+    Base::freePages(ptr, npages);
+  }
+};
+
+// dTLB read misses of this thread; valid() is false when perf is unavailable
+class DtlbCounter {
+  int fd_ = -1;
+
+public:
+  DtlbCounter() {
+    perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = PERF_TYPE_HW_CACHE;
+    attr.config = PERF_COUNT_HW_CACHE_DTLB |
+                  (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+                  (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+    attr.disabled = 1;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    fd_ = static_cast<int>(syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0));
+  }
+
+  ~DtlbCounter() {
+    if (fd_ >= 0) close(fd_);
+  }
+
+  bool valid() const { return fd_ >= 0; }
+
+  void start() {
+    if (fd_ >= 0) {
+      ioctl(fd_, PERF_EVENT_IOC_RESET, 0);
+      ioctl(fd_, PERF_EVENT_IOC_ENABLE, 0);
+    }
+  }
+
+  uint64_t stop() {
+    uint64_t count = 0;
+    if (fd_ >= 0) {
+      ioctl(fd_, PERF_EVENT_IOC_DISABLE, 0);
+      if (read(fd_, &count, sizeof(count)) != sizeof(count)) count = 0;
+    }
+    return count;
+  }
+};
+
+// Value of a "Key:   123 kB" line of /proc/self/smaps_rollup, in bytes
+size_t smapsBytes(const char* key) {
+  FILE* f = fopen("/proc/self/smaps_rollup", "r");
+  if (!f) return 0;
+  char line[256];
+  size_t len = strlen(key);
+  size_t kb = 0;
+  while (fgets(line, sizeof(line), f)) {
+    if (strncmp(line, key, len) == 0 && line[len] == ':') {
+      kb = strtoul(line + len + 1, nullptr, 10);
+      break;
+    }
+  }
+  fclose(f);
+  return kb * 1024;
+}
+
+size_t randomSize(std::mt19937_64& rng) {
+  // Mostly small objects, with a tail of medium ones that take whole runs
+  uint64_t r = rng() % 100;
+  if (r < 90) return 16 + rng() % 2048;
+  if (r < 99) return 4096 + rng() % (60 * 1024);
+  return 64 * 1024 + rng() % (448 * 1024);
+}
+
+template<typename Source>
+void runOnce(const char* name, size_t bytes, size_t accesses) {
+  static alloc8::SpanHeap<Source> heap;
+  std::mt19937_64 rng(7);
+
+  // Build, then free a random half and refill it
+  std::vector<void*> objs;
+  size_t total = 0;
+  while (total < bytes) {
+    size_t sz = randomSize(rng);
+    void* p = heap.malloc(sz);
+    memset(p, 1, sz);
+    objs.push_back(p);
+    total += sz;
+  }
+  for (int round = 0; round < 3; round++) {
+    for (void*& p : objs) {
+      if (rng() & 1) {
+        heap.free(p);
+        size_t sz = randomSize(rng);
+        p = heap.malloc(sz);
+        memset(p, 1, sz);
+      }
+    }
+  }
+
+  // Random reads of one byte per object
+  std::vector<uint32_t> order(accesses);
+  for (uint32_t& i : order) {
+    i = static_cast<uint32_t>(rng() % objs.size());
+  }
+  DtlbCounter dtlb;
+  uint64_t sum = 0;
+  dtlb.start();
+  double t0 = bench::now();
+  for (uint32_t i : order) {
+    sum += *static_cast<volatile uint8_t*>(objs[i]);
+  }
+  double seconds = bench::now() - t0;
+  uint64_t misses = dtlb.stop();
+
+  size_t rss = smapsBytes("Rss");
+  size_t huge = smapsBytes("AnonHugePages");
+  char missText[32] = "-";
+  if (dtlb.valid()) {
+    snprintf(missText, sizeof(missText), "%.3f", double(misses) / double(accesses));
+  }
+  char coverage[32] = "-";
+  if constexpr (requires(Source& s) { s.stats(); }) {
+    snprintf(coverage, sizeof(coverage), "%.1f%%",
+             100.0 * heap.pageSource().stats().coverage);
+  }
+  printf("%-10s %10.2f %12s %9.1f %10.1f%% %10s%s\n", name,
+         seconds * 1e9 / double(accesses), missText, bench::mb(rss),
+         rss ? 100.0 * double(huge) / double(rss) : 0.0, coverage,
+         sum == 1 ? " (unexpected)" : "");
+  fflush(stdout);
+}
+
+template<typename Source>
+void inChild(const char* name, size_t bytes, size_t accesses) {
+  fflush(stdout);
+  pid_t pid = fork();
+  if (pid == 0) {
+    runOnce<Source>(name, bytes, accesses);
+    _exit(0);
+  }
+  int status = 0;
+  waitpid(pid, &status, 0);
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+  size_t mib = (argc > 1) ? strtoul(argv[1], nullptr, 10) : 256;
+  size_t millions = (argc > 2) ? strtoul(argv[2], nullptr, 10) : 20;
+  if (mib == 0 || millions == 0) {
+    fprintf(stderr, "usage: %s [MiB] [accesses-in-millions]\n", argv[0]);
+    return 1;
+  }
+  size_t bytes = mib * 1024 * 1024;
+  size_t accesses = millions * 1000000;
+
+  printf("live=%zu MiB accesses=%zuM\n\n", mib, millions);
+  printf("%-10s %10s %12s %9s %11s %10s\n", "source", "ns/access",
+         "dTLB/access", "RSS MB", "THP share", "coverage");
+  inChild<alloc8::OSPageSource>("os", bytes, accesses);
+  inChild<NaiveThpSource>("thp", bytes, accesses);
+  inChild<alloc8::HugePageSource<>>("hugepage", bytes, accesses);
+  return 0;
+}
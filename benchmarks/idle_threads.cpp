@@ -0,0 +1,152 @@
+// alloc8/benchmarks/idle_threads.cpp
+// Steady-state RSS of a large, mostly idle thread pool with and without
+// idle notifications
+//
+// Every worker wakes for a short burst (allocate a batch of mixed-size
+// objects, free them), then blocks until the next round, like a pool
+// worker waiting on a queue. Without notifications each parked worker
+// keeps the objects its ThreadCache collected in the burst. With them, the
+// worker calls threadIdle() (alloc8_thread_idle in a preloaded allocator)
+// before blocking and threadBusy() after waking, so parked caches are
+// empty and the heap can return its spans to the OS.
+//
+// Reports RSS with every worker parked (after the last round), bytes held
+// by thread caches at that point, and the mean wall time of one round
+// across the pool. Each mode runs in a forked child so RSS is not shared.
+//
+// Usage: idle_threads [threads] [rounds] [objects-per-burst]
+
+#include "bench_util.h"
+
+#include <alloc8/ansi_wrapper.h>
+#include <alloc8/span_heap.h>
+#include <alloc8/thread_cache.h>
+
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <mutex>
+#include <random>
+#include <thread>
+#include <vector>
+
+#include <sys/wait.h>
+#include <unistd.h>
+
+namespace {
+
+using Heap = alloc8::ANSIWrapper<alloc8::ThreadCache<alloc8::SpanHeap<>>>;
+
+// Workers wait here between rounds; main starts a round by bumping `round`
+struct Pool {
+  std::mutex lock;
+  std::condition_variable wake;
+  std::condition_variable parked;
+  uint64_t round = 0;
+  size_t parkedCount = 0;
+  bool exit = false;
+};
+
+void runOnce(const char* name, bool notify, size_t threads, size_t rounds, size_t burst) {
+  static Heap heap;
+  Pool pool;
+  std::vector<std::thread> workers;
+  workers.reserve(threads);
+
+  for (size_t t = 0; t < threads; t++) {
+    workers.emplace_back([&, t] {
+      std::mt19937 rng(static_cast<uint32_t>(t));
+      std::vector<void*> blocks(burst);
+      uint64_t seen = 0;
+      for (;;) {
+        for (void*& p : blocks) {
+          p = heap.malloc(16u << (rng() % 6));  // 16 B .. 512 B
+        }
+        for (void* p : blocks) {
+          heap.free(p);
+        }
+        if (notify) {
+          heap.threadIdle();
+        }
+        {
+          std::unique_lock<std::mutex> guard(pool.lock);
+          pool.parkedCount++;
+          pool.parked.notify_one();
+          pool.wake.wait(guard, [&] { return pool.exit || pool.round != seen; });
+          seen = pool.round;
+          if (pool.exit) {
+            break;
+          }
+        }
+        if (notify) {
+          heap.threadBusy();
+        }
+      }
+      heap.threadCleanup();
+    });
+  }
+
+  auto waitParked = [&] {
+    std::unique_lock<std::mutex> guard(pool.lock);
+    pool.parked.wait(guard, [&] { return pool.parkedCount == threads; });
+  };
+
+  waitParked();
+  double seconds = 0;
+  for (size_t r = 0; r < rounds; r++) {
+    double t0 = bench::now();
+    {
+      std::lock_guard<std::mutex> guard(pool.lock);
+      pool.parkedCount = 0;
+      pool.round++;
+    }
+    pool.wake.notify_all();
+    waitParked();
+    seconds += bench::now() - t0;
+  }
+
+  size_t rss = bench::rssBytes();
+  size_t cached = heap.cachedBytes();
+  {
+    std::lock_guard<std::mutex> guard(pool.lock);
+    pool.exit = true;
+  }
+  pool.wake.notify_all();
+  for (std::thread& w : workers) {
+    w.join();
+  }
+
+  printf("%-10s %10.1f %14.1f %12.2f\n", name, bench::mb(rss),
+         double(cached) / 1024.0, seconds * 1e3 / double(rounds));
+  fflush(stdout);
+}
+
+void inChild(const char* name, bool notify, size_t threads, size_t rounds, size_t burst) {
+  fflush(stdout);
+  pid_t pid = fork();
+  if (pid == 0) {
+    runOnce(name, notify, threads, rounds, burst);
+    _exit(0);
+  }
+  int status = 0;
+  waitpid(pid, &status, 0);
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+  size_t threads = (argc > 1) ? strtoul(argv[1], nullptr, 10) : 1000;
+  size_t rounds = (argc > 2) ? strtoul(argv[2], nullptr, 10) : 5;
+  size_t burst = (argc > 3) ? strtoul(argv[3], nullptr, 10) : 512;
+  if (threads == 0 || rounds == 0 || burst == 0) {
+    fprintf(stderr, "usage: %s [threads] [rounds] [objects-per-burst]\n", argv[0]);
+    return 1;
+  }
+
+  printf("threads=%zu rounds=%zu burst=%zu objects\n\n", threads, rounds, burst);
+  printf("%-10s %10s %14s %12s\n", "mode", "RSS MB", "cached KiB", "ms/round");
+  inChild("always-on", false, threads, rounds, burst);
+  inChild("idle/busy", true, threads, rounds, burst);
+  return 0;
+}
@@ -0,0 +1,314 @@
+// alloc8/benchmarks/io_uring_fixed.cpp
+// io_uring reads into registered (fixed) buffers vs ordinary heap buffers
+//
+// Writes a temporary file, then reads it end to end several times through a
+// minimal raw-syscall io_uring ring with `depth` reads in flight:
+//
+//   heap     IORING_OP_READ into posix_memalign'd buffers (the kernel pins
+//            and unpins the user pages on every read)
+//   fixed    IORING_OP_READ_FIXED into buffers from alloc8::FixedBufferHeap,
+//            registered once with IORING_REGISTER_BUFFERS
+//
+// Both modes checksum what they read, so a wrong buffer index or offset
+// shows up as a mismatch. Reads are buffered (page cache) unless "direct"
+// is given, which opens the file with O_DIRECT.
+//
+// Usage: io_uring_fixed [file-MiB] [block-KiB] [depth] [passes] [direct]
+
+#include "bench_util.h"
+
+#include <alloc8/fixed_buffer_heap.h>
+
+#include <cerrno>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <vector>
+
+namespace {
+
+using IoHeap = alloc8::FixedBufferHeap<256 * 1024 * 1024>;
+
+// Just enough of a ring for one reader: submit, then reap completions
+class Ring {
+  int fd_ = -1;
+  io_uring_params params_ = {};
+  void* sqMap_ = MAP_FAILED;
+  void* cqMap_ = MAP_FAILED;
+  size_t sqMapBytes_ = 0;
+  size_t cqMapBytes_ = 0;
+  io_uring_sqe* sqes_ = static_cast<io_uring_sqe*>(MAP_FAILED);
+  unsigned* sqTail_ = nullptr;
+  unsigned* sqMask_ = nullptr;
+  unsigned* sqArray_ = nullptr;
+  unsigned* cqHead_ = nullptr;
+  unsigned* cqTail_ = nullptr;
+  unsigned* cqMask_ = nullptr;
+  io_uring_cqe* cqes_ = nullptr;
+  unsigned pending_ = 0;  // Prepared but not yet submitted
+
+  template<typename T>
+  static T* at(void* base, uint32_t offset) {
+    return reinterpret_cast<T*>(static_cast<char*>(base) + offset);
+  }
+
+public:
+  explicit Ring(unsigned entries) {
+    fd_ = static_cast<int>(syscall(__NR_io_uring_setup, entries, &params_));
+    if (fd_ < 0) {
+      return;
+    }
+    sqMapBytes_ = params_.sq_off.array + params_.sq_entries * sizeof(unsigned);
+    cqMapBytes_ = params_.cq_off.cqes + params_.cq_entries * sizeof(io_uring_cqe);
+    sqMap_ = mmap(nullptr, sqMapBytes_, PROT_READ | PROT_WRITE,
+                  MAP_SHARED | MAP_POPULATE, fd_, IORING_OFF_SQ_RING);
+    cqMap_ = mmap(nullptr, cqMapBytes_, PROT_READ | PROT_WRITE,
+                  MAP_SHARED | MAP_POPULATE, fd_, IORING_OFF_CQ_RING);
+    sqes_ = static_cast<io_uring_sqe*>(
+        mmap(nullptr, params_.sq_entries * sizeof(io_uring_sqe),
+             PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd_, IORING_OFF_SQES));
+    if (sqMap_ == MAP_FAILED || cqMap_ == MAP_FAILED || sqes_ == MAP_FAILED) {
+      close(fd_);
+      fd_ = -1;
+      return;
+    }
+    sqTail_ = at<unsigned>(sqMap_, params_.sq_off.tail);
+    sqMask_ = at<unsigned>(sqMap_, params_.sq_off.ring_mask);
+    sqArray_ = at<unsigned>(sqMap_, params_.sq_off.array);
+    cqHead_ = at<unsigned>(cqMap_, params_.cq_off.head);
+    cqTail_ = at<unsigned>(cqMap_, params_.cq_off.tail);
+    cqMask_ = at<unsigned>(cqMap_, params_.cq_off.ring_mask);
+    cqes_ = at<io_uring_cqe>(cqMap_, params_.cq_off.cqes);
+  }
+
+  ~Ring() {
+    if (fd_ >= 0) {
+      munmap(sqes_, params_.sq_entries * sizeof(io_uring_sqe));
+      munmap(cqMap_, cqMapBytes_);
+      munmap(sqMap_, sqMapBytes_);
+      close(fd_);
+    }
+  }
+
+  int fd() const { return fd_; }
+
+  void prepRead(int file, void* buf, unsigned len, uint64_t offset,
+                int fixedIndex, uint64_t userData) {
+    unsigned tail = *sqTail_;
+    unsigned slot = tail & *sqMask_;
+    io_uring_sqe* sqe = &sqes_[slot];
+    memset(sqe, 0, sizeof(*sqe));
+    sqe->opcode = fixedIndex >= 0 ? IORING_OP_READ_FIXED : IORING_OP_READ;
+    sqe->fd = file;
+    sqe->addr = reinterpret_cast<uintptr_t>(buf);
+    sqe->len = len;
+    sqe->off = offset;
+    sqe->buf_index = static_cast<uint16_t>(fixedIndex >= 0 ? fixedIndex : 0);
+    sqe->user_data = userData;
+    sqArray_[slot] = slot;
+    __atomic_store_n(sqTail_, tail + 1, __ATOMIC_RELEASE);
+    pending_++;
+  }
+
+  // Submit everything prepared and wait for at least one completion
+  bool submitAndWait() {
+    int rc = static_cast<int>(syscall(__NR_io_uring_enter, fd_, pending_, 1,
+                                      IORING_ENTER_GETEVENTS, nullptr, 0));
+    if (rc < 0 && errno != EINTR) {
+      return false;
+    }
+    pending_ = 0;
+    return true;
+  }
+
+  // Pop one completion if available
+  bool reap(io_uring_cqe& out) {
+    unsigned head = *cqHead_;
+    if (head == __atomic_load_n(cqTail_, __ATOMIC_ACQUIRE)) {
+      return false;
+    }
+    out = cqes_[head & *cqMask_];
+    __atomic_store_n(cqHead_, head + 1, __ATOMIC_RELEASE);
+    return true;
+  }
+};
+
+uint64_t checksum(const void* data, size_t n) {
+  const uint64_t* words = static_cast<const uint64_t*>(data);
+  uint64_t sum = 0;
+  for (size_t i = 0; i < n / sizeof(uint64_t); i++) {
+    sum += words[i] * (i | 1);
+  }
+  return sum;
+}
+
+struct Buffer {
+  void* data;
+  int index;  // Registered buffer index, or -1
+};
+
+struct Result {
+  double seconds;
+  uint64_t sum;
+  bool ok;
+};
+
+// Read the whole file `passes` times with `buffers.size()` reads in flight
+Result readAll(Ring& ring, int file, size_t fileBytes, size_t block,
+               const std::vector<Buffer>& buffers, size_t passes) {
+  Result r = {0, 0, true};
+  double start = bench::now();
+  for (size_t pass = 0; pass < passes && r.ok; pass++) {
+    uint64_t next = 0;
+    size_t inFlight = 0;
+    for (size_t b = 0; b < buffers.size() && next < fileBytes; b++, next += block) {
+      ring.prepRead(file, buffers[b].data, static_cast<unsigned>(block), next,
+                    buffers[b].index, b);
+      inFlight++;
+    }
+    while (inFlight > 0) {
+      if (!ring.submitAndWait()) {
+        r.ok = false;
+        break;
+      }
+      io_uring_cqe cqe;
+      while (ring.reap(cqe)) {
+        inFlight--;
+        size_t b = static_cast<size_t>(cqe.user_data);
+        if (cqe.res < 0) {
+          fprintf(stderr, "read failed: %s\n", strerror(-cqe.res));
+          r.ok = false;
+          continue;
+        }
+        r.sum += checksum(buffers[b].data, static_cast<size_t>(cqe.res));
+        if (next < fileBytes) {
+          ring.prepRead(file, buffers[b].data, static_cast<unsigned>(block), next,
+                        buffers[b].index, b);
+          next += block;
+          inFlight++;
+        }
+      }
+    }
+  }
+  r.seconds = bench::now() - start;
+  return r;
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+  size_t fileMiB = (argc > 1) ? strtoul(argv[1], nullptr, 10) : 256;
+  size_t blockKiB = (argc > 2) ? strtoul(argv[2], nullptr, 10) : 128;
+  size_t depth = (argc > 3) ? strtoul(argv[3], nullptr, 10) : 16;
+  size_t passes = (argc > 4) ? strtoul(argv[4], nullptr, 10) : 8;
+  bool direct = (argc > 5) && strcmp(argv[5], "direct") == 0;
+  size_t block = blockKiB * 1024;
+  if (fileMiB == 0 || block == 0 || block % 4096 != 0 || depth == 0 ||
+      depth > 256 || passes == 0 || depth * block > IoHeap::kBufferBytes) {
+    fprintf(stderr, "usage: %s [file-MiB] [block-KiB] [depth<=256] [passes] [direct]\n",
+            argv[0]);
+    return 1;
+  }
+  size_t fileBytes = fileMiB * 1024 * 1024;
+
+  Ring ring(static_cast<unsigned>(depth));
+  if (ring.fd() < 0) {
+    printf("io_uring unavailable (%s); nothing to measure\n", strerror(errno));
+    return 0;
+  }
+  static IoHeap heap;
+  int rc = heap.registerBuffers(ring.fd());
+  if (rc != 0) {
+    printf("cannot register fixed buffers (%s); nothing to measure\n", strerror(-rc));
+    return 0;
+  }
+
+  // The file under test, removed again on exit
+  char path[] = "/tmp/alloc8_io_uring_XXXXXX";
+  int out = mkstemp(path);
+  if (out < 0) {
+    perror("mkstemp");
+    return 1;
+  }
+  unlink(path);
+  {
+    std::vector<uint64_t> chunk(block / sizeof(uint64_t));
+    uint64_t x = 88172645463325252ull;
+    for (size_t done = 0; done < fileBytes; done += block) {
+      for (uint64_t& w : chunk) {
+        x ^= x << 13; x ^= x >> 7; x ^= x << 17;
+        w = x;
+      }
+      if (write(out, chunk.data(), block) != static_cast<ssize_t>(block)) {
+        perror("write");
+        return 1;
+      }
+    }
+    fsync(out);
+  }
+  int file = out;
+  if (direct) {
+    char fdPath[64];
+    snprintf(fdPath, sizeof(fdPath), "/proc/self/fd/%d", out);
+    file = open(fdPath, O_RDONLY | O_DIRECT);
+    if (file < 0) {
+      printf("O_DIRECT unsupported here (%s); using buffered reads\n", strerror(errno));
+      file = out;
+      direct = false;
+    }
+  }
+
+  std::vector<Buffer> heapBuffers(depth);
+  std::vector<Buffer> fixedBuffers(depth);
+  for (size_t i = 0; i < depth; i++) {
+    if (posix_memalign(&heapBuffers[i].data, 4096, block) != 0) {
+      return 1;
+    }
+    heapBuffers[i].index = -1;
+    alloc8::FixedBuffer fb = heap.mallocFixed(block);
+    if (!fb.data) {
+      fprintf(stderr, "fixed buffer heap exhausted\n");
+      return 1;
+    }
+    fixedBuffers[i] = {fb.data, fb.index};
+  }
+
+  printf("file=%zu MiB block=%zu KiB depth=%zu passes=%zu %s\n\n", fileMiB,
+         blockKiB, depth, passes, direct ? "O_DIRECT" : "buffered");
+  printf("%-8s %10s %10s %20s\n", "buffers", "seconds", "MB/s", "checksum");
+
+  // One untimed pass each to warm the page cache and fault in the buffers
+  readAll(ring, file, fileBytes, block, heapBuffers, 1);
+  readAll(ring, file, fileBytes, block, fixedBuffers, 1);
+
+  Result plain = readAll(ring, file, fileBytes, block, heapBuffers, passes);
+  Result fixed = readAll(ring, file, fileBytes, block, fixedBuffers, passes);
+  double mbTotal = double(fileBytes) * passes / 1e6;
+  printf("%-8s %10.3f %10.0f %20llx\n", "heap", plain.seconds, mbTotal / plain.seconds,
+         static_cast<unsigned long long>(plain.sum));
+  printf("%-8s %10.3f %10.0f %20llx\n", "fixed", fixed.seconds, mbTotal / fixed.seconds,
+         static_cast<unsigned long long>(fixed.sum));
+  if (!plain.ok || !fixed.ok || plain.sum != fixed.sum) {
+    fprintf(stderr, "mismatch: fixed-buffer reads returned different data\n");
+    return 1;
+  }
+
+  for (Buffer& b : heapBuffers) {
+    free(b.data);
+  }
+  for (Buffer& b : fixedBuffers) {
+    heap.free(b.data);
+  }
+  heap.unregisterBuffers(ring.fd());
+  if (file != out) {
+    close(file);
+  }
+  close(out);
+  return 0;
+}
@@ -0,0 +1,153 @@
+// alloc8/benchmarks/macro_ast.cpp
+// Macro benchmark: compiler-style AST build and rewrite
+//
+// Each operation builds the AST of a random "function" (statements of
+// nested expressions with identifiers, literals and calls), then runs
+// passes the way a compiler front end would: constant folding (replacing
+// subtrees with fresh nodes), identifier renaming via an interned symbol
+// table, and lowering calls into temporaries. The tree is then destroyed.
+// Node lifetimes are short and sizes mixed, with bursts of frees.
+
+#include "macro_common.h"
+
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace {
+
+struct Node {
+  enum Kind { Literal, Ident, Binary, Call, Assign } kind;
+  int64_t value = 0;
+  char op = '+';
+  std::string name;
+  std::vector<std::unique_ptr<Node>> kids;
+
+  explicit Node(Kind k) : kind(k) {}
+};
+
+using NodePtr = std::unique_ptr<Node>;
+
+NodePtr genExpr(std::mt19937_64& rng, int depth) {
+  unsigned r = static_cast<unsigned>(rng() % 10);
+  if (depth > 5 || r < 3) {
+    if (r & 1) {
+      auto n = std::make_unique<Node>(Node::Literal);
+      n->value = static_cast<int64_t>(rng() % 100);
+      return n;
+    }
+    auto n = std::make_unique<Node>(Node::Ident);
+    n->name = "var_" + std::to_string(rng() % 64);
+    return n;
+  }
+  if (r < 8) {
+    auto n = std::make_unique<Node>(Node::Binary);
+    n->op = "+-*"[rng() % 3];
+    n->kids.push_back(genExpr(rng, depth + 1));
+    n->kids.push_back(genExpr(rng, depth + 1));
+    return n;
+  }
+  auto n = std::make_unique<Node>(Node::Call);
+  n->name = "fn_" + std::to_string(rng() % 32);
+  size_t args = rng() % 5;
+  for (size_t i = 0; i < args; i++) {
+    n->kids.push_back(genExpr(rng, depth + 1));
+  }
+  return n;
+}
+
+NodePtr genFunction(std::mt19937_64& rng) {
+  auto body = std::make_unique<Node>(Node::Call);
+  body->name = "body";
+  size_t stmts = 20 + rng() % 40;
+  for (size_t i = 0; i < stmts; i++) {
+    auto assign = std::make_unique<Node>(Node::Assign);
+    assign->name = "var_" + std::to_string(rng() % 64);
+    assign->kids.push_back(genExpr(rng, 0));
+    body->kids.push_back(std::move(assign));
+  }
+  return body;
+}
+
+// Fold Binary(Literal, Literal) into a new Literal, bottom-up.
+NodePtr fold(NodePtr n) {
+  for (auto& kid : n->kids) {
+    kid = fold(std::move(kid));
+  }
+  if (n->kind == Node::Binary && n->kids[0]->kind == Node::Literal &&
+      n->kids[1]->kind == Node::Literal) {
+    int64_t a = n->kids[0]->value, b = n->kids[1]->value;
+    auto lit = std::make_unique<Node>(Node::Literal);
+    lit->value = (n->op == '+') ? a + b : (n->op == '-') ? a - b : a * b;
+    return lit;
+  }
+  return n;
+}
+
+// Rename identifiers to SSA-style names through a symbol table.
+void rename(Node& n, std::unordered_map<std::string, std::string>& symbols) {
+  if (n.kind == Node::Ident || n.kind == Node::Assign) {
+    auto it = symbols.find(n.name);
+    if (it == symbols.end()) {
+      it = symbols.emplace(n.name, n.name + ".ssa" + std::to_string(symbols.size())).first;
+    }
+    n.name = it->second;
+  }
+  for (auto& kid : n.kids) {
+    rename(*kid, symbols);
+  }
+}
+
+// Hoist call arguments into temporaries: Call(args) -> Ident(tmp) + Assigns.
+void lowerCalls(Node& n, std::vector<NodePtr>& hoisted, size_t& temps) {
+  for (auto& kid : n.kids) {
+    lowerCalls(*kid, hoisted, temps);
+    if (kid->kind == Node::Call) {
+      auto assign = std::make_unique<Node>(Node::Assign);
+      assign->name = "tmp" + std::to_string(temps++);
+      auto ref = std::make_unique<Node>(Node::Ident);
+      ref->name = assign->name;
+      assign->kids.push_back(std::move(kid));
+      hoisted.push_back(std::move(assign));
+      kid = std::move(ref);
+    }
+  }
+}
+
+size_t countNodes(const Node& n) {
+  size_t c = 1;
+  for (auto& kid : n.kids) c += countNodes(*kid);
+  return c;
+}
+
+} // anonymous namespace
+
+int main(int argc, char* argv[]) {
+  bench::MacroOptions opts = bench::parseMacroOptions(argc, argv);
+  const size_t ops = bench::scaled(2000, opts);
+  std::atomic<size_t> checksum{0};
+
+  int rc = bench::runMacro("ast", opts, [&](bench::MacroThread& t) {
+    size_t sum = 0;
+    for (size_t i = 0; i < ops; i++) {
+      t.op([&] {
+        NodePtr fn = fold(genFunction(t.rng()));
+        std::unordered_map<std::string, std::string> symbols;
+        rename(*fn, symbols);
+        std::vector<NodePtr> hoisted;
+        size_t temps = 0;
+        for (auto& stmt : fn->kids) {
+          lowerCalls(*stmt, hoisted, temps);
+        }
+        for (auto& h : hoisted) {
+          fn->kids.push_back(std::move(h));
+        }
+        sum += countNodes(*fn);
+      });
+    }
+    checksum += sum;
+  });
+  fprintf(stderr, "checksum %zu\n", checksum.load());
+  return rc;
+}
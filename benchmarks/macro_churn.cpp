@@ -0,0 +1,61 @@
+// alloc8/benchmarks/macro_churn.cpp
+// Macro benchmark: short-lived worker threads (thread churn)
+//
+// Each operation spawns a worker thread that builds a batch of small and
+// medium objects, frees most of them, and hands the survivors back to its
+// parent, which frees them after the worker has exited. Many thousands of
+// threads come and go over a run, so allocators that give every thread its
+// own heap and never recycle it show up as peak RSS growth; allocators that
+// pool per-thread state stay flat.
+
+#include "macro_common.h"
+
+#include <thread>
+#include <vector>
+
+namespace {
+
+constexpr size_t kObjectsPerWorker = 2000;
+constexpr size_t kSurvivors = 64;  // Objects freed by the parent thread
+
+void workerBody(uint64_t seed, std::vector<void*>* survivors) {
+  std::mt19937_64 rng(seed);
+  std::vector<void*> objects;
+  objects.reserve(kObjectsPerWorker);
+  for (size_t i = 0; i < kObjectsPerWorker; i++) {
+    size_t sz = (rng() % 8 == 0) ? 256 + rng() % 4096 : 8 + rng() % 120;
+    char* p = static_cast<char*>(malloc(sz));
+    p[0] = static_cast<char>(i);
+    objects.push_back(p);
+  }
+  for (size_t i = 0; i < objects.size(); i++) {
+    if (i % (kObjectsPerWorker / kSurvivors) == 0 && survivors->size() < kSurvivors) {
+      survivors->push_back(objects[i]);
+    } else {
+      free(objects[i]);
+    }
+  }
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+  bench::MacroOptions opts = bench::parseMacroOptions(argc, argv);
+  size_t spawns = bench::scaled(300, opts);
+
+  return bench::runMacro("churn", opts, [&](bench::MacroThread& t) {
+    std::vector<void*> survivors;
+    survivors.reserve(kSurvivors);
+    for (size_t i = 0; i < spawns; i++) {
+      uint64_t seed = t.random();
+      t.op([&] {
+        std::thread worker(workerBody, seed, &survivors);
+        worker.join();
+        for (void* p : survivors) {
+          free(p);
+        }
+        survivors.clear();
+      });
+    }
+  });
+}
@@ -0,0 +1,194 @@
+// alloc8/benchmarks/macro_common.h
+// Harness for the macro benchmarks (macro_*.cpp)
+//
+// Each macro benchmark is a plain program that allocates through the
+// system malloc, so any alloc8 allocator can be injected with LD_PRELOAD.
+// The harness runs a per-thread body on N threads, times every operation
+// into a fixed-size latency histogram (no allocation while measuring), and
+// prints one result line:
+//
+//   RESULT <name> threads=<n> ops=<n> seconds=<s> ops_per_sec=<x>
+//          p50_us=<x> p99_us=<x> peak_rss_mb=<x>
+//
+// Common options: --threads N  --seed S  --scale X (multiplies work)
+
+#pragma once
+
+#include "bench_util.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <thread>
+#include <vector>
+
+namespace bench {
+
+struct MacroOptions {
+  int threads = 4;
+  uint64_t seed = 1;
+  double scale = 1.0;
+};
+
+inline MacroOptions parseMacroOptions(int argc, char* argv[]) {
+  MacroOptions opts;
+  for (int i = 1; i < argc; i++) {
+    const char* arg = argv[i];
+    const char* val = (i + 1 < argc) ? argv[i + 1] : nullptr;
+    if (strcmp(arg, "--threads") == 0 && val) {
+      opts.threads = std::max(1, atoi(val));
+      i++;
+    } else if (strcmp(arg, "--seed") == 0 && val) {
+      opts.seed = strtoull(val, nullptr, 10);
+      i++;
+    } else if (strcmp(arg, "--scale") == 0 && val) {
+      opts.scale = atof(val);
+      i++;
+    } else {
+      fprintf(stderr, "usage: %s [--threads N] [--seed S] [--scale X]\n", argv[0]);
+      exit(1);
+    }
+  }
+  return opts;
+}
+
+/**
+ * Log-linear latency histogram: 16 sub-buckets per power of two of
+ * nanoseconds, so percentiles are accurate to ~6%. Fixed size, so
+ * recording never allocates.
+ */
+class LatencyHistogram {
+  static constexpr int kSubBits = 4;
+  static constexpr int kSub = 1 << kSubBits;
+  static constexpr int kBuckets = 64 * kSub;
+  uint64_t counts_[kBuckets] = {};
+  uint64_t total_ = 0;
+
+  static int bucketFor(uint64_t ns) {
+    if (ns < kSub) return static_cast<int>(ns);
+    int exp = 63 - __builtin_clzll(ns);
+    int sub = static_cast<int>((ns >> (exp - kSubBits)) & (kSub - 1));
+    return (exp - kSubBits + 1) * kSub + sub;
+  }
+
+  static uint64_t bucketValue(int bucket) {
+    if (bucket < kSub) return static_cast<uint64_t>(bucket);
+    int exp = bucket / kSub + kSubBits - 1;
+    uint64_t sub = static_cast<uint64_t>(bucket % kSub);
+    return (uint64_t(1) << exp) | (sub << (exp - kSubBits));
+  }
+
+public:
+  void record(uint64_t ns) {
+    counts_[bucketFor(ns)]++;
+    total_++;
+  }
+
+  void merge(const LatencyHistogram& other) {
+    for (int i = 0; i < kBuckets; i++) counts_[i] += other.counts_[i];
+    total_ += other.total_;
+  }
+
+  uint64_t count() const { return total_; }
+
+  // Latency at quantile q (0..1), in nanoseconds
+  uint64_t percentile(double q) const {
+    uint64_t target = static_cast<uint64_t>(q * double(total_));
+    uint64_t seen = 0;
+    for (int i = 0; i < kBuckets; i++) {
+      seen += counts_[i];
+      if (seen > target) return bucketValue(i);
+    }
+    return 0;
+  }
+};
+
+/**
+ * Per-thread state handed to a benchmark body.
+ */
+class MacroThread {
+public:
+  MacroThread(int id, uint64_t seed) : id_(id), rng_(seed) {}
+
+  int id() const { return id_; }
+  std::mt19937_64& rng() { return rng_; }
+  uint64_t random() { return rng_(); }
+  LatencyHistogram& latencies() { return latencies_; }
+
+  // Run one operation and record its latency.
+  template<typename Fn>
+  void op(Fn&& fn) {
+    auto start = std::chrono::steady_clock::now();
+    fn();
+    auto end = std::chrono::steady_clock::now();
+    latencies_.record(static_cast<uint64_t>(
+        std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count()));
+  }
+
+private:
+  int id_;
+  std::mt19937_64 rng_;
+  LatencyHistogram latencies_;
+};
+
+/**
+ * Run `body(MacroThread&)` on opts.threads threads, released together, and
+ * print the RESULT line. Thread i is seeded from opts.seed and i, so runs
+ * are reproducible for a given seed and thread count.
+ */
+template<typename Body>
+int runMacro(const char* name, const MacroOptions& opts, Body&& body) {
+  std::vector<MacroThread*> states(opts.threads);
+  for (int i = 0; i < opts.threads; i++) {
+    states[i] = new MacroThread(i, opts.seed * 0x9E3779B97F4A7C15ull + i);
+  }
+
+  std::atomic<int> ready{0};
+  std::atomic<bool> go{false};
+  std::vector<std::thread> threads;
+  for (int i = 0; i < opts.threads; i++) {
+    threads.emplace_back([&, i] {
+      ready.fetch_add(1);
+      while (!go.load(std::memory_order_acquire)) {
+        std::this_thread::yield();
+      }
+      body(*states[i]);
+    });
+  }
+  while (ready.load() != opts.threads) {
+    std::this_thread::yield();
+  }
+  double start = now();
+  go.store(true, std::memory_order_release);
+  for (auto& t : threads) {
+    t.join();
+  }
+  double seconds = now() - start;
+
+  LatencyHistogram all;
+  for (MacroThread* s : states) {
+    all.merge(s->latencies());
+    delete s;
+  }
+  printf("RESULT %s threads=%d ops=%llu seconds=%.4f ops_per_sec=%.0f "
+         "p50_us=%.2f p99_us=%.2f peak_rss_mb=%.1f\n",
+         name, opts.threads, static_cast<unsigned long long>(all.count()),
+         seconds, double(all.count()) / seconds,
+         double(all.percentile(0.50)) / 1000.0,
+         double(all.percentile(0.99)) / 1000.0,
+         mb(double(peakRssBytes())));
+  return 0;
+}
+
+// Operation count scaled by --scale (at least 1)
+inline size_t scaled(size_t base, const MacroOptions& opts) {
+  double n = double(base) * opts.scale;
+  return n < 1.0 ? 1 : static_cast<size_t>(n);
+}
+
+} // namespace bench
@@ -0,0 +1,93 @@
+// alloc8/benchmarks/macro_graph.cpp
+// Macro benchmark: graph build and breadth-first search
+//
+// Each operation builds a random labeled graph (node objects with string
+// labels and growing adjacency vectors, plus a label index), runs several
+// BFS traversals that allocate their own frontier, visited set and parent
+// map, then tears the graph down. Adjacency vectors grow by repeated
+// reallocation, and teardown frees many mid-sized blocks at once.
+
+#include "macro_common.h"
+
+#include <deque>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+namespace {
+
+struct GraphNode {
+  std::string label;
+  std::vector<GraphNode*> out;
+};
+
+struct Graph {
+  std::vector<std::unique_ptr<GraphNode>> nodes;
+  std::unordered_map<std::string, GraphNode*> byLabel;
+};
+
+std::unique_ptr<Graph> build(std::mt19937_64& rng, size_t n, size_t avgDegree) {
+  auto g = std::make_unique<Graph>();
+  for (size_t i = 0; i < n; i++) {
+    auto node = std::make_unique<GraphNode>();
+    node->label = "node-" + std::to_string(i) + "-" + std::to_string(rng() % 1000);
+    g->byLabel[node->label] = node.get();
+    g->nodes.push_back(std::move(node));
+  }
+  // Mix local and random edges, like a social or dependency graph
+  for (size_t i = 0; i < n * avgDegree; i++) {
+    size_t from = rng() % n;
+    size_t to = (rng() & 1) ? (from + 1 + rng() % 16) % n : rng() % n;
+    g->nodes[from]->out.push_back(g->nodes[to].get());
+  }
+  return g;
+}
+
+// Hop count from src to the farthest reachable node
+size_t bfs(GraphNode* src) {
+  std::unordered_set<GraphNode*> visited;
+  std::unordered_map<GraphNode*, GraphNode*> parent;
+  std::deque<std::pair<GraphNode*, size_t>> frontier;
+  visited.insert(src);
+  frontier.emplace_back(src, 0);
+  size_t depth = 0;
+  while (!frontier.empty()) {
+    auto [node, d] = frontier.front();
+    frontier.pop_front();
+    depth = d;
+    for (GraphNode* next : node->out) {
+      if (visited.insert(next).second) {
+        parent[next] = node;
+        frontier.emplace_back(next, d + 1);
+      }
+    }
+  }
+  return depth;
+}
+
+} // anonymous namespace
+
+int main(int argc, char* argv[]) {
+  bench::MacroOptions opts = bench::parseMacroOptions(argc, argv);
+  const size_t ops = bench::scaled(60, opts);
+  std::atomic<size_t> checksum{0};
+
+  int rc = bench::runMacro("graph", opts, [&](bench::MacroThread& t) {
+    size_t sum = 0;
+    for (size_t i = 0; i < ops; i++) {
+      t.op([&] {
+        size_t n = 2000 + t.random() % 4000;
+        auto g = build(t.rng(), n, 4);
+        for (int s = 0; s < 4; s++) {
+          std::string label = g->nodes[t.random() % n]->label;
+          sum += bfs(g->byLabel[label]);
+        }
+      });
+    }
+    checksum += sum;
+  });
+  fprintf(stderr, "checksum %zu\n", checksum.load());
+  return rc;
+}
@@ -0,0 +1,230 @@
+// alloc8/benchmarks/macro_json.cpp
+// Macro benchmark: JSON parse / serialize round-trip
+//
+// Each thread generates a corpus of random JSON documents (nested objects,
+// arrays, strings, numbers), then repeatedly parses one into a heap-allocated
+// DOM, edits it, serializes it back to a string and frees the DOM. One
+// operation = one parse + edit + serialize + destroy.
+
+#include "macro_common.h"
+
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace {
+
+struct Value {
+  enum Kind { Null, Bool, Number, String, Array, Object } kind = Null;
+  bool boolean = false;
+  double number = 0;
+  std::string str;
+  std::vector<std::unique_ptr<Value>> items;
+  std::map<std::string, std::unique_ptr<Value>> members;
+};
+
+// ─── GENERATOR ────────────────────────────────────────────────────────────────
+
+void genString(std::mt19937_64& rng, std::string& out) {
+  static const char kChars[] = "abcdefghijklmnopqrstuvwxyz0123456789 _-";
+  size_t len = 1 + rng() % 24;
+  out += '"';
+  for (size_t i = 0; i < len; i++) {
+    out += kChars[rng() % (sizeof(kChars) - 1)];
+  }
+  out += '"';
+}
+
+void genValue(std::mt19937_64& rng, int depth, std::string& out) {
+  int kind = (depth > 4) ? static_cast<int>(rng() % 4) : static_cast<int>(rng() % 6);
+  switch (kind) {
+    case 0: out += "null"; break;
+    case 1: out += (rng() & 1) ? "true" : "false"; break;
+    case 2: out += std::to_string(static_cast<int64_t>(rng() % 2000000) - 1000000); break;
+    case 3: genString(rng, out); break;
+    case 4: {
+      out += '[';
+      size_t n = rng() % 8;
+      for (size_t i = 0; i < n; i++) {
+        if (i) out += ',';
+        genValue(rng, depth + 1, out);
+      }
+      out += ']';
+      break;
+    }
+    default: {
+      out += '{';
+      size_t n = 1 + rng() % 8;
+      for (size_t i = 0; i < n; i++) {
+        if (i) out += ',';
+        genString(rng, out);
+        out += ':';
+        genValue(rng, depth + 1, out);
+      }
+      out += '}';
+      break;
+    }
+  }
+}
+
+// ─── PARSER ───────────────────────────────────────────────────────────────────
+
+class Parser {
+  const char* p_;
+
+  void skipWs() {
+    while (*p_ == ' ' || *p_ == '\n' || *p_ == '\t' || *p_ == '\r') p_++;
+  }
+
+  std::string parseString() {
+    std::string s;
+    p_++;  // opening quote
+    while (*p_ && *p_ != '"') {
+      if (*p_ == '\\' && p_[1]) p_++;
+      s += *p_++;
+    }
+    if (*p_) p_++;
+    return s;
+  }
+
+public:
+  explicit Parser(const std::string& text) : p_(text.c_str()) {}
+
+  std::unique_ptr<Value> parse() {
+    skipWs();
+    auto v = std::make_unique<Value>();
+    switch (*p_) {
+      case 'n': v->kind = Value::Null; p_ += 4; break;
+      case 't': v->kind = Value::Bool; v->boolean = true; p_ += 4; break;
+      case 'f': v->kind = Value::Bool; p_ += 5; break;
+      case '"': v->kind = Value::String; v->str = parseString(); break;
+      case '[':
+        v->kind = Value::Array;
+        p_++;
+        skipWs();
+        while (*p_ && *p_ != ']') {
+          v->items.push_back(parse());
+          skipWs();
+          if (*p_ == ',') p_++;
+        }
+        if (*p_) p_++;
+        break;
+      case '{':
+        v->kind = Value::Object;
+        p_++;
+        skipWs();
+        while (*p_ && *p_ != '}') {
+          std::string key = parseString();
+          skipWs();
+          if (*p_ == ':') p_++;
+          v->members[std::move(key)] = parse();
+          skipWs();
+          if (*p_ == ',') p_++;
+          skipWs();
+        }
+        if (*p_) p_++;
+        break;
+      default: {
+        char* end;
+        v->kind = Value::Number;
+        v->number = strtod(p_, &end);
+        p_ = end;
+        break;
+      }
+    }
+    return v;
+  }
+};
+
+// ─── EDIT + SERIALIZE ─────────────────────────────────────────────────────────
+
+// Touch the DOM the way an API handler might: bump numbers, tag objects.
+void edit(Value& v, std::mt19937_64& rng) {
+  switch (v.kind) {
+    case Value::Number: v.number += 1; break;
+    case Value::Array:
+      for (auto& item : v.items) edit(*item, rng);
+      break;
+    case Value::Object:
+      for (auto& kv : v.members) edit(*kv.second, rng);
+      if ((rng() & 3) == 0) {
+        auto tag = std::make_unique<Value>();
+        tag->kind = Value::String;
+        tag->str = "rev-" + std::to_string(rng() % 1000);
+        v.members["_rev"] = std::move(tag);
+      }
+      break;
+    default: break;
+  }
+}
+
+void serialize(const Value& v, std::string& out) {
+  switch (v.kind) {
+    case Value::Null: out += "null"; break;
+    case Value::Bool: out += v.boolean ? "true" : "false"; break;
+    case Value::Number: out += std::to_string(static_cast<int64_t>(v.number)); break;
+    case Value::String: out += '"'; out += v.str; out += '"'; break;
+    case Value::Array: {
+      out += '[';
+      bool first = true;
+      for (auto& item : v.items) {
+        if (!first) out += ',';
+        first = false;
+        serialize(*item, out);
+      }
+      out += ']';
+      break;
+    }
+    case Value::Object: {
+      out += '{';
+      bool first = true;
+      for (auto& kv : v.members) {
+        if (!first) out += ',';
+        first = false;
+        out += '"';
+        out += kv.first;
+        out += "\":";
+        serialize(*kv.second, out);
+      }
+      out += '}';
+      break;
+    }
+  }
+}
+
+} // anonymous namespace
+
+int main(int argc, char* argv[]) {
+  bench::MacroOptions opts = bench::parseMacroOptions(argc, argv);
+  const size_t corpus = 64;
+  const size_t ops = bench::scaled(10000, opts);
+  std::atomic<size_t> checksum{0};
+
+  int rc = bench::runMacro("json", opts, [&](bench::MacroThread& t) {
+    std::vector<std::string> docs(corpus);
+    for (auto& doc : docs) {
+      doc += '{';
+      for (int i = 0; i < 6; i++) {
+        if (i) doc += ',';
+        genString(t.rng(), doc);
+        doc += ':';
+        genValue(t.rng(), 1, doc);
+      }
+      doc += '}';
+    }
+    size_t sum = 0;
+    for (size_t i = 0; i < ops; i++) {
+      t.op([&] {
+        auto dom = Parser(docs[t.random() % corpus]).parse();
+        edit(*dom, t.rng());
+        std::string out;
+        serialize(*dom, out);
+        sum += out.size();
+      });
+    }
+    checksum += sum;
+  });
+  fprintf(stderr, "checksum %zu\n", checksum.load());
+  return rc;
+}
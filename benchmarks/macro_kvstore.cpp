@@ -0,0 +1,138 @@
+// alloc8/benchmarks/macro_kvstore.cpp
+// Macro benchmark: in-memory key-value store with TTL churn
+//
+// A sharded hash map of string keys to variable-size string values shared by
+// all threads. Operations are a seeded mix of GET (60%), SET with a TTL
+// (35%) and DEL (5%), over a skewed key space; every SET may replace a value
+// of a different size, and each shard lazily evicts expired entries, so
+// values are continually freed on threads other than the one that
+// allocated them.
+
+#include "macro_common.h"
+
+#include <list>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+namespace {
+
+constexpr size_t kShards = 64;
+
+struct Entry {
+  std::string value;
+  uint64_t expiry;                         // Logical time
+  std::list<std::string>::iterator order;  // Position in shard's expiry queue
+};
+
+struct alignas(64) Shard {
+  std::mutex lock;
+  std::unordered_map<std::string, Entry> map;
+  std::list<std::string> byInsert;  // Oldest first; approximates expiry order
+};
+
+class Store {
+  Shard shards_[kShards];
+  std::atomic<uint64_t> clock_{0};
+
+  Shard& shardFor(const std::string& key) {
+    return shards_[std::hash<std::string>()(key) % kShards];
+  }
+
+  // Drop up to a few expired entries from the front of the queue.
+  static void evict(Shard& s, uint64_t now) {
+    for (int i = 0; i < 4 && !s.byInsert.empty(); i++) {
+      auto it = s.map.find(s.byInsert.front());
+      if (it == s.map.end() || it->second.expiry > now) {
+        break;
+      }
+      s.byInsert.pop_front();
+      s.map.erase(it);
+    }
+  }
+
+public:
+  uint64_t tick() { return clock_.fetch_add(1, std::memory_order_relaxed); }
+
+  bool get(const std::string& key, std::string& out) {
+    uint64_t now = tick();
+    Shard& s = shardFor(key);
+    std::lock_guard<std::mutex> guard(s.lock);
+    auto it = s.map.find(key);
+    if (it == s.map.end() || it->second.expiry <= now) {
+      return false;
+    }
+    out = it->second.value;
+    return true;
+  }
+
+  void set(const std::string& key, std::string value, uint64_t ttl) {
+    uint64_t now = tick();
+    Shard& s = shardFor(key);
+    std::lock_guard<std::mutex> guard(s.lock);
+    evict(s, now);
+    auto it = s.map.find(key);
+    if (it != s.map.end()) {
+      s.byInsert.erase(it->second.order);
+      it->second.value = std::move(value);
+      it->second.expiry = now + ttl;
+      it->second.order = s.byInsert.insert(s.byInsert.end(), key);
+      return;
+    }
+    auto order = s.byInsert.insert(s.byInsert.end(), key);
+    s.map.emplace(key, Entry{std::move(value), now + ttl, order});
+  }
+
+  void del(const std::string& key) {
+    Shard& s = shardFor(key);
+    std::lock_guard<std::mutex> guard(s.lock);
+    auto it = s.map.find(key);
+    if (it != s.map.end()) {
+      s.byInsert.erase(it->second.order);
+      s.map.erase(it);
+    }
+  }
+};
+
+// Skewed key choice: most traffic goes to a hot 10% of the key space.
+std::string pickKey(std::mt19937_64& rng, size_t keySpace) {
+  size_t k = (rng() % 10 < 8) ? rng() % (keySpace / 10 + 1) : rng() % keySpace;
+  return "user:" + std::to_string(k) + ":session";
+}
+
+std::string makeValue(std::mt19937_64& rng) {
+  // Mostly small values with an occasional large blob
+  size_t len = (rng() % 100 < 95) ? 16 + rng() % 256 : 1024 + rng() % 16384;
+  return std::string(len, static_cast<char>('a' + rng() % 26));
+}
+
+} // anonymous namespace
+
+int main(int argc, char* argv[]) {
+  bench::MacroOptions opts = bench::parseMacroOptions(argc, argv);
+  const size_t ops = bench::scaled(400000, opts);
+  const size_t keySpace = 200000;
+  static Store store;
+  std::atomic<size_t> hits{0};
+
+  int rc = bench::runMacro("kvstore", opts, [&](bench::MacroThread& t) {
+    std::string out;
+    size_t localHits = 0;
+    for (size_t i = 0; i < ops; i++) {
+      t.op([&] {
+        std::string key = pickKey(t.rng(), keySpace);
+        unsigned dice = static_cast<unsigned>(t.random() % 100);
+        if (dice < 60) {
+          localHits += store.get(key, out);
+        } else if (dice < 95) {
+          store.set(key, makeValue(t.rng()), 1000 + t.random() % 200000);
+        } else {
+          store.del(key);
+        }
+      });
+    }
+    hits += localHits;
+  });
+  fprintf(stderr, "hits %zu\n", hits.load());
+  return rc;
+}
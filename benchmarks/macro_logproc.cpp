@@ -0,0 +1,132 @@
+// alloc8/benchmarks/macro_logproc.cpp
+// Macro benchmark: string-heavy log processing
+//
+// Each operation formats a batch of synthetic access-log lines, splits each
+// into fields, normalizes the path (lower-casing, stripping ids), and
+// aggregates per-endpoint counters and byte totals in a hash map keyed by
+// strings. Every few batches the thread emits a text report and resets its
+// aggregates, freeing all of the keys at once.
+
+#include "macro_common.h"
+
+#include <algorithm>
+#include <cctype>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace {
+
+const char* const kMethods[] = {"GET", "POST", "PUT", "DELETE"};
+const char* const kPaths[] = {
+  "/api/v1/Users/", "/api/v1/orders/", "/static/img/", "/api/v2/Search?q=",
+  "/health", "/api/v1/Cart/items/", "/login", "/api/v1/inventory/sku/",
+};
+
+std::string makeLine(std::mt19937_64& rng) {
+  std::string line;
+  line += "10.";
+  line += std::to_string(rng() % 256) + "." + std::to_string(rng() % 256) + ".";
+  line += std::to_string(rng() % 256);
+  line += " - - [18/Oct/2026:12:";
+  line += std::to_string(10 + rng() % 50) + ":" + std::to_string(10 + rng() % 50);
+  line += " +0000] \"";
+  line += kMethods[rng() % 4];
+  line += ' ';
+  line += kPaths[rng() % 8];
+  line += std::to_string(rng() % 100000);
+  line += " HTTP/1.1\" ";
+  line += std::to_string((rng() % 10 < 9) ? 200 : 404 + rng() % 100);
+  line += ' ';
+  line += std::to_string(rng() % 50000);
+  return line;
+}
+
+std::vector<std::string> split(const std::string& line) {
+  std::vector<std::string> fields;
+  std::string cur;
+  bool quoted = false;
+  for (char c : line) {
+    if (c == '"') {
+      quoted = !quoted;
+    } else if (c == ' ' && !quoted) {
+      if (!cur.empty()) fields.push_back(std::move(cur));
+      cur.clear();
+    } else {
+      cur += c;
+    }
+  }
+  if (!cur.empty()) fields.push_back(std::move(cur));
+  return fields;
+}
+
+// "/api/v1/Users/123" -> "get /api/v1/users/:id"
+std::string normalize(const std::string& request) {
+  std::string out;
+  out.reserve(request.size());
+  bool inNumber = false;
+  for (char c : request) {
+    if (c == '?') break;
+    if (isdigit(static_cast<unsigned char>(c)) && !out.empty() && out.back() == '/') {
+      out += ":id";
+      inNumber = true;
+    } else if (inNumber && isdigit(static_cast<unsigned char>(c))) {
+      continue;
+    } else {
+      inNumber = false;
+      out += static_cast<char>(tolower(static_cast<unsigned char>(c)));
+    }
+  }
+  return out;
+}
+
+struct Aggregate {
+  size_t count = 0;
+  size_t bytes = 0;
+  size_t errors = 0;
+};
+
+} // anonymous namespace
+
+int main(int argc, char* argv[]) {
+  bench::MacroOptions opts = bench::parseMacroOptions(argc, argv);
+  const size_t ops = bench::scaled(4000, opts);
+  const size_t linesPerBatch = 64;
+  std::atomic<size_t> reportBytes{0};
+
+  int rc = bench::runMacro("logproc", opts, [&](bench::MacroThread& t) {
+    std::unordered_map<std::string, Aggregate> stats;
+    size_t reported = 0;
+    for (size_t i = 0; i < ops; i++) {
+      t.op([&] {
+        for (size_t l = 0; l < linesPerBatch; l++) {
+          std::vector<std::string> f = split(makeLine(t.rng()));
+          if (f.size() < 8) continue;
+          // Fields: ip - - [time zone] "method path proto" status bytes
+          std::string key = f[5] + " " + normalize(f[6]);
+          Aggregate& a = stats[key];
+          a.count++;
+          a.bytes += strtoul(f[f.size() - 1].c_str(), nullptr, 10);
+          a.errors += f[f.size() - 2][0] != '2';
+        }
+        if (i % 50 == 49) {
+          std::vector<std::pair<std::string, Aggregate>> rows(stats.begin(), stats.end());
+          std::sort(rows.begin(), rows.end(), [](const auto& a, const auto& b) {
+            return a.second.count > b.second.count;
+          });
+          std::string report;
+          for (auto& row : rows) {
+            report += row.first + " " + std::to_string(row.second.count) + " " +
+                      std::to_string(row.second.bytes) + " " +
+                      std::to_string(row.second.errors) + "\n";
+          }
+          reported += report.size();
+          stats.clear();
+        }
+      });
+    }
+    reportBytes += reported;
+  });
+  fprintf(stderr, "report bytes %zu\n", reportBytes.load());
+  return rc;
+}
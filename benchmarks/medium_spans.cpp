@@ -0,0 +1,150 @@
+// alloc8/benchmarks/medium_spans.cpp
+// Medium-size churn (256 KiB - 32 MiB): time, page faults and fragmentation
+//
+// Keeps a live set of about [live-MiB] of medium blocks and replaces a
+// random one per op, writing one byte to every page of each new block as a
+// program filling a buffer would. Sizes are log-uniform, 80% in
+// 256 KiB - 2 MiB and 20% in 2 - 32 MiB. Four heaps serve the blocks:
+//
+//   coalescing   CoalescingSpanHeap: best-fit runs inside 64 MiB chunks
+//   mmap-cache   MmapCacheHeap: a mapping per block, freed ones cached
+//   span-heap    SpanHeap's large path: a mapping per block, unmapped on free
+//   system       malloc/free of the C library
+//
+// Reports us per op, minor page faults per op, peak RSS over peak live
+// bytes (fragmentation and cached memory both show up here), and RSS left
+// once every block is freed (after two decay() ticks for coalescing).
+//
+// Usage: medium_spans [ops] [live-MiB]
+
+#include "bench_util.h"
+
+#include <alloc8/coalescing_span_heap.h>
+#include <alloc8/mmap_cache_heap.h>
+#include <alloc8/span_heap.h>
+
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <random>
+#include <vector>
+
+namespace {
+
+struct SystemHeap {
+  void* malloc(size_t sz) { return ::malloc(sz); }
+  void free(void* ptr) { ::free(ptr); }
+};
+
+struct Result {
+  double usPerOp;
+  double faultsPerOp;
+  double peakRatio;
+  size_t rssAfterFree;
+};
+
+size_t pickSize(std::mt19937_64& rng) {
+  std::uniform_real_distribution<double> unit(0.0, 1.0);
+  double lo = unit(rng) < 0.8 ? 18.0 : 21.0;  // log2(256 KiB), log2(2 MiB)
+  double hi = lo == 18.0 ? 21.0 : 25.0;
+  return static_cast<size_t>(std::exp2(lo + (hi - lo) * unit(rng)));
+}
+
+void touch(void* p, size_t sz) {
+  auto* bytes = static_cast<volatile char*>(p);
+  for (size_t off = 0; off < sz; off += 4096) {
+    bytes[off] = 1;
+  }
+}
+
+template<typename Heap>
+Result run(size_t ops, size_t liveTarget) {
+  auto heap = std::make_unique<Heap>();
+  std::mt19937_64 rng(7);
+  struct Block {
+    void* ptr;
+    size_t size;
+  };
+  std::vector<Block> live;
+  size_t liveBytes = 0;
+  size_t peakLive = 0;
+  size_t rssBase = bench::rssBytes();
+  size_t peakRss = 0;
+
+  double t0 = bench::now();
+  long f0 = bench::minorFaults();
+  for (size_t i = 0; i < ops; i++) {
+    if (liveBytes > liveTarget && !live.empty()) {
+      size_t victim = rng() % live.size();
+      heap->free(live[victim].ptr);
+      liveBytes -= live[victim].size;
+      live[victim] = live.back();
+      live.pop_back();
+    }
+    size_t sz = pickSize(rng);
+    void* p = heap->malloc(sz);
+    if (!p) {
+      fprintf(stderr, "allocation of %zu bytes failed\n", sz);
+      exit(1);
+    }
+    touch(p, sz);
+    live.push_back({p, sz});
+    liveBytes += sz;
+    if (liveBytes > peakLive) {
+      peakLive = liveBytes;
+    }
+    if (i % 64 == 0) {
+      size_t rss = bench::rssBytes() - rssBase;
+      peakRss = rss > peakRss ? rss : peakRss;
+    }
+  }
+  double t1 = bench::now();
+  long f1 = bench::minorFaults();
+
+  for (const Block& b : live) {
+    heap->free(b.ptr);
+  }
+  if constexpr (requires { heap->decay(); }) {
+    heap->decay();
+    heap->decay();
+  }
+  Result r;
+  r.usPerOp = (t1 - t0) * 1e6 / double(ops);
+  r.faultsPerOp = double(f1 - f0) / double(ops);
+  r.peakRatio = double(peakRss) / double(peakLive);
+  r.rssAfterFree = bench::rssBytes() - rssBase;
+  if constexpr (requires { heap->releaseCache(); }) {
+    heap->releaseCache();
+  }
+  return r;
+}
+
+template<typename Heap>
+void report(const char* name, size_t ops, size_t liveTarget) {
+  Result r = run<Heap>(ops, liveTarget);
+  printf("%-12s %10.1f %12.1f %14.2f %16.1f\n", name, r.usPerOp, r.faultsPerOp,
+         r.peakRatio, bench::mb(double(r.rssAfterFree)));
+  fflush(stdout);
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+  size_t ops = (argc > 1) ? strtoul(argv[1], nullptr, 10) : 20000;
+  size_t liveMiB = (argc > 2) ? strtoul(argv[2], nullptr, 10) : 256;
+  if (ops == 0 || liveMiB == 0) {
+    fprintf(stderr, "usage: %s [ops] [live-MiB]\n", argv[0]);
+    return 1;
+  }
+  size_t liveTarget = liveMiB << 20;
+
+  printf("ops=%zu live=%zu MiB sizes=256 KiB-32 MiB\n\n", ops, liveMiB);
+  printf("%-12s %10s %12s %14s %16s\n", "heap", "us/op", "faults/op",
+         "peak RSS/live", "RSS freed (MB)");
+  report<alloc8::CoalescingSpanHeap<>>("coalescing", ops, liveTarget);
+  report<alloc8::MmapCacheHeap<>>("mmap-cache", ops, liveTarget);
+  report<alloc8::SpanHeap<>>("span-heap", ops, liveTarget);
+  report<SystemHeap>("system", ops, liveTarget);
+  return 0;
+}
@@ -0,0 +1,157 @@
+// alloc8/benchmarks/prefork_dirty.cpp
+// Prefork server pattern: in-band vs out-of-band slab metadata
+//
+// A parent builds a heap of small objects and forks workers. Each worker
+// frees the inherited objects (as a request handler tearing down shared
+// state would). With an in-band free list every free() writes into the
+// object's page, so the child copies nearly the whole heap; with
+// out-of-band metadata only the metadata pages are copied.
+//
+// The parent then bulk-frees most objects (one survivor per `keepEvery`)
+// and reports RSS, showing what OutOfBandSlab<true> returns to the OS from
+// spans that are still partially in use.
+//
+// Usage: prefork_dirty [objects] [objSize] [children] [keepEvery]
+
+#include "bench_util.h"
+
+#include <alloc8/span_heap.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include <random>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <vector>
+
+namespace {
+
+struct Config {
+  size_t objects = 1 << 20;
+  size_t objSize = 64;
+  int children = 4;
+  size_t keepEvery = 300;
+};
+
+struct Result {
+  double childDirtyMB = 0;   // Average pages copied (CoW) per child
+  double rssFullMB = 0;      // RSS delta with every object live
+  double rssAfterFreeMB = 0; // RSS delta after the bulk free
+  double freeSeconds = 0;    // Parent bulk-free time
+};
+
+template<typename Heap>
+Result run(const Config& cfg, const std::vector<size_t>& order) {
+  Result r;
+  size_t rssBase = bench::rssBytes();
+
+  // Heaps hold many cache-line-aligned locks; keep them off the stack.
+  alignas(Heap) static unsigned char storage[sizeof(Heap)];
+  Heap* heap = new (storage) Heap();
+
+  std::vector<void*> ptrs(cfg.objects);
+  for (size_t i = 0; i < cfg.objects; i++) {
+    ptrs[i] = heap->malloc(cfg.objSize);
+    if (!ptrs[i]) {
+      fprintf(stderr, "allocation failed\n");
+      exit(1);
+    }
+    memset(ptrs[i], static_cast<int>(i), cfg.objSize);
+  }
+  r.rssFullMB = bench::mb(double(bench::rssBytes() - rssBase));
+
+  // Children free everything they inherited and report the pages they copied.
+  double dirtyTotal = 0;
+  int reported = 0;
+  for (int c = 0; c < cfg.children; c++) {
+    int fds[2];
+    if (pipe(fds) != 0) {
+      perror("pipe");
+      exit(1);
+    }
+    pid_t pid = fork();
+    if (pid == 0) {
+      close(fds[0]);
+      // Count copy-on-write faults rather than diffing Private_Dirty,
+      // which drops again as emptied spans are unmapped.
+      long before = bench::minorFaults();
+      for (size_t idx : order) {
+        heap->free(ptrs[idx]);
+      }
+      long after = bench::minorFaults();
+      long delta = (before < 0 || after < 0)
+                   ? -1 : (after - before) * sysconf(_SC_PAGESIZE);
+      ssize_t n = write(fds[1], &delta, sizeof(delta));
+      (void)n;
+      _exit(0);
+    }
+    close(fds[1]);
+    long delta = -1;
+    if (read(fds[0], &delta, sizeof(delta)) == sizeof(delta) && delta >= 0) {
+      dirtyTotal += double(delta);
+      reported++;
+    }
+    close(fds[0]);
+    waitpid(pid, nullptr, 0);
+  }
+  r.childDirtyMB = reported ? bench::mb(dirtyTotal / reported) : -1;
+
+  // Parent bulk free, leaving sparse survivors in most spans.
+  double t0 = bench::now();
+  for (size_t idx : order) {
+    if (idx % cfg.keepEvery != 0) {
+      heap->free(ptrs[idx]);
+    }
+  }
+  r.freeSeconds = bench::now() - t0;
+  size_t rss = bench::rssBytes();
+  r.rssAfterFreeMB = rss > rssBase ? bench::mb(double(rss - rssBase)) : 0;
+
+  for (size_t i = 0; i < cfg.objects; i += cfg.keepEvery) {
+    heap->free(ptrs[i]);
+  }
+  heap->~Heap();
+  return r;
+}
+
+void report(const char* name, const Result& r) {
+  printf("%-22s %14.1f %12.1f %14.1f %10.3f\n", name, r.childDirtyMB,
+         r.rssFullMB, r.rssAfterFreeMB, r.freeSeconds);
+}
+
+} // anonymous namespace
+
+int main(int argc, char* argv[]) {
+  Config cfg;
+  if (argc > 1) cfg.objects = strtoul(argv[1], nullptr, 10);
+  if (argc > 2) cfg.objSize = strtoul(argv[2], nullptr, 10);
+  if (argc > 3) cfg.children = atoi(argv[3]);
+  if (argc > 4) cfg.keepEvery = strtoul(argv[4], nullptr, 10);
+  if (cfg.objects == 0 || cfg.objSize == 0 || cfg.keepEvery == 0) {
+    fprintf(stderr, "usage: %s [objects] [objSize] [children] [keepEvery]\n", argv[0]);
+    return 1;
+  }
+
+  // Free in a fixed random order so both layouts see the same pattern.
+  std::vector<size_t> order(cfg.objects);
+  for (size_t i = 0; i < cfg.objects; i++) order[i] = i;
+  std::shuffle(order.begin(), order.end(), std::mt19937_64(42));
+
+  printf("objects=%zu size=%zu children=%d keepEvery=%zu\n\n",
+         cfg.objects, cfg.objSize, cfg.children, cfg.keepEvery);
+  printf("%-22s %14s %12s %14s %10s\n", "layout", "child copy MB",
+         "live RSS MB", "RSS after free", "free s");
+
+  using alloc8::OSPageSource;
+  using alloc8::SizeClasses;
+  report("in-band", run<alloc8::SpanHeap<OSPageSource, SizeClasses,
+                                         alloc8::InBandFreeList>>(cfg, order));
+  report("out-of-band", run<alloc8::SpanHeap<OSPageSource, SizeClasses,
+                                             alloc8::OutOfBandSlab<>>>(cfg, order));
+  report("out-of-band+release", run<alloc8::SpanHeap<OSPageSource, SizeClasses,
+                                                     alloc8::OutOfBandSlab<true>>>(cfg, order));
+  return 0;
+}
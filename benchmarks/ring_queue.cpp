@@ -0,0 +1,173 @@
+// alloc8/benchmarks/ring_queue.cpp
+// Producer/consumer message queue: RingHeap vs the default heap
+//
+// A producer thread allocates messages of 32 B - 2 KiB, fills them and
+// pushes them through a bounded queue of 4096 entries; a consumer thread
+// checks and frees them, so payloads die in allocation order. Each
+// allocator runs twice:
+//
+//   fifo        every message is freed when it is consumed
+//   stragglers  every 20000th message is kept by the consumer until the
+//               end, which holds a ring's tail back
+//
+// Heaps:
+//
+//   ring        RingHeap<16 MiB> spilling to SpanHeap
+//   span-heap   ThreadCache<SpanHeap<>>, as in examples/span_heap
+//   system      malloc/free of the C library
+//
+// Reports million messages per second, RSS growth over the run and, for
+// the ring, how many allocations spilled to the fallback.
+//
+// Usage: ring_queue [messages]
+
+#include "bench_util.h"
+
+#include <alloc8/ansi_wrapper.h>
+#include <alloc8/ring_heap.h>
+#include <alloc8/span_heap.h>
+#include <alloc8/thread_cache.h>
+
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <thread>
+#include <vector>
+
+namespace {
+
+constexpr size_t kQueue = 4096;
+constexpr size_t kStraggleEvery = 20000;
+
+struct SystemHeap {
+  void* malloc(size_t sz) { return ::malloc(sz); }
+  void free(void* ptr) { ::free(ptr); }
+  size_t spills() const { return 0; }
+};
+
+using Ring = alloc8::ANSIWrapper<alloc8::RingHeap<(16 << 20)>>;
+using Default = alloc8::ANSIWrapper<alloc8::ThreadCache<alloc8::SpanHeap<>>>;
+
+// Single-producer single-consumer queue of pointers
+class Queue {
+  void* slots_[kQueue];
+  alignas(64) std::atomic<size_t> head_{0};
+  alignas(64) std::atomic<size_t> tail_{0};
+
+public:
+  void push(void* p) {
+    size_t h = head_.load(std::memory_order_relaxed);
+    while (h - tail_.load(std::memory_order_acquire) == kQueue) {
+      std::this_thread::yield();
+    }
+    slots_[h % kQueue] = p;
+    head_.store(h + 1, std::memory_order_release);
+  }
+
+  void* pop() {
+    size_t t = tail_.load(std::memory_order_relaxed);
+    while (head_.load(std::memory_order_acquire) == t) {
+      std::this_thread::yield();
+    }
+    void* p = slots_[t % kQueue];
+    tail_.store(t + 1, std::memory_order_release);
+    return p;
+  }
+};
+
+struct Result {
+  double mmsgPerSec;
+  size_t rssGrowth;
+  size_t spills;
+};
+
+template<typename Heap>
+Result run(Heap& heap, size_t messages, bool stragglers) {
+  auto queue = std::make_unique<Queue>();
+  size_t rss0 = bench::rssBytes();
+  size_t spills0 = 0;
+  if constexpr (requires { heap.spills(); }) {
+    spills0 = heap.spills();
+  }
+  double t0 = bench::now();
+
+  std::thread consumer([&] {
+    std::vector<void*> kept;
+    for (size_t i = 0; i < messages; i++) {
+      auto* msg = static_cast<uint32_t*>(queue->pop());
+      if (msg[0] != i || msg[1] != (i ^ 0x9e3779b9u)) {
+        fprintf(stderr, "message %zu corrupted\n", i);
+        exit(1);
+      }
+      if (stragglers && i % kStraggleEvery == 0) {
+        kept.push_back(msg);
+      } else {
+        heap.free(msg);
+      }
+    }
+    for (void* p : kept) {
+      heap.free(p);
+    }
+    if constexpr (requires { heap.threadCleanup(); }) {
+      heap.threadCleanup();
+    }
+  });
+
+  uint64_t x = 88172645463325252ull;
+  for (size_t i = 0; i < messages; i++) {
+    x ^= x << 13;
+    x ^= x >> 7;
+    x ^= x << 17;
+    size_t sz = 32 + (x % 2017);
+    auto* msg = static_cast<uint32_t*>(heap.malloc(sz));
+    memset(msg, 0x5a, sz);
+    msg[0] = static_cast<uint32_t>(i);
+    msg[1] = static_cast<uint32_t>(i) ^ 0x9e3779b9u;
+    queue->push(msg);
+  }
+  consumer.join();
+  double t1 = bench::now();
+
+  Result r;
+  r.mmsgPerSec = double(messages) / (t1 - t0) / 1e6;
+  size_t rss1 = bench::rssBytes();
+  r.rssGrowth = rss1 > rss0 ? rss1 - rss0 : 0;
+  r.spills = 0;
+  if constexpr (requires { heap.spills(); }) {
+    r.spills = heap.spills() - spills0;
+  }
+  return r;
+}
+
+template<typename Heap>
+void report(const char* name, size_t messages) {
+  static Heap heap;
+  Result fifo = run(heap, messages, false);
+  Result straggle = run(heap, messages, true);
+  printf("%-10s %10.2f %10.1f %12.2f %10.1f %10zu\n", name,
+         fifo.mmsgPerSec, bench::mb(double(fifo.rssGrowth)),
+         straggle.mmsgPerSec, bench::mb(double(straggle.rssGrowth)), straggle.spills);
+  fflush(stdout);
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+  size_t messages = (argc > 1) ? strtoul(argv[1], nullptr, 10) : 2000000;
+  if (messages == 0) {
+    fprintf(stderr, "usage: %s [messages]\n", argv[0]);
+    return 1;
+  }
+
+  printf("messages=%zu size=32-2048 B queue=%zu straggler every %zu\n\n", messages,
+         kQueue, kStraggleEvery);
+  printf("%-10s %21s %34s\n", "", "fifo", "stragglers");
+  printf("%-10s %10s %10s %12s %10s %10s\n", "heap", "Mmsg/s", "RSS MB",
+         "Mmsg/s", "RSS MB", "spills");
+  report<Ring>("ring", messages);
+  report<Default>("span-heap", messages);
+  report<SystemHeap>("system", messages);
+  return 0;
+}
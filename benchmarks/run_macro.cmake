@@ -0,0 +1,101 @@
+# alloc8/benchmarks/run_macro.cmake
+# Run the macro benchmarks under the system allocator and every preload
+# allocator, and tabulate throughput, p99 latency and peak RSS.
+#
+# Normally run via the alloc8_macro_bench target. Directly:
+#   cmake -DALLOC8_MACRO_BIN_DIR=<dir with macro_* binaries> \
+#         -DALLOC8_MACRO_PRELOADS="span_heap=/path/libspan_heap.so,..." \
+#         [-DALLOC8_MACRO_ARGS="--threads 4 --seed 1"] \
+#         [-DALLOC8_MACRO_REPORT=<file>] -P run_macro.cmake
+
+cmake_minimum_required(VERSION 3.15)
+
+if(NOT ALLOC8_MACRO_BIN_DIR)
+  message(FATAL_ERROR "Set ALLOC8_MACRO_BIN_DIR")
+endif()
+if(NOT DEFINED ALLOC8_MACRO_ARGS)
+  set(ALLOC8_MACRO_ARGS "--threads 4 --seed 1")
+endif()
+if(NOT ALLOC8_MACRO_REPORT)
+  set(ALLOC8_MACRO_REPORT ${ALLOC8_MACRO_BIN_DIR}/macro_report.tsv)
+endif()
+
+if(APPLE)
+  set(preload_var DYLD_INSERT_LIBRARIES)
+else()
+  set(preload_var LD_PRELOAD)
+endif()
+
+set(workloads json kvstore ast logproc graph churn)
+separate_arguments(bench_args UNIX_COMMAND "${ALLOC8_MACRO_ARGS}")
+
+# "system" (no preload) first, then each name=path pair
+set(allocators "system=")
+if(ALLOC8_MACRO_PRELOADS)
+  string(REPLACE "," ";" preloads "${ALLOC8_MACRO_PRELOADS}")
+  list(APPEND allocators ${preloads})
+endif()
+
+set(report "allocator\tworkload\tops_per_sec\tp99_us\tpeak_rss_mb\n")
+set(table "")
+string(APPEND table "allocator        workload      ops/s        p99 us   peak RSS MB\n")
+
+foreach(entry IN LISTS allocators)
+  string(FIND "${entry}" "=" eq)
+  string(SUBSTRING "${entry}" 0 ${eq} name)
+  math(EXPR path_start "${eq} + 1")
+  string(SUBSTRING "${entry}" ${path_start} -1 lib)
+  if(lib)
+    set(env_args ${CMAKE_COMMAND} -E env "${preload_var}=${lib}")
+  else()
+    set(env_args "")
+  endif()
+
+  foreach(workload IN LISTS workloads)
+    set(exe ${ALLOC8_MACRO_BIN_DIR}/macro_${workload})
+    if(NOT EXISTS ${exe})
+      continue()
+    endif()
+    execute_process(
+      COMMAND ${env_args} ${exe} ${bench_args}
+      RESULT_VARIABLE rv
+      OUTPUT_VARIABLE output
+      ERROR_QUIET
+    )
+    set(ops "-")
+    set(p99 "-")
+    set(rss "-")
+    if(rv EQUAL 0 AND output MATCHES "ops_per_sec=([0-9.]+) .*p99_us=([0-9.]+) peak_rss_mb=([0-9.]+)")
+      set(ops ${CMAKE_MATCH_1})
+      set(p99 ${CMAKE_MATCH_2})
+      set(rss ${CMAKE_MATCH_3})
+    else()
+      message(WARNING "macro_${workload} failed under ${name} (${rv})")
+    endif()
+    string(APPEND report "${name}\t${workload}\t${ops}\t${p99}\t${rss}\n")
+
+    # Fixed-width row for the console
+    set(row "")
+    foreach(col name workload ops p99 rss)
+      set(cell "${${col}}")
+      if(col STREQUAL "name")
+        set(width 17)
+      elseif(col STREQUAL "workload")
+        set(width 14)
+      else()
+        set(width 13)
+      endif()
+      string(LENGTH "${cell}" len)
+      while(len LESS width)
+        string(APPEND cell " ")
+        math(EXPR len "${len} + 1")
+      endwhile()
+      string(APPEND row "${cell}")
+    endforeach()
+    string(APPEND table "${row}\n")
+  endforeach()
+endforeach()
+
+file(WRITE ${ALLOC8_MACRO_REPORT} "${report}")
+message(STATUS "alloc8 macro benchmarks (${ALLOC8_MACRO_ARGS})\n${table}")
+message(STATUS "Report written to ${ALLOC8_MACRO_REPORT}")
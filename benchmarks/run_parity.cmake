@@ -0,0 +1,190 @@
+# alloc8/benchmarks/run_parity.cmake
+# Run the same benchmarks under a native build and an alloc8 build of each
+# allocator, and tabulate per-entry-point instruction counts, throughput and
+# the alloc8-vs-native delta.
+#
+# Normally run via the alloc8_parity_bench target. Directly:
+#   cmake -DALLOC8_PARITY_BIN_DIR=<dir with entry_cost and macro_* binaries> \
+#         -DALLOC8_PARITY_PAIRS="hoard=/path/libhoard_native.so|/path/libhoard_alloc8.so,..." \
+#         [-DALLOC8_PARITY_THREADTEST=/path/threadtest] \
+#         [-DALLOC8_PARITY_ARGS="--threads 4 --seed 1"] \
+#         [-DALLOC8_PARITY_REPORT=<file>] -P run_parity.cmake
+#
+# Deltas are (alloc8 - native) / native. For instructions, ns and seconds a
+# negative delta means alloc8 is cheaper; for ops/s a positive one does.
+
+cmake_minimum_required(VERSION 3.15)
+
+if(NOT ALLOC8_PARITY_BIN_DIR)
+  message(FATAL_ERROR "Set ALLOC8_PARITY_BIN_DIR")
+endif()
+if(NOT ALLOC8_PARITY_PAIRS)
+  message(FATAL_ERROR "Set ALLOC8_PARITY_PAIRS (no native/alloc8 pairs were built)")
+endif()
+if(NOT DEFINED ALLOC8_PARITY_ARGS)
+  set(ALLOC8_PARITY_ARGS "--threads 4 --seed 1")
+endif()
+if(NOT ALLOC8_PARITY_REPORT)
+  set(ALLOC8_PARITY_REPORT ${ALLOC8_PARITY_BIN_DIR}/parity_report.tsv)
+endif()
+
+set(workloads json kvstore ast logproc graph churn)
+separate_arguments(bench_args UNIX_COMMAND "${ALLOC8_PARITY_ARGS}")
+
+# ─── HELPERS ──────────────────────────────────────────────────────────────────
+
+# Decimal string -> integer thousandths (empty if not a number)
+function(parity_fixed value out)
+  if(NOT value MATCHES "^([0-9]+)(\\.([0-9]*))?$")
+    set(${out} "" PARENT_SCOPE)
+    return()
+  endif()
+  set(whole ${CMAKE_MATCH_1})
+  set(frac "${CMAKE_MATCH_3}000")
+  string(SUBSTRING "${frac}" 0 3 frac)
+  string(REGEX REPLACE "^0+([0-9])" "\\1" whole "${whole}")
+  string(REGEX REPLACE "^0+([0-9])" "\\1" frac "${frac}")
+  math(EXPR fixed "${whole} * 1000 + ${frac}")
+  set(${out} ${fixed} PARENT_SCOPE)
+endfunction()
+
+# Percentage change from `native` to `alloc8`, one decimal ("+1.5%")
+function(parity_delta native alloc8 out)
+  parity_fixed("${native}" n)
+  parity_fixed("${alloc8}" a)
+  if(n STREQUAL "" OR a STREQUAL "" OR n EQUAL 0)
+    set(${out} "-" PARENT_SCOPE)
+    return()
+  endif()
+  math(EXPR tenths "(${a} - ${n}) * 1000 / ${n}")
+  set(sign "+")
+  if(tenths LESS 0)
+    set(sign "-")
+    math(EXPR tenths "0 - ${tenths}")
+  endif()
+  math(EXPR whole "${tenths} / 10")
+  math(EXPR frac "${tenths} % 10")
+  set(${out} "${sign}${whole}.${frac}%" PARENT_SCOPE)
+endfunction()
+
+# Run `exe` with `lib` preloaded; sets <out> to stdout, or "" on failure
+function(parity_run lib out)
+  execute_process(
+    COMMAND ${CMAKE_COMMAND} -E env "LD_PRELOAD=${lib}" ${ARGN}
+    RESULT_VARIABLE rv
+    OUTPUT_VARIABLE output
+    ERROR_QUIET
+  )
+  if(NOT rv EQUAL 0)
+    list(GET ARGN 0 exe)
+    get_filename_component(exe ${exe} NAME)
+    message(WARNING "${exe} failed under ${lib} (${rv})")
+    set(output "")
+  endif()
+  set(${out} "${output}" PARENT_SCOPE)
+endfunction()
+
+# Collect every metric for one library as parallel lists of keys
+# ("metric:unit") and values
+function(parity_measure lib prefix)
+  set(keys "")
+  set(values "")
+
+  set(exe ${ALLOC8_PARITY_BIN_DIR}/entry_cost)
+  if(EXISTS ${exe})
+    parity_run("${lib}" output ${exe})
+    string(REGEX MATCHALL "ENTRY name=[^ ]+ insns=[^ ]+ ns=[0-9.]+" entries "${output}")
+    foreach(entry IN LISTS entries)
+      string(REGEX MATCH "name=([^ ]+) insns=([^ ]+) ns=([0-9.]+)" _ "${entry}")
+      list(APPEND keys "${CMAKE_MATCH_1}:insns/call" "${CMAKE_MATCH_1}:ns/call")
+      list(APPEND values "${CMAKE_MATCH_2}" "${CMAKE_MATCH_3}")
+    endforeach()
+  endif()
+
+  foreach(workload IN LISTS workloads)
+    set(exe ${ALLOC8_PARITY_BIN_DIR}/macro_${workload})
+    if(NOT EXISTS ${exe})
+      continue()
+    endif()
+    parity_run("${lib}" output ${exe} ${bench_args})
+    set(ops "-")
+    if(output MATCHES "ops_per_sec=([0-9.]+)")
+      set(ops ${CMAKE_MATCH_1})
+    endif()
+    list(APPEND keys "macro_${workload}:ops/s")
+    list(APPEND values "${ops}")
+  endforeach()
+
+  if(ALLOC8_PARITY_THREADTEST AND EXISTS ${ALLOC8_PARITY_THREADTEST})
+    parity_run("${lib}" output ${ALLOC8_PARITY_THREADTEST} 4 1000 10000 0 8)
+    set(seconds "-")
+    if(output MATCHES "Time elapsed = ([0-9.]+)")
+      set(seconds ${CMAKE_MATCH_1})
+    endif()
+    list(APPEND keys "threadtest:seconds")
+    list(APPEND values "${seconds}")
+  endif()
+
+  set(${prefix}_keys "${keys}" PARENT_SCOPE)
+  set(${prefix}_values "${values}" PARENT_SCOPE)
+endfunction()
+
+# Pad `text` with spaces to `width`
+function(parity_pad text width out)
+  string(LENGTH "${text}" len)
+  while(len LESS width)
+    string(APPEND text " ")
+    math(EXPR len "${len} + 1")
+  endwhile()
+  set(${out} "${text}" PARENT_SCOPE)
+endfunction()
+
+# ─── RUN PAIRS ────────────────────────────────────────────────────────────────
+
+set(report "allocator\tmetric\tunit\tnative\talloc8\tdelta\n")
+set(table "")
+string(APPEND table "allocator  metric              unit         native       alloc8       delta\n")
+
+string(REPLACE "," ";" pairs "${ALLOC8_PARITY_PAIRS}")
+foreach(pair IN LISTS pairs)
+  if(NOT pair MATCHES "^([^=]+)=([^|]+)\\|(.+)$")
+    message(WARNING "Ignoring malformed pair '${pair}'")
+    continue()
+  endif()
+  set(name ${CMAKE_MATCH_1})
+  set(native_lib ${CMAKE_MATCH_2})
+  set(alloc8_lib ${CMAKE_MATCH_3})
+
+  parity_measure("${native_lib}" native)
+  parity_measure("${alloc8_lib}" alloc8)
+
+  list(LENGTH native_keys count)
+  if(count EQUAL 0)
+    continue()
+  endif()
+  math(EXPR last "${count} - 1")
+  foreach(i RANGE ${last})
+    list(GET native_keys ${i} key)
+    list(GET native_values ${i} native_value)
+    string(REGEX REPLACE ":.*$" "" metric "${key}")
+    string(REGEX REPLACE "^.*:" "" unit "${key}")
+    set(alloc8_value "-")
+    list(FIND alloc8_keys "${key}" j)
+    if(j GREATER -1)
+      list(GET alloc8_values ${j} alloc8_value)
+    endif()
+    parity_delta("${native_value}" "${alloc8_value}" delta)
+    string(APPEND report "${name}\t${metric}\t${unit}\t${native_value}\t${alloc8_value}\t${delta}\n")
+
+    parity_pad("${name}" 11 c1)
+    parity_pad("${metric}" 20 c2)
+    parity_pad("${unit}" 13 c3)
+    parity_pad("${native_value}" 13 c4)
+    parity_pad("${alloc8_value}" 13 c5)
+    string(APPEND table "${c1}${c2}${c3}${c4}${c5}${delta}\n")
+  endforeach()
+endforeach()
+
+file(WRITE ${ALLOC8_PARITY_REPORT} "${report}")
+message(STATUS "alloc8 parity (native vs alloc8, ${ALLOC8_PARITY_ARGS})\n${table}")
+message(STATUS "Report written to ${ALLOC8_PARITY_REPORT}")
@@ -0,0 +1,220 @@
+// alloc8/benchmarks/snapshot_save.cpp
+// Background save of a multi-GB heap: fork() vs SnapshotPageSource
+//
+// Builds [heap-GiB] of 256-byte records, then saves them the way Redis's
+// BGSAVE does: something reads a consistent image of every record (here:
+// checksums it) while the main thread keeps updating [update-%] of the
+// records at random. Two ways to get the image:
+//
+//   fork       ThreadCache<SpanHeap<>>; fork() and the child reads its
+//              copy-on-write image of the parent, then exits
+//   snapshot   ThreadCache<SpanHeap<SnapshotPageSource<>>>; snapshot()
+//              and a thread reads the view, then merge() in the main thread
+//
+// Reports the pause of the call that starts the save (fork() or
+// snapshot()), how long the save ran, ns per update made during the save
+// (copy-on-write faults land here), MB of pages copied because of those
+// updates, and the merge() pause. Both check the saved checksum against
+// the one taken before the updates started.
+//
+// Usage: snapshot_save [heap-GiB] [update-%]
+
+#include "bench_util.h"
+
+#include <alloc8/ansi_wrapper.h>
+#include <alloc8/snapshot_page_source.h>
+#include <alloc8/span_heap.h>
+#include <alloc8/thread_cache.h>
+
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <random>
+#include <sys/wait.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+namespace {
+
+constexpr size_t kRecordBytes = 256;
+constexpr size_t kWords = kRecordBytes / sizeof(uint64_t);
+
+using ForkHeap = alloc8::ANSIWrapper<alloc8::ThreadCache<alloc8::SpanHeap<>>>;
+using SnapshotHeap = alloc8::ANSIWrapper<alloc8::ThreadCache<
+    alloc8::SpanHeap<alloc8::SnapshotPageSource<(size_t(64) << 30)>>>>;
+
+struct Result {
+  double pauseMs;
+  double saveMs;
+  double nsPerUpdate;
+  double copiedMB;
+  double mergeMs;
+};
+
+// Checksum of every record, reading each through `at`
+template<typename At>
+uint64_t checksum(const std::vector<uint64_t*>& records, At at) {
+  uint64_t sum = 0;
+  for (uint64_t* r : records) {
+    const uint64_t* words = at(r);
+    for (size_t w = 0; w < kWords; w++) {
+      sum = sum * 31 + words[w];
+    }
+  }
+  return sum;
+}
+
+template<typename Heap>
+std::vector<uint64_t*> build(Heap& heap, size_t count) {
+  std::vector<uint64_t*> records(count);
+  for (size_t i = 0; i < count; i++) {
+    records[i] = static_cast<uint64_t*>(heap.malloc(kRecordBytes));
+    for (size_t w = 0; w < kWords; w++) {
+      records[i][w] = i * kWords + w;
+    }
+  }
+  return records;
+}
+
+// Update `updates` random records; returns ns per update
+double mutate(std::vector<uint64_t*>& records, size_t updates, uint64_t seed) {
+  std::mt19937_64 rng(seed);
+  double t0 = bench::now();
+  for (size_t i = 0; i < updates; i++) {
+    uint64_t* r = records[rng() % records.size()];
+    r[0]++;
+    r[kWords - 1] ^= i;
+  }
+  return (bench::now() - t0) * 1e9 / double(updates);
+}
+
+void check(uint64_t saved, uint64_t expected, const char* name) {
+  if (saved != expected) {
+    fprintf(stderr, "%s: saved checksum does not match the heap at save time\n", name);
+    exit(1);
+  }
+}
+
+Result runFork(size_t count, size_t updates) {
+  auto heap = std::make_unique<ForkHeap>();
+  std::vector<uint64_t*> records = build(*heap, count);
+  uint64_t expected = checksum(records, [](uint64_t* r) { return r; });
+
+  int pipefd[2];
+  if (pipe(pipefd) != 0) {
+    perror("pipe");
+    exit(1);
+  }
+  Result res{};
+  double t0 = bench::now();
+  pid_t pid = fork();
+  if (pid == 0) {
+    close(pipefd[0]);
+    double start = bench::now();
+    uint64_t sum = checksum(records, [](uint64_t* r) { return r; });
+    double ms = (bench::now() - start) * 1e3;
+    ssize_t n = write(pipefd[1], &sum, sizeof(sum));
+    n += write(pipefd[1], &ms, sizeof(ms));
+    _exit(n == sizeof(sum) + sizeof(ms) ? 0 : 1);
+  }
+  res.pauseMs = (bench::now() - t0) * 1e3;
+  close(pipefd[1]);
+
+  long f0 = bench::minorFaults();
+  res.nsPerUpdate = mutate(records, updates, 1);
+  res.copiedMB = bench::mb(double(bench::minorFaults() - f0) * ALLOC8_PAGE_SIZE);
+
+  uint64_t sum = 0;
+  if (read(pipefd[0], &sum, sizeof(sum)) != sizeof(sum) ||
+      read(pipefd[0], &res.saveMs, sizeof(res.saveMs)) != sizeof(res.saveMs)) {
+    fprintf(stderr, "fork: child failed\n");
+    exit(1);
+  }
+  close(pipefd[0]);
+  waitpid(pid, nullptr, 0);
+  check(sum, expected, "fork");
+  res.mergeMs = 0;
+
+  for (uint64_t* r : records) {
+    heap->free(r);
+  }
+  heap->threadCleanup();
+  return res;
+}
+
+Result runSnapshot(size_t count, size_t updates) {
+  auto heap = std::make_unique<SnapshotHeap>();
+  std::vector<uint64_t*> records = build(*heap, count);
+  uint64_t expected = checksum(records, [](uint64_t* r) { return r; });
+  auto& pages = heap->pageSource();
+
+  Result res{};
+  alloc8::SnapshotView view;
+  double t0 = bench::now();
+  if (int rc = pages.snapshot(&view); rc != 0) {
+    fprintf(stderr, "snapshot: failed (%d)\n", rc);
+    exit(1);
+  }
+  res.pauseMs = (bench::now() - t0) * 1e3;
+
+  uint64_t sum = 0;
+  std::thread saver([&] {
+    double start = bench::now();
+    sum = checksum(records, [&view](uint64_t* r) {
+      return reinterpret_cast<const uint64_t*>(
+          view.data + (reinterpret_cast<const char*>(r) - view.heap));
+    });
+    res.saveMs = (bench::now() - start) * 1e3;
+    pages.release(&view);
+  });
+  res.nsPerUpdate = mutate(records, updates, 1);
+  saver.join();
+  check(sum, expected, "snapshot");
+
+  double t1 = bench::now();
+  if (int rc = pages.merge(); rc != 0) {
+    fprintf(stderr, "merge: failed (%d)\n", rc);
+    exit(1);
+  }
+  res.mergeMs = (bench::now() - t1) * 1e3;
+  res.copiedMB = bench::mb(double(pages.stats().lastMergeBytes));
+
+  for (uint64_t* r : records) {
+    heap->free(r);
+  }
+  heap->threadCleanup();
+  return res;
+}
+
+void report(const char* name, const Result& r) {
+  printf("%-10s %10.2f %10.0f %12.1f %12.1f %10.2f\n", name, r.pauseMs, r.saveMs,
+         r.nsPerUpdate, r.copiedMB, r.mergeMs);
+  fflush(stdout);
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+  double heapGiB = (argc > 1) ? strtod(argv[1], nullptr) : 2.0;
+  double updatePct = (argc > 2) ? strtod(argv[2], nullptr) : 10.0;
+  if (heapGiB <= 0 || updatePct < 0) {
+    fprintf(stderr, "usage: %s [heap-GiB] [update-%%]\n", argv[0]);
+    return 1;
+  }
+  size_t count = static_cast<size_t>(heapGiB * double(size_t(1) << 30)) / kRecordBytes;
+  size_t updates = static_cast<size_t>(double(count) * updatePct / 100.0);
+  if (updates == 0) {
+    updates = 1;
+  }
+
+  printf("heap=%.1f GiB records=%zu x %zu B updates=%zu during the save\n\n", heapGiB,
+         count, kRecordBytes, updates);
+  printf("%-10s %10s %10s %12s %12s %10s\n", "mode", "pause ms", "save ms",
+         "ns/update", "copied MB", "merge ms");
+  report("fork", runFork(count, updates));
+  report("snapshot", runSnapshot(count, updates));
+  return 0;
+}
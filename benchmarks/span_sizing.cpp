@@ -0,0 +1,169 @@
+// alloc8/benchmarks/span_sizing.cpp
+// Phase-changing workload: fixed vs adaptive per-class span sizes
+//
+// Runs [rounds] rounds of three phases. Each phase has one hot size class
+// (48, 320, then 1536 bytes): it builds a live set of [live-MiB] of that
+// size, replaces random objects for as many ops again, then frees all but
+// [survive-%] of them (5 by default). The survivors stay live until the
+// same class comes back in the next round, so the hot class moves while
+// the cold ones sit on sparse spans. Two SpanHeaps serve it:
+//
+//   fixed      FixedSpanSizing: the size-class map's pages for every span
+//   adaptive   AdaptiveSpanSizing<>: spans grow up to 8x for classes that
+//              keep refilling, and shrink up to 4x after occupancy dips
+//
+// Reports ns per malloc/free, spans mapped (each one a trip to the page
+// source), and span bytes held at the end of the phases over the bytes
+// live then (the worst phase, and the average). With adaptive sizing, the
+// decisions taken for each hot class follow.
+//
+// Usage: span_sizing [live-MiB] [rounds] [survive-%]
+
+#include "bench_util.h"
+
+#include <alloc8/page_map.h>
+#include <alloc8/span_heap.h>
+#include <alloc8/span_sizing.h>
+
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <random>
+#include <vector>
+
+namespace {
+
+constexpr size_t kSizes[] = {48, 320, 1536};
+constexpr size_t kPhases = sizeof(kSizes) / sizeof(kSizes[0]);
+
+// Counts the spans a heap maps
+struct CountingSource : alloc8::OSPageSource {
+  size_t maps = 0;
+
+  void* allocPages(size_t npages, size_t alignment = ALLOC8_PAGE_SIZE) {
+    maps++;
+    return OSPageSource::allocPages(npages, alignment);
+  }
+};
+
+using FixedHeap = alloc8::SpanHeap<CountingSource>;
+using AdaptiveHeap = alloc8::SpanHeap<CountingSource, alloc8::SizeClasses,
+                                      alloc8::InBandFreeList, 0,
+                                      alloc8::AdaptiveSpanSizing<>>;
+
+struct Result {
+  double nsPerOp;
+  size_t spans;
+  double worstRatio;
+  double meanRatio;
+};
+
+template<typename Heap>
+size_t heldBytes(Heap& heap) {
+  size_t held = 0;
+  alloc8::pageMap().forEachSpan([&](uintptr_t, alloc8::Span* span) {
+    if (span->owner == heap.owner()) {
+      held += span->bytes();
+    }
+  });
+  return held;
+}
+
+template<typename Heap>
+Result run(Heap& heap, size_t liveBytes, int rounds, double survivePct) {
+  std::mt19937_64 rng(42);
+  std::uniform_real_distribution<double> pct(0.0, 100.0);
+  std::vector<void*> survivors[kPhases];
+  size_t ops = 0;
+  double ratioSum = 0;
+  double worst = 0;
+  double elapsed = 0;
+
+  for (int round = 0; round < rounds; round++) {
+    for (size_t phase = 0; phase < kPhases; phase++) {
+      size_t size = kSizes[phase];
+      size_t count = liveBytes / size;
+      std::vector<void*> live;
+      live.reserve(count);
+
+      double t0 = bench::now();
+      for (void* p : survivors[phase]) {
+        heap.free(p);
+      }
+      ops += survivors[phase].size();
+      survivors[phase].clear();
+      for (size_t i = 0; i < count; i++) {
+        live.push_back(heap.malloc(size));
+        static_cast<char*>(live.back())[0] = 1;
+      }
+      for (size_t i = 0; i < count; i++) {
+        size_t victim = rng() % count;
+        heap.free(live[victim]);
+        live[victim] = heap.malloc(size);
+        static_cast<char*>(live[victim])[0] = 1;
+      }
+      for (size_t i = 0; i < count; i++) {
+        if (pct(rng) < survivePct) {
+          survivors[phase].push_back(live[i]);
+        } else {
+          heap.free(live[i]);
+        }
+      }
+      elapsed += bench::now() - t0;
+      ops += count * 4;
+
+      size_t liveNow = 0;
+      for (size_t p = 0; p < kPhases; p++) {
+        liveNow += survivors[p].size() * kSizes[p];
+      }
+      double ratio = double(heldBytes(heap)) / double(liveNow);
+      ratioSum += ratio;
+      worst = ratio > worst ? ratio : worst;
+    }
+  }
+  for (auto& s : survivors) {
+    for (void* p : s) {
+      heap.free(p);
+    }
+  }
+  return Result{elapsed * 1e9 / double(ops), heap.pageSource().maps, worst,
+                ratioSum / double(rounds * kPhases)};
+}
+
+void report(const char* name, const Result& r) {
+  printf("%-10s %8.1f %10zu %14.2f %14.2f\n", name, r.nsPerOp, r.spans, r.worstRatio,
+         r.meanRatio);
+  fflush(stdout);
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+  double liveMiB = (argc > 1) ? strtod(argv[1], nullptr) : 64.0;
+  int rounds = (argc > 2) ? atoi(argv[2]) : 3;
+  double survivePct = (argc > 3) ? strtod(argv[3], nullptr) : 5.0;
+  if (liveMiB <= 0 || rounds <= 0 || survivePct <= 0 || survivePct > 100) {
+    fprintf(stderr, "usage: %s [live-MiB] [rounds] [survive-%%]\n", argv[0]);
+    return 1;
+  }
+  size_t liveBytes = static_cast<size_t>(liveMiB * 1024 * 1024);
+
+  printf("live=%.0f MiB per phase, %d rounds of %zu phases (48, 320, 1536 B), "
+         "%.1f%% survive\n\n", liveMiB, rounds, kPhases, survivePct);
+  printf("%-10s %8s %10s %14s %14s\n", "sizing", "ns/op", "spans", "held/live max",
+         "held/live avg");
+  auto fixed = std::make_unique<FixedHeap>();
+  report("fixed", run(*fixed, liveBytes, rounds, survivePct));
+  auto adaptive = std::make_unique<AdaptiveHeap>();
+  report("adaptive", run(*adaptive, liveBytes, rounds, survivePct));
+
+  printf("\n%-10s %8s %8s %8s %8s %8s\n", "class", "base", "pages", "grows", "shrinks",
+         "refills");
+  for (size_t size : kSizes) {
+    size_t cls = alloc8::SizeClasses::sizeToClass(size);
+    alloc8::SpanSizingStats s = adaptive->spanSizingStats(cls);
+    printf("%-10zu %8zu %8zu %8zu %8zu %8zu\n", size, s.basePages, s.pages, s.grows,
+           s.shrinks, s.refills);
+  }
+  return 0;
+}
@@ -0,0 +1,174 @@
+// alloc8/benchmarks/tiny_nodes.cpp
+// Small-node workload: memory and speed with 8-byte tiny size classes
+//
+// Builds [records] records of three nodes each, as a program full of
+// containers would: an 8-byte boxed value, a 24-byte list node (next,
+// prev, value) and a 40-byte tree node (left, right, parent, key, value).
+// Then frees every other record, rebuilds them and walks the list. Heaps:
+//
+//   default   ThreadCache<SpanHeap<>>: 16-byte classes (16, 32, 48)
+//   tiny      the same over TinySizeClasses behind an ANSIWrapper with a
+//             TinyLimit of 8 (8, 32, 48: only the box shrinks)
+//   system    malloc/free of the C library
+//
+// Reports ns per node allocated, RSS growth per record after the build,
+// the same after the churn, and ns per list node walked.
+//
+// Usage: tiny_nodes [records]
+
+#include "bench_util.h"
+
+#include <alloc8/ansi_wrapper.h>
+#include <alloc8/size_classes.h>
+#include <alloc8/span_heap.h>
+#include <alloc8/thread_cache.h>
+
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <vector>
+
+namespace {
+
+struct SystemHeap {
+  void* malloc(size_t sz) { return ::malloc(sz); }
+  void free(void* ptr) { ::free(ptr); }
+};
+
+using Default = alloc8::ANSIWrapper<alloc8::ThreadCache<alloc8::SpanHeap<>>>;
+using Tiny = alloc8::ANSIWrapper<
+    alloc8::ThreadCache<alloc8::SpanHeap<alloc8::OSPageSource, alloc8::TinySizeClasses>,
+                        alloc8::TinySizeClasses>,
+    ALLOC8_MIN_ALIGNMENT, 8>;
+
+struct ListNode {
+  ListNode* next;
+  ListNode* prev;
+  uint64_t* value;
+};
+
+struct TreeNode {
+  TreeNode* left;
+  TreeNode* right;
+  TreeNode* parent;
+  uint64_t key;
+  uint64_t* value;
+};
+
+static_assert(sizeof(ListNode) == 24 && sizeof(TreeNode) == 40);
+
+struct Record {
+  uint64_t* box;
+  ListNode* list;
+  TreeNode* tree;
+};
+
+struct Result {
+  double nsPerNode;
+  double bytesPerRecord;
+  double bytesAfterChurn;
+  double nsPerWalk;
+};
+
+template<typename Heap>
+void build(Heap& heap, Record& r, uint64_t i, ListNode*& tail) {
+  r.box = static_cast<uint64_t*>(heap.malloc(sizeof(uint64_t)));
+  *r.box = i;
+  r.list = static_cast<ListNode*>(heap.malloc(sizeof(ListNode)));
+  r.list->next = nullptr;
+  r.list->prev = tail;
+  r.list->value = r.box;
+  if (tail) {
+    tail->next = r.list;
+  }
+  tail = r.list;
+  r.tree = static_cast<TreeNode*>(heap.malloc(sizeof(TreeNode)));
+  *r.tree = TreeNode{nullptr, nullptr, nullptr, i, r.box};
+}
+
+template<typename Heap>
+void destroy(Heap& heap, Record& r) {
+  heap.free(r.tree);
+  heap.free(r.list);
+  heap.free(r.box);
+}
+
+template<typename Heap>
+Result run(size_t records) {
+  auto heap = std::make_unique<Heap>();
+  std::vector<Record> recs(records);
+  size_t rss0 = bench::rssBytes();
+  Result res;
+
+  double t0 = bench::now();
+  ListNode* tail = nullptr;
+  for (size_t i = 0; i < records; i++) {
+    build(*heap, recs[i], i, tail);
+  }
+  double t1 = bench::now();
+  res.nsPerNode = (t1 - t0) * 1e9 / double(3 * records);
+  res.bytesPerRecord = double(bench::rssBytes() - rss0) / double(records);
+
+  // Free every other record and rebuild it as a new list
+  for (size_t i = 0; i < records; i += 2) {
+    destroy(*heap, recs[i]);
+  }
+  tail = nullptr;
+  for (size_t i = 0; i < records; i += 2) {
+    build(*heap, recs[i], i, tail);
+  }
+  res.bytesAfterChurn = double(bench::rssBytes() - rss0) / double(records);
+
+  uint64_t sum = 0;
+  size_t walked = 0;
+  double t2 = bench::now();
+  for (ListNode* n = recs[0].list; n; n = n->next) {
+    sum += *n->value;
+    walked++;
+  }
+  double t3 = bench::now();
+  res.nsPerWalk = (t3 - t2) * 1e9 / double(walked);
+  uint64_t expected = 0;
+  for (size_t i = 0; i < records; i += 2) {
+    expected += i;
+  }
+  if (sum != expected || walked != (records + 1) / 2) {
+    fprintf(stderr, "list corrupted\n");
+    exit(1);
+  }
+
+  for (Record& r : recs) {
+    destroy(*heap, r);
+  }
+  if constexpr (requires { heap->threadCleanup(); }) {
+    heap->threadCleanup();
+  }
+  return res;
+}
+
+template<typename Heap>
+void report(const char* name, size_t records) {
+  Result r = run<Heap>(records);
+  printf("%-10s %10.1f %14.1f %14.1f %10.2f\n", name, r.nsPerNode, r.bytesPerRecord,
+         r.bytesAfterChurn, r.nsPerWalk);
+  fflush(stdout);
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+  size_t records = (argc > 1) ? strtoul(argv[1], nullptr, 10) : 2000000;
+  if (records < 2) {
+    fprintf(stderr, "usage: %s [records]\n", argv[0]);
+    return 1;
+  }
+
+  printf("records=%zu nodes=8+24+40 B (72 B of payload per record)\n\n", records);
+  printf("%-10s %10s %14s %14s %10s\n", "heap", "ns/node", "RSS B/record",
+         "after churn", "ns/walk");
+  report<Default>("default", records);
+  report<Tiny>("tiny", records);
+  report<SystemHeap>("system", records);
+  return 0;
+}
@@ -0,0 +1,60 @@
+# alloc8/cmake/Alloc8PGO.cmake
+# Profile-guided optimization for alloc8 preload libraries
+#
+# ALLOC8_PGO selects the stage applied by alloc8_enable_pgo(<target>):
+#   (empty)   plain build (LTO only)
+#   GENERATE  instrumented build; running it writes profiles to ALLOC8_PGO_DIR
+#   USE       optimized build from the profiles in ALLOC8_PGO_DIR
+# ALLOC8_PGO_BOLT additionally links with relocations kept, so llvm-bolt can
+# rewrite the library afterwards.
+#
+# Both stages must be built in the same build directory: GCC names its
+# profiles after object file paths. cmake/alloc8_pgo_pipeline.cmake drives
+# the whole two-stage build (see the alloc8_pgo target).
+
+set(ALLOC8_PGO "" CACHE STRING "PGO stage for preload libraries: GENERATE, USE, or empty")
+set_property(CACHE ALLOC8_PGO PROPERTY STRINGS "" "GENERATE" "USE")
+set(ALLOC8_PGO_DIR "${CMAKE_BINARY_DIR}/pgo-profiles" CACHE PATH "Directory for PGO profiles")
+option(ALLOC8_PGO_BOLT "Link preload libraries with relocations for llvm-bolt" OFF)
+
+if(ALLOC8_PGO AND NOT ALLOC8_PGO MATCHES "^(GENERATE|USE)$")
+  message(FATAL_ERROR "ALLOC8_PGO must be GENERATE, USE, or empty (got '${ALLOC8_PGO}')")
+endif()
+
+if(ALLOC8_PGO AND MSVC)
+  message(WARNING "ALLOC8_PGO is only supported with GCC and Clang; ignoring")
+endif()
+
+# Apply the selected PGO stage (and BOLT link flags) to a preload library.
+function(alloc8_enable_pgo target)
+  if(MSVC)
+    return()
+  endif()
+
+  if(ALLOC8_PGO STREQUAL "GENERATE")
+    if(CMAKE_CXX_COMPILER_ID MATCHES "Clang")
+      set(flags "-fprofile-generate=${ALLOC8_PGO_DIR}")
+    else()
+      # Atomic counters: the training workloads are multithreaded
+      set(flags "-fprofile-generate" "-fprofile-dir=${ALLOC8_PGO_DIR}"
+                "-fprofile-update=atomic")
+    endif()
+    target_compile_options(${target} PRIVATE ${flags})
+    target_link_options(${target} PRIVATE ${flags})
+  elseif(ALLOC8_PGO STREQUAL "USE")
+    if(CMAKE_CXX_COMPILER_ID MATCHES "Clang")
+      set(flags "-fprofile-use=${ALLOC8_PGO_DIR}/alloc8.profdata"
+                "-Wno-profile-instr-unprofiled")
+    else()
+      # Code the training never reached keeps normal optimization
+      set(flags "-fprofile-use" "-fprofile-dir=${ALLOC8_PGO_DIR}"
+                "-fprofile-partial-training" "-Wno-missing-profile")
+    endif()
+    target_compile_options(${target} PRIVATE ${flags})
+    target_link_options(${target} PRIVATE ${flags})
+  endif()
+
+  if(ALLOC8_PGO_BOLT AND CMAKE_SYSTEM_NAME STREQUAL "Linux")
+    target_link_options(${target} PRIVATE "LINKER:--emit-relocs")
+  endif()
+endfunction()
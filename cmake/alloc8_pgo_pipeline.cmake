@@ -0,0 +1,257 @@
+# alloc8/cmake/alloc8_pgo_pipeline.cmake
+# Two-stage PGO (+ optional BOLT) build of the alloc8 preload libraries
+#
+# Run via the alloc8_pgo target (ALLOC8_PGO_PIPELINE=ON), or directly:
+#   cmake -DALLOC8_SOURCE_DIR=<src> -DALLOC8_PGO_WORK_DIR=<dir> \
+#         [-DCMAKE_CXX_COMPILER=...] [-DALLOC8_BUILD_HOARD_EXAMPLE=ON] \
+#         -P cmake/alloc8_pgo_pipeline.cmake
+#
+# Stages, all under ALLOC8_PGO_WORK_DIR:
+#   lto/      plain LTO build (the baseline)
+#   pgo/      instrumented build, trained, then rebuilt with the profiles
+#   bolt/     llvm-bolt rewrites of the PGO libraries (if llvm-bolt is found)
+# Finally every variant of every preload library runs the comparison
+# workloads; the table is printed and written to report.txt.
+
+cmake_minimum_required(VERSION 3.15)
+
+if(NOT ALLOC8_SOURCE_DIR OR NOT ALLOC8_PGO_WORK_DIR)
+  message(FATAL_ERROR "Set ALLOC8_SOURCE_DIR and ALLOC8_PGO_WORK_DIR")
+endif()
+if(NOT DEFINED ALLOC8_PGO_REPEAT)
+  set(ALLOC8_PGO_REPEAT 3)
+endif()
+
+# Workloads are "<path relative to the build dir> [args...]", run with each
+# preload library injected. Training covers the tests and the macro
+# benchmarks.
+set(ALLOC8_PGO_TRAINING
+  "tests/test_basic_alloc"
+  "tests/threadtest 1 50 30000 0 8"
+  "tests/threadtest 4 50 30000 0 64"
+  "tests/threadtest 8 20 30000 0 256"
+  "benchmarks/macro_json --threads 2 --scale 0.2"
+  "benchmarks/macro_kvstore --threads 2 --scale 0.2"
+  "benchmarks/macro_ast --threads 2 --scale 0.2"
+  "benchmarks/macro_logproc --threads 2 --scale 0.2"
+  "benchmarks/macro_graph --threads 2 --scale 0.2"
+)
+# Comparison workloads must print "Time elapsed = <s>" (threadtest) or
+# "seconds=<s>" (macro benchmarks).
+set(ALLOC8_PGO_BENCHMARKS
+  "tests/threadtest 1 100 30000 0 8"
+  "tests/threadtest 4 100 30000 0 64"
+  "benchmarks/macro_json --threads 4 --seed 1"
+  "benchmarks/macro_kvstore --threads 4 --seed 1"
+)
+
+if(APPLE)
+  set(preload_var DYLD_INSERT_LIBRARIES)
+  set(lib_glob "examples/*/lib*.dylib")
+else()
+  set(preload_var LD_PRELOAD)
+  set(lib_glob "examples/*/lib*.so")
+endif()
+
+# Options forwarded to every configure
+set(forward_args
+  -DCMAKE_BUILD_TYPE=Release
+  -DALLOC8_BUILD_TESTS=ON
+  -DALLOC8_BUILD_EXAMPLES=ON
+  -DALLOC8_BUILD_BENCHMARKS=ON
+)
+foreach(var CMAKE_GENERATOR CMAKE_C_COMPILER CMAKE_CXX_COMPILER
+            ALLOC8_BUILD_HOARD_EXAMPLE ALLOC8_BUILD_DIEHARD_EXAMPLE)
+  if(DEFINED ${var} AND NOT "${${var}}" STREQUAL "")
+    if(var STREQUAL "CMAKE_GENERATOR")
+      list(APPEND forward_args -G "${${var}}")
+    else()
+      list(APPEND forward_args "-D${var}=${${var}}")
+    endif()
+  endif()
+endforeach()
+
+include(ProcessorCount)
+ProcessorCount(jobs)
+if(jobs EQUAL 0)
+  set(jobs 1)
+endif()
+
+# ─── HELPERS ──────────────────────────────────────────────────────────────────
+
+function(run_checked)
+  execute_process(COMMAND ${ARGN} RESULT_VARIABLE rv)
+  if(NOT rv EQUAL 0)
+    string(REPLACE ";" " " cmd "${ARGN}")
+    message(FATAL_ERROR "Command failed (${rv}): ${cmd}")
+  endif()
+endfunction()
+
+function(configure_and_build dir)
+  run_checked(${CMAKE_COMMAND} -S ${ALLOC8_SOURCE_DIR} -B ${dir}
+              ${forward_args} ${ARGN})
+  run_checked(${CMAKE_COMMAND} --build ${dir} --parallel ${jobs})
+endfunction()
+
+function(find_preload_libs dir out)
+  file(GLOB libs "${dir}/${lib_glob}")
+  set(${out} ${libs} PARENT_SCOPE)
+endfunction()
+
+# Run one workload with `lib` preloaded; sets `out` to its stdout.
+function(run_workload build_dir lib workload out)
+  separate_arguments(argv UNIX_COMMAND "${workload}")
+  list(GET argv 0 exe)
+  list(REMOVE_AT argv 0)
+  execute_process(
+    COMMAND ${CMAKE_COMMAND} -E env "${preload_var}=${lib}"
+            ${build_dir}/${exe} ${argv}
+    RESULT_VARIABLE rv
+    OUTPUT_VARIABLE output
+    ERROR_QUIET
+  )
+  if(NOT rv EQUAL 0)
+    message(WARNING "${workload} failed under ${lib} (${rv})")
+  endif()
+  set(${out} "${output}" PARENT_SCOPE)
+endfunction()
+
+function(train build_dir lib)
+  foreach(workload IN LISTS ALLOC8_PGO_TRAINING)
+    run_workload(${build_dir} ${lib} "${workload}" ignored)
+  endforeach()
+endfunction()
+
+# Best-of-N elapsed seconds for one workload; "-" if it never reports one.
+function(best_time build_dir lib workload out)
+  set(best "")
+  foreach(i RANGE 1 ${ALLOC8_PGO_REPEAT})
+    run_workload(${build_dir} ${lib} "${workload}" output)
+    if(output MATCHES "(Time elapsed = |seconds=)([0-9.e+-]+)")
+      set(t ${CMAKE_MATCH_2})
+      if(best STREQUAL "" OR t LESS best)
+        set(best ${t})
+      endif()
+    endif()
+  endforeach()
+  if(best STREQUAL "")
+    set(best "-")
+  endif()
+  set(${out} ${best} PARENT_SCOPE)
+endfunction()
+
+# ─── STAGE 0: PLAIN LTO BASELINE ──────────────────────────────────────────────
+
+set(lto_dir ${ALLOC8_PGO_WORK_DIR}/lto)
+set(pgo_dir ${ALLOC8_PGO_WORK_DIR}/pgo)
+set(bolt_dir ${ALLOC8_PGO_WORK_DIR}/bolt)
+set(profile_dir ${ALLOC8_PGO_WORK_DIR}/profiles)
+
+message(STATUS "alloc8 PGO: building LTO baseline")
+configure_and_build(${lto_dir} -DALLOC8_PGO=)
+
+# ─── STAGE 1: INSTRUMENT AND TRAIN ────────────────────────────────────────────
+
+message(STATUS "alloc8 PGO: building instrumented libraries")
+file(REMOVE_RECURSE ${profile_dir})
+file(MAKE_DIRECTORY ${profile_dir})
+find_program(LLVM_BOLT llvm-bolt)
+if(LLVM_BOLT)
+  set(bolt_arg -DALLOC8_PGO_BOLT=ON)
+else()
+  set(bolt_arg -DALLOC8_PGO_BOLT=OFF)
+endif()
+configure_and_build(${pgo_dir} -DALLOC8_PGO=GENERATE
+                    -DALLOC8_PGO_DIR=${profile_dir} ${bolt_arg})
+
+find_preload_libs(${pgo_dir} pgo_libs)
+if(NOT pgo_libs)
+  message(FATAL_ERROR "No preload libraries found in ${pgo_dir}")
+endif()
+foreach(lib IN LISTS pgo_libs)
+  message(STATUS "alloc8 PGO: training ${lib}")
+  train(${pgo_dir} ${lib})
+endforeach()
+
+# Clang writes raw profiles that must be merged; GCC reads .gcda directly.
+file(GLOB raw_profiles "${profile_dir}/*.profraw")
+if(raw_profiles)
+  get_filename_component(compiler_dir "${CMAKE_CXX_COMPILER}" DIRECTORY)
+  find_program(LLVM_PROFDATA llvm-profdata HINTS ${compiler_dir})
+  if(NOT LLVM_PROFDATA)
+    message(FATAL_ERROR "llvm-profdata not found; needed to merge Clang profiles")
+  endif()
+  run_checked(${LLVM_PROFDATA} merge -o ${profile_dir}/alloc8.profdata ${raw_profiles})
+endif()
+
+# ─── STAGE 2: REBUILD WITH PROFILES ───────────────────────────────────────────
+
+message(STATUS "alloc8 PGO: rebuilding with profiles")
+configure_and_build(${pgo_dir} -DALLOC8_PGO=USE)
+find_preload_libs(${pgo_dir} pgo_libs)
+
+# ─── OPTIONAL: BOLT ───────────────────────────────────────────────────────────
+
+set(bolt_libs "")
+if(LLVM_BOLT)
+  get_filename_component(bolt_bin_dir "${LLVM_BOLT}" DIRECTORY)
+  find_program(MERGE_FDATA merge-fdata HINTS ${bolt_bin_dir})
+  file(MAKE_DIRECTORY ${bolt_dir})
+  foreach(lib IN LISTS pgo_libs)
+    get_filename_component(name ${lib} NAME)
+    message(STATUS "alloc8 PGO: BOLT-optimizing ${name}")
+    set(inst ${bolt_dir}/${name}.inst)
+    set(fdata_dir ${bolt_dir}/${name}.fdata.d)
+    file(REMOVE_RECURSE ${fdata_dir})
+    file(MAKE_DIRECTORY ${fdata_dir})
+    run_checked(${LLVM_BOLT} ${lib} -instrument -o ${inst}
+                -instrumentation-file=${fdata_dir}/prof
+                -instrumentation-file-append-pid)
+    train(${pgo_dir} ${inst})
+    file(GLOB fdata_files "${fdata_dir}/*")
+    if(NOT fdata_files)
+      message(WARNING "BOLT: no profile written for ${name}; skipping")
+      continue()
+    endif()
+    if(MERGE_FDATA)
+      execute_process(COMMAND ${MERGE_FDATA} ${fdata_files}
+                      OUTPUT_FILE ${bolt_dir}/${name}.fdata)
+    else()
+      list(GET fdata_files 0 first)
+      run_checked(${CMAKE_COMMAND} -E copy ${first} ${bolt_dir}/${name}.fdata)
+    endif()
+    run_checked(${LLVM_BOLT} ${lib} -o ${bolt_dir}/${name}
+                -data=${bolt_dir}/${name}.fdata
+                -reorder-blocks=ext-tsp -reorder-functions=hfsort
+                -split-functions -icf=1)
+    list(APPEND bolt_libs ${bolt_dir}/${name})
+  endforeach()
+else()
+  message(STATUS "alloc8 PGO: llvm-bolt not found; skipping BOLT")
+endif()
+
+# ─── COMPARISON ───────────────────────────────────────────────────────────────
+
+set(report "allocator\tworkload\tlto\tpgo\tpgo+bolt\n")
+foreach(pgo_lib IN LISTS pgo_libs)
+  get_filename_component(name ${pgo_lib} NAME)
+  file(GLOB lto_lib "${lto_dir}/examples/*/${name}")
+  set(bolt_lib "${bolt_dir}/${name}")
+  foreach(workload IN LISTS ALLOC8_PGO_BENCHMARKS)
+    set(t_lto "-")
+    set(t_bolt "-")
+    if(lto_lib)
+      best_time(${lto_dir} ${lto_lib} "${workload}" t_lto)
+    endif()
+    best_time(${pgo_dir} ${pgo_lib} "${workload}" t_pgo)
+    if(bolt_lib IN_LIST bolt_libs)
+      best_time(${pgo_dir} ${bolt_lib} "${workload}" t_bolt)
+    endif()
+    string(APPEND report "${name}\t${workload}\t${t_lto}\t${t_pgo}\t${t_bolt}\n")
+  endforeach()
+endforeach()
+
+file(WRITE ${ALLOC8_PGO_WORK_DIR}/report.txt "${report}")
+message(STATUS "alloc8 PGO: best-of-${ALLOC8_PGO_REPEAT} seconds (lower is better)\n${report}")
+message(STATUS "alloc8 PGO: optimized libraries in ${pgo_dir}/examples"
+               " and ${bolt_dir}; report in ${ALLOC8_PGO_WORK_DIR}/report.txt")
@@ -2,13 +2,23 @@
 // DieHard allocator using alloc8 for interposition
 //
 // Uses alloc8's header-only gnu_wrapper.h for zero-overhead interposition.
+//
+// With DIEHARD_SCALABLE, each thread gets its own randomized heap from a
+// fixed pool when alloc8's thread hooks report it starting (xxthread_init),
+// and gives it back when the thread exits (xxthread_cleanup), so programs
+// that keep creating short-lived threads reuse heaps instead of growing new
+// ones. Link with ${ALLOC8_THREAD_SOURCES} for the hooks.
+
+#include <alloc8/alloc8.h>
 
+#include <atomic>
 #include <cstddef>
 #include <cstdlib>
 #include <cstdio>
 #include <new>
 #include <cassert>
 #include <cstring>
+#include <thread>
 
 // Required by printf.h/printf.cpp
 extern "C" void _putchar(char c) {
@@ -30,7 +40,6 @@ enum { Numerator = 8, Denominator = 7 };
 #include "util/atomicbitmap.h"
 #include "globalfreepool.h"
 #include "objectownership.h"
-#include "scalableheap.h"
 
 // ─── PLATFORM-SPECIFIC LOCK TYPE ──────────────────────────────────────────────
 
@@ -66,17 +75,164 @@ typedef
                 TheLargeHeap>>>
 PerThreadDieHardHeap;
 
-typedef
- ANSIWrapper<
-  LockedHeap<TheLockType,
-     CombineHeap<DieHardHeap<Numerator, Denominator, 1048576,
-                             (DIEHARD_DIEFAST == 1),
-                             (DIEHARD_DIEHARDER == 1)>,
-                 TheLargeHeap>>>
-FallbackDieHardHeap;
+// ─── THREAD HEAP POOL ────────────────────────────────────────────────────────
+//
+// Slots 1..MaxHeaps-1 are handed out by threadInit() and returned by
+// threadCleanup(); a returned heap keeps its memory, so the next thread
+// to take the slot reuses it. Threads the hooks never saw start (the main
+// thread, and threads started before the hooks were active) claim a slot
+// on their first call instead. Slot 0 is the shared heap, used under a
+// lock only by threads that found every slot taken and by TLS destructors
+// that run after threadCleanup().
+//
+// PerThreadDieHardHeap tracks object ownership and frees through atomic
+// bitmaps, so free() and getSize() may go through whichever heap the
+// calling thread holds, whoever allocated the object. Every call into the
+// shared heap takes its lock, frees and size queries included.
+//
+// A pooled heap's thread marks it busy across each call (an uncontended
+// flag, never waited on outside fork), so lock() can quiesce every heap
+// before fork() and the child never inherits one mid-operation.
+
+template <class PerThreadHeap, int MaxHeaps>
+class PooledThreadHeaps {
+public:
+  PooledThreadHeaps() {
+    new (_storage[0]) PerThreadHeap;
+    _constructed[0] = true;
+  }
+
+  inline void* malloc(size_t sz) {
+    Hold hold(this, currentSlot());
+    return heap(hold.slot())->malloc(sz);
+  }
+
+  inline void free(void* ptr) {
+    Hold hold(this, currentSlot());
+    heap(hold.slot())->free(ptr);
+  }
+
+  inline size_t getSize(void* ptr) {
+    Hold hold(this, currentSlot());
+    return heap(hold.slot())->getSize(ptr);
+  }
+
+  // Fork safety: the shared heap and every pooled heap
+  void lock() {
+    _sharedLock.lock();
+    for (int i = 1; i < MaxHeaps; i++) {
+      acquire(i);
+    }
+  }
+
+  void unlock() {
+    for (int i = MaxHeaps - 1; i >= 1; i--) {
+      _busy[i].store(false, std::memory_order_release);
+    }
+    _sharedLock.unlock();
+  }
+
+  // Thread start: claim a free slot, building its heap on first use.
+  void threadInit() {
+    if (threadSlot() == UnclaimedSlot) {
+      claim();
+    }
+  }
+
+  // Thread exit: hand the heap back for the next thread. Later calls from
+  // this thread's TLS destructors go to the shared heap.
+  void threadCleanup() {
+    int slot = threadSlot();
+    threadSlot() = SharedSlot;
+    if (slot > 0) {
+      _inUse[slot].store(false, std::memory_order_release);
+    }
+  }
+
+private:
+  // Holds the calling thread's heap for one call
+  class Hold {
+    PooledThreadHeaps* _pool;
+    int _slot;
+
+  public:
+    inline Hold(PooledThreadHeaps* pool, int slot) : _pool(pool), _slot(slot) {
+      if (__builtin_expect(slot != 0, 1)) {
+        pool->acquire(slot);
+      } else {
+        pool->_sharedLock.lock();
+      }
+    }
+    inline ~Hold() {
+      if (__builtin_expect(_slot != 0, 1)) {
+        _pool->_busy[_slot].store(false, std::memory_order_release);
+      } else {
+        _pool->_sharedLock.unlock();
+      }
+    }
+    inline int slot() const { return _slot; }
+    Hold(const Hold&) = delete;
+    Hold& operator=(const Hold&) = delete;
+  };
+
+  inline void acquire(int slot) {
+    while (__builtin_expect(_busy[slot].exchange(true, std::memory_order_acquire), 0)) {
+      std::this_thread::yield();
+    }
+  }
+
+  // Per-thread slot: UnclaimedSlot until the first call or threadInit(),
+  // SharedSlot once the thread uses slot 0 for good
+  enum { UnclaimedSlot = 0, SharedSlot = -1 };
+
+  static int& threadSlot() {
+    static ALLOC8_TLS int slot;
+    return slot;
+  }
+
+  inline int currentSlot() {
+    int slot = threadSlot();
+    if (__builtin_expect(slot == UnclaimedSlot, 0)) {
+      slot = claim();
+    }
+    return slot > 0 ? slot : 0;
+  }
+
+  // Take the first free slot, or settle on the shared heap when none is
+  int claim() {
+    for (int i = 1; i < MaxHeaps; i++) {
+      bool expected = false;
+      if (_inUse[i].compare_exchange_strong(expected, true,
+                                            std::memory_order_acquire)) {
+        if (!_constructed[i]) {
+          acquire(i);  // So a fork() meanwhile waits for the constructor
+          new (_storage[i]) PerThreadHeap;
+          _constructed[i] = true;
+          _busy[i].store(false, std::memory_order_release);
+        }
+        threadSlot() = i;
+        return i;
+      }
+    }
+    threadSlot() = SharedSlot;
+    return SharedSlot;
+  }
+
+  inline PerThreadHeap* heap(int slot) {
+    return reinterpret_cast<PerThreadHeap*>(_storage[slot]);
+  }
+
+  alignas(PerThreadHeap) char _storage[MaxHeaps][sizeof(PerThreadHeap)];
+  bool _constructed[MaxHeaps] = {};
+  std::atomic<bool> _inUse[MaxHeaps] = {};
+  std::atomic<bool> _busy[MaxHeaps] = {};
+  TheLockType _sharedLock;
+};
+
+enum { MaxThreadHeaps = 64 };
 
 typedef
- ScalableHeap<PerThreadDieHardHeap, FallbackDieHardHeap>
+ PooledThreadHeaps<PerThreadDieHardHeap, MaxThreadHeaps>
 TheDieHardHeap;
 
 #else
@@ -103,27 +259,24 @@ public:
     return TheDieHardHeap::malloc(sz < alignment ? alignment : sz);
   }
 
-  // Fork safety - scalable version has per-thread heaps, no global lock
+  // Fork safety - the scalable version quiesces the shared heap and
+  // every pooled heap
   inline void lock() {
-#if !DIEHARD_SCALABLE
     TheDieHardHeap::lock();
-#endif
   }
 
   inline void unlock() {
-#if !DIEHARD_SCALABLE
     TheDieHardHeap::unlock();
-#endif
   }
+
 };
 
 // ─── HEAP SINGLETON (required by alloc8's gnu_wrapper.h) ────────────────────
-// Meyers singleton pattern - compiler optimizes away redundant checks with LTO
+// Shared with alloc8::ThreadRedirect, so the thread hooks below reach the
+// same heap. Compiler optimizes away redundant checks with LTO.
 
 inline static TheCustomHeapType* getCustomHeap() {
-  static char buf[sizeof(TheCustomHeapType)];
-  static TheCustomHeapType* heap = new (buf) TheCustomHeapType;
-  return heap;
+  return alloc8::HeapRedirect<TheCustomHeapType>::getHeap();
 }
 
 // ─── XXMALLOC INTERFACE (required by Heap-Layers wrappers) ──────────────────
@@ -182,6 +335,13 @@ void* xxcalloc(size_t count, size_t sz) {
 
 } // extern "C"
 
+// ─── THREAD HOOKS (scalable only) ───────────────────────────────────────────
+
+#if DIEHARD_SCALABLE
+using DieHardThreads = alloc8::ThreadRedirect<TheCustomHeapType>;
+ALLOC8_THREAD_REDIRECT(DieHardThreads);
+#endif
+
 // ─── INCLUDE PLATFORM-SPECIFIC WRAPPER ───────────────────────────────────────
 
 #if defined(__linux__)
@@ -0,0 +1,19 @@
+// alloc8/examples/sharded_heap/sharded_heap.cpp
+// Example: A mimalloc-style allocator from alloc8 components
+//
+// ShardedPageHeap gives every thread its own pages, each with its own free,
+// local-free and thread-free lists. Objects allocated together come from
+// one page, and a free from another thread is a single compare-and-swap on
+// the object's page. Pages of exited threads are adopted by live ones.
+// Large blocks go to an MmapCacheHeap.
+//
+//   LD_PRELOAD=./libsharded_heap.so ./my_program
+
+#include <alloc8/alloc8.h>
+#include <alloc8/ansi_wrapper.h>
+#include <alloc8/sharded_page_heap.h>
+
+class TheShardedHeap : public alloc8::ANSIWrapper<alloc8::ShardedPageHeap<>> {};
+
+using ShardedHeapRedirect = alloc8::HeapRedirect<TheShardedHeap>;
+ALLOC8_REDIRECT_WITH_THREADS(ShardedHeapRedirect);
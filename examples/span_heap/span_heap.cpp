@@ -0,0 +1,33 @@
+// alloc8/examples/span_heap/span_heap.cpp
+// Example: A complete allocator assembled from alloc8 components
+//
+// SpanHeap provides size-classed spans registered in alloc8's page map, and
+// ANSIWrapper adds the C standard edge cases. Because SpanHeap implements
+// iterate(), the resulting library exports a working xxmalloc_iterate and
+// can write heap dumps:
+//
+//   ALLOC8_HEAP_DUMP=/tmp/heap.txt LD_PRELOAD=./libspan_heap.so ./my_program
+//
+// Allocations of 1 MB and up are growable: realloc extends them in place by
+// committing reserved pages instead of copying.
+//
+// Small objects go through a ThreadCache reached via the current
+// AllocContext. Fiber runtimes can call alloc8_switch_context() on resume so
+// each fiber keeps its own cache while migrating between threads.
+
+#include <alloc8/alloc8.h>
+#include <alloc8/ansi_wrapper.h>
+#include <alloc8/span_heap.h>
+#include <alloc8/thread_cache.h>
+
+constexpr size_t kGrowInPlaceMin = 1024 * 1024;
+
+class TheSpanHeap
+  : public alloc8::ANSIWrapper<
+      alloc8::ThreadCache<alloc8::SpanHeap<alloc8::OSPageSource,
+                                           alloc8::SizeClasses,
+                                           alloc8::InBandFreeList,
+                                           kGrowInPlaceMin>>> {};
+
+using SpanHeapRedirect = alloc8::HeapRedirect<TheSpanHeap>;
+ALLOC8_REDIRECT_WITH_THREADS(SpanHeapRedirect);
@@ -3,6 +3,7 @@
 
 #include "platform.h"
 #include "allocator_traits.h"
+#include "alloc_context.h"
 
 // ─── XXMALLOC INTERFACE ───────────────────────────────────────────────────────
 //
@@ -51,6 +52,14 @@
       return HeapRedirectType::memalign(alignment, sz); \
     } \
     \
+    ALLOC8_EXPORT void* xxmalloc_from(const void* caller, size_t sz) { \
+      return HeapRedirectType::mallocFrom(caller, sz); \
+    } \
+    \
+    ALLOC8_EXPORT void* xxmemalign_from(const void* caller, size_t alignment, size_t sz) { \
+      return HeapRedirectType::memalignFrom(caller, alignment, sz); \
+    } \
+    \
     ALLOC8_EXPORT size_t xxmalloc_usable_size(void* ptr) { \
       return HeapRedirectType::getSize(ptr); \
     } \
@@ -70,6 +79,30 @@
     ALLOC8_EXPORT void* xxcalloc(size_t count, size_t sz) { \
       return HeapRedirectType::calloc(count, sz); \
     } \
+    \
+    ALLOC8_EXPORT int xxmalloc_iterate(alloc8_iterate_callback cb, void* ctx) { \
+      return HeapRedirectType::iterate(cb, ctx); \
+    } \
+    \
+    ALLOC8_EXPORT int xxmalloc_cache_stats(alloc8_cache_stats_callback cb, void* ctx) { \
+      return HeapRedirectType::cacheStats(cb, ctx); \
+    } \
+    \
+    ALLOC8_EXPORT int xxmalloc_span_sizing_stats(alloc8_span_sizing_stats_callback cb, void* ctx) { \
+      return HeapRedirectType::spanSizingStats(cb, ctx); \
+    } \
+    \
+    ALLOC8_EXPORT alloc8_context* alloc8_switch_context(alloc8_context* next) { \
+      return alloc8::switch_context(next); \
+    } \
+    \
+    ALLOC8_EXPORT alloc8_context* alloc8_current_context(void) { \
+      return alloc8::current_context(); \
+    } \
+    \
+    ALLOC8_EXPORT void alloc8_release_context(alloc8_context* ctx) { \
+      alloc8::release_context(ctx); \
+    } \
   }
 
 // ─── THREAD REDIRECT MACRO ────────────────────────────────────────────────────
@@ -95,6 +128,8 @@
  *     // Thread hooks (optional)
  *     void threadInit() { ... }      // Initialize per-thread state
  *     void threadCleanup() { ... }   // Cleanup per-thread state
+ *     void threadIdle() { ... }      // Release caches before a long block
+ *     void threadBusy() { ... }      // Resume after threadIdle()
  *   };
  *
  *   using MyRedirect = alloc8::HeapRedirect<MyHeap>;
@@ -113,6 +148,14 @@
     ALLOC8_EXPORT void xxthread_cleanup(void) { \
       ThreadRedirectType::threadCleanup(); \
     } \
+    \
+    ALLOC8_EXPORT void alloc8_thread_idle(void) { \
+      ThreadRedirectType::threadIdle(); \
+    } \
+    \
+    ALLOC8_EXPORT void alloc8_thread_busy(void) { \
+      ThreadRedirectType::threadBusy(); \
+    } \
   }
 
 /**
@@ -159,9 +202,38 @@ extern "C" {
   ALLOC8_EXPORT void* xxrealloc(void* ptr, size_t sz);
   ALLOC8_EXPORT void* xxcalloc(size_t count, size_t sz);
 
+  // Allocations on behalf of code at `caller`: operator new passes its own
+  // return address, since it cannot reach xxmalloc by a tail call. The
+  // platform wrappers define weak versions that drop the caller, for
+  // allocators that define xxmalloc themselves.
+  ALLOC8_EXPORT void* xxmalloc_from(const void* caller, size_t sz);
+  ALLOC8_EXPORT void* xxmemalign_from(const void* caller, size_t alignment, size_t sz);
+
+  // Live-heap iteration (returns -1 if the allocator has no iterate())
+  ALLOC8_EXPORT int xxmalloc_iterate(alloc8_iterate_callback cb, void* ctx);
+
+  // Per-thread cache sizes (returns -1 if the allocator has no cacheStats())
+  ALLOC8_EXPORT int xxmalloc_cache_stats(alloc8_cache_stats_callback cb, void* ctx);
+
+  // Per-class span sizing (returns -1 if the allocator has no adaptive
+  // span sizing)
+  ALLOC8_EXPORT int xxmalloc_span_sizing_stats(alloc8_span_sizing_stats_callback cb, void* ctx);
+
+  // Allocation contexts (see alloc_context.h). A fiber runtime calls these
+  // on the preloaded allocator, so its caches follow fibers across threads;
+  // declare them weak if the allocator may not be preloaded.
+  ALLOC8_EXPORT alloc8_context* alloc8_switch_context(alloc8_context* next);
+  ALLOC8_EXPORT alloc8_context* alloc8_current_context(void);
+  ALLOC8_EXPORT void alloc8_release_context(alloc8_context* ctx);
+
   // Thread hooks (optional - only if ALLOC8_THREAD_REDIRECT used)
   ALLOC8_EXPORT void xxthread_init(void);
   ALLOC8_EXPORT void xxthread_cleanup(void);
+
+  // Application notifications (see thread_hooks.h); declare them weak if
+  // the allocator may not be preloaded
+  ALLOC8_EXPORT void alloc8_thread_idle(void);
+  ALLOC8_EXPORT void alloc8_thread_busy(void);
 }
 
 // ─── USAGE INSTRUCTIONS ───────────────────────────────────────────────────────
@@ -175,8 +247,15 @@ extern "C" {
 //      - void unlock()
 //    Optional:
 //      - void* realloc(void* ptr, size_t sz)  // if not provided, default used
+//      - void iterate(alloc8_iterate_callback cb, void* ctx)  // live-heap walk
+//      - void cacheStats(alloc8_cache_stats_callback cb, void* ctx)  // cache sizes
+//      - void spanSizingStats(alloc8_span_sizing_stats_callback cb, void* ctx)
+//      - void* mallocFrom(const void* caller, size_t sz)  // per-caller heaps
+//      - void* memalignFrom(const void* caller, size_t align, size_t sz)
 //      - void threadInit()      // called when new thread starts
 //      - void threadCleanup()   // called when thread exits
+//      - void threadIdle()      // alloc8_thread_idle(): release caches
+//      - void threadBusy()      // alloc8_thread_busy(): idle thread resumed
 //
 // 2. Create a HeapRedirect type alias:
 //      using MyRedirect = alloc8::HeapRedirect<MyAllocator>;
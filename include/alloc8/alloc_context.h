@@ -0,0 +1,99 @@
+// alloc8/alloc_context.h - Switchable allocation context for fibers
+#pragma once
+
+#include "platform.h"
+#include <cstddef>
+#include <cstdint>
+
+extern "C" {
+/**
+ * Allocation context: the per-thread state a thread-aware layer would
+ * otherwise keep in raw TLS (current heap, its thread cache, a tag).
+ *
+ * Each OS thread starts on its own default context. A fiber scheduler gives
+ * each fiber its own zero-initialized context and switches to it whenever
+ * the fiber is resumed, so the fiber keeps its cache (and locality) when it
+ * migrates to another OS thread, and two fibers never share one.
+ *
+ * Layers fill in `heap`, `threadCache` and `release` on first use; `tag` is
+ * free for the caller (fiber id, request class, ...).
+ */
+struct alloc8_context {
+  void*    heap;         // Layer that owns threadCache (nullptr until first use)
+  void*    threadCache;  // That layer's per-context cache
+  uint32_t tag;          // Caller-defined label
+  void   (*release)(struct alloc8_context* ctx);  // Returns threadCache to heap
+};
+}
+
+namespace alloc8 {
+
+using AllocContext = alloc8_context;
+
+// ─── CONTEXT SLOTS ────────────────────────────────────────────────────────────
+
+/**
+ * The calling thread's default context (used when no fiber context is
+ * active). Zero-initialized static TLS, so it is usable from inside malloc.
+ */
+ALLOC8_ALWAYS_INLINE
+AllocContext& thread_context() {
+  static ALLOC8_TLS AllocContext context;
+  return context;
+}
+
+namespace detail {
+ALLOC8_ALWAYS_INLINE
+AllocContext*& context_slot() {
+  static ALLOC8_TLS AllocContext* slot;
+  return slot;
+}
+} // namespace detail
+
+// ─── CONTEXT API ──────────────────────────────────────────────────────────────
+
+/**
+ * The active context: one TLS load, then every thread-aware layer reaches
+ * its state through this pointer.
+ */
+ALLOC8_ALWAYS_INLINE
+AllocContext* current_context() {
+  AllocContext*& slot = detail::context_slot();
+  if (ALLOC8_UNLIKELY(slot == nullptr)) {
+    slot = &thread_context();
+  }
+  return slot;
+}
+
+/**
+ * Make `next` the active context on this thread (nullptr = the thread's
+ * default context) and return the previously active one, so a scheduler can
+ * restore it when the fiber yields:
+ *
+ *   AllocContext* saved = alloc8::switch_context(&fiber->alloc);
+ *   swapcontext(&scheduler, &fiber->uc);
+ *   alloc8::switch_context(saved);
+ *
+ * A context must be active on at most one thread at a time.
+ */
+ALLOC8_ALWAYS_INLINE
+AllocContext* switch_context(AllocContext* next) {
+  AllocContext* prev = current_context();
+  detail::context_slot() = next ? next : &thread_context();
+  return prev;
+}
+
+/**
+ * Return everything cached in `ctx` to its heap and reset it, e.g. when a
+ * fiber finishes. The context must not be active on any thread.
+ */
+inline void release_context(AllocContext* ctx) {
+  if (ctx->release) {
+    ctx->release(ctx);
+  }
+  ctx->heap = nullptr;
+  ctx->threadCache = nullptr;
+  ctx->release = nullptr;
+}
+
+} // namespace alloc8
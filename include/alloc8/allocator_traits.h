@@ -3,6 +3,7 @@
 
 #include "platform.h"
 #include <cstddef>
+#include <cstdint>
 #include <cstring>
 #include <new>
 #include <type_traits>
@@ -11,8 +12,65 @@
 #include <concepts>
 #endif
 
+extern "C" {
+/**
+ * Callback invoked once per live allocation by xxmalloc_iterate.
+ *
+ * Runs while part of the heap is locked: it must not call malloc, free, or
+ * anything that may allocate (stdio, iostreams, std::string...).
+ */
+typedef void (*alloc8_iterate_callback)(void* ptr, size_t size, void* ctx);
+
+/**
+ * One per-thread (per-context) object cache, as reported by
+ * xxmalloc_cache_stats.
+ */
+typedef struct alloc8_cache_stats {
+  uint32_t id;        // Cache number, in order of creation
+  uint32_t idle;      // 1 if drained as idle by the last rebalance
+  uint64_t bytes;     // Bytes of objects currently cached
+  uint64_t capacity;  // Bytes of the global budget this cache holds (0 = unbudgeted)
+  uint64_t ops;       // Operations so far (budgeted caches only)
+} alloc8_cache_stats;
+
+/**
+ * Callback invoked once per cache by xxmalloc_cache_stats. Runs with the
+ * cache registry locked: it must not allocate.
+ */
+typedef void (*alloc8_cache_stats_callback)(const alloc8_cache_stats* stats, void* ctx);
+
+/**
+ * One size class of a heap with adaptive span sizing (see
+ * AdaptiveSpanSizing), as reported by xxmalloc_span_sizing_stats.
+ */
+typedef struct alloc8_span_sizing_stats {
+  uint32_t owner;     // Owner id of the heap (a process may have several)
+  uint32_t size;      // Object size of the class
+  int32_t shift;      // log2(pages / base), before clamping
+  uint64_t pages;     // Pages of the class's current span size
+  uint64_t base;      // Pages the size-class map chose
+  uint64_t refills;   // Spans created
+  uint64_t releases;  // Empty spans released
+  uint64_t grows;     // Times the span size doubled
+  uint64_t shrinks;   // Times it halved
+  uint64_t live;      // Objects allocated from the class's spans
+  uint64_t slots;     // Objects the class's spans can hold
+} alloc8_span_sizing_stats;
+
+/**
+ * Callback invoked once per size class that has made a span. Runs with no
+ * heap lock held, but may run inside a heap dump: it must not allocate.
+ */
+typedef void (*alloc8_span_sizing_stats_callback)(const alloc8_span_sizing_stats* stats,
+                                                  void* ctx);
+}
+
 namespace alloc8 {
 
+using IterateCallback = alloc8_iterate_callback;
+using CacheStatsCallback = alloc8_cache_stats_callback;
+using SpanSizingStatsCallback = alloc8_span_sizing_stats_callback;
+
 // ─── ALLOCATOR CONCEPT (C++20) ────────────────────────────────────────────────
 
 #if __cplusplus >= 202002L
@@ -49,6 +107,16 @@ concept AllocatorWithRealloc = Allocator<T> &&
     { allocator.realloc(ptr, size) } -> std::convertible_to<void*>;
   };
 
+/**
+ * Optional extension: allocator can enumerate its live allocations.
+ * Exported as xxmalloc_iterate for leak and heap-dump analysis.
+ */
+template<typename T>
+concept IterableAllocator = Allocator<T> &&
+  requires(T& allocator, IterateCallback cb, void* ctx) {
+    { allocator.iterate(cb, ctx) } -> std::same_as<void>;
+  };
+
 #endif // C++20
 
 // ─── HEAP REDIRECT TEMPLATE ───────────────────────────────────────────────────
@@ -109,6 +177,34 @@ public:
     return getHeap()->memalign(alignment, sz);
   }
 
+  /**
+   * malloc() on behalf of code at `caller` (operator new passes its own
+   * return address), for allocators that attribute allocations to callers
+   * (see ModuleHeap). Others ignore the caller.
+   */
+  ALLOC8_ALWAYS_INLINE ALLOC8_MALLOC_ATTR ALLOC8_ALLOC_SIZE(2)
+  static void* mallocFrom(const void* caller, size_t sz) {
+    if constexpr (requires(AllocatorType& a) { a.mallocFrom(caller, sz); }) {
+      return getHeap()->mallocFrom(caller, sz);
+    } else {
+      (void)caller;
+      return getHeap()->malloc(sz);
+    }
+  }
+
+  /**
+   * memalign() on behalf of code at `caller`; see mallocFrom().
+   */
+  ALLOC8_ALWAYS_INLINE ALLOC8_MALLOC_ATTR ALLOC8_ALLOC_SIZE(3)
+  static void* memalignFrom(const void* caller, size_t alignment, size_t sz) {
+    if constexpr (requires(AllocatorType& a) { a.memalignFrom(caller, alignment, sz); }) {
+      return getHeap()->memalignFrom(caller, alignment, sz);
+    } else {
+      (void)caller;
+      return getHeap()->memalign(alignment, sz);
+    }
+  }
+
   ALLOC8_ALWAYS_INLINE
   static size_t getSize(void* ptr) {
     return ptr ? getHeap()->getSize(ptr) : 0;
@@ -158,6 +254,52 @@ public:
     }
   }
 
+  /**
+   * Visit every live allocation, if the allocator supports it.
+   * @return 0 on success, -1 if the allocator has no iterate() member
+   */
+  static int iterate(IterateCallback cb, void* ctx) {
+    if constexpr (requires(AllocatorType& a) { a.iterate(cb, ctx); }) {
+      getHeap()->iterate(cb, ctx);
+      return 0;
+    } else {
+      (void)cb;
+      (void)ctx;
+      return -1;
+    }
+  }
+
+  /**
+   * Report per-thread cache sizes, if the allocator has caches.
+   * @return 0 on success, -1 if the allocator has no cacheStats() member
+   */
+  static int cacheStats(CacheStatsCallback cb, void* ctx) {
+    if constexpr (requires(AllocatorType& a) { a.cacheStats(cb, ctx); }) {
+      getHeap()->cacheStats(cb, ctx);
+      return 0;
+    } else {
+      (void)cb;
+      (void)ctx;
+      return -1;
+    }
+  }
+
+  /**
+   * Report span sizing per size class, if the allocator sizes spans
+   * adaptively.
+   * @return 0 on success, -1 if the allocator has no spanSizingStats(cb, ctx)
+   */
+  static int spanSizingStats(SpanSizingStatsCallback cb, void* ctx) {
+    if constexpr (requires(AllocatorType& a) { a.spanSizingStats(cb, ctx); }) {
+      getHeap()->spanSizingStats(cb, ctx);
+      return 0;
+    } else {
+      (void)cb;
+      (void)ctx;
+      return -1;
+    }
+  }
+
   /**
    * Calloc with overflow check and zero-init.
    */
@@ -211,6 +353,8 @@ concept ThreadAwareAllocator = requires(T& allocator) {
  *     // ... malloc/free methods ...
  *     void threadInit();      // Called when thread starts
  *     void threadCleanup();   // Called when thread exits
+ *     void threadIdle();      // Optional: thread about to block for long
+ *     void threadBusy();      // Optional: idle thread resumed
  *   };
  *
  *   using MyRedirect = alloc8::HeapRedirect<MyHeap>;
@@ -255,6 +399,28 @@ public:
     }
   }
 
+  /**
+   * Thread idle hook (alloc8_thread_idle).
+   * Called by the application before a thread blocks for a long time.
+   */
+  ALLOC8_ALWAYS_INLINE
+  static void threadIdle() {
+    if constexpr (requires(AllocatorType& a) { a.threadIdle(); }) {
+      getAllocator()->threadIdle();
+    }
+  }
+
+  /**
+   * Thread busy hook (alloc8_thread_busy).
+   * Called by the application when an idle thread resumes work.
+   */
+  ALLOC8_ALWAYS_INLINE
+  static void threadBusy() {
+    if constexpr (requires(AllocatorType& a) { a.threadBusy(); }) {
+      getAllocator()->threadBusy();
+    }
+  }
+
   /**
    * Check if allocator actually has thread hooks.
    * Used to conditionally enable pthread interposition.
@@ -2,6 +2,7 @@
 #pragma once
 
 #include "platform.h"
+#include <cerrno>
 #include <cstddef>
 #include <cstdint>
 #include <cstring>
@@ -17,18 +18,40 @@ namespace alloc8 {
  * - Overflow detection for size calculations
  * - Proper handling of edge cases (size 0, null pointers)
  *
+ * With a TinyLimit of 8, requests of at most 8 bytes get an 8-byte block
+ * instead of a MinAlignment one, so boxed words and pointers stop paying
+ * for 16. malloc(n) must be aligned for every object that fits in n bytes
+ * (C17, DR 445), and no object of 8 bytes or less needs more than 8. Any
+ * larger request may hold a 16-aligned member (long double, __int128, a
+ * max_align_t header followed by a few bytes), so it is rounded to
+ * MinAlignment as before. The heap must serve every multiple of
+ * MinAlignment at that alignment, as SpanHeap<..., TinySizeClasses> and
+ * ThreadCache over it do:
+ *
+ *   using Nodes = alloc8::ANSIWrapper<
+ *       alloc8::ThreadCache<alloc8::SpanHeap<alloc8::OSPageSource,
+ *                                            alloc8::TinySizeClasses>,
+ *                           alloc8::TinySizeClasses>,
+ *       ALLOC8_MIN_ALIGNMENT, 8>;
+ *
  * @tparam SuperHeap The underlying allocator to wrap
  * @tparam MinAlignment Minimum alignment in bytes (default: 16)
+ * @tparam TinyLimit Largest request given an 8-byte block (0 = off, or 8)
  */
-template<typename SuperHeap, size_t MinAlignment = ALLOC8_MIN_ALIGNMENT>
+template<typename SuperHeap, size_t MinAlignment = ALLOC8_MIN_ALIGNMENT,
+         size_t TinyLimit = 0>
 class ANSIWrapper : public SuperHeap {
   static_assert((MinAlignment & (MinAlignment - 1)) == 0,
                 "MinAlignment must be a power of 2");
   static_assert(MinAlignment >= sizeof(void*),
                 "MinAlignment must be at least sizeof(void*)");
+  static_assert(TinyLimit == 0 || TinyLimit == 8,
+                "TinyLimit must be 0 or 8: larger requests may need MinAlignment");
 
 public:
   static constexpr size_t alignment = MinAlignment;
+  static constexpr size_t tinyAlignment = (MinAlignment > 8) ? 8 : MinAlignment;
+  static constexpr size_t tinyLimit = TinyLimit;
 
   /**
    * Allocate memory with ANSI compliance.
@@ -38,20 +61,20 @@ public:
    */
   ALLOC8_ALWAYS_INLINE
   void* malloc(size_t sz) {
-    // Enforce minimum size for alignment
-    if (sz < alignment) {
-      sz = alignment;
-    }
-
-    // Check for overflow in size rounding
-    if (ALLOC8_UNLIKELY(sz > SIZE_MAX - alignment + 1)) {
-      return nullptr;
-    }
-
-    // Round up to alignment
-    sz = (sz + alignment - 1) & ~(alignment - 1);
+    sz = roundRequest(sz);
+    return ALLOC8_LIKELY(sz != 0) ? SuperHeap::malloc(sz) : nullptr;
+  }
 
-    return SuperHeap::malloc(sz);
+  /**
+   * malloc() on behalf of code at `caller`, for heaps that attribute
+   * allocations to callers (see ModuleHeap).
+   */
+  ALLOC8_ALWAYS_INLINE
+  void* mallocFrom(const void* caller, size_t sz)
+    requires requires(SuperHeap& h) { h.mallocFrom(caller, sz); }
+  {
+    sz = roundRequest(sz);
+    return ALLOC8_LIKELY(sz != 0) ? SuperHeap::mallocFrom(caller, sz) : nullptr;
   }
 
   /**
@@ -81,10 +104,14 @@ public:
     }
 
     // Enforce minimum and alignment
-    if (sz < alignment) {
-      sz = alignment;
+    if (TinyLimit != 0 && sz <= TinyLimit) {
+      sz = roundTiny(sz);
+    } else {
+      if (sz < alignment) {
+        sz = alignment;
+      }
+      sz = (sz + alignment - 1) & ~(alignment - 1);
     }
-    sz = (sz + alignment - 1) & ~(alignment - 1);
 
     // Check current size
     size_t currentSize = SuperHeap::getSize(ptr);
@@ -95,6 +122,14 @@ public:
       return ptr;
     }
 
+    // Let the heap grow the block in place if it can (e.g. SpanHeap's
+    // growable large objects)
+    if constexpr (requires(SuperHeap& h) { h.resizeInPlace(ptr, sz); }) {
+      if (SuperHeap::resizeInPlace(ptr, sz)) {
+        return ptr;
+      }
+    }
+
     // Allocate new block
     void* newPtr = SuperHeap::malloc(sz);
     if (ALLOC8_UNLIKELY(!newPtr)) {
@@ -135,18 +170,27 @@ public:
    */
   ALLOC8_ALWAYS_INLINE
   void* memalign(size_t requestedAlignment, size_t sz) {
-    // Use the larger of requested and minimum alignment
-    size_t actualAlignment = (requestedAlignment > alignment)
-                             ? requestedAlignment : alignment;
-
-    // Validate alignment is power of 2
-    if ((actualAlignment & (actualAlignment - 1)) != 0) {
+    size_t actualAlignment = roundAlignment(requestedAlignment);
+    if (actualAlignment == 0) {
       return nullptr;
     }
-
     return SuperHeap::memalign(actualAlignment, sz);
   }
 
+  /**
+   * memalign() on behalf of code at `caller`; see mallocFrom().
+   */
+  ALLOC8_ALWAYS_INLINE
+  void* memalignFrom(const void* caller, size_t requestedAlignment, size_t sz)
+    requires requires(SuperHeap& h) { h.memalignFrom(caller, requestedAlignment, sz); }
+  {
+    size_t actualAlignment = roundAlignment(requestedAlignment);
+    if (actualAlignment == 0) {
+      return nullptr;
+    }
+    return SuperHeap::memalignFrom(caller, actualAlignment, sz);
+  }
+
   /**
    * posix_memalign semantics.
    * Returns 0 on success, error code on failure.
@@ -189,9 +233,41 @@ public:
   using SuperHeap::unlock;
 
 private:
-  // EINVAL if not defined
-  static constexpr int EINVAL = 22;
-  static constexpr int ENOMEM = 12;
+  /**
+   * The size malloc() asks SuperHeap for, or 0 if rounding overflows.
+   */
+  static constexpr size_t roundRequest(size_t sz) {
+    // Nothing that fits in 8 bytes needs more than 8-byte alignment
+    if (TinyLimit != 0 && sz <= TinyLimit) {
+      return roundTiny(sz);
+    }
+
+    // Enforce minimum size for alignment
+    if (sz < alignment) {
+      sz = alignment;
+    }
+
+    // Check for overflow in size rounding
+    if (ALLOC8_UNLIKELY(sz > SIZE_MAX - alignment + 1)) {
+      return 0;
+    }
+
+    // Round up to alignment
+    return (sz + alignment - 1) & ~(alignment - 1);
+  }
+
+  /**
+   * The larger of `requested` and the minimum alignment, or 0 if it is
+   * not a power of 2.
+   */
+  static constexpr size_t roundAlignment(size_t requested) {
+    size_t actual = (requested > alignment) ? requested : alignment;
+    return ((actual & (actual - 1)) == 0) ? actual : 0;
+  }
+
+  static constexpr size_t roundTiny(size_t) {
+    return tinyAlignment;
+  }
 };
 
 } // namespace alloc8
@@ -0,0 +1,367 @@
+// alloc8/bitmap_slab.h - Fixed-size slab heap with out-of-band occupancy bitmaps
+#pragma once
+
+#include "platform.h"
+#include "allocator_traits.h"
+#include "metadata.h"
+#include "os_memory.h"
+#include "page_map.h"
+#include "page_source.h"
+#include "span.h"
+#include <atomic>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+
+#if defined(__AVX2__)
+  #include <immintrin.h>
+#endif
+
+namespace alloc8 {
+
+// ─── BITMAP SLAB ──────────────────────────────────────────────────────────────
+
+/**
+ * BitmapSlab: Objects of one size in spans of SlotsPerSpan slots, with one
+ * occupancy bit per slot kept outside object memory (as in DieHard).
+ *
+ * Allocation finds a word with a clear bit and takes its free slots with
+ * count-trailing-zeros (tzcnt), so mallocBatch() fills a ThreadCache refill
+ * from one or two words without touching any object. When built with AVX2
+ * (-mavx2 or a -march that has it), bitmaps of four words or more are
+ * searched four words per compare, which skips long full runs in big
+ * spans. Allocation is serialized by one lock; spans are picked next-fit,
+ * and a new span is made only when every span is full.
+ *
+ * free() takes no lock: it clears the object's bit with an atomic AND and
+ * drops the span's live count, so frees from any thread never contend with
+ * the allocating thread or with each other beyond the bitmap word. A bit
+ * that is already clear (a double free) is ignored. Empty spans are kept
+ * until releaseEmpty().
+ *
+ * Spans are registered in pageMap() under this heap's owner id, so it can
+ * serve as a tier of a SizeRouterN or sit under a ThreadCache:
+ *
+ *   using Small = alloc8::BitmapSlab<64, 1024>;
+ *   using MyHeap = alloc8::ANSIWrapper<alloc8::SizeRouterN<
+ *       alloc8::Route<64, Small>, alloc8::Route<SIZE_MAX, alloc8::SpanHeap<>>>>;
+ *
+ * Requests above ObjSize return nullptr.
+ *
+ * @tparam ObjSize      Bytes per object (a multiple of ALLOC8_MIN_ALIGNMENT)
+ * @tparam SlotsPerSpan Objects per span (a multiple of 64)
+ * @tparam PageSource   Where span pages come from (see page_source.h)
+ */
+template<size_t ObjSize, size_t SlotsPerSpan = 1024, typename PageSource = OSPageSource>
+class BitmapSlab {
+  static_assert(ObjSize >= ALLOC8_MIN_ALIGNMENT && ObjSize % ALLOC8_MIN_ALIGNMENT == 0,
+                "ObjSize must be a multiple of ALLOC8_MIN_ALIGNMENT");
+  static_assert(SlotsPerSpan >= 64 && SlotsPerSpan % 64 == 0,
+                "SlotsPerSpan must be a multiple of 64");
+
+  static constexpr size_t kWords = SlotsPerSpan / 64;
+  static constexpr size_t kPages = alignUp(ObjSize * SlotsPerSpan, ALLOC8_PAGE_SIZE) / ALLOC8_PAGE_SIZE;
+  // Largest power of two dividing ObjSize, up to a page: slots stay aligned
+  static constexpr size_t kAlignment =
+      (ObjSize & (~ObjSize + 1)) < ALLOC8_PAGE_SIZE ? (ObjSize & (~ObjSize + 1))
+                                                    : ALLOC8_PAGE_SIZE;
+
+  struct Slab {
+    Span span;                        // First member: pageMap() yields &slab->span
+    std::atomic<uint32_t> live;       // Set bits; dropped by lock-free frees
+    uint32_t hint;                    // First word that may have a clear bit
+    Slab* next;                       // List of all slabs (under lock_)
+    alignas(32) uint64_t used[kWords];  // Set bit = slot in use
+  };
+
+public:
+  /**
+   * True when this build searches bitmaps with AVX2.
+   */
+  static constexpr bool kVectorSearch =
+#if defined(__AVX2__)
+    kWords >= 4;
+#else
+    false;
+#endif
+
+  BitmapSlab() : owner_(registerOwner()) {}
+
+  /**
+   * Owner id stamped into every span this heap creates.
+   */
+  uint16_t owner() const { return owner_; }
+
+  ALLOC8_ALWAYS_INLINE
+  void* malloc(size_t sz) {
+    void* obj;
+    return mallocBatch(sz, &obj, 1) ? obj : nullptr;
+  }
+
+  void* memalign(size_t alignment, size_t sz) {
+    return alignment <= kAlignment ? malloc(sz) : nullptr;
+  }
+
+  /**
+   * Allocate up to `n` objects under one lock acquisition, taking whole
+   * runs of clear bits per bitmap word. Returns how many were stored in
+   * `out` (0 above ObjSize or when out of memory).
+   */
+  size_t mallocBatch(size_t sz, void** out, size_t n) {
+    if (ALLOC8_UNLIKELY(sz > ObjSize)) {
+      return 0;
+    }
+    std::lock_guard<std::mutex> guard(lock_);
+    size_t got = 0;
+    while (got < n) {
+      if (current_ == nullptr && (current_ = nextSlabLocked()) == nullptr) {
+        break;
+      }
+      got += takeSlots(current_, out + got, n - got);
+      if (got < n) {
+        current_->hint = 0;  // Frees behind the hint are found next visit
+        current_ = nextSlabLocked();
+      }
+    }
+    return got;
+  }
+
+  ALLOC8_ALWAYS_INLINE
+  void free(void* ptr) {
+    Span* span = pageMap().get(ptr);
+    if (ALLOC8_UNLIKELY(span == nullptr || span->owner != owner_)) {
+      return;  // Not ours
+    }
+    Slab* slab = reinterpret_cast<Slab*>(span);
+    size_t index = span->indexOf(ptr);
+    uint64_t bit = uint64_t(1) << (index % 64);
+    uint64_t old = std::atomic_ref<uint64_t>(slab->used[index / 64])
+                       .fetch_and(~bit, std::memory_order_release);
+    if (ALLOC8_LIKELY(old & bit)) {
+      slab->live.fetch_sub(1, std::memory_order_release);
+    }
+  }
+
+  /**
+   * Free `n` objects, clearing all bits that share a bitmap word with one
+   * atomic AND.
+   */
+  void freeBatch(void** ptrs, size_t n) {
+    size_t i = 0;
+    while (i < n) {
+      Span* span = pageMap().get(ptrs[i]);
+      if (span == nullptr || span->owner != owner_) {
+        i++;
+        continue;
+      }
+      Slab* slab = reinterpret_cast<Slab*>(span);
+      size_t word = span->indexOf(ptrs[i]) / 64;
+      uint64_t mask = 0;
+      do {
+        mask |= uint64_t(1) << (span->indexOf(ptrs[i]) % 64);
+      } while (++i < n && span->contains(ptrs[i]) &&
+               span->indexOf(ptrs[i]) / 64 == word);
+      uint64_t old = std::atomic_ref<uint64_t>(slab->used[word])
+                         .fetch_and(~mask, std::memory_order_release);
+      if (uint32_t freed = static_cast<uint32_t>(std::popcount(old & mask))) {
+        slab->live.fetch_sub(freed, std::memory_order_release);
+      }
+    }
+  }
+
+  ALLOC8_ALWAYS_INLINE
+  size_t getSize(void* ptr) {
+    Span* span = pageMap().get(ptr);
+    if (ALLOC8_UNLIKELY(span == nullptr || span->owner != owner_)) {
+      return 0;
+    }
+    return ObjSize;
+  }
+
+  /**
+   * Bytes in spans (live or free).
+   */
+  size_t spanBytes() {
+    std::lock_guard<std::mutex> guard(lock_);
+    return count_ * kPages * ALLOC8_PAGE_SIZE;
+  }
+
+  /**
+   * Return every span with no live object to the page source. Returns
+   * bytes released.
+   */
+  size_t releaseEmpty() {
+    std::lock_guard<std::mutex> guard(lock_);
+    size_t released = 0;
+    Slab** link = &head_;
+    while (Slab* slab = *link) {
+      if (slab->live.load(std::memory_order_acquire) != 0) {
+        link = &slab->next;
+        continue;
+      }
+      *link = slab->next;
+      if (current_ == slab) {
+        current_ = nullptr;
+      }
+      void* mem = reinterpret_cast<void*>(slab->span.start);
+      pageMap().erase(&slab->span);
+      slabs_.deallocate(slab);
+      source_.freePages(mem, kPages);
+      count_--;
+      released += kPages * ALLOC8_PAGE_SIZE;
+    }
+    cursor_ = current_;
+    return released;
+  }
+
+  void lock() {
+    lock_.lock();
+    source_.lock();
+  }
+
+  void unlock() {
+    source_.unlock();
+    lock_.unlock();
+  }
+
+  /**
+   * Visit every live allocation (see alloc8_iterate_callback). Holds the
+   * allocation lock; an object freed concurrently from another thread may
+   * or may not be reported.
+   */
+  void iterate(IterateCallback cb, void* ctx) {
+    std::lock_guard<std::mutex> guard(lock_);
+    for (Slab* slab = head_; slab; slab = slab->next) {
+      for (size_t w = 0; w < kWords; w++) {
+        uint64_t bits = std::atomic_ref<uint64_t>(slab->used[w]).load(std::memory_order_acquire);
+        for (; bits; bits &= bits - 1) {
+          size_t index = w * 64 + static_cast<size_t>(std::countr_zero(bits));
+          cb(slab->span.objectAt(index), ObjSize, ctx);
+        }
+      }
+    }
+  }
+
+private:
+  std::mutex lock_;
+  Slab* head_ = nullptr;     // All slabs
+  Slab* current_ = nullptr;  // Slab being allocated from
+  Slab* cursor_ = nullptr;   // Where the next-fit search resumes
+  size_t count_ = 0;
+  PageSource source_;
+  MetadataArena<Slab> slabs_;
+  uint16_t owner_;
+
+  static uint64_t loadWord(const uint64_t& word) {
+    return std::atomic_ref<uint64_t>(const_cast<uint64_t&>(word)).load(std::memory_order_relaxed);
+  }
+
+  /**
+   * Index of the first word at or after `w` with a clear bit, or kWords.
+   * The vector loop reads the bitmap without atomics: concurrent frees only
+   * clear bits, so a stale word can hide a free slot until the next visit
+   * but never shows a taken one as free.
+   */
+  static size_t findFreeWord(const uint64_t* used, size_t w) {
+#if defined(__AVX2__)
+    if constexpr (kWords >= 4) {
+      for (; w % 4 != 0 && w < kWords; w++) {
+        if (~loadWord(used[w])) {
+          return w;
+        }
+      }
+      const __m256i full = _mm256_set1_epi64x(-1);
+      for (; w + 4 <= kWords; w += 4) {
+        __m256i v = _mm256_load_si256(reinterpret_cast<const __m256i*>(used + w));
+        unsigned fullWords = static_cast<unsigned>(
+            _mm256_movemask_pd(_mm256_castsi256_pd(_mm256_cmpeq_epi64(v, full))));
+        if (fullWords != 0xF) {
+          return w + static_cast<size_t>(std::countr_zero(~fullWords));
+        }
+      }
+    }
+#endif
+    for (; w < kWords; w++) {
+      if (~loadWord(used[w])) {
+        return w;
+      }
+    }
+    return kWords;
+  }
+
+  // Claim up to `n` clear bits of `slab`, lowest first
+  size_t takeSlots(Slab* slab, void** out, size_t n) {
+    size_t got = 0;
+    size_t w = slab->hint;
+    while (got < n && (w = findFreeWord(slab->used, w)) < kWords) {
+      std::atomic_ref<uint64_t> word(slab->used[w]);
+      uint64_t clear = ~word.load(std::memory_order_relaxed);
+      uint64_t claim = 0;
+      for (; clear && got < n; clear &= clear - 1) {
+        uint64_t bit = clear & (~clear + 1);
+        claim |= bit;
+        out[got++] = slab->span.objectAt(w * 64 + static_cast<size_t>(std::countr_zero(bit)));
+      }
+      // Only this (locked) side sets bits, so the clear bits seen stay
+      // clear; acquire pairs with the release in free().
+      word.fetch_or(claim, std::memory_order_acquire);
+      if (clear == 0) {
+        w++;
+      }
+    }
+    slab->hint = static_cast<uint32_t>(w < kWords ? w : kWords);
+    slab->live.fetch_add(static_cast<uint32_t>(got), std::memory_order_relaxed);
+    return got;
+  }
+
+  // Next slab after the cursor with a free slot, or a new one
+  Slab* nextSlabLocked() {
+    Slab* start = cursor_ ? cursor_->next : nullptr;
+    for (size_t i = 0; i < count_; i++) {
+      if (start == nullptr) {
+        start = head_;
+      }
+      // A free clears its bit before dropping live, so live below
+      // SlotsPerSpan means a clear bit is already visible.
+      if (start->live.load(std::memory_order_acquire) < SlotsPerSpan) {
+        cursor_ = start;
+        return start;
+      }
+      start = start->next;
+    }
+    Slab* slab = newSlab();
+    cursor_ = slab ? slab : cursor_;
+    return slab;
+  }
+
+  Slab* newSlab() {
+    void* mem = source_.allocPages(kPages, ALLOC8_PAGE_SIZE);
+    if (!mem) {
+      return nullptr;
+    }
+    Slab* slab = slabs_.allocate();
+    if (!slab) {
+      source_.freePages(mem, kPages);
+      return nullptr;
+    }
+    Span& span = slab->span;
+    span.start = reinterpret_cast<uintptr_t>(mem);
+    span.npages = kPages;
+    span.objectSize = ObjSize;
+    span.sizeClass = 1;  // Any nonzero class: a small-object span
+    span.capacity = static_cast<uint32_t>(SlotsPerSpan);
+    span.owner = owner_;
+    if (!pageMap().insert(&span)) {
+      slabs_.deallocate(slab);
+      source_.freePages(mem, kPages);
+      return nullptr;
+    }
+    slab->next = head_;
+    head_ = slab;
+    count_++;
+    return slab;
+  }
+};
+
+} // namespace alloc8
@@ -0,0 +1,266 @@
+// alloc8/central_free_list.h - Lock-free per-class batch stacks over a heap
+#pragma once
+
+#include "platform.h"
+#include "heap_iteration.h"
+#include "metadata.h"
+#include "size_classes.h"
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+namespace alloc8 {
+
+// ─── CENTRAL FREE LIST ────────────────────────────────────────────────────────
+
+/**
+ * CentralFreeList: A lock-free transfer tier between per-thread caches and
+ * a shared heap.
+ *
+ * Every size class has a Treiber stack of object batches. freeBatch() (a
+ * ThreadCache flush) links the objects through their first word and pushes
+ * them as one batch. mallocBatch() (a ThreadCache refill) pops one. Both
+ * are a single compare-and-swap, so cache refills and flushes between
+ * threads never take a lock. The underlying heap is reached only on the
+ * span-level slow paths: when a class stack is empty, or holds ClassBytes
+ * already.
+ *
+ *   using MyHeap = alloc8::ANSIWrapper<alloc8::ThreadCache<
+ *       alloc8::CentralFreeList<alloc8::SpanHeap<>>>>;
+ *
+ * Batch descriptors live in a MetadataArena and are recycled, never
+ * unmapped, so a pop that races another pop reads a stale descriptor
+ * rather than freed memory. Each stack head packs a 16-bit sequence number
+ * above the 48-bit descriptor address, which is bumped on every push and
+ * pop, so a head that was popped and pushed again between a thread's read
+ * and its compare-and-swap fails the swap (the ABA problem).
+ *
+ * freeBatch() expects objects of one size class, as ThreadCache flushes
+ * them. iterate() leaves objects held in batches out of the heap's walk.
+ * Call drain() to return them all to the heap.
+ *
+ * @tparam Heap       Shared heap (e.g. SpanHeap); must be safe from any thread
+ * @tparam Classes    Size-class map (should match the heap's)
+ * @tparam ClassBytes Most bytes held per class before flushes go to the heap
+ */
+template<typename Heap, typename Classes = SizeClasses,
+         size_t ClassBytes = 512 * 1024>
+class CentralFreeList : public Heap {
+  static_assert(sizeof(void*) == 8, "Tagged stack heads need 64-bit pointers");
+
+  static constexpr int kAddressBits = 48;
+  static constexpr uint64_t kAddressMask = (uint64_t(1) << kAddressBits) - 1;
+
+  struct Batch {
+    std::atomic<Batch*> next;  // Read racily by concurrent pops
+    void* head;                // Objects, linked through their first word
+    size_t count;
+  };
+
+  // Treiber stack of Batch descriptors with a sequence-tagged head
+  class BatchStack {
+    std::atomic<uint64_t> top_{0};
+
+    static Batch* batchOf(uint64_t word) {
+      return reinterpret_cast<Batch*>(word & kAddressMask);
+    }
+
+    static uint64_t pack(Batch* batch, uint64_t word) {
+      uint64_t seq = (word >> kAddressBits) + 1;
+      return (seq << kAddressBits) | reinterpret_cast<uint64_t>(batch);
+    }
+
+  public:
+    void push(Batch* batch) {
+      uint64_t top = top_.load(std::memory_order_relaxed);
+      do {
+        batch->next.store(batchOf(top), std::memory_order_relaxed);
+      } while (!top_.compare_exchange_weak(top, pack(batch, top),
+                                           std::memory_order_release,
+                                           std::memory_order_relaxed));
+    }
+
+    Batch* pop() {
+      uint64_t top = top_.load(std::memory_order_acquire);
+      while (Batch* batch = batchOf(top)) {
+        Batch* next = batch->next.load(std::memory_order_relaxed);
+        if (top_.compare_exchange_weak(top, pack(next, top),
+                                       std::memory_order_acquire,
+                                       std::memory_order_acquire)) {
+          return batch;
+        }
+      }
+      return nullptr;
+    }
+  };
+
+  struct alignas(ALLOC8_CACHE_LINE_SIZE) ClassState {
+    BatchStack batches;
+    std::atomic<size_t> bytes{0};
+  };
+
+  ClassState classes_[Classes::kNumClasses];
+  BatchStack spare_;  // Unused descriptors
+  MetadataArena<Batch> descriptors_;
+
+public:
+  /**
+   * Allocate up to `n` objects of the class serving `sz`, popping one
+   * batch; falls back to the heap when the class has none.
+   */
+  size_t mallocBatch(size_t sz, void** out, size_t n) {
+    size_t cls = Classes::sizeToClass(sz);
+    if (cls == 0 || n == 0) {
+      return 0;
+    }
+    ClassState& state = classes_[cls];
+    Batch* batch = state.batches.pop();
+    if (batch == nullptr) {
+      return heapMallocBatch(Classes::classToSize(cls), out, n);
+    }
+    size_t take = batch->count < n ? batch->count : n;
+    void* obj = batch->head;
+    for (size_t i = 0; i < take; i++) {
+      out[i] = obj;
+      obj = *static_cast<void**>(obj);
+    }
+    batch->head = obj;
+    batch->count -= take;
+    state.bytes.fetch_sub(take * Classes::classToSize(cls), std::memory_order_relaxed);
+    if (batch->count != 0) {
+      state.batches.push(batch);  // Leftovers stay available as a smaller batch
+    } else {
+      spare_.push(batch);
+    }
+    return take;
+  }
+
+  /**
+   * Free `n` objects of one size class as a single batch; falls back to
+   * the heap when the class is full or the objects are not class-sized.
+   */
+  void freeBatch(void** ptrs, size_t n) {
+    if (n == 0) {
+      return;
+    }
+    size_t sz = Heap::getSize(ptrs[0]);
+    size_t cls = Classes::sizeToClass(sz);
+    if (cls == 0 || Classes::classToSize(cls) != sz) {
+      heapFreeBatch(ptrs, n);
+      return;
+    }
+    ClassState& state = classes_[cls];
+    size_t bytes = n * sz;
+    if (state.bytes.load(std::memory_order_relaxed) + bytes > ClassBytes) {
+      heapFreeBatch(ptrs, n);
+      return;
+    }
+    Batch* batch = spare_.pop();
+    if (batch == nullptr && (batch = descriptors_.allocate()) == nullptr) {
+      heapFreeBatch(ptrs, n);
+      return;
+    }
+    for (size_t i = 0; i + 1 < n; i++) {
+      *static_cast<void**>(ptrs[i]) = ptrs[i + 1];
+    }
+    *static_cast<void**>(ptrs[n - 1]) = nullptr;
+    batch->head = ptrs[0];
+    batch->count = n;
+    state.bytes.fetch_add(bytes, std::memory_order_relaxed);
+    state.batches.push(batch);
+  }
+
+  /**
+   * Visit every live allocation of the heap beneath, leaving out objects
+   * held in batches. Every batch is popped while its objects are noted and
+   * pushed back before the heap is walked; refills meanwhile go to the
+   * heap.
+   */
+  void iterate(IterateCallback cb, void* ctx)
+    requires requires(Heap& h, IterateCallback f, void* c) { h.iterate(f, c); }
+  {
+    Batch* taken[Classes::kNumClasses] = {};
+    size_t count = 0;
+    for (size_t cls = 1; cls < Classes::kNumClasses; cls++) {
+      while (Batch* batch = classes_[cls].batches.pop()) {
+        batch->next.store(taken[cls], std::memory_order_relaxed);
+        taken[cls] = batch;
+        count += batch->count;
+      }
+    }
+    ExcludedObjects batched(count);
+    for (size_t cls = 1; cls < Classes::kNumClasses; cls++) {
+      while (Batch* batch = taken[cls]) {
+        taken[cls] = batch->next.load(std::memory_order_relaxed);
+        for (void* obj = batch->head; obj; obj = *static_cast<void**>(obj)) {
+          batched.add(obj);
+        }
+        classes_[cls].batches.push(batch);
+      }
+    }
+    batched.iterate([this](IterateCallback f, void* c) { Heap::iterate(f, c); }, cb, ctx);
+  }
+
+  /**
+   * Bytes held in batches across all classes.
+   */
+  size_t centralBytes() const {
+    size_t total = 0;
+    for (size_t cls = 1; cls < Classes::kNumClasses; cls++) {
+      total += classes_[cls].bytes.load(std::memory_order_relaxed);
+    }
+    return total;
+  }
+
+  /**
+   * Return every batched object to the heap. Returns bytes released.
+   */
+  size_t drain() {
+    size_t released = 0;
+    for (size_t cls = 1; cls < Classes::kNumClasses; cls++) {
+      ClassState& state = classes_[cls];
+      while (Batch* batch = state.batches.pop()) {
+        size_t bytes = batch->count * Classes::classToSize(cls);
+        void* ptrs[64];
+        size_t count = 0;
+        for (void* obj = batch->head; obj; ) {
+          ptrs[count++] = obj;
+          obj = *static_cast<void**>(obj);
+          if (count == 64 || obj == nullptr) {
+            heapFreeBatch(ptrs, count);
+            count = 0;
+          }
+        }
+        state.bytes.fetch_sub(bytes, std::memory_order_relaxed);
+        released += bytes;
+        spare_.push(batch);
+      }
+    }
+    return released;
+  }
+
+private:
+  size_t heapMallocBatch(size_t sz, void** out, size_t n) {
+    if constexpr (requires(Heap& h) { h.mallocBatch(sz, out, n); }) {
+      return Heap::mallocBatch(sz, out, n);
+    } else {
+      size_t got = 0;
+      while (got < n && (out[got] = Heap::malloc(sz)) != nullptr) {
+        got++;
+      }
+      return got;
+    }
+  }
+
+  void heapFreeBatch(void** ptrs, size_t n) {
+    if constexpr (requires(Heap& h) { h.freeBatch(ptrs, n); }) {
+      Heap::freeBatch(ptrs, n);
+    } else {
+      for (size_t i = 0; i < n; i++) {
+        Heap::free(ptrs[i]);
+      }
+    }
+  }
+};
+
+} // namespace alloc8
@@ -0,0 +1,529 @@
+// alloc8/coalescing_span_heap.h - Best-fit coalescing heap for medium sizes
+#pragma once
+
+#include "platform.h"
+#include "heap_iteration.h"
+#include "maintenance.h"
+#include "metadata.h"
+#include "os_memory.h"
+#include "page_map.h"
+#include "page_source.h"
+#include "span.h"
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+
+namespace alloc8 {
+
+// ─── COALESCING SPAN HEAP ─────────────────────────────────────────────────────
+
+/**
+ * Snapshot of a CoalescingSpanHeap (see CoalescingSpanHeap::stats()).
+ */
+struct CoalescingSpanStats {
+  size_t mappedBytes;       // Chunks held from the page source
+  size_t liveBytes;         // In live allocations
+  size_t freeBytes;         // In free runs (mappedBytes - liveBytes)
+  size_t largestFreeBytes;  // Longest free run
+  size_t chunks;            // Chunks held
+  size_t emptyChunks;       // ... of which nothing is live
+};
+
+/**
+ * CoalescingSpanHeap: Best-fit page runs carved from large chunks, for the
+ * sizes between the slab classes and per-allocation mappings.
+ *
+ * Allocations of a few hundred KiB to a few tens of MiB are too big for
+ * size-class slabs (a power-of-two class wastes up to half) and too small
+ * and too frequent for a mapping each (every allocate/free cycle pays for
+ * mmap, munmap and a page fault per page). This heap maps ChunkBytes at a
+ * time and manages page runs inside the chunks, dlmalloc-style:
+ *
+ * - Free runs are indexed by length in pages: one list per length and a
+ *   two-level bitmap over the lists, so the smallest run that fits is found
+ *   with a few tzcnt steps. Allocation takes it and splits off the rest.
+ * - A freed run merges at once with free neighbours in the same chunk, so
+ *   a chunk whose allocations are all gone is one run again.
+ * - A chunk that empties stays mapped, and best fit reuses it last. decay()
+ *   releases chunks that were already empty at its previous call; it is
+ *   registered with the Maintenance thread when the first chunk is mapped.
+ *   releaseEmpty() releases every empty chunk now.
+ *
+ * Every run, live or free, is a Span registered in pageMap() under this
+ * heap's owner id, which is also how free() finds a run's neighbours. Meant
+ * as a middle tier of a SizeRouterN:
+ *
+ *   using Heap = alloc8::ANSIWrapper<alloc8::SizeRouterN<
+ *       alloc8::Route<256 * 1024, alloc8::SpanHeap<alloc8::OSPageSource,
+ *                                                  alloc8::SizeClassMap<256 * 1024>>>,
+ *       alloc8::Route<32 << 20, alloc8::CoalescingSpanHeap<>>,
+ *       alloc8::Route<SIZE_MAX, alloc8::MmapCacheHeap<>>>>;
+ *
+ * A request larger than a chunk gets a chunk of its own. resizeInPlace()
+ * grows a run into a free run that follows it. One lock guards the heap.
+ *
+ * @tparam ChunkBytes Bytes mapped per chunk (whole pages)
+ * @tparam PageSource Where chunks come from (see page_source.h)
+ */
+template<size_t ChunkBytes = size_t(64) << 20, typename PageSource = OSPageSource>
+class CoalescingSpanHeap {
+  static_assert(ChunkBytes % ALLOC8_PAGE_SIZE == 0 && ChunkBytes > 0,
+                "Chunks must be whole pages");
+
+public:
+  static constexpr size_t kChunkPages = ChunkBytes / ALLOC8_PAGE_SIZE;
+
+  CoalescingSpanHeap() : owner_(registerOwner()) {}
+
+  CoalescingSpanHeap(const CoalescingSpanHeap&) = delete;
+  CoalescingSpanHeap& operator=(const CoalescingSpanHeap&) = delete;
+
+  ~CoalescingSpanHeap() {
+    if (taskAdded_) {
+      Maintenance::instance().remove(&decayTask, this);
+    }
+  }
+
+  /**
+   * Owner id stamped into every span this heap creates.
+   */
+  uint16_t owner() const { return owner_; }
+
+  void* malloc(size_t sz) {
+    return allocate(sz, ALLOC8_PAGE_SIZE);
+  }
+
+  void* memalign(size_t alignment, size_t sz) {
+    return allocate(sz, alignment < ALLOC8_PAGE_SIZE ? ALLOC8_PAGE_SIZE : alignment);
+  }
+
+  void free(void* ptr) {
+    Span* span = pageMap().get(ptr);
+    if (ALLOC8_UNLIKELY(span == nullptr || span->owner != owner_)) {
+      return;  // Not ours
+    }
+    std::lock_guard<std::mutex> guard(lock_);
+    if (ALLOC8_UNLIKELY(pageMap().get(ptr) != span || !span->allocated ||
+                        span->start != reinterpret_cast<uintptr_t>(ptr))) {
+      return;  // Double free or interior pointer
+    }
+    Run* run = reinterpret_cast<Run*>(span);
+    Chunk* chunk = run->chunk;
+    span->allocated = 0;
+    chunk->livePages -= span->npages;
+    livePages_ -= span->npages;
+    insertLocked(coalesceLocked(run));
+    if (chunk->livePages == 0) {
+      chunk->emptySince = epoch_;
+    }
+  }
+
+  size_t getSize(void* ptr) {
+    Span* span = pageMap().get(ptr);
+    if (ALLOC8_UNLIKELY(span == nullptr || span->owner != owner_ || !span->allocated)) {
+      return 0;
+    }
+    return span->objectSize;
+  }
+
+  /**
+   * Grow or shrink `ptr` to at least `sz` bytes without moving it. Growing
+   * takes the front of a free run that directly follows; returns false when
+   * there is none or it is too short.
+   */
+  bool resizeInPlace(void* ptr, size_t sz) {
+    Span* span = pageMap().get(ptr);
+    if (span == nullptr || span->owner != owner_ ||
+        sz > SIZE_MAX - ALLOC8_PAGE_SIZE) {
+      return false;
+    }
+    size_t npages = alignUp(sz ? sz : 1, ALLOC8_PAGE_SIZE) / ALLOC8_PAGE_SIZE;
+    std::lock_guard<std::mutex> guard(lock_);
+    if (pageMap().get(ptr) != span || !span->allocated ||
+        span->start != reinterpret_cast<uintptr_t>(ptr)) {
+      return false;
+    }
+    Run* run = reinterpret_cast<Run*>(span);
+    if (npages <= span->npages) {
+      return true;  // Shrinking keeps the run whole
+    }
+    Run* next = freeNeighbourLocked(run->chunk, span->start + span->bytes());
+    size_t extra = npages - span->npages;
+    if (next == nullptr || next->span.npages < extra) {
+      return false;
+    }
+    removeLocked(next);
+    if (next->span.npages == extra) {
+      pageMap().setRange(next->span.start, extra, span);
+      runs_.deallocate(next);
+    } else {
+      // The head pages change hands; the rest keep pointing at `next`
+      pageMap().setRange(next->span.start, extra, span);
+      next->span.start += extra * ALLOC8_PAGE_SIZE;
+      next->span.npages -= extra;
+      next->span.objectSize = next->span.bytes();
+      insertLocked(next);
+    }
+    span->npages = npages;
+    span->objectSize = span->bytes();
+    run->chunk->livePages += extra;
+    livePages_ += extra;
+    return true;
+  }
+
+  /**
+   * Release chunks that were already empty at the previous call. Called by
+   * the Maintenance thread; safe from any thread. Returns bytes released.
+   */
+  size_t decay() {
+    return release(false);
+  }
+
+  /**
+   * Release every empty chunk now. Returns bytes released.
+   */
+  size_t releaseEmpty() {
+    return release(true);
+  }
+
+  CoalescingSpanStats stats() {
+    std::lock_guard<std::mutex> guard(lock_);
+    CoalescingSpanStats s{};
+    s.mappedBytes = mappedPages_ * ALLOC8_PAGE_SIZE;
+    s.liveBytes = livePages_ * ALLOC8_PAGE_SIZE;
+    s.freeBytes = s.mappedBytes - s.liveBytes;
+    for (Chunk* c = chunks_; c; c = c->next) {
+      s.chunks++;
+      s.emptyChunks += (c->livePages == 0);
+    }
+    for (Span* span = buckets_[kOversize].front(); span; span = span->next) {
+      if (span->npages * ALLOC8_PAGE_SIZE > s.largestFreeBytes) {
+        s.largestFreeBytes = span->npages * ALLOC8_PAGE_SIZE;
+      }
+    }
+    if (s.largestFreeBytes == 0) {
+      s.largestFreeBytes = lastBucketLocked() * ALLOC8_PAGE_SIZE;
+    }
+    return s;
+  }
+
+  void lock() {
+    lock_.lock();
+    source_.lock();
+  }
+
+  void unlock() {
+    source_.unlock();
+    lock_.unlock();
+  }
+
+  /**
+   * Visit every live allocation (see alloc8_iterate_callback). Free runs
+   * are not visited.
+   */
+  void iterate(IterateCallback cb, void* ctx) {
+    iterateOwnedSpans(owner_, [this](Span*) -> std::mutex& {
+      return lock_;
+    }, cb, ctx);
+  }
+
+private:
+  // Free runs of 1..kChunkPages pages have a list each; longer ones (from
+  // chunks mapped for oversize requests) share the last list
+  static constexpr size_t kOversize = kChunkPages + 1;
+  static constexpr size_t kBuckets = kChunkPages + 2;
+  static constexpr size_t kWords = (kBuckets + 63) / 64;
+  static constexpr size_t kSummaryWords = (kWords + 63) / 64;
+
+  struct Chunk {
+    Chunk* prev;
+    Chunk* next;
+    uintptr_t start;
+    size_t npages;
+    size_t livePages;
+    uint64_t emptySince;  // decay() epoch at which livePages last hit 0
+  };
+
+  struct Run {
+    Span span;  // First member: page-map entries point here
+    Chunk* chunk;
+  };
+
+  std::mutex lock_;
+  PageSource source_;
+  MetadataArena<Run> runs_;
+  MetadataArena<Chunk> chunkRecords_;
+  Chunk* chunks_ = nullptr;
+  size_t mappedPages_ = 0;
+  size_t livePages_ = 0;
+  uint64_t epoch_ = 0;
+  bool taskAdded_ = false;
+  uint16_t owner_;
+  uint64_t summary_[kSummaryWords] = {};  // Bit w: words_[w] != 0
+  uint64_t words_[kWords] = {};           // Bit b: buckets_[b] not empty
+  SpanList buckets_[kBuckets];
+
+  static void decayTask(void* self) {
+    static_cast<CoalescingSpanHeap*>(self)->decay();
+  }
+
+  static size_t bucketFor(size_t npages) {
+    return npages < kOversize ? npages : kOversize;
+  }
+
+  void* allocate(size_t sz, size_t alignment) {
+    if (ALLOC8_UNLIKELY(sz > SIZE_MAX - alignment)) {
+      return nullptr;
+    }
+    size_t npages = alignUp(sz ? sz : 1, ALLOC8_PAGE_SIZE) / ALLOC8_PAGE_SIZE;
+    // Any run this much longer holds an aligned start
+    size_t slack = (alignment - ALLOC8_PAGE_SIZE) / ALLOC8_PAGE_SIZE;
+    std::lock_guard<std::mutex> guard(lock_);
+    Run* run = takeFitLocked(npages + slack);
+    if (run == nullptr) {
+      run = mapChunkLocked(npages + slack);
+      if (run == nullptr) {
+        return nullptr;
+      }
+    }
+    uintptr_t start = alignUp(run->span.start, alignment);
+    if (start != run->span.start) {
+      Run* lead = splitLocked(run, (start - run->span.start) / ALLOC8_PAGE_SIZE);
+      if (lead == nullptr) {
+        insertLocked(run);
+        return nullptr;
+      }
+      insertLocked(lead);
+    }
+    if (run->span.npages > npages) {
+      Run* head = splitLocked(run, npages);
+      if (head == nullptr) {
+        insertLocked(coalesceLocked(run));  // Rejoin the lead run, if any
+        return nullptr;
+      }
+      insertLocked(run);
+      run = head;
+    }
+    run->span.allocated = 1;
+    run->chunk->livePages += npages;
+    livePages_ += npages;
+    return reinterpret_cast<void*>(run->span.start);
+  }
+
+  // Map a chunk of at least `npages` pages; returns it as one free run that
+  // is not in any list. Runs under the lock, but only once per chunk.
+  Run* mapChunkLocked(size_t npages) {
+    size_t chunkPages = npages > kChunkPages ? npages : kChunkPages;
+    Chunk* chunk = chunkRecords_.allocate();
+    Run* run = runs_.allocate();
+    void* mem = (chunk && run) ? source_.allocPages(chunkPages, ALLOC8_PAGE_SIZE) : nullptr;
+    if (mem) {
+      run->span.start = reinterpret_cast<uintptr_t>(mem);
+      run->span.npages = chunkPages;
+      run->span.objectSize = run->span.bytes();
+      run->span.capacity = 1;
+      run->span.carved = 1;
+      run->span.owner = owner_;
+      run->chunk = chunk;
+      if (pageMap().insert(&run->span)) {
+        chunk->start = run->span.start;
+        chunk->npages = chunkPages;
+        chunk->prev = nullptr;
+        chunk->next = chunks_;
+        if (chunks_) {
+          chunks_->prev = chunk;
+        }
+        chunks_ = chunk;
+        mappedPages_ += chunkPages;
+        if (!taskAdded_) {
+          taskAdded_ = Maintenance::instance().add(&decayTask, this);
+        }
+        return run;
+      }
+      pageMap().erase(&run->span);
+      source_.freePages(mem, chunkPages);
+    }
+    if (run) {
+      runs_.deallocate(run);
+    }
+    if (chunk) {
+      chunkRecords_.deallocate(chunk);
+    }
+    return nullptr;
+  }
+
+  // Split the first `npages` pages of `run` into a new free run and return
+  // it; `run` keeps the rest, whose page-map entries already point to it.
+  // Returns nullptr (and leaves `run` whole) if no descriptor is available.
+  Run* splitLocked(Run* run, size_t npages) {
+    Run* head = runs_.allocate();
+    if (head == nullptr) {
+      return nullptr;
+    }
+    head->span.start = run->span.start;
+    head->span.npages = npages;
+    head->span.objectSize = head->span.bytes();
+    head->span.capacity = 1;
+    head->span.carved = 1;
+    head->span.owner = owner_;
+    head->chunk = run->chunk;
+    pageMap().setRange(head->span.start, npages, &head->span);
+    run->span.start += npages * ALLOC8_PAGE_SIZE;
+    run->span.npages -= npages;
+    run->span.objectSize = run->span.bytes();
+    return head;
+  }
+
+  // The free run starting at `addr` inside `chunk`, or nullptr
+  Run* freeNeighbourLocked(Chunk* chunk, uintptr_t addr) const {
+    if (addr < chunk->start || addr >= chunk->start + chunk->npages * ALLOC8_PAGE_SIZE) {
+      return nullptr;
+    }
+    Span* span = pageMap().get(reinterpret_cast<void*>(addr));
+    return span->allocated ? nullptr : reinterpret_cast<Run*>(span);
+  }
+
+  // Merge `run` with the free runs on either side. The longer of each pair
+  // keeps its descriptor, so only the shorter one's pages are remapped.
+  Run* coalesceLocked(Run* run) {
+    if (Run* next = freeNeighbourLocked(run->chunk, run->span.start + run->span.bytes())) {
+      removeLocked(next);
+      run = mergeLocked(run, next);
+    }
+    if (run->span.start > run->chunk->start) {
+      Span* prev = pageMap().get(reinterpret_cast<void*>(run->span.start - ALLOC8_PAGE_SIZE));
+      if (!prev->allocated) {
+        removeLocked(reinterpret_cast<Run*>(prev));
+        run = mergeLocked(reinterpret_cast<Run*>(prev), run);
+      }
+    }
+    return run;
+  }
+
+  // Merge adjacent free runs (`left` directly before `right`)
+  Run* mergeLocked(Run* left, Run* right) {
+    Run* keep = left->span.npages >= right->span.npages ? left : right;
+    Run* gone = keep == left ? right : left;
+    pageMap().setRange(gone->span.start, gone->span.npages, &keep->span);
+    keep->span.start = left->span.start;
+    keep->span.npages = left->span.npages + right->span.npages;
+    keep->span.objectSize = keep->span.bytes();
+    runs_.deallocate(gone);
+    return keep;
+  }
+
+  void insertLocked(Run* run) {
+    size_t b = bucketFor(run->span.npages);
+    if (buckets_[b].empty()) {
+      words_[b / 64] |= uint64_t(1) << (b % 64);
+      summary_[b / 4096] |= uint64_t(1) << (b / 64 % 64);
+    }
+    buckets_[b].push(&run->span);
+  }
+
+  void removeLocked(Run* run) {
+    size_t b = bucketFor(run->span.npages);
+    buckets_[b].remove(&run->span);
+    if (buckets_[b].empty()) {
+      words_[b / 64] &= ~(uint64_t(1) << (b % 64));
+      if (words_[b / 64] == 0) {
+        summary_[b / 4096] &= ~(uint64_t(1) << (b / 64 % 64));
+      }
+    }
+  }
+
+  // First non-empty bucket at or after `b`, or kBuckets
+  size_t nextBucketLocked(size_t b) const {
+    size_t w = b / 64;
+    if (uint64_t bits = words_[w] & (~uint64_t(0) << (b % 64))) {
+      return w * 64 + std::countr_zero(bits);
+    }
+    for (size_t s = (w + 1) / 64; s < kSummaryWords; s++) {
+      uint64_t bits = summary_[s];
+      if (s == (w + 1) / 64) {
+        bits &= ~uint64_t(0) << ((w + 1) % 64);
+      }
+      if (bits) {
+        size_t word = s * 64 + std::countr_zero(bits);
+        return word * 64 + std::countr_zero(words_[word]);
+      }
+    }
+    return kBuckets;
+  }
+
+  // Highest non-empty bucket, or 0
+  size_t lastBucketLocked() const {
+    for (size_t s = kSummaryWords; s-- > 0;) {
+      if (summary_[s]) {
+        size_t word = s * 64 + 63 - std::countl_zero(summary_[s]);
+        return word * 64 + 63 - std::countl_zero(words_[word]);
+      }
+    }
+    return 0;
+  }
+
+  // Unlink and return the shortest free run of at least `npages` pages
+  Run* takeFitLocked(size_t npages) {
+    size_t b = bucketFor(npages);
+    if (b < kOversize) {
+      b = nextBucketLocked(b);
+    }
+    if (b == kBuckets || buckets_[b].empty()) {
+      return nullptr;
+    }
+    Span* best = nullptr;
+    if (b < kOversize) {
+      best = buckets_[b].front();
+    } else {
+      for (Span* span = buckets_[b].front(); span; span = span->next) {
+        if (span->npages >= npages && (!best || span->npages < best->npages)) {
+          best = span;
+        }
+      }
+      if (best == nullptr) {
+        return nullptr;
+      }
+    }
+    Run* run = reinterpret_cast<Run*>(best);
+    removeLocked(run);
+    return run;
+  }
+
+  size_t release(bool all) {
+    Chunk* released = nullptr;
+    {
+      std::lock_guard<std::mutex> guard(lock_);
+      for (Chunk* chunk = chunks_; chunk;) {
+        Chunk* next = chunk->next;
+        if (chunk->livePages == 0 && (all || chunk->emptySince < epoch_)) {
+          // An empty chunk is one free run
+          Run* run = reinterpret_cast<Run*>(pageMap().get(reinterpret_cast<void*>(chunk->start)));
+          removeLocked(run);
+          pageMap().erase(&run->span);
+          runs_.deallocate(run);
+          (chunk->prev ? chunk->prev->next : chunks_) = chunk->next;
+          if (chunk->next) {
+            chunk->next->prev = chunk->prev;
+          }
+          mappedPages_ -= chunk->npages;
+          chunk->next = released;
+          released = chunk;
+        }
+        chunk = next;
+      }
+      epoch_++;
+    }
+    size_t bytes = 0;
+    while (released) {
+      Chunk* chunk = released;
+      released = chunk->next;
+      source_.freePages(reinterpret_cast<void*>(chunk->start), chunk->npages);
+      bytes += chunk->npages * ALLOC8_PAGE_SIZE;
+      chunkRecords_.deallocate(chunk);
+    }
+    return bytes;
+  }
+};
+
+} // namespace alloc8
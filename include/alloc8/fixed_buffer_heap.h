@@ -0,0 +1,173 @@
+// alloc8/fixed_buffer_heap.h - Heap over io_uring registered (fixed) buffers
+#pragma once
+
+#include "platform.h"
+#include "os_memory.h"
+#include "page_source.h"
+#include "span_heap.h"
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+
+#if defined(ALLOC8_LINUX)
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include <unistd.h>
+#endif
+
+namespace alloc8 {
+
+// ─── IO_URING REGISTRATION ────────────────────────────────────────────────────
+//
+// Raw syscalls, so alloc8 needs neither liburing nor new kernel headers.
+
+namespace uring {
+
+#if defined(ALLOC8_LINUX) && defined(__NR_io_uring_register)
+inline constexpr unsigned kRegisterBuffers = 0;    // IORING_REGISTER_BUFFERS
+inline constexpr unsigned kUnregisterBuffers = 1;  // IORING_UNREGISTER_BUFFERS
+
+// io_uring_register(2); returns 0 or -errno
+inline int registerCall(int ringFd, unsigned opcode, const void* arg, unsigned count) {
+  long rc = syscall(__NR_io_uring_register, ringFd, opcode, arg, count);
+  return rc < 0 ? -errno : 0;
+}
+#endif
+
+} // namespace uring
+
+// ─── FIXED BUFFER HEAP ────────────────────────────────────────────────────────
+
+/**
+ * FixedBuffer: An allocation from a FixedBufferHeap, addressed the way
+ * io_uring fixed-buffer operations need it.
+ *
+ * For IORING_OP_READ_FIXED / WRITE_FIXED set sqe->addr = data,
+ * sqe->buf_index = index; `offset` is data's position within that
+ * registered buffer.
+ */
+struct FixedBuffer {
+  void*    data;    // nullptr if the allocation failed
+  uint16_t index;   // Registered buffer index
+  size_t   offset;  // Byte offset of data within the registered buffer
+};
+
+/**
+ * FixedBufferHeap: A SpanHeap whose memory is one region registered with
+ * io_uring as fixed buffers.
+ *
+ * The region is mapped when the heap is constructed. registerBuffers() then
+ * hands it to a ring once, as RegionBytes / BufferBytes iovecs (the kernel
+ * caps each registered buffer at 1 GiB). Spans never cross a buffer
+ * boundary, so every allocation lies within a single registered buffer.
+ * mallocFixed() returns the pointer together with its buffer index and
+ * offset, so callers can issue READ_FIXED/WRITE_FIXED without keeping
+ * their own buffer free lists. The kernel pins the region while it is
+ * registered, so memory freed back to this heap is reused but never
+ * returned to the OS.
+ *
+ *   static alloc8::FixedBufferHeap<> heap;
+ *   heap.registerBuffers(ringFd);
+ *   alloc8::FixedBuffer buf = heap.mallocFixed(128 * 1024);
+ *   // sqe->opcode = IORING_OP_READ_FIXED; sqe->addr = (uintptr_t)buf.data;
+ *   // sqe->buf_index = buf.index; ...
+ *   heap.free(buf.data);
+ *
+ * Linux only; registerBuffers() returns -ENOSYS elsewhere.
+ *
+ * @tparam RegionBytes Size of the registered region
+ * @tparam BufferBytes Size of each registered buffer (at most 1 GiB; also
+ *                     the largest single allocation)
+ */
+template<size_t RegionBytes = 64 * 1024 * 1024,
+         size_t BufferBytes = (RegionBytes < (size_t(1) << 30) ? RegionBytes
+                                                               : size_t(1) << 30)>
+class FixedBufferHeap
+    : public SpanHeap<RegionPageSource<RegionBytes, BufferBytes>> {
+  static_assert(BufferBytes <= (size_t(1) << 30),
+                "io_uring registered buffers are limited to 1 GiB");
+
+  using Base = SpanHeap<RegionPageSource<RegionBytes, BufferBytes>>;
+
+public:
+  static constexpr size_t kBufferCount = RegionBytes / BufferBytes;
+  static constexpr size_t kBufferBytes = BufferBytes;
+
+  static_assert(kBufferCount <= 16384, "io_uring allows at most 16384 buffers");
+
+  /**
+   * Start of the registered region (nullptr if it could not be mapped).
+   */
+  char* base() { return Base::pageSource().base(); }
+
+  /**
+   * Register the region with the ring `ringFd` as kBufferCount fixed
+   * buffers. Returns 0 or -errno (e.g. -EBUSY if the ring already has
+   * buffers, -ENOMEM if RLIMIT_MEMLOCK is too small).
+   */
+  int registerBuffers(int ringFd) {
+#if defined(ALLOC8_LINUX) && defined(__NR_io_uring_register)
+    if (!base()) {
+      return -ENOMEM;
+    }
+    // Up to 256 KiB of iovecs: mapped rather than on the stack
+    constexpr size_t kIovBytes = alignUp(kBufferCount * sizeof(iovec), ALLOC8_PAGE_SIZE);
+    auto* iov = static_cast<iovec*>(osMap(kIovBytes));
+    if (!iov) {
+      return -ENOMEM;
+    }
+    for (size_t i = 0; i < kBufferCount; i++) {
+      iov[i].iov_base = base() + i * BufferBytes;
+      iov[i].iov_len = BufferBytes;
+    }
+    int rc = uring::registerCall(ringFd, uring::kRegisterBuffers, iov,
+                                 static_cast<unsigned>(kBufferCount));
+    osUnmap(iov, kIovBytes);
+    return rc;
+#else
+    (void)ringFd;
+    return -ENOSYS;
+#endif
+  }
+
+  /**
+   * Drop the ring's registered buffers. Returns 0 or -errno.
+   */
+  int unregisterBuffers(int ringFd) {
+#if defined(ALLOC8_LINUX) && defined(__NR_io_uring_register)
+    return uring::registerCall(ringFd, uring::kUnregisterBuffers, nullptr, 0);
+#else
+    (void)ringFd;
+    return -ENOSYS;
+#endif
+  }
+
+  /**
+   * Allocate `sz` bytes and report where they sit among the registered
+   * buffers. data is nullptr on failure.
+   */
+  FixedBuffer mallocFixed(size_t sz) {
+    FixedBuffer buf = {Base::malloc(sz), 0, 0};
+    if (buf.data) {
+      locate(buf.data, buf);
+    }
+    return buf;
+  }
+
+  /**
+   * Fill `out` with the buffer index and offset of `ptr` (any address
+   * inside the region). Returns false if `ptr` is not in the region.
+   */
+  bool locate(const void* ptr, FixedBuffer& out) {
+    if (!Base::pageSource().contains(ptr)) {
+      return false;
+    }
+    size_t pos = static_cast<size_t>(static_cast<const char*>(ptr) - base());
+    out.data = const_cast<void*>(ptr);
+    out.index = static_cast<uint16_t>(pos / BufferBytes);
+    out.offset = pos % BufferBytes;
+    return true;
+  }
+};
+
+} // namespace alloc8
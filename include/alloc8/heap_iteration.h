@@ -0,0 +1,143 @@
+// alloc8/heap_iteration.h - Generic live-heap iteration over the page map
+#pragma once
+
+#include "platform.h"
+#include "allocator_traits.h"
+#include "os_memory.h"
+#include "page_map.h"
+#include "span.h"
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+
+namespace alloc8 {
+
+// ─── GENERIC SPAN ITERATION ───────────────────────────────────────────────────
+
+/**
+ * Walk every live allocation owned by component `owner`, one span at a time.
+ *
+ * Works for any component that registers Span descriptors in pageMap() and
+ * tracks liveness with Span::carved plus freeList or freeIndex (or
+ * Span::allocated for large spans). The page map walk itself is lock-free;
+ * each span is revalidated and visited with only its own lock held, so the
+ * heap is never stopped for longer than one span.
+ *
+ * @param owner   Owner id stamped into the component's spans
+ * @param lockFor Returns the lock (BasicLockable) guarding a given span.
+ *                Called before the lock is held; the span is rechecked
+ *                after locking, so a racy read of Span::sizeClass is fine.
+ * @param cb      Malloc-free callback (see alloc8_iterate_callback)
+ * @param ctx     Opaque pointer passed to the callback
+ * @return Number of live allocations visited
+ */
+template<typename LockFor>
+size_t iterateOwnedSpans(uint16_t owner, LockFor&& lockFor,
+                         IterateCallback cb, void* ctx) {
+  size_t visited = 0;
+  PageMap& map = pageMap();
+  map.forEachSpan([&](uintptr_t addr, Span* span) {
+    if (span->owner != owner) {
+      return;
+    }
+    auto& lock = lockFor(span);
+    lock.lock();
+    // The span may have been freed or recycled since the unlocked walk saw
+    // it; only trust it if it still heads the same pages for this owner and
+    // is still guarded by the lock we took.
+    if (map.get(reinterpret_cast<void*>(addr)) == span &&
+        span->start == addr && span->owner == owner &&
+        &lockFor(span) == &lock) {
+      span->forEachLive([&](void* ptr, size_t size) {
+        cb(ptr, size, ctx);
+        visited++;
+      });
+    }
+    lock.unlock();
+  });
+  return visited;
+}
+
+// ─── EXCLUDED OBJECTS ─────────────────────────────────────────────────────────
+
+/**
+ * ExcludedObjects: Addresses a caching layer holds, left out of the walk
+ * of the heap beneath it.
+ *
+ * Objects in a thread cache or central free list are free to the program
+ * but allocated to the heap underneath, whose iterate() reports them. The
+ * caching layer adds the objects it holds, then walks through iterate(),
+ * which visits everything else. The set lives in OS pages and is sorted
+ * once, so building and querying it never calls malloc.
+ *
+ *   ExcludedObjects cached(count);
+ *   for (...) cached.add(obj);
+ *   cached.iterate([this](IterateCallback f, void* c) {
+ *     Heap::iterate(f, c);
+ *   }, cb, ctx);
+ *
+ * If the set cannot be mapped, add() drops objects and the walk visits
+ * them as live.
+ */
+class ExcludedObjects {
+  void** ptrs_ = nullptr;
+  size_t count_ = 0;
+  size_t capacity_ = 0;
+  size_t mapped_ = 0;
+
+  struct Filter {
+    const ExcludedObjects* self;
+    IterateCallback cb;
+    void* ctx;
+  };
+
+  static void filter(void* ptr, size_t size, void* ctx) {
+    const Filter& f = *static_cast<const Filter*>(ctx);
+    if (!std::binary_search(f.self->ptrs_, f.self->ptrs_ + f.self->count_, ptr)) {
+      f.cb(ptr, size, f.ctx);
+    }
+  }
+
+public:
+  explicit ExcludedObjects(size_t capacity) {
+    if (capacity != 0) {
+      mapped_ = alignUp(capacity * sizeof(void*), ALLOC8_PAGE_SIZE);
+      ptrs_ = static_cast<void**>(osMap(mapped_));
+      capacity_ = ptrs_ ? capacity : 0;
+    }
+  }
+
+  ~ExcludedObjects() {
+    if (ptrs_) {
+      osUnmap(ptrs_, mapped_);
+    }
+  }
+
+  ExcludedObjects(const ExcludedObjects&) = delete;
+  ExcludedObjects& operator=(const ExcludedObjects&) = delete;
+
+  void add(void* ptr) {
+    if (count_ < capacity_) {
+      ptrs_[count_++] = ptr;
+    }
+  }
+
+  size_t size() const { return count_; }
+
+  /**
+   * Call `walk(filterCb, filterCtx)`, which should run the heap's
+   * iterate() with them, and pass every object not in the set on to `cb`.
+   */
+  template<typename Walk>
+  void iterate(Walk&& walk, IterateCallback cb, void* ctx) {
+    if (count_ == 0) {
+      walk(cb, ctx);
+      return;
+    }
+    std::sort(ptrs_, ptrs_ + count_);
+    Filter f{this, cb, ctx};
+    walk(&filter, &f);
+  }
+};
+
+} // namespace alloc8
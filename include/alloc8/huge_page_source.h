@@ -0,0 +1,527 @@
+// alloc8/huge_page_source.h - Page source that keeps huge pages intact
+#pragma once
+
+#include "platform.h"
+#include "os_memory.h"
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+
+namespace alloc8 {
+
+// ─── HUGE PAGE SOURCE ─────────────────────────────────────────────────────────
+
+/**
+ * Snapshot of a HugePageSource (see HugePageSource::stats()).
+ */
+struct HugePageStats {
+  size_t usedBytes;         // Handed out by allocPages()
+  size_t backedBytes;       // Not returned to the OS (used or cached free)
+  size_t freeBytes;         // Backed but unused
+  size_t subreleasedBytes;  // Free pages returned from inside used huge pages
+  size_t hugePages;         // Huge pages holding data
+  size_t intactHugePages;   // ... of which nothing was subreleased
+  size_t emptyHugePages;    // Backed huge pages with nothing in them
+  double coverage;          // Share of usedBytes on intact huge pages
+};
+
+/**
+ * HugePageSource: A PageSource that packs page runs into huge pages and
+ * avoids breaking them on release.
+ *
+ * Turning on transparent huge pages is not enough for an allocator. The
+ * first time it returns a single 4 KiB page inside a 2 MiB huge page to the
+ * OS, the kernel splits that huge page, and the TLB reach is gone until
+ * khugepaged gets round to collapsing it again. This source follows the
+ * design of tcmalloc's Temeraire:
+ *
+ * - Runs smaller than a huge page are packed into huge pages (the filler).
+ *   A run goes to the huge page whose longest free range fits it most
+ *   tightly, and among those to the fullest, so lightly used huge pages
+ *   drain and can be released whole.
+ * - Runs of a huge page or more get their own mapping aligned to a huge
+ *   page, and are unmapped when freed.
+ * - A huge page that empties is kept for reuse (up to EmptyCache of them)
+ *   and beyond that released whole, which never splits anything.
+ * - Free pages inside partly used huge pages are returned to the OS
+ *   ("subrelease") only under memory pressure: when releaseMemory() asks
+ *   for it, or when backed memory exceeds setMemoryLimit(). Empty huge
+ *   pages are always released first.
+ *
+ * stats() reports huge-page coverage, the share of used memory that sits
+ * on huge pages nothing was subreleased from.
+ *
+ *   using Heap = alloc8::SpanHeap<alloc8::HugePageSource<>>;
+ *
+ * Address space is reserved RegionBytes at a time and never returned;
+ * metadata lives in OS-mapped memory, so no call here allocates.
+ *
+ * @tparam RegionBytes Address space reserved per region (whole huge pages)
+ * @tparam EmptyCache  Empty huge pages kept backed for reuse
+ */
+template<size_t RegionBytes = size_t(1) << 30, size_t EmptyCache = 4>
+class HugePageSource {
+public:
+  static constexpr size_t kHugePageSize = 2 * 1024 * 1024;
+  static constexpr size_t kPagesPerHuge = kHugePageSize / ALLOC8_PAGE_SIZE;
+
+private:
+  static_assert(kPagesPerHuge % 64 == 0, "Huge pages must hold whole bitmap words");
+  static_assert(RegionBytes % kHugePageSize == 0 && RegionBytes > 0,
+                "Regions must be whole huge pages");
+
+  static constexpr size_t kWords = kPagesPerHuge / 64;
+  static constexpr size_t kHugePerRegion = RegionBytes / kHugePageSize;
+  static constexpr size_t kScan = 8;  // Candidates compared per bucket
+
+  struct HugePage {
+    HugePage* prev;
+    HugePage* next;
+    char* base;
+    uint64_t used[kWords];
+    uint64_t released[kWords];  // Free pages given back to the OS
+    uint32_t usedPages;
+    uint32_t releasedPages;
+    uint32_t longestFree;
+  };
+
+  struct List {
+    HugePage* head = nullptr;
+    size_t count = 0;
+
+    void push(HugePage* hp) {
+      hp->prev = nullptr;
+      hp->next = head;
+      if (head) head->prev = hp;
+      head = hp;
+      count++;
+    }
+
+    void remove(HugePage* hp) {
+      (hp->prev ? hp->prev->next : head) = hp->next;
+      if (hp->next) hp->next->prev = hp->prev;
+      count--;
+    }
+
+    HugePage* pop() {
+      HugePage* hp = head;
+      if (hp) remove(hp);
+      return hp;
+    }
+  };
+
+  struct Region {
+    Region* next;
+    char* base;
+    size_t carved;  // Huge pages handed to the filler so far
+    HugePage pages[kHugePerRegion];
+  };
+
+  std::mutex lock_;
+  Region* regions_ = nullptr;
+
+  // Filling huge pages, bucketed by longest free run (0 = full)
+  List filling_[kPagesPerHuge];
+  uint64_t nonEmpty_[kWords] = {};
+  List empty_;     // Backed, nothing used
+  List released_;  // Returned to the OS whole
+
+  size_t usedPages_ = 0;         // Filler pages handed out
+  size_t subreleasedPages_ = 0;  // Released pages inside filling huge pages
+  size_t largeBytes_ = 0;
+  size_t largeHugePages_ = 0;
+  size_t memoryLimit_ = 0;
+
+  static bool test(const uint64_t* bits, size_t i) {
+    return bits[i / 64] & (uint64_t(1) << (i % 64));
+  }
+
+  static void setRange(uint64_t* bits, size_t first, size_t n, bool value) {
+    for (size_t i = first; i < first + n; i++) {
+      if (value) {
+        bits[i / 64] |= uint64_t(1) << (i % 64);
+      } else {
+        bits[i / 64] &= ~(uint64_t(1) << (i % 64));
+      }
+    }
+  }
+
+  static size_t countRange(const uint64_t* bits, size_t first, size_t n) {
+    size_t count = 0;
+    for (size_t i = first; i < first + n; i++) {
+      count += test(bits, i);
+    }
+    return count;
+  }
+
+  // Lowest free run of `n` pages starting at a multiple of `align` pages,
+  // or kPagesPerHuge if there is none
+  static size_t findRun(const uint64_t* used, size_t n, size_t align) {
+    size_t page = 0;
+    while (page + n <= kPagesPerHuge) {
+      if (page % 64 == 0 && used[page / 64] == ~uint64_t(0)) {
+        page += 64;
+        continue;
+      }
+      size_t run = 0;
+      while (run < n && !test(used, page + run)) {
+        run++;
+      }
+      if (run == n) {
+        return page;
+      }
+      page = alignUp(page + run + 1, align);
+    }
+    return kPagesPerHuge;
+  }
+
+  static uint32_t longestRun(const uint64_t* used) {
+    size_t best = 0;
+    size_t run = 0;
+    for (size_t w = 0; w < kWords; w++) {
+      uint64_t word = used[w];
+      if (word == 0) {
+        run += 64;
+      } else if (word == ~uint64_t(0)) {
+        best = run > best ? run : best;
+        run = 0;
+      } else {
+        for (size_t b = 0; b < 64; b++) {
+          if (word & (uint64_t(1) << b)) {
+            best = run > best ? run : best;
+            run = 0;
+          } else {
+            run++;
+          }
+        }
+      }
+    }
+    return static_cast<uint32_t>(run > best ? run : best);
+  }
+
+  // Only huge pages with something in them are linked, so the longest free
+  // run is always below kPagesPerHuge
+  void link(HugePage* hp) {
+    hp->longestFree = longestRun(hp->used);
+    size_t b = hp->longestFree;
+    filling_[b].push(hp);
+    nonEmpty_[b / 64] |= uint64_t(1) << (b % 64);
+  }
+
+  void unlink(HugePage* hp) {
+    size_t b = hp->longestFree;
+    filling_[b].remove(hp);
+    if (filling_[b].count == 0) {
+      nonEmpty_[b / 64] &= ~(uint64_t(1) << (b % 64));
+    }
+  }
+
+  // First non-empty bucket at or above `b`, or kPagesPerHuge
+  size_t nextBucket(size_t b) const {
+    while (b < kPagesPerHuge) {
+      uint64_t word = nonEmpty_[b / 64] >> (b % 64);
+      if (word) {
+        return b + std::countr_zero(word);
+      }
+      b = (b / 64 + 1) * 64;
+    }
+    return kPagesPerHuge;
+  }
+
+  // Best-fitting huge page for a run (see class comment); sets `start`
+  HugePage* chooseFilling(size_t npages, size_t align, size_t& start) {
+    for (size_t b = nextBucket(npages); b < kPagesPerHuge; b = nextBucket(b + 1)) {
+      HugePage* best = nullptr;
+      size_t scanned = 0;
+      for (HugePage* hp = filling_[b].head; hp && scanned < kScan; hp = hp->next) {
+        scanned++;
+        if (best && hp->usedPages <= best->usedPages) {
+          continue;
+        }
+        size_t page = findRun(hp->used, npages, align);
+        if (page != kPagesPerHuge) {
+          best = hp;
+          start = page;
+        }
+      }
+      if (best) {
+        return best;
+      }
+    }
+    return nullptr;
+  }
+
+  // A huge page with nothing in it: cached, released, or newly carved
+  HugePage* freshHugePage() {
+    if (HugePage* hp = empty_.pop()) {
+      return hp;
+    }
+    if (HugePage* hp = released_.pop()) {
+      if (!osCommit(hp->base, kHugePageSize)) {
+        released_.push(hp);
+        return nullptr;
+      }
+      osHugePageHint(hp->base, kHugePageSize);
+      return hp;
+    }
+    Region* region = regions_;
+    if (!region || region->carved == kHugePerRegion) {
+      region = newRegion();
+      if (!region) {
+        return nullptr;
+      }
+    }
+    HugePage* hp = &region->pages[region->carved];
+    hp->base = region->base + region->carved * kHugePageSize;
+    if (!osCommit(hp->base, kHugePageSize)) {
+      return nullptr;
+    }
+    region->carved++;
+    osHugePageHint(hp->base, kHugePageSize);
+    return hp;
+  }
+
+  Region* newRegion() {
+    auto* region = static_cast<Region*>(osMap(sizeof(Region)));
+    if (!region) {
+      return nullptr;
+    }
+    char* raw = static_cast<char*>(osReserve(RegionBytes + kHugePageSize));
+    if (!raw) {
+      osUnmap(region, sizeof(Region));
+      return nullptr;
+    }
+    region->base = reinterpret_cast<char*>(
+        alignUp(reinterpret_cast<uintptr_t>(raw), kHugePageSize));
+    region->carved = 0;
+    region->next = regions_;
+    regions_ = region;
+    return region;
+  }
+
+  HugePage* findHugePage(const void* ptr) const {
+    auto p = reinterpret_cast<uintptr_t>(ptr);
+    for (Region* r = regions_; r; r = r->next) {
+      auto b = reinterpret_cast<uintptr_t>(r->base);
+      if (p >= b && p < b + RegionBytes) {
+        return &r->pages[(p - b) / kHugePageSize];
+      }
+    }
+    return nullptr;
+  }
+
+  void releaseWhole(HugePage* hp) {
+    osDecommit(hp->base, kHugePageSize);
+    released_.push(hp);
+  }
+
+  // Return at least `bytes` to the OS if possible: empty huge pages first,
+  // then free pages inside the emptiest filling huge pages
+  size_t releaseLocked(size_t bytes) {
+    size_t done = 0;
+    while (done < bytes) {
+      HugePage* hp = empty_.pop();
+      if (!hp) {
+        break;
+      }
+      releaseWhole(hp);
+      done += kHugePageSize;
+    }
+    for (size_t b = kPagesPerHuge; b-- > 1 && done < bytes;) {
+      for (HugePage* hp = filling_[b].head; hp && done < bytes; hp = hp->next) {
+        done += subrelease(hp);
+      }
+    }
+    return done;
+  }
+
+  // Give back every free, still-backed page of a filling huge page
+  size_t subrelease(HugePage* hp) {
+    size_t released = 0;
+    size_t page = 0;
+    while (page < kPagesPerHuge) {
+      if (test(hp->used, page) || test(hp->released, page)) {
+        page++;
+        continue;
+      }
+      size_t end = page;
+      while (end < kPagesPerHuge && !test(hp->used, end) && !test(hp->released, end)) {
+        end++;
+      }
+      osDecommit(hp->base + page * ALLOC8_PAGE_SIZE, (end - page) * ALLOC8_PAGE_SIZE);
+      setRange(hp->released, page, end - page, true);
+      released += end - page;
+      page = end;
+    }
+    hp->releasedPages += static_cast<uint32_t>(released);
+    subreleasedPages_ += released;
+    return released * ALLOC8_PAGE_SIZE;
+  }
+
+  size_t backedBytesLocked() const {
+    size_t filling = 0;
+    for (const List& list : filling_) {
+      filling += list.count;
+    }
+    return (filling + empty_.count) * kHugePageSize -
+           subreleasedPages_ * ALLOC8_PAGE_SIZE + largeBytes_;
+  }
+
+  void* allocLarge(size_t npages, size_t alignment) {
+    size_t bytes = npages * ALLOC8_PAGE_SIZE;
+    void* mem = osMapAligned(bytes, alignment > kHugePageSize ? alignment : kHugePageSize);
+    if (!mem) {
+      return nullptr;
+    }
+    osHugePageHint(mem, bytes);
+    std::lock_guard<std::mutex> guard(lock_);
+    largeBytes_ += bytes;
+    largeHugePages_ += npages / kPagesPerHuge;
+    return mem;
+  }
+
+  void freeLarge(void* ptr, size_t npages) {
+    osUnmap(ptr, npages * ALLOC8_PAGE_SIZE);
+    std::lock_guard<std::mutex> guard(lock_);
+    largeBytes_ -= npages * ALLOC8_PAGE_SIZE;
+    largeHugePages_ -= npages / kPagesPerHuge;
+  }
+
+public:
+  HugePageSource() = default;
+  HugePageSource(const HugePageSource&) = delete;
+  HugePageSource& operator=(const HugePageSource&) = delete;
+
+  void* allocPages(size_t npages, size_t alignment = ALLOC8_PAGE_SIZE) {
+    if (npages == 0) {
+      return nullptr;
+    }
+    if (npages >= kPagesPerHuge || alignment > kHugePageSize) {
+      return allocLarge(npages, alignment);
+    }
+    size_t align = alignment > ALLOC8_PAGE_SIZE ? alignment / ALLOC8_PAGE_SIZE : 1;
+    std::lock_guard<std::mutex> guard(lock_);
+    size_t start = 0;
+    HugePage* hp = chooseFilling(npages, align, start);
+    if (hp) {
+      unlink(hp);
+    } else {
+      hp = freshHugePage();
+      if (!hp) {
+        return nullptr;
+      }
+      for (size_t w = 0; w < kWords; w++) {
+        hp->used[w] = 0;
+        hp->released[w] = 0;
+      }
+      hp->usedPages = 0;
+      hp->releasedPages = 0;
+      start = 0;
+    }
+    char* mem = hp->base + start * ALLOC8_PAGE_SIZE;
+    if (size_t reused = countRange(hp->released, start, npages)) {
+      // Subreleased pages come back (on Windows they must be recommitted)
+      osCommit(mem, npages * ALLOC8_PAGE_SIZE);
+      setRange(hp->released, start, npages, false);
+      hp->releasedPages -= static_cast<uint32_t>(reused);
+      subreleasedPages_ -= reused;
+    }
+    setRange(hp->used, start, npages, true);
+    hp->usedPages += static_cast<uint32_t>(npages);
+    usedPages_ += npages;
+    link(hp);
+    return mem;
+  }
+
+  void freePages(void* ptr, size_t npages) {
+    if (npages >= kPagesPerHuge) {
+      freeLarge(ptr, npages);
+      return;
+    }
+    std::unique_lock<std::mutex> guard(lock_);
+    HugePage* hp = findHugePage(ptr);
+    if (!hp) {
+      guard.unlock();
+      freeLarge(ptr, npages);  // Over-aligned small run
+      return;
+    }
+    size_t start = (static_cast<char*>(ptr) - hp->base) / ALLOC8_PAGE_SIZE;
+    unlink(hp);
+    setRange(hp->used, start, npages, false);
+    hp->usedPages -= static_cast<uint32_t>(npages);
+    usedPages_ -= npages;
+    if (hp->usedPages > 0) {
+      link(hp);
+    } else if (hp->releasedPages > 0) {
+      // Already broken: finish the job rather than cache a split page
+      subreleasedPages_ -= hp->releasedPages;
+      releaseWhole(hp);
+    } else {
+      empty_.push(hp);
+      if (empty_.count > EmptyCache) {
+        HugePage* oldest = empty_.head;
+        while (oldest->next) {
+          oldest = oldest->next;
+        }
+        empty_.remove(oldest);
+        releaseWhole(oldest);
+      }
+    }
+    if (memoryLimit_) {
+      size_t backed = backedBytesLocked();
+      if (backed > memoryLimit_) {
+        releaseLocked(backed - memoryLimit_);
+      }
+    }
+  }
+
+  /**
+   * Return at least `bytes` of free memory to the OS if there is that much:
+   * whole empty huge pages first, then free pages inside partly used huge
+   * pages (which breaks them). Returns the bytes released.
+   */
+  size_t releaseMemory(size_t bytes) {
+    std::lock_guard<std::mutex> guard(lock_);
+    return releaseLocked(bytes);
+  }
+
+  /**
+   * Keep backed memory at or below `bytes` by releasing after frees that
+   * exceed it (0 = no limit).
+   */
+  void setMemoryLimit(size_t bytes) {
+    std::lock_guard<std::mutex> guard(lock_);
+    memoryLimit_ = bytes;
+  }
+
+  HugePageStats stats() {
+    std::lock_guard<std::mutex> guard(lock_);
+    HugePageStats s = {};
+    size_t intactUsed = 0;
+    for (const List& list : filling_) {
+      for (HugePage* hp = list.head; hp; hp = hp->next) {
+        s.hugePages++;
+        if (hp->releasedPages == 0) {
+          s.intactHugePages++;
+          intactUsed += hp->usedPages;
+        }
+      }
+    }
+    s.usedBytes = usedPages_ * ALLOC8_PAGE_SIZE + largeBytes_;
+    s.backedBytes = backedBytesLocked();
+    s.freeBytes = s.backedBytes - s.usedBytes;
+    s.subreleasedBytes = subreleasedPages_ * ALLOC8_PAGE_SIZE;
+    s.hugePages += largeHugePages_;
+    s.intactHugePages += largeHugePages_;
+    s.emptyHugePages = empty_.count;
+    size_t covered = intactUsed * ALLOC8_PAGE_SIZE + largeHugePages_ * kHugePageSize;
+    s.coverage = s.usedBytes ? double(covered) / double(s.usedBytes) : 1.0;
+    return s;
+  }
+
+  void lock() { lock_.lock(); }
+  void unlock() { lock_.unlock(); }
+};
+
+} // namespace alloc8
@@ -0,0 +1,1113 @@
+// alloc8/leak_scanner.h - Background conservative leak scanning (Linux)
+#pragma once
+
+#include "platform.h"
+#include "maintenance.h"
+#include "os_memory.h"
+#include "page_map.h"
+#include "span.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <mutex>
+#include <new>
+
+#if defined(ALLOC8_LINUX)
+#include <csetjmp>
+#include <fcntl.h>
+#include <sys/uio.h>
+#include <unistd.h>
+#include <unwind.h>
+#endif
+
+extern "C" {
+/**
+ * One allocation site with leaked sampled allocations, as reported by
+ * alloc8_leak_sites.
+ */
+typedef struct alloc8_leak_site {
+  const void* const* frames;  // Return addresses, innermost first
+  uint32_t depth;             // Entries in frames (0: site table was full)
+  uint64_t objects;           // Sampled allocations reported as leaked
+  uint64_t bytes;             // Their requested bytes
+} alloc8_leak_site;
+
+/**
+ * Callback invoked once per leaking site. Runs without the scanner's
+ * sample lock held, so it may allocate.
+ */
+typedef void (*alloc8_leak_site_callback)(const alloc8_leak_site* site, void* ctx);
+}
+
+namespace alloc8 {
+
+using LeakSite = alloc8_leak_site;
+using LeakSiteCallback = alloc8_leak_site_callback;
+
+/**
+ * Snapshot of a LeakScanner (see LeakScanner::stats()).
+ */
+struct LeakScanStats {
+  size_t sampled;        // Allocations sampled so far
+  size_t tracked;        // Sampled allocations still live
+  size_t dropped;        // Samples not tracked because the table was full
+  size_t scans;          // Scans completed
+  size_t leakedObjects;  // Tracked allocations currently reported as leaked
+  size_t leakedBytes;    // ... their requested bytes
+  size_t lastScanBytes;  // Bytes of roots and heap read by the last scan
+  uint64_t lastScanNs;   // Wall time from the start to the end of the last scan
+  uint64_t busyNs;       // Time spent scanning, in total
+};
+
+#if defined(ALLOC8_LINUX)
+
+// ─── LEAK SCANNER ─────────────────────────────────────────────────────────────
+
+/**
+ * LeakScanner: Finds leaks in a running process by scanning its memory for
+ * pointers to sampled allocations, a few milliseconds at a time on the
+ * Maintenance thread.
+ *
+ * LeakCheckHeap samples about one allocation per SampleBytes allocated and
+ * records its stack here. A scan then reads, conservatively (every aligned
+ * word is a possible pointer, interior pointers count):
+ *
+ * - roots: every private writable mapping in /proc/self/maps, which covers
+ *   data and bss, thread stacks, TLS and memory mapped outside the heap,
+ *   plus the registers threads saved at their last safepoint();
+ * - the heap: every span in pageMap(), object slots up to Span::carved
+ *   (or the whole object of a large span), sampled objects excepted;
+ * - sampled objects found referenced, transitively.
+ *
+ * A sampled allocation that no scan finds a reference to for
+ * scansToReport scans in a row is reported as leaked, grouped by
+ * allocation stack (forEachLeak(), report()). Memory is read with
+ * process_vm_readv(), which fails instead of faulting when a page is
+ * unmapped under it, so the scan takes no heap locks and never stops the
+ * program. The price is that the heap moves while it is read: a pointer
+ * moved from a part not yet scanned to a part already scanned is missed,
+ * which is why one scan is not enough to report. Errors go the other way
+ * by design: free slots, stale stack and anything that merely looks like a
+ * pointer can hide a leak, and a leaked object's unsampled neighbours keep
+ * what they point to referenced, so what is reported is typically the
+ * root of a leaked structure.
+ *
+ * Scanning is rate-limited two ways: each Maintenance tick scans for at
+ * most `budget`, and a scan starts no sooner than `interval` after the
+ * previous one ended (see configure()). With the defaults (1 ms per tick,
+ * a scan every 10 s) and a 100 ms tick the scanner uses at most 1% of a
+ * core, and a scan of a large heap simply takes more ticks.
+ *
+ * Threads that keep the only copy of a pointer in registers for long
+ * (tight loops over a structure) should call safepoint() now and then; the
+ * registers it saves are scanned as roots. Everything here works from
+ * inside malloc except the callbacks, and the Maintenance thread must be
+ * started for scans to happen in the background. Linux only.
+ */
+class LeakScanner {
+public:
+  static constexpr size_t kMaxSamples = 8192;   // Live sampled allocations tracked
+  static constexpr size_t kMaxSites = 1024;     // Distinct allocation stacks
+  static constexpr size_t kMaxFrames = 16;      // Return addresses per stack
+  static constexpr size_t kMaxThreads = 256;    // Threads with a safepoint slot
+  static constexpr size_t kMaxRanges = 4096;    // Root mappings per scan
+  static constexpr size_t kChunkBytes = 64 * 1024;
+
+  /**
+   * The process-wide scanner LeakCheckHeap records into (never destroyed,
+   * so frees during exit still find it).
+   */
+  static LeakScanner& instance() {
+    alignas(LeakScanner) static char buffer[sizeof(LeakScanner)];
+    static LeakScanner* self = new (buffer) LeakScanner;
+    return *self;
+  }
+
+  LeakScanner() {
+    void* mem = osMap(kStateBytes);
+    state_ = mem ? new (mem) State : nullptr;
+  }
+
+  ~LeakScanner() {
+    if (taskAdded_) {
+      Maintenance::instance().remove(&scanTask, this);
+    }
+    if (state_) {
+      osUnmap(state_, kStateBytes);
+    }
+  }
+
+  LeakScanner(const LeakScanner&) = delete;
+  LeakScanner& operator=(const LeakScanner&) = delete;
+
+  /**
+   * Set the rate limits: scan for at most `budget` per step(), start a
+   * scan no sooner than `interval` after the previous one ended, and
+   * report an allocation once `scansToReport` scans in a row found no
+   * reference to it.
+   */
+  void configure(std::chrono::microseconds budget, std::chrono::milliseconds interval,
+                 uint32_t scansToReport = 3) {
+    budgetNs_.store(uint64_t(budget.count()) * 1000, std::memory_order_relaxed);
+    intervalNs_.store(uint64_t(interval.count()) * 1000000, std::memory_order_relaxed);
+    scansToReport_.store(scansToReport ? scansToReport : 1, std::memory_order_relaxed);
+  }
+
+  /**
+   * Count `size` bytes against the calling thread's sampling interval (one
+   * per Every, so heaps sampling at different rates do not interfere).
+   * @return true if this allocation should be recorded
+   */
+  template<size_t Every>
+  ALLOC8_ALWAYS_INLINE
+  static bool sampleDue(size_t size) {
+    static ALLOC8_TLS int64_t untilSample;
+    untilSample -= static_cast<int64_t>(size);
+    if (ALLOC8_LIKELY(untilSample > 0)) {
+      return false;
+    }
+    return rearm(untilSample, Every);
+  }
+
+  /**
+   * Track a sampled allocation and record the stack that made it.
+   */
+  ALLOC8_NOINLINE
+  void record(void* ptr, size_t size) {
+    if (!state_) {
+      return;
+    }
+    ThreadState& t = threadState();
+    t.busy = true;  // The unwinder may allocate: do not sample that
+    const void* frames[kMaxFrames];
+    Unwind unwind{frames, 0, 1};  // Skip record() itself
+    _Unwind_Backtrace(&unwindFrame, &unwind);
+    {
+      std::lock_guard<std::mutex> guard(lock_);
+      stats_.sampled++;
+      uintptr_t p = reinterpret_cast<uintptr_t>(ptr);
+      Sample* s = findSample(p);
+      if (!s && stats_.tracked == kMaxSamples) {
+        stats_.dropped++;
+      } else {
+        if (!s) {
+          s = &state_->samples[sampleSlot(p)];
+          while (s->ptr) {
+            s = &state_->samples[(s - state_->samples + 1) & (kTableSize - 1)];
+          }
+          stats_.tracked++;
+          std::atomic<uint8_t>& count = state_->filter[filterSlot(p)];
+          if (count.load(std::memory_order_relaxed) != UINT8_MAX) {
+            count.fetch_add(1, std::memory_order_relaxed);
+          }
+        }
+        *s = Sample{p, ++nextId_, size, internSite(frames, unwind.depth), 0};
+      }
+      if (!taskAdded_) {
+        taskAdded_ = Maintenance::instance().add(&scanTask, this);
+      }
+    }
+    t.busy = false;
+  }
+
+  /**
+   * Cheap check for free(): false means `ptr` is certainly not tracked.
+   */
+  ALLOC8_ALWAYS_INLINE
+  bool mayBeTracked(const void* ptr) const {
+    return state_ && state_->filter[filterSlot(reinterpret_cast<uintptr_t>(ptr))]
+                         .load(std::memory_order_relaxed) != 0;
+  }
+
+  /**
+   * Stop tracking `ptr` (call before the heap frees it).
+   */
+  ALLOC8_NOINLINE
+  void forget(void* ptr) {
+    uintptr_t p = reinterpret_cast<uintptr_t>(ptr);
+    std::lock_guard<std::mutex> guard(lock_);
+    if (Sample* s = findSample(p)) {
+      eraseSample(static_cast<size_t>(s - state_->samples));
+      stats_.tracked--;
+      std::atomic<uint8_t>& count = state_->filter[filterSlot(p)];
+      if (count.load(std::memory_order_relaxed) != UINT8_MAX) {
+        count.fetch_sub(1, std::memory_order_relaxed);
+      }
+    }
+  }
+
+  /**
+   * Save the calling thread's registers where scans read them as roots.
+   * Without a slot (more than kMaxThreads threads), does nothing.
+   */
+  ALLOC8_NOINLINE
+  void safepoint() {
+    ThreadState& t = threadState();
+    if (!state_ || (t.slot == 0 && !claimSlot(t))) {
+      return;
+    }
+    setjmp(state_->threads[t.slot - 1].regs);  // Never longjmp'd to
+  }
+
+  /**
+   * Give up the calling thread's safepoint slot (thread exit).
+   */
+  void threadExit() {
+    ThreadState& t = threadState();
+    if (t.slot != 0) {
+      RegisterSlot& slot = state_->threads[t.slot - 1];
+      std::memset(&slot.regs, 0, sizeof(slot.regs));
+      slot.used.store(false, std::memory_order_release);
+      t.slot = 0;
+    }
+  }
+
+  /**
+   * Scan for at most the configured budget, starting a new scan if one
+   * is due. Called by the Maintenance thread; safe from any thread.
+   * @return true if a scan finished during this step
+   */
+  bool step() {
+    if (!state_) {
+      return false;
+    }
+    std::lock_guard<std::mutex> scan(scanLock_);
+    uint64_t now = nowNs();
+    if (phase_ == kIdle) {
+      if (now < nextScanNs_) {
+        return false;
+      }
+      scanFrame_ = reinterpret_cast<uintptr_t>(__builtin_frame_address(0));
+      begin(now);
+    }
+    bool done = advance(now + budgetNs_.load(std::memory_order_relaxed));
+    uint64_t end = nowNs();
+    if (done) {
+      finish(end);
+    }
+    addBusy(end - now);
+    return done;
+  }
+
+  /**
+   * Finish any scan in progress, then run a whole new one on the calling
+   * thread, ignoring the rate limits.
+   */
+  void scanNow() {
+    if (!state_) {
+      return;
+    }
+    std::lock_guard<std::mutex> scan(scanLock_);
+    uint64_t now = nowNs();
+    if (phase_ != kIdle) {
+      advance(UINT64_MAX);
+      finish(nowNs());
+    }
+    scanFrame_ = reinterpret_cast<uintptr_t>(__builtin_frame_address(0));
+    begin(nowNs());
+    advance(UINT64_MAX);
+    uint64_t end = nowNs();
+    finish(end);
+    addBusy(end - now);
+  }
+
+  LeakScanStats stats() {
+    std::lock_guard<std::mutex> guard(lock_);
+    return stats_;
+  }
+
+  /**
+   * Call `cb` once per allocation site with leaked allocations.
+   * @return Number of sites reported
+   */
+  size_t forEachLeak(LeakSiteCallback cb, void* ctx) {
+    if (!state_) {
+      return 0;
+    }
+    std::lock_guard<std::mutex> report(reportLock_);
+    Site* sites = state_->sites;
+    uint32_t threshold = scansToReport_.load(std::memory_order_relaxed);
+    {
+      std::lock_guard<std::mutex> guard(lock_);
+      for (size_t i = 0; i <= kMaxSites; i++) {
+        sites[i].objects = 0;
+        sites[i].bytes = 0;
+      }
+      for (const Sample& s : state_->samples) {
+        if (s.ptr && s.misses >= threshold) {
+          sites[s.site].objects++;
+          sites[s.site].bytes += s.size;
+        }
+      }
+    }
+    // Sites with objects are complete and never change again
+    size_t reported = 0;
+    for (size_t i = 0; i <= kMaxSites; i++) {
+      if (sites[i].objects) {
+        LeakSite site{sites[i].frames, sites[i].depth, sites[i].objects, sites[i].bytes};
+        cb(&site, ctx);
+        reported++;
+      }
+    }
+    return reported;
+  }
+
+  /**
+   * Write the leaks to `fd` without allocating.
+   *
+   * Format (one record per line, space separated):
+   *   scans <n>
+   *   tracked <n>                             sampled allocations live
+   *   leak <objects> <bytes> <pc>...          per site, innermost frame first
+   *
+   * @return 0 on success
+   */
+  int report(int fd) {
+    Writer out(fd);
+    LeakScanStats s = stats();
+    out.str("# alloc8 leak report\n");
+    out.str("scans ").num(s.scans).str("\n");
+    out.str("tracked ").num(s.tracked).str("\n");
+    forEachLeak([](const LeakSite* site, void* ctx) {
+      Writer& w = *static_cast<Writer*>(ctx);
+      w.str("leak ").num(site->objects).str(" ").num(site->bytes);
+      for (uint32_t i = 0; i < site->depth; i++) {
+        w.str(" ").hex(reinterpret_cast<uintptr_t>(site->frames[i]));
+      }
+      w.str("\n");
+    }, &out);
+    return 0;
+  }
+
+private:
+  struct ThreadState {
+    uint64_t rng;         // xorshift state for the sampling interval
+    uint32_t slot;        // Safepoint slot + 1, or 0
+    bool busy;            // Inside record()
+  };
+
+  struct Sample {
+    uintptr_t ptr;    // 0: empty table slot
+    uint64_t id;      // Tells a reused address from the allocation scanned
+    size_t size;
+    uint32_t site;
+    uint32_t misses;  // Scans in a row that found no reference
+  };
+
+  struct Site {
+    uint64_t hash;    // 0: empty table slot
+    uint32_t depth;
+    const void* frames[kMaxFrames];
+    uint64_t objects;  // forEachLeak() totals
+    uint64_t bytes;
+  };
+
+  struct Candidate {
+    uintptr_t ptr;
+    uintptr_t start;  // The object's whole slot
+    uintptr_t end;
+    uint64_t id;
+    bool referenced;
+    bool scanned;     // Contents read by the closure phase
+  };
+
+  struct Range {
+    uintptr_t start;
+    uintptr_t end;
+  };
+
+  struct RegisterSlot {
+    std::atomic<bool> used;
+    std::jmp_buf regs;
+  };
+
+  static constexpr size_t kTableSize = 2 * kMaxSamples;
+  static constexpr size_t kFilterBits = 17;
+  static constexpr uint32_t kUnknownSite = kMaxSites;  // Site table full
+
+  // Everything the scan must not mistake for roots lives in one mapping
+  struct State {
+    Sample samples[kTableSize];
+    Site sites[kMaxSites + 1];
+    Candidate candidates[kMaxSamples];
+    Range ranges[kMaxRanges];
+    RegisterSlot threads[kMaxThreads];
+    std::atomic<uint8_t> filter[size_t(1) << kFilterBits];  // Samples per hash
+    char maps[8192];
+    alignas(16) char buffer[kChunkBytes];
+  };
+
+  static constexpr size_t kStateBytes = alignUp(sizeof(State), ALLOC8_PAGE_SIZE);
+
+  enum Phase { kIdle, kRoots, kHeap, kClosure };
+
+  struct Unwind {
+    const void** frames;
+    uint32_t depth;
+    uint32_t skip;
+  };
+
+  // Malloc-free line output for report()
+  class Writer {
+    int fd_;
+    char buf_[512];
+    size_t len_ = 0;
+
+  public:
+    explicit Writer(int fd) : fd_(fd) {}
+    ~Writer() { flush(); }
+
+    void flush() {
+      size_t off = 0;
+      while (off < len_) {
+        ssize_t n = write(fd_, buf_ + off, len_ - off);
+        if (n <= 0) break;
+        off += static_cast<size_t>(n);
+      }
+      len_ = 0;
+    }
+
+    Writer& put(char c) {
+      if (len_ == sizeof(buf_)) flush();
+      buf_[len_++] = c;
+      return *this;
+    }
+
+    Writer& str(const char* s) {
+      while (*s) put(*s++);
+      return *this;
+    }
+
+    Writer& num(uint64_t v) {
+      char tmp[20];
+      int n = 0;
+      do {
+        tmp[n++] = static_cast<char>('0' + v % 10);
+        v /= 10;
+      } while (v);
+      while (n) put(tmp[--n]);
+      return *this;
+    }
+
+    Writer& hex(uint64_t v) {
+      char tmp[16];
+      int n = 0;
+      do {
+        tmp[n++] = "0123456789abcdef"[v & 15];
+        v >>= 4;
+      } while (v);
+      str("0x");
+      while (n) put(tmp[--n]);
+      return *this;
+    }
+  };
+
+  State* state_ = nullptr;
+  std::mutex lock_;        // Guards the sample and site tables, stats_, taskAdded_
+  LeakScanStats stats_{};
+  uint64_t nextId_ = 0;
+  size_t sites_ = 0;
+  bool taskAdded_ = false;
+  std::mutex reportLock_;  // One forEachLeak() at a time
+  std::atomic<uint64_t> budgetNs_{1000000};
+  std::atomic<uint64_t> intervalNs_{10000000000};
+  std::atomic<uint32_t> scansToReport_{3};
+
+  // Scan progress, guarded by scanLock_
+  std::mutex scanLock_;
+  Phase phase_ = kIdle;
+  size_t candidates_ = 0;
+  uintptr_t lo_ = 0;         // Lowest candidate start
+  uintptr_t hi_ = 0;         // Highest candidate end
+  size_t ranges_ = 0;
+  size_t range_ = 0;
+  uintptr_t cursor_ = 0;     // Next address in the range, span or candidate
+  uintptr_t spanHead_ = 0;   // Span the last step stopped inside, or 0
+  uintptr_t heapNext_ = 0;   // Where the page map walk resumes
+  size_t closure_ = 0;
+  bool marked_ = false;      // A candidate was marked since this was cleared
+  uintptr_t scanFrame_ = 0;  // Frame of the step() or scanNow() that began the scan
+  uint64_t scanStartNs_ = 0;
+  uint64_t nextScanNs_ = 0;
+  size_t scanBytes_ = 0;
+
+  static ThreadState& threadState() {
+    static ALLOC8_TLS ThreadState state;
+    return state;
+  }
+
+  ALLOC8_NOINLINE
+  static bool rearm(int64_t& untilSample, size_t every) {
+    ThreadState& t = threadState();
+    if (t.rng == 0) {
+      t.rng = reinterpret_cast<uintptr_t>(&t) | 1;
+    }
+    t.rng ^= t.rng << 13;
+    t.rng ^= t.rng >> 7;
+    t.rng ^= t.rng << 17;
+    // Uniform in [every/2, 3*every/2): a fixed period would keep sampling
+    // the same allocation of a periodic pattern
+    untilSample = static_cast<int64_t>(every / 2 + t.rng % every);
+    return !t.busy;
+  }
+
+  static _Unwind_Reason_Code unwindFrame(_Unwind_Context* ctx, void* arg) {
+    Unwind& u = *static_cast<Unwind*>(arg);
+    uintptr_t ip = _Unwind_GetIP(ctx);
+    if (ip == 0) {
+      return _URC_END_OF_STACK;
+    }
+    if (u.skip) {
+      u.skip--;
+      return _URC_NO_REASON;
+    }
+    u.frames[u.depth++] = reinterpret_cast<const void*>(ip);
+    return (u.depth == kMaxFrames) ? _URC_END_OF_STACK : _URC_NO_REASON;
+  }
+
+  static void scanTask(void* arg) {
+    static_cast<LeakScanner*>(arg)->step();
+  }
+
+  static uint64_t nowNs() {
+    return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count());
+  }
+
+  static uint64_t mix(uint64_t v) {
+    return v * 0x9E3779B97F4A7C15ull;
+  }
+
+  static size_t sampleSlot(uintptr_t p) {
+    return static_cast<size_t>(mix(p >> 3) >> (64 - log2Floor(kTableSize)));
+  }
+
+  static size_t filterSlot(uintptr_t p) {
+    return static_cast<size_t>(mix(p >> 3) >> (64 - kFilterBits));
+  }
+
+  // ─── Tables (lock_ held) ───
+
+  Sample* findSample(uintptr_t p) {
+    for (size_t i = sampleSlot(p); state_->samples[i].ptr; i = (i + 1) & (kTableSize - 1)) {
+      if (state_->samples[i].ptr == p) {
+        return &state_->samples[i];
+      }
+    }
+    return nullptr;
+  }
+
+  // Backward-shift deletion keeps probe chains intact without tombstones
+  void eraseSample(size_t hole) {
+    Sample* s = state_->samples;
+    for (size_t j = (hole + 1) & (kTableSize - 1); s[j].ptr; j = (j + 1) & (kTableSize - 1)) {
+      size_t home = sampleSlot(s[j].ptr);
+      bool stays = (hole < j) ? (home > hole && home <= j) : (home > hole || home <= j);
+      if (!stays) {
+        s[hole] = s[j];
+        hole = j;
+      }
+    }
+    s[hole].ptr = 0;
+  }
+
+  uint32_t internSite(const void* const* frames, uint32_t depth) {
+    uint64_t hash = depth;
+    for (uint32_t i = 0; i < depth; i++) {
+      hash = mix(hash ^ reinterpret_cast<uintptr_t>(frames[i])) ^ (hash >> 29);
+    }
+    hash |= 1;
+    for (size_t i = hash % kMaxSites;; i = (i + 1) % kMaxSites) {
+      Site& site = state_->sites[i];
+      if (site.hash == hash && site.depth == depth &&
+          std::memcmp(site.frames, frames, depth * sizeof(void*)) == 0) {
+        return static_cast<uint32_t>(i);
+      }
+      if (site.hash == 0) {
+        if (sites_ >= kMaxSites * 3 / 4) {
+          return kUnknownSite;
+        }
+        std::memcpy(site.frames, frames, depth * sizeof(void*));
+        site.depth = depth;
+        site.hash = hash;
+        sites_++;
+        return static_cast<uint32_t>(i);
+      }
+    }
+  }
+
+  bool claimSlot(ThreadState& t) {
+    for (size_t i = 0; i < kMaxThreads; i++) {
+      if (!state_->threads[i].used.exchange(true, std::memory_order_acquire)) {
+        t.slot = static_cast<uint32_t>(i + 1);
+        return true;
+      }
+    }
+    return false;
+  }
+
+  void addBusy(uint64_t ns) {
+    std::lock_guard<std::mutex> guard(lock_);
+    stats_.busyNs += ns;
+  }
+
+  // ─── Scan phases (scanLock_ held) ───
+
+  void begin(uint64_t now) {
+    Candidate* c = state_->candidates;
+    size_t n = 0;
+    {
+      std::lock_guard<std::mutex> guard(lock_);
+      for (const Sample& s : state_->samples) {
+        if (s.ptr) {
+          c[n++] = Candidate{s.ptr, s.ptr, s.ptr + s.size, s.id, false, false};
+        }
+      }
+    }
+    // Widen each candidate to its slot, so interior pointers and the slack
+    // of the size class count too
+    for (size_t i = 0; i < n; i++) {
+      const void* ptr = reinterpret_cast<const void*>(c[i].ptr);
+      Span* span = pageMap().get(ptr);
+      if (span && span->contains(ptr) && span->objectSize) {
+        c[i].start = span->isLarge() ? span->start
+                                     : reinterpret_cast<uintptr_t>(span->objectAt(span->indexOf(ptr)));
+        c[i].end = c[i].start + span->objectSize;
+      }
+    }
+    std::sort(c, c + n, [](const Candidate& a, const Candidate& b) { return a.start < b.start; });
+    // Spans are read unlocked: never let a recycled descriptor make slots overlap
+    for (size_t i = 0; i + 1 < n; i++) {
+      c[i].end = std::max(std::min(c[i].end, c[i + 1].start), c[i].ptr + 1);
+    }
+    candidates_ = n;
+    lo_ = n ? c[0].start : 0;
+    hi_ = 0;
+    for (size_t i = 0; i < n; i++) {
+      hi_ = std::max(hi_, c[i].end);
+    }
+    readMaps();
+    phase_ = kRoots;
+    range_ = 0;
+    cursor_ = 0;
+    spanHead_ = 0;
+    heapNext_ = 0;
+    closure_ = 0;
+    marked_ = false;
+    scanStartNs_ = now;
+    scanBytes_ = 0;
+  }
+
+  bool advance(uint64_t deadline) {
+    if (candidates_ == 0) {
+      return true;
+    }
+    switch (phase_) {
+    case kRoots:
+      if (!scanRoots(deadline)) {
+        return false;
+      }
+      phase_ = kHeap;
+      cursor_ = 0;
+      [[fallthrough]];
+    case kHeap:
+      if (!scanHeap(deadline)) {
+        return false;
+      }
+      phase_ = kClosure;
+      cursor_ = 0;
+      marked_ = false;
+      [[fallthrough]];
+    case kClosure:
+      return scanClosure(deadline);
+    default:
+      return true;
+    }
+  }
+
+  void finish(uint64_t now) {
+    uint32_t threshold = scansToReport_.load(std::memory_order_relaxed);
+    {
+      std::lock_guard<std::mutex> guard(lock_);
+      for (size_t i = 0; i < candidates_; i++) {
+        const Candidate& c = state_->candidates[i];
+        Sample* s = findSample(c.ptr);
+        if (s && s->id == c.id) {
+          s->misses = c.referenced ? 0 : std::min(s->misses + 1, threshold);
+        }
+      }
+      stats_.leakedObjects = 0;
+      stats_.leakedBytes = 0;
+      for (const Sample& s : state_->samples) {
+        if (s.ptr && s.misses >= threshold) {
+          stats_.leakedObjects++;
+          stats_.leakedBytes += s.size;
+        }
+      }
+      stats_.scans++;
+      stats_.lastScanBytes = scanBytes_;
+      stats_.lastScanNs = now - scanStartNs_;
+    }
+    phase_ = kIdle;
+    candidates_ = 0;
+    nextScanNs_ = now + intervalNs_.load(std::memory_order_relaxed);
+  }
+
+  // Private writable mappings, minus this scanner's own state
+  void readMaps() {
+    ranges_ = 0;
+    int fd = open("/proc/self/maps", O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+      return;
+    }
+    char* buf = state_->maps;
+    size_t len = 0;
+    for (;;) {
+      ssize_t n = read(fd, buf + len, sizeof(state_->maps) - len);
+      if (n <= 0) {
+        break;
+      }
+      len += static_cast<size_t>(n);
+      size_t line = 0;
+      for (size_t i = 0; i < len; i++) {
+        if (buf[i] == '\n') {
+          buf[i] = '\0';
+          addMapping(buf + line);
+          line = i + 1;
+        }
+      }
+      std::memmove(buf, buf + line, len - line);
+      len -= line;
+      if (len == sizeof(state_->maps)) {
+        len = 0;  // No line is this long; drop it
+      }
+    }
+    close(fd);
+  }
+
+  // "start-end perms offset dev inode [path]"
+  void addMapping(const char* line) {
+    auto hexField = [&line]() {
+      uintptr_t v = 0;
+      for (;; line++) {
+        char ch = *line;
+        int d = (ch >= '0' && ch <= '9') ? ch - '0' : (ch >= 'a' && ch <= 'f') ? ch - 'a' + 10 : -1;
+        if (d < 0) break;
+        v = v * 16 + static_cast<uintptr_t>(d);
+      }
+      return v;
+    };
+    uintptr_t start = hexField();
+    if (*line++ != '-') return;
+    uintptr_t end = hexField();
+    if (*line++ != ' ' || line[0] != 'r' || line[1] != 'w' || line[3] != 'p') return;
+    for (int field = 0; field < 4 && *line; field++) {  // To the path
+      while (*line && *line != ' ') line++;
+      while (*line == ' ') line++;
+    }
+    if (std::strncmp(line, "/dev/", 5) == 0) return;  // Device memory
+
+    // The scanner's own frames (sort temporaries, copies of candidates)
+    // and the dead stack below them
+    bool ours = start <= scanFrame_ && scanFrame_ < end;
+    uintptr_t selfLo[3] = {reinterpret_cast<uintptr_t>(state_), reinterpret_cast<uintptr_t>(this),
+                           ours ? start : 0};
+    uintptr_t selfHi[3] = {selfLo[0] + kStateBytes, selfLo[1] + sizeof(*this),
+                           ours ? scanFrame_ : 0};
+    addRange(start, end, selfLo, selfHi, 0);
+  }
+
+  void addRange(uintptr_t start, uintptr_t end, const uintptr_t* lo, const uintptr_t* hi,
+                int excluded) {
+    for (; excluded < 3; excluded++) {
+      if (lo[excluded] < end && hi[excluded] > start) {
+        if (start < lo[excluded]) {
+          addRange(start, lo[excluded], lo, hi, excluded + 1);
+        }
+        start = std::min(end, hi[excluded]);
+      }
+    }
+    if (start < end && ranges_ < kMaxRanges) {
+      state_->ranges[ranges_++] = Range{start, end};
+    }
+  }
+
+  bool scanRoots(uint64_t deadline) {
+    PageMap& map = pageMap();
+    for (; range_ < ranges_; range_++) {
+      const Range& r = state_->ranges[range_];
+      cursor_ = std::max(cursor_, r.start);
+      while (cursor_ < r.end) {
+        if (nowNs() >= deadline) {
+          return false;
+        }
+        uintptr_t stop = std::min(r.end, cursor_ + kChunkBytes);
+        // Heap pages are read object by object in the heap phase
+        for (uintptr_t a = cursor_; a < stop;) {
+          uintptr_t b = std::min(stop, (a | (ALLOC8_PAGE_SIZE - 1)) + 1);
+          if (map.get(reinterpret_cast<void*>(a))) {
+            a = b;
+            continue;
+          }
+          while (b < stop && !map.get(reinterpret_cast<void*>(b))) {
+            b = std::min(stop, b + ALLOC8_PAGE_SIZE);
+          }
+          scanRemote(a, b - a, true);
+          a = b;
+        }
+        cursor_ = stop;
+      }
+      cursor_ = 0;
+    }
+    scanRemote(reinterpret_cast<uintptr_t>(state_->threads), sizeof(state_->threads), true);
+    return true;
+  }
+
+  bool scanHeap(uint64_t deadline) {
+    PageMap& map = pageMap();
+    if (spanHead_) {
+      uintptr_t head = spanHead_;
+      spanHead_ = 0;
+      Span* span = map.get(reinterpret_cast<void*>(head));
+      if (span && span->start == head && !scanSpan(span, cursor_, deadline)) {
+        spanHead_ = head;
+        return false;
+      }
+    }
+    heapNext_ = map.forEachSpanFrom(heapNext_, [&](uintptr_t addr, Span* span) {
+      if (scanSpan(span, addr, deadline)) {
+        return true;
+      }
+      spanHead_ = addr;
+      return false;
+    });
+    return spanHead_ == 0;
+  }
+
+  // Read the span's carved slots from `from` on, skipping candidates
+  bool scanSpan(Span* span, uintptr_t from, uint64_t deadline) {
+    if (nowNs() >= deadline) {
+      cursor_ = from;
+      return false;
+    }
+    uintptr_t start = span->start;
+    size_t objectSize = span->objectSize;
+    uintptr_t end = start;
+    if (span->isLarge()) {
+      end += span->allocated ? objectSize : 0;
+    } else {
+      end += size_t(span->carved) * objectSize;
+    }
+    end = std::min(end, start + span->npages * ALLOC8_PAGE_SIZE);
+    cursor_ = std::max(from, start);
+    const Candidate* c = state_->candidates;
+    const Candidate* k = std::upper_bound(c, c + candidates_, cursor_,
+        [](uintptr_t a, const Candidate& cand) { return a < cand.end; });
+    while (cursor_ < end) {
+      if (nowNs() >= deadline) {
+        return false;
+      }
+      uintptr_t stop = std::min(end, cursor_ + kChunkBytes);
+      while (k < c + candidates_ && k->end <= cursor_) {
+        k++;
+      }
+      if (k < c + candidates_ && k->start < stop) {
+        if (k->start <= cursor_) {
+          cursor_ = k->end;
+          continue;
+        }
+        stop = k->start;
+      }
+      scanRemote(cursor_, stop - cursor_, false);
+      cursor_ = stop;
+    }
+    return true;
+  }
+
+  // Read referenced candidates until no pass marks another one
+  bool scanClosure(uint64_t deadline) {
+    Candidate* c = state_->candidates;
+    for (;;) {
+      for (; closure_ < candidates_; closure_++) {
+        Candidate& cand = c[closure_];
+        if (!cand.referenced || cand.scanned) {
+          continue;
+        }
+        cursor_ = std::max(cursor_, cand.start);
+        while (cursor_ < cand.end) {
+          if (nowNs() >= deadline) {
+            return false;
+          }
+          uintptr_t stop = std::min(cand.end, cursor_ + kChunkBytes);
+          scanRemote(cursor_, stop - cursor_, false);
+          cursor_ = stop;
+        }
+        cand.scanned = true;
+        cursor_ = 0;
+      }
+      if (!marked_) {
+        return true;
+      }
+      marked_ = false;
+      closure_ = 0;
+    }
+  }
+
+  // Copy [addr, addr + len) through the kernel, which skips what is unmapped
+  void scanRemote(uintptr_t addr, size_t len, bool roots) {
+    pid_t pid = getpid();
+    while (len > 0) {
+      size_t want = std::min(len, kChunkBytes);
+      iovec local{state_->buffer, want};
+      iovec remote{reinterpret_cast<void*>(addr), want};
+      ssize_t n = process_vm_readv(pid, &local, 1, &remote, 1, 0);
+      size_t got = (n > 0) ? static_cast<size_t>(n) : 0;
+      scanWords(state_->buffer, got, addr, roots);
+      scanBytes_ += got;
+      if (got < want) {
+        got = std::min(len, ((addr + got) | (ALLOC8_PAGE_SIZE - 1)) + 1 - addr);
+      }
+      addr += got;
+      len -= got;
+    }
+  }
+
+  void scanWords(const char* buf, size_t len, uintptr_t addr, bool roots) {
+    const uintptr_t* words = reinterpret_cast<const uintptr_t*>(buf);
+    size_t skew = (sizeof(uintptr_t) - addr % sizeof(uintptr_t)) % sizeof(uintptr_t);
+    if (skew) {
+      words = reinterpret_cast<const uintptr_t*>(buf + skew);  // Keep words aligned
+      len = (len > skew) ? len - skew : 0;
+      addr += skew;
+    }
+    uintptr_t span = hi_ - lo_;
+    for (size_t i = 0; i < len / sizeof(uintptr_t); i++) {
+      uintptr_t w = words[i];
+      if (w - lo_ < span) {
+        mark(w, addr + i * sizeof(uintptr_t), roots);
+      }
+    }
+  }
+
+  void mark(uintptr_t w, uintptr_t where, bool roots) {
+    Candidate* c = state_->candidates;
+    Candidate* it = std::upper_bound(c, c + candidates_, w,
+        [](uintptr_t a, const Candidate& cand) { return a < cand.start; });
+    if (it == c) {
+      return;
+    }
+    Candidate& cand = *(it - 1);
+    if (w >= cand.end || cand.referenced) {
+      return;
+    }
+    if (roots) {
+      // A span descriptor names the object at the start of its span
+      Span* span = pageMap().get(reinterpret_cast<void*>(w));
+      if (span && where == reinterpret_cast<uintptr_t>(&span->start)) {
+        return;
+      }
+    }
+    cand.referenced = true;
+    marked_ = true;
+  }
+};
+
+// ─── LEAK CHECK HEAP ──────────────────────────────────────────────────────────
+
+/**
+ * LeakCheckHeap: Samples allocations for LeakScanner::instance().
+ *
+ * About one allocation per SampleBytes allocated (per thread, at a random
+ * point in each interval) has its stack recorded; a sampled allocation
+ * stays tracked until it is freed. Place it above any ThreadCache, whose
+ * batch paths would bypass it, and below ANSIWrapper:
+ *
+ *   using Heap = alloc8::ANSIWrapper<
+ *       alloc8::LeakCheckHeap<alloc8::ThreadCache<alloc8::SpanHeap<>>>>;
+ *
+ *   alloc8::Maintenance::instance().start();  // Scans in the background
+ *   ...
+ *   alloc8::LeakScanner::instance().report(STDERR_FILENO);
+ *
+ * Frees cost one load from a small counting filter, and a locked lookup
+ * only when it says the pointer may be tracked. Recording a sample walks
+ * the stack with the unwinder (a few microseconds), so keep SampleBytes
+ * large in production; the default samples about 2000 times per GB.
+ *
+ * @tparam SuperHeap   Heap whose objects live in pageMap() spans
+ * @tparam SampleBytes Mean bytes allocated between samples
+ */
+template<typename SuperHeap, size_t SampleBytes = 512 * 1024>
+class LeakCheckHeap : public SuperHeap {
+  static_assert(SampleBytes > 0, "SampleBytes must be positive");
+
+public:
+  ALLOC8_ALWAYS_INLINE
+  void* malloc(size_t sz) {
+    void* ptr = SuperHeap::malloc(sz);
+    if (ALLOC8_UNLIKELY(LeakScanner::sampleDue<SampleBytes>(sz)) && ptr) {
+      LeakScanner::instance().record(ptr, sz);
+    }
+    return ptr;
+  }
+
+  ALLOC8_ALWAYS_INLINE
+  void* memalign(size_t alignment, size_t sz) {
+    void* ptr = SuperHeap::memalign(alignment, sz);
+    if (ALLOC8_UNLIKELY(LeakScanner::sampleDue<SampleBytes>(sz)) && ptr) {
+      LeakScanner::instance().record(ptr, sz);
+    }
+    return ptr;
+  }
+
+  ALLOC8_ALWAYS_INLINE
+  void free(void* ptr) {
+    LeakScanner& scanner = LeakScanner::instance();
+    if (ALLOC8_UNLIKELY(scanner.mayBeTracked(ptr))) {
+      scanner.forget(ptr);
+    }
+    SuperHeap::free(ptr);
+  }
+
+  void threadCleanup() {
+    LeakScanner::instance().threadExit();
+    if constexpr (requires(SuperHeap& h) { h.threadCleanup(); }) {
+      SuperHeap::threadCleanup();
+    }
+  }
+
+  LeakScanner& leakScanner() {
+    return LeakScanner::instance();
+  }
+};
+
+#endif // ALLOC8_LINUX
+
+} // namespace alloc8
+
+#if defined(ALLOC8_LINUX)
+
+/**
+ * Export the process-wide LeakScanner as alloc8_leak_report(fd),
+ * alloc8_leak_sites(cb, ctx) and alloc8_leak_safepoint(), next to
+ * ALLOC8_REDIRECT in an allocator built over LeakCheckHeap.
+ */
+#define ALLOC8_LEAK_REDIRECT() \
+  extern "C" { \
+    ALLOC8_EXPORT int alloc8_leak_report(int fd) { \
+      return alloc8::LeakScanner::instance().report(fd); \
+    } \
+    \
+    ALLOC8_EXPORT int alloc8_leak_sites(alloc8_leak_site_callback cb, void* ctx) { \
+      return static_cast<int>(alloc8::LeakScanner::instance().forEachLeak(cb, ctx)); \
+    } \
+    \
+    ALLOC8_EXPORT void alloc8_leak_safepoint(void) { \
+      alloc8::LeakScanner::instance().safepoint(); \
+    } \
+  }
+
+#endif // ALLOC8_LINUX
@@ -0,0 +1,180 @@
+// alloc8/maintenance.h - Background thread for periodic allocator upkeep
+#pragma once
+
+#include "platform.h"
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <new>
+#include <thread>
+
+namespace alloc8 {
+
+// ─── MAINTENANCE THREAD ───────────────────────────────────────────────────────
+
+/**
+ * Maintenance: One process-wide background thread that runs registered
+ * upkeep tasks (draining idle caches, returning memory...) periodically.
+ *
+ * Components register tasks with add(); registration never allocates, so
+ * it is safe from inside an allocator. Nothing runs in the background until
+ * someone calls start(). Starting the thread allocates, so call it from
+ * ordinary code (program start-up, a library constructor), never from
+ * inside malloc. runOnce() runs every task on the calling thread, for
+ * programs that would rather drive upkeep themselves.
+ *
+ *   alloc8::Maintenance::instance().start(std::chrono::milliseconds(50));
+ *
+ * Tasks run one at a time on the maintenance thread. They may allocate,
+ * and they must not block on locks that are held across allocations.
+ */
+class Maintenance {
+public:
+  using Task = void (*)(void* arg);
+
+  static constexpr size_t kMaxTasks = 16;
+
+  /**
+   * The process-wide instance (never destroyed, so tasks can run during
+   * exit).
+   */
+  static Maintenance& instance() {
+    alignas(Maintenance) static char buffer[sizeof(Maintenance)];
+    static Maintenance* self = new (buffer) Maintenance;
+    return *self;
+  }
+
+  /**
+   * Run `task(arg)` on every tick. Returns false if the table is full.
+   */
+  bool add(Task task, void* arg) {
+    std::lock_guard<std::mutex> guard(lock_);
+    for (Entry& e : tasks_) {
+      if (e.task == nullptr) {
+        e.task = task;
+        e.arg = arg;
+        return true;
+      }
+    }
+    return false;
+  }
+
+  /**
+   * Unregister a task. Once this returns, the task is not running and will
+   * not run again.
+   */
+  void remove(Task task, void* arg) {
+    std::lock_guard<std::mutex> run(runLock_);
+    std::lock_guard<std::mutex> guard(lock_);
+    for (Entry& e : tasks_) {
+      if (e.task == task && e.arg == arg) {
+        e.task = nullptr;
+        e.arg = nullptr;
+      }
+    }
+  }
+
+  /**
+   * Run every registered task once on the calling thread.
+   */
+  void runOnce() {
+    std::lock_guard<std::mutex> run(runLock_);
+    Entry snapshot[kMaxTasks];
+    {
+      std::lock_guard<std::mutex> guard(lock_);
+      for (size_t i = 0; i < kMaxTasks; i++) {
+        snapshot[i] = tasks_[i];
+      }
+    }
+    for (const Entry& e : snapshot) {
+      if (e.task) {
+        e.task(e.arg);
+      }
+    }
+    ticks_.fetch_add(1, std::memory_order_relaxed);
+  }
+
+  /**
+   * Start the background thread, ticking every `period`. Returns false if
+   * it is already running.
+   */
+  bool start(std::chrono::milliseconds period = std::chrono::milliseconds(100)) {
+    std::lock_guard<std::mutex> guard(threadLock_);
+    if (thread_.joinable()) {
+      return false;
+    }
+    {
+      std::lock_guard<std::mutex> wake(wakeLock_);
+      stopping_ = false;
+    }
+    period_ = period;
+    thread_ = std::thread([this] { loop(); });
+    return true;
+  }
+
+  /**
+   * Stop and join the background thread (no-op if not running).
+   */
+  void stop() {
+    std::lock_guard<std::mutex> guard(threadLock_);
+    if (!thread_.joinable()) {
+      return;
+    }
+    {
+      std::lock_guard<std::mutex> wake(wakeLock_);
+      stopping_ = true;
+    }
+    wake_.notify_all();
+    thread_.join();
+  }
+
+  bool running() {
+    std::lock_guard<std::mutex> guard(threadLock_);
+    return thread_.joinable();
+  }
+
+  /**
+   * Ticks completed so far (by the thread or runOnce()).
+   */
+  uint64_t ticks() const {
+    return ticks_.load(std::memory_order_relaxed);
+  }
+
+private:
+  struct Entry {
+    Task task;
+    void* arg;
+  };
+
+  Maintenance() = default;
+
+  void loop() {
+    std::unique_lock<std::mutex> wake(wakeLock_);
+    while (!stopping_) {
+      if (wake_.wait_for(wake, period_, [this] { return stopping_; })) {
+        break;
+      }
+      wake.unlock();
+      runOnce();
+      wake.lock();
+    }
+  }
+
+  std::mutex lock_;     // Guards tasks_
+  std::mutex runLock_;  // Held while tasks run
+  Entry tasks_[kMaxTasks] = {};
+  std::atomic<uint64_t> ticks_{0};
+
+  std::mutex threadLock_;  // Guards thread_ and period_
+  std::thread thread_;
+  std::chrono::milliseconds period_{100};
+
+  std::mutex wakeLock_;
+  std::condition_variable wake_;
+  bool stopping_ = false;
+};
+
+} // namespace alloc8
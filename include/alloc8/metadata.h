@@ -0,0 +1,153 @@
+// alloc8/metadata.h - Malloc-free storage for allocator metadata
+#pragma once
+
+#include "platform.h"
+#include "os_memory.h"
+#include <cstddef>
+#include <cstring>
+#include <mutex>
+#include <new>
+
+namespace alloc8 {
+
+// ─── METADATA ARENA ───────────────────────────────────────────────────────────
+
+/**
+ * MetadataArena: Fixed-size record allocator for allocator bookkeeping.
+ *
+ * Records are bump-allocated from OS chunks and recycled through a free
+ * list. Chunks are never returned to the OS, so a record pointer stays
+ * dereferenceable forever; lock-free readers (e.g. page map lookups racing
+ * a free) may observe a recycled record but never an unmapped one.
+ *
+ * @tparam T          Record type (constructed with value-initialization)
+ * @tparam ChunkSize  Bytes requested from the OS per refill
+ */
+template<typename T, size_t ChunkSize = 64 * 1024>
+class MetadataArena {
+  static_assert(sizeof(T) <= ChunkSize, "Record larger than arena chunk");
+
+  union Slot {
+    Slot* next;
+    alignas(T) char storage[sizeof(T)];
+  };
+
+  std::mutex mutex_;
+  Slot* freeList_ = nullptr;
+  char* bump_ = nullptr;
+  char* end_ = nullptr;
+
+public:
+  /**
+   * Allocate and value-initialize a record.
+   * @return Record, or nullptr if the OS is out of memory
+   */
+  T* allocate() {
+    void* mem;
+    {
+      std::lock_guard<std::mutex> guard(mutex_);
+      if (freeList_) {
+        mem = freeList_;
+        freeList_ = freeList_->next;
+      } else {
+        if (bump_ + sizeof(Slot) > end_) {
+          bump_ = static_cast<char*>(osMap(ChunkSize));
+          if (!bump_) {
+            end_ = nullptr;
+            return nullptr;
+          }
+          end_ = bump_ + ChunkSize;
+        }
+        mem = bump_;
+        bump_ += sizeof(Slot);
+      }
+    }
+    return new (mem) T();
+  }
+
+  /**
+   * Return a record to the arena.
+   */
+  void deallocate(T* record) {
+    record->~T();
+    Slot* slot = reinterpret_cast<Slot*>(record);
+    std::lock_guard<std::mutex> guard(mutex_);
+    slot->next = freeList_;
+    freeList_ = slot;
+  }
+};
+
+// ─── METADATA REGION ──────────────────────────────────────────────────────────
+
+/**
+ * MetadataRegion: Variable-size metadata allocator.
+ *
+ * Requests are rounded up to kGranularity and recycled through one free
+ * list per rounded size, which suits metadata whose size is fixed per size
+ * class (free-slot stacks, per-page counters). Like MetadataArena, memory is
+ * never returned to the OS, and it never shares pages with object memory.
+ */
+class MetadataRegion {
+public:
+  static constexpr size_t kGranularity = 64;
+  static constexpr size_t kMaxRecord = 64 * 1024;
+  static constexpr size_t kChunkSize = 1024 * 1024;
+
+  /**
+   * Allocate `bytes` of zeroed metadata, or nullptr if out of memory.
+   */
+  void* allocate(size_t bytes) {
+    size_t bucket = bucketFor(bytes);
+    if (bucket == 0) {
+      return nullptr;
+    }
+    size_t rounded = bucket * kGranularity;
+    std::lock_guard<std::mutex> guard(mutex_);
+    if (FreeRecord* rec = freeLists_[bucket]) {
+      freeLists_[bucket] = rec->next;
+      std::memset(rec, 0, rounded);
+      return rec;
+    }
+    if (bump_ + rounded > end_) {
+      bump_ = static_cast<char*>(osMap(kChunkSize));
+      if (!bump_) {
+        end_ = nullptr;
+        return nullptr;
+      }
+      end_ = bump_ + kChunkSize;
+    }
+    void* mem = bump_;
+    bump_ += rounded;
+    return mem;
+  }
+
+  /**
+   * Return metadata previously obtained with allocate(bytes).
+   */
+  void deallocate(void* ptr, size_t bytes) {
+    size_t bucket = bucketFor(bytes);
+    FreeRecord* rec = static_cast<FreeRecord*>(ptr);
+    std::lock_guard<std::mutex> guard(mutex_);
+    rec->next = freeLists_[bucket];
+    freeLists_[bucket] = rec;
+  }
+
+private:
+  struct FreeRecord {
+    FreeRecord* next;
+  };
+
+  std::mutex mutex_;
+  FreeRecord* freeLists_[kMaxRecord / kGranularity + 1] = {};
+  char* bump_ = nullptr;
+  char* end_ = nullptr;
+
+  static size_t bucketFor(size_t bytes) {
+    if (bytes == 0 || bytes > kMaxRecord) {
+      return 0;
+    }
+    return (bytes + kGranularity - 1) / kGranularity;
+  }
+};
+
+} // namespace alloc8
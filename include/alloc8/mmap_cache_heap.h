@@ -0,0 +1,235 @@
+// alloc8/mmap_cache_heap.h - Large-object heap with a cache of freed runs
+#pragma once
+
+#include "platform.h"
+#include "heap_iteration.h"
+#include "metadata.h"
+#include "os_memory.h"
+#include "page_map.h"
+#include "page_source.h"
+#include "span.h"
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+
+namespace alloc8 {
+
+// ─── MMAP CACHE HEAP ──────────────────────────────────────────────────────────
+
+/**
+ * MmapCacheHeap: One page run per allocation, with freed runs kept for reuse.
+ *
+ * Meant as the last tier of a SizeRouterN, behind heaps that serve small
+ * and medium sizes. Every allocation is a large span (sizeClass 0)
+ * registered in pageMap() under this heap's owner id, so free() and
+ * getSize() need no headers and a router can find the owner with one
+ * lookup. Freed runs stay mapped and committed in a small cache of at most
+ * CacheBytes; a request reuses the smallest cached run of at least its
+ * size and at most a quarter larger, which avoids the mmap/page-fault cost
+ * of allocate/free cycles on big buffers. When the cache is full the
+ * oldest run goes back to the page source.
+ *
+ * Alignments above the page size bypass the cache.
+ *
+ * @tparam CacheBytes Most bytes kept in freed runs (0 = no cache)
+ * @tparam PageSource Where runs come from (see page_source.h)
+ */
+template<size_t CacheBytes = size_t(64) << 20, typename PageSource = OSPageSource>
+class MmapCacheHeap {
+public:
+  MmapCacheHeap() : owner_(registerOwner()) {}
+
+  /**
+   * Owner id stamped into every span this heap creates.
+   */
+  uint16_t owner() const { return owner_; }
+
+  void* malloc(size_t sz) {
+    return allocate(sz, ALLOC8_PAGE_SIZE);
+  }
+
+  void* memalign(size_t alignment, size_t sz) {
+    return allocate(sz, alignment < ALLOC8_PAGE_SIZE ? ALLOC8_PAGE_SIZE : alignment);
+  }
+
+  void free(void* ptr) {
+    Span* span = pageMap().get(ptr);
+    if (ALLOC8_UNLIKELY(span == nullptr || span->owner != owner_)) {
+      return;  // Not ours
+    }
+    void* mem = reinterpret_cast<void*>(span->start);
+    size_t npages = span->npages;
+    Entry evicted{};
+    {
+      std::lock_guard<std::mutex> guard(lock_);
+      pageMap().erase(span);
+      spans_.deallocate(span);
+      evicted = cacheLocked(mem, npages);
+    }
+    if (evicted.mem) {
+      source_.freePages(evicted.mem, evicted.npages);
+    }
+  }
+
+  size_t getSize(void* ptr) {
+    Span* span = pageMap().get(ptr);
+    if (ALLOC8_UNLIKELY(span == nullptr || span->owner != owner_)) {
+      return 0;
+    }
+    return span->objectSize;
+  }
+
+  /**
+   * Bytes currently held in freed, reusable runs.
+   */
+  size_t cachedBytes() {
+    std::lock_guard<std::mutex> guard(lock_);
+    return cachedBytes_;
+  }
+
+  /**
+   * Return every cached run to the page source. Returns bytes released.
+   */
+  size_t releaseCache() {
+    size_t released = 0;
+    for (;;) {
+      Entry entry{};
+      {
+        std::lock_guard<std::mutex> guard(lock_);
+        if (count_ == 0) {
+          break;
+        }
+        entry = takeLocked(0);
+      }
+      source_.freePages(entry.mem, entry.npages);
+      released += entry.npages * ALLOC8_PAGE_SIZE;
+    }
+    return released;
+  }
+
+  void lock() {
+    lock_.lock();
+    source_.lock();
+  }
+
+  void unlock() {
+    source_.unlock();
+    lock_.unlock();
+  }
+
+  /**
+   * Visit every live allocation (see alloc8_iterate_callback). Cached runs
+   * are not live and are not visited.
+   */
+  void iterate(IterateCallback cb, void* ctx) {
+    iterateOwnedSpans(owner_, [this](Span*) -> std::mutex& {
+      return lock_;
+    }, cb, ctx);
+  }
+
+private:
+  static constexpr size_t kSlots = 64;
+
+  struct Entry {
+    void* mem;
+    size_t npages;
+  };
+
+  std::mutex lock_;
+  PageSource source_;
+  MetadataArena<Span> spans_;
+  Entry cache_[kSlots] = {};  // Oldest first
+  size_t count_ = 0;
+  size_t cachedBytes_ = 0;
+  uint16_t owner_;
+
+  void* allocate(size_t sz, size_t alignment) {
+    if (ALLOC8_UNLIKELY(sz > SIZE_MAX - ALLOC8_PAGE_SIZE)) {
+      return nullptr;
+    }
+    size_t npages = alignUp(sz ? sz : 1, ALLOC8_PAGE_SIZE) / ALLOC8_PAGE_SIZE;
+    std::unique_lock<std::mutex> guard(lock_);
+    Entry entry{};
+    if (alignment == ALLOC8_PAGE_SIZE) {
+      size_t slot = bestFitLocked(npages);
+      if (slot < count_) {
+        entry = takeLocked(slot);
+      }
+    }
+    if (!entry.mem) {
+      guard.unlock();
+      entry.mem = source_.allocPages(npages, alignment);
+      entry.npages = npages;
+      if (!entry.mem) {
+        return nullptr;
+      }
+      guard.lock();
+    }
+    Span* span = spans_.allocate();
+    if (span) {
+      span->start = reinterpret_cast<uintptr_t>(entry.mem);
+      span->npages = entry.npages;
+      span->objectSize = entry.npages * ALLOC8_PAGE_SIZE;
+      span->sizeClass = 0;
+      span->capacity = 1;
+      span->allocated = 1;
+      span->carved = 1;
+      span->owner = owner_;
+      span->reserved = 0;
+      if (pageMap().insert(span)) {
+        return entry.mem;
+      }
+      spans_.deallocate(span);
+    }
+    guard.unlock();
+    source_.freePages(entry.mem, entry.npages);
+    return nullptr;
+  }
+
+  // Slot of the smallest cached run in [npages, npages * 5/4], or count_
+  size_t bestFitLocked(size_t npages) const {
+    size_t limit = npages + npages / 4;
+    size_t best = count_;
+    for (size_t i = 0; i < count_; i++) {
+      size_t have = cache_[i].npages;
+      if (have >= npages && have <= limit &&
+          (best == count_ || have < cache_[best].npages)) {
+        best = i;
+      }
+    }
+    return best;
+  }
+
+  Entry takeLocked(size_t slot) {
+    Entry entry = cache_[slot];
+    for (size_t i = slot + 1; i < count_; i++) {
+      cache_[i - 1] = cache_[i];
+    }
+    count_--;
+    cachedBytes_ -= entry.npages * ALLOC8_PAGE_SIZE;
+    return entry;
+  }
+
+  // Cache a freed run; returns a run to give back to the page source (the
+  // run itself when it does not fit, else the oldest ones evicted), or {}
+  Entry cacheLocked(void* mem, size_t npages) {
+    size_t bytes = npages * ALLOC8_PAGE_SIZE;
+    if (bytes > CacheBytes) {
+      return Entry{mem, npages};
+    }
+    // Evict oldest runs until this one fits; all but the last eviction are
+    // released under the lock, which only happens for runs near CacheBytes
+    Entry evicted{};
+    while (count_ == kSlots || cachedBytes_ + bytes > CacheBytes) {
+      if (evicted.mem) {
+        source_.freePages(evicted.mem, evicted.npages);
+      }
+      evicted = takeLocked(0);
+    }
+    cache_[count_++] = Entry{mem, npages};
+    cachedBytes_ += bytes;
+    return evicted;
+  }
+};
+
+} // namespace alloc8
@@ -0,0 +1,85 @@
+// alloc8/include/alloc8/mmap_stats.h
+// Whole-process anonymous memory accounting (Linux)
+//
+// Heap statistics only cover memory the allocator hands out. JITs, arenas
+// in third-party code and other direct mmap users can hold as much again.
+// Adding ${ALLOC8_MMAP_SOURCES} to an allocator library interposes mmap,
+// munmap, mremap, brk and sbrk. It then keeps live anonymous-mapping totals
+// per call site and per tag:
+//
+//   add_library(myalloc SHARED
+//     my_allocator.cpp
+//     ${ALLOC8_INTERPOSE_SOURCES}
+//     ${ALLOC8_MMAP_SOURCES}
+//   )
+//
+// Each mapping is charged to the return address of the mmap call and to a
+// tag. The tag is, in order of preference:
+//   - the calling thread's tag (see alloc8_mmap_tag)
+//   - "stack" for MAP_STACK mappings
+//   - "alloc8" for mappings made by the allocator library itself
+//   - "brk" for the program break (brk/sbrk)
+//   - "untagged"
+//
+// Only calls that go through the dynamic symbol are seen. glibc's own
+// internal mappings (thread stacks it allocates, ld.so loading libraries)
+// bypass interposition.
+//
+// The accounting runs alongside each system call, under one spin lock, and
+// its tables are mapped with raw system calls, so it never allocates.
+// alloc8_heap_dump() includes the totals when the sources are linked.
+
+#ifndef ALLOC8_MMAP_STATS_H
+#define ALLOC8_MMAP_STATS_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Live anonymous mappings charged to one tag or one call site.
+ */
+typedef struct alloc8_mmap_stats {
+  const char* tag;    // Tag name (per-tag stats), or the site's last tag
+  const void* site;   // Call site (per-site stats), or NULL
+  uint64_t bytes;     // Bytes currently mapped
+  uint64_t peak;      // Highest value of bytes
+  uint64_t calls;     // mmap/mremap/brk/sbrk calls charged here
+} alloc8_mmap_stats;
+
+/**
+ * Callback invoked once per tag or call site. Runs without the accounting
+ * lock held, so it may allocate.
+ */
+typedef void (*alloc8_mmap_stats_callback)(const alloc8_mmap_stats* stats, void* ctx);
+
+/**
+ * alloc8_mmap_tag - Set the tag charged for the calling thread's mappings
+ *
+ * `tag` must outlive every mapping made under it (a string literal). Pass
+ * NULL to go back to automatic tags. Tags are compared by content. Past 64
+ * distinct tags, new ones are charged to "other".
+ *
+ * @return The previous tag, for restoring it
+ */
+const char* alloc8_mmap_tag(const char* tag);
+
+/**
+ * alloc8_mmap_tag_stats / alloc8_mmap_site_stats - Report live totals
+ *
+ * Calls `cb` for every tag or call site that has made a mapping. Past 1024
+ * distinct call sites, new ones are charged to a NULL site.
+ *
+ * @return 0 on success
+ */
+int alloc8_mmap_tag_stats(alloc8_mmap_stats_callback cb, void* ctx);
+int alloc8_mmap_site_stats(alloc8_mmap_stats_callback cb, void* ctx);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // ALLOC8_MMAP_STATS_H
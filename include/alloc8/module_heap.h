@@ -0,0 +1,700 @@
+// alloc8/module_heap.h - Per-shared-object allocation attribution and routing (Linux)
+#pragma once
+
+#include "platform.h"
+#include "allocator_traits.h"
+#include "maintenance.h"
+#include "os_memory.h"
+#include "page_map.h"
+#include "size_router.h"
+#include "span.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <mutex>
+#include <new>
+
+#if defined(ALLOC8_LINUX)
+#include <link.h>
+#endif
+
+extern "C" {
+/**
+ * Allocation counts charged to one loaded module (executable or shared
+ * object), as reported by alloc8_module_usage().
+ */
+typedef struct alloc8_module_stats {
+  const char* name;  // Path as loaded ("" for the main program, "[unknown]"
+                     // for code outside every module)
+  const void* base;  // Load address
+  uint64_t mallocs;  // malloc/memalign calls made from the module's code
+  uint64_t bytes;    // Bytes those calls asked ModuleHeap for
+  uint64_t frees;    // free calls made from the module's code
+  int routed;        // Its allocations go to the sub-heap
+  int loaded;        // Still loaded at the last refresh
+} alloc8_module_stats;
+
+/**
+ * Callback invoked once per module. Runs without the module table's lock
+ * held, so it may allocate.
+ */
+typedef void (*alloc8_module_stats_callback)(const alloc8_module_stats* stats, void* ctx);
+}
+
+namespace alloc8 {
+
+using ModuleStats = alloc8_module_stats;
+using ModuleStatsCallback = alloc8_module_stats_callback;
+
+#if defined(ALLOC8_LINUX)
+
+// ─── MODULE TABLE ─────────────────────────────────────────────────────────────
+
+/**
+ * ModuleTable: Maps a code address to the module (executable or shared
+ * object) it belongs to, and keeps allocation counts per module.
+ *
+ * Lookups are lock-free: the executable PT_LOAD segments of every loaded
+ * module, sorted by address, sit in an immutable table that readers binary
+ * search, behind a one-entry per-thread cache of the last segment hit.
+ * refresh() builds a new table from dl_iterate_phdr() and publishes it
+ * with one atomic store. Like PageMap leaves, tables are mapped from the
+ * OS and never released, so a reader still holding an old one never
+ * touches freed memory; each rebuild costs a page or two.
+ *
+ * A rebuild happens only when the loader's load and unload counters
+ * (dlpi_adds, dlpi_subs) have moved. It is attempted when a lookup misses
+ * every segment (a module loaded since the last refresh), at most once per
+ * kMissRefreshNs so code outside every module (JIT output) cannot turn
+ * each lookup into a loader call, and on every Maintenance tick, which is
+ * what catches a module unloaded and another loaded over its addresses.
+ * A module loaded within kMissRefreshNs of such a miss is charged to
+ * "[unknown]" until the next refresh.
+ *
+ * Modules are identified by path and load address. Their entries are never
+ * removed: an unloaded module keeps its counts and is marked not loaded,
+ * and loading it again at the same address reuses its entry. Entry 0 is
+ * "[unknown]", charged for addresses outside every module. Past
+ * kMaxModules modules, new ones are charged there too. Linux only.
+ */
+class ModuleTable {
+public:
+  static constexpr size_t kMaxModules = 512;     // Entries, "[unknown]" included
+  static constexpr size_t kMaxRanges = 2048;     // Executable segments per table
+  static constexpr size_t kMaxRoutes = 16;       // route() names
+  static constexpr size_t kNameBytes = 256;      // Longest path kept, with the NUL
+  static constexpr uint64_t kMissRefreshNs = 1000000;
+  static constexpr uint32_t kUnknown = 0;
+
+  /**
+   * The process-wide table (never destroyed, so frees during exit still
+   * find it).
+   */
+  static ModuleTable& instance() {
+    alignas(ModuleTable) static char buffer[sizeof(ModuleTable)];
+    static ModuleTable* self = new (buffer) ModuleTable;
+    return *self;
+  }
+
+  ModuleTable() {
+    void* mem = osMap(kMaxModules * sizeof(Module) + kMaxRanges * sizeof(Range));
+    if (mem) {
+      modules_ = static_cast<Module*>(mem);
+      for (size_t i = 0; i < kMaxModules; i++) {
+        new (&modules_[i]) Module;
+      }
+      scratch_ = reinterpret_cast<Range*>(static_cast<char*>(mem) + kMaxModules * sizeof(Module));
+      strcpy(modules_[kUnknown].name, "[unknown]");
+      moduleCount_.store(1, std::memory_order_release);
+    }
+  }
+
+  ~ModuleTable() {
+    if (taskAdded_) {
+      Maintenance::instance().remove(&refreshTask, this);
+    }
+  }
+
+  ModuleTable(const ModuleTable&) = delete;
+  ModuleTable& operator=(const ModuleTable&) = delete;
+
+  /**
+   * The module containing code address `pc`, or kUnknown.
+   */
+  ALLOC8_ALWAYS_INLINE
+  uint32_t find(const void* pc) {
+    uintptr_t addr = reinterpret_cast<uintptr_t>(pc);
+    const Table* table = table_.load(std::memory_order_acquire);
+    LastHit& last = lastHit();
+    if (ALLOC8_LIKELY(last.table == table && table != nullptr &&
+                      addr - last.start < last.size)) {
+      return last.module;
+    }
+    return findSlow(addr);
+  }
+
+  /**
+   * Charge an allocation of `bytes` made from module `id` (see find()).
+   */
+  ALLOC8_ALWAYS_INLINE
+  void chargeMalloc(uint32_t id, size_t bytes) {
+    if (ALLOC8_UNLIKELY(!modules_)) {
+      return;
+    }
+    modules_[id].mallocs.fetch_add(1, std::memory_order_relaxed);
+    modules_[id].bytes.fetch_add(bytes, std::memory_order_relaxed);
+  }
+
+  /**
+   * Charge a free made from module `id`.
+   */
+  ALLOC8_ALWAYS_INLINE
+  void chargeFree(uint32_t id) {
+    if (ALLOC8_LIKELY(modules_ != nullptr)) {
+      modules_[id].frees.fetch_add(1, std::memory_order_relaxed);
+    }
+  }
+
+  /**
+   * Whether allocations made from module `id` go to the sub-heap.
+   */
+  ALLOC8_ALWAYS_INLINE
+  bool routed(uint32_t id) const {
+    return modules_ && modules_[id].routed.load(std::memory_order_relaxed);
+  }
+
+  /**
+   * Route allocations from modules named `name` to the sub-heap, both those
+   * loaded now and those loaded later. `name` matches a module's path
+   * exactly or its last component ("libfoo.so.1").
+   * @return false if the name is too long or kMaxRoutes names are set
+   */
+  bool route(const char* name) {
+    size_t len = strlen(name);
+    if (len == 0 || len >= kNameBytes || !modules_) {
+      return false;
+    }
+    std::lock_guard<std::mutex> guard(lock_);
+    for (size_t i = 0; i < routeCount_; i++) {
+      if (strcmp(routes_[i], name) == 0) {
+        return true;
+      }
+    }
+    if (routeCount_ == kMaxRoutes) {
+      return false;
+    }
+    memcpy(routes_[routeCount_++], name, len + 1);
+    size_t count = moduleCount_.load(std::memory_order_relaxed);
+    for (size_t i = kUnknown + 1; i < count; i++) {
+      if (matches(name, modules_[i].name)) {
+        modules_[i].routed.store(true, std::memory_order_relaxed);
+      }
+    }
+    return true;
+  }
+
+  /**
+   * Rebuild the table if modules were loaded or unloaded since the last
+   * rebuild. Called lazily by lookups and by the Maintenance thread;
+   * callable from inside malloc (dl_iterate_phdr() does not allocate).
+   * @return true if a new table was published
+   */
+  bool refresh() {
+    if (!modules_) {
+      return false;
+    }
+    std::lock_guard<std::mutex> guard(lock_);
+    if (!taskAdded_) {
+      taskAdded_ = Maintenance::instance().add(&refreshTask, this);
+    }
+    LoaderCounts counts{};
+    dl_iterate_phdr(&readCounts, &counts);
+    if (table_.load(std::memory_order_relaxed) && counts.known &&
+        counts.adds == adds_ && counts.subs == subs_) {
+      return false;
+    }
+    return rebuild();
+  }
+
+  /**
+   * Call `cb` once per module that is loaded or was charged something, in
+   * the order modules were first seen.
+   * @return Number of modules reported
+   */
+  size_t forEachModule(ModuleStatsCallback cb, void* ctx) const {
+    if (!modules_) {
+      return 0;
+    }
+    size_t reported = 0;
+    size_t count = moduleCount_.load(std::memory_order_acquire);
+    for (size_t i = 0; i < count; i++) {
+      const Module& m = modules_[i];
+      ModuleStats s{m.name, reinterpret_cast<const void*>(m.base),
+                    m.mallocs.load(std::memory_order_relaxed),
+                    m.bytes.load(std::memory_order_relaxed),
+                    m.frees.load(std::memory_order_relaxed),
+                    m.routed.load(std::memory_order_relaxed),
+                    m.loaded.load(std::memory_order_relaxed)};
+      if (s.loaded || s.mallocs || s.frees) {
+        cb(&s, ctx);
+        reported++;
+      }
+    }
+    return reported;
+  }
+
+  /**
+   * Fork safety: hold the lock rebuilds take, which lookups inside malloc
+   * can take too (see ModuleHeap::lock()).
+   */
+  void lock() { lock_.lock(); }
+  void unlock() { lock_.unlock(); }
+
+private:
+  struct Module {
+    char name[kNameBytes] = {};
+    uintptr_t base = 0;
+    std::atomic<bool> routed{false};
+    std::atomic<bool> loaded{false};
+    alignas(64) std::atomic<uint64_t> mallocs{0};
+    std::atomic<uint64_t> bytes{0};
+    std::atomic<uint64_t> frees{0};
+  };
+
+  struct Range {
+    uintptr_t start;
+    uintptr_t end;
+    uint32_t module;
+  };
+
+  struct Table {
+    size_t count;
+    Range ranges[1];  // count entries, sorted by start
+  };
+
+  struct LastHit {
+    const Table* table;
+    uintptr_t start;
+    uintptr_t size;
+    uint32_t module;
+  };
+
+  struct LoaderCounts {
+    unsigned long long adds;
+    unsigned long long subs;
+    bool known;
+  };
+
+  struct BuildState {
+    ModuleTable* self;
+    size_t ranges;
+    size_t overflow;  // Segments that did not fit in the scratch table
+  };
+
+  Module* modules_ = nullptr;
+  Range* scratch_ = nullptr;                   // Ranges being collected, under lock_
+  std::atomic<const Table*> table_{nullptr};
+  std::atomic<size_t> moduleCount_{0};
+  std::atomic<uint64_t> nextMissRefreshNs_{0};
+  std::mutex lock_;  // Guards rebuilds, routes_, adds_/subs_, taskAdded_
+  char routes_[kMaxRoutes][kNameBytes] = {};
+  size_t routeCount_ = 0;
+  unsigned long long adds_ = 0;
+  unsigned long long subs_ = 0;
+  bool taskAdded_ = false;
+
+  static LastHit& lastHit() {
+    static ALLOC8_TLS LastHit last;
+    return last;
+  }
+
+  static void refreshTask(void* arg) {
+    static_cast<ModuleTable*>(arg)->refresh();
+  }
+
+  static uint64_t nowNs() {
+    return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count());
+  }
+
+  static bool matches(const char* name, const char* path) {
+    if (strcmp(name, path) == 0) {
+      return true;
+    }
+    const char* slash = strrchr(path, '/');
+    return slash && strcmp(name, slash + 1) == 0;
+  }
+
+  static const Range* search(const Table* table, uintptr_t addr) {
+    if (!table) {
+      return nullptr;
+    }
+    const Range* end = table->ranges + table->count;
+    const Range* it = std::upper_bound(table->ranges, end, addr,
+        [](uintptr_t a, const Range& r) { return a < r.start; });
+    if (it == table->ranges || addr >= (it - 1)->end) {
+      return nullptr;
+    }
+    return it - 1;
+  }
+
+  ALLOC8_NOINLINE
+  uint32_t findSlow(uintptr_t addr) {
+    const Table* table = table_.load(std::memory_order_acquire);
+    const Range* r = search(table, addr);
+    if (!r) {
+      // Maybe a module loaded since the last rebuild
+      uint64_t now = nowNs();
+      uint64_t due = nextMissRefreshNs_.load(std::memory_order_relaxed);
+      if (!table || (now >= due && nextMissRefreshNs_.compare_exchange_strong(
+                                       due, now + kMissRefreshNs, std::memory_order_relaxed))) {
+        refresh();
+        table = table_.load(std::memory_order_acquire);
+        r = search(table, addr);
+      }
+    }
+    if (!r) {
+      return kUnknown;
+    }
+    lastHit() = LastHit{table, r->start, r->end - r->start, r->module};
+    return r->module;
+  }
+
+  static int readCounts(dl_phdr_info* info, size_t size, void* arg) {
+    LoaderCounts& c = *static_cast<LoaderCounts*>(arg);
+    if (size >= offsetof(dl_phdr_info, dlpi_subs) + sizeof(info->dlpi_subs)) {
+      c = LoaderCounts{info->dlpi_adds, info->dlpi_subs, true};
+    }
+    return 1;  // The counters are the same in every entry
+  }
+
+  static int collect(dl_phdr_info* info, size_t size, void* arg) {
+    BuildState& b = *static_cast<BuildState*>(arg);
+    ModuleTable& self = *b.self;
+    if (size >= offsetof(dl_phdr_info, dlpi_subs) + sizeof(info->dlpi_subs)) {
+      self.adds_ = info->dlpi_adds;
+      self.subs_ = info->dlpi_subs;
+    }
+    uint32_t id = kUnknown;
+    for (size_t i = 0; i < info->dlpi_phnum; i++) {
+      const ElfW(Phdr)& ph = info->dlpi_phdr[i];
+      if (ph.p_type != PT_LOAD || !(ph.p_flags & PF_X) || ph.p_memsz == 0) {
+        continue;
+      }
+      if (id == kUnknown) {
+        id = self.intern(info->dlpi_name ? info->dlpi_name : "", info->dlpi_addr);
+      }
+      if (b.ranges == kMaxRanges) {
+        b.overflow++;
+        continue;
+      }
+      uintptr_t start = info->dlpi_addr + ph.p_vaddr;
+      self.scratch_[b.ranges++] = Range{start, start + ph.p_memsz, id};
+    }
+    return 0;
+  }
+
+  /**
+   * The entry for the module at `base` named `name`, marked loaded, or
+   * kUnknown if the module table is full. Called under lock_.
+   */
+  uint32_t intern(const char* name, uintptr_t base) {
+    size_t count = moduleCount_.load(std::memory_order_relaxed);
+    for (size_t i = kUnknown + 1; i < count; i++) {
+      Module& m = modules_[i];
+      if (m.base == base && strncmp(m.name, name, kNameBytes - 1) == 0) {
+        m.loaded.store(true, std::memory_order_relaxed);
+        return static_cast<uint32_t>(i);
+      }
+    }
+    if (count == kMaxModules) {
+      return kUnknown;
+    }
+    Module& m = modules_[count];
+    strncpy(m.name, name, kNameBytes - 1);
+    m.base = base;
+    for (size_t r = 0; r < routeCount_; r++) {
+      if (matches(routes_[r], m.name)) {
+        m.routed.store(true, std::memory_order_relaxed);
+      }
+    }
+    m.loaded.store(true, std::memory_order_relaxed);
+    moduleCount_.store(count + 1, std::memory_order_release);
+    return static_cast<uint32_t>(count);
+  }
+
+  /**
+   * Collect every loaded module's executable segments and publish them as
+   * a new table. Called under lock_.
+   */
+  bool rebuild() {
+    size_t count = moduleCount_.load(std::memory_order_relaxed);
+    for (size_t i = kUnknown + 1; i < count; i++) {
+      modules_[i].loaded.store(false, std::memory_order_relaxed);
+    }
+    BuildState b{this, 0, 0};
+    dl_iterate_phdr(&collect, &b);
+    std::sort(scratch_, scratch_ + b.ranges,
+              [](const Range& x, const Range& y) { return x.start < y.start; });
+
+    size_t bytes = offsetof(Table, ranges) + (b.ranges ? b.ranges : 1) * sizeof(Range);
+    auto* table = static_cast<Table*>(osMap(bytes));
+    if (!table) {
+      return false;
+    }
+    table->count = b.ranges;
+    memcpy(table->ranges, scratch_, b.ranges * sizeof(Range));
+    table_.store(table, std::memory_order_release);
+    return true;
+  }
+};
+
+// ─── MODULE HEAP ──────────────────────────────────────────────────────────────
+
+/**
+ * ModuleHeap: Charges every malloc, memalign and free to the module that
+ * called it (see ModuleTable), and serves allocations from modules named
+ * with route() from a separate SubHeap, so a library that churns memory
+ * cannot fragment the main heap.
+ *
+ *   using Heap = alloc8::ANSIWrapper<alloc8::ModuleHeap<
+ *       alloc8::ThreadCache<alloc8::SpanHeap<>>, alloc8::SpanHeap<>>>;
+ *
+ *   heap.route("libthirdparty.so");
+ *   ...
+ *   alloc8::ModuleTable::instance().forEachModule(print, nullptr);
+ *
+ * malloc(), memalign() and free() take the caller to be
+ * __builtin_return_address(0) of the function they inline into: xxmalloc
+ * when the heap is interposed, which the exported malloc reaches by a tail
+ * call in optimized builds, or whatever function calls the heap directly.
+ * operator new cannot tail call (it must test for null and throw), so it
+ * passes its own return address to xxmalloc_from(), which ALLOC8_REDIRECT
+ * sends to mallocFrom(). An allocation made inside another library on a
+ * module's behalf (strdup() in libc) is charged to, and routed for, that
+ * library. Use mallocFrom() and memalignFrom() to name the caller
+ * explicitly.
+ *
+ * free() goes by ownership, not by caller: one page-map lookup says
+ * whether SubHeap owns the pointer, so memory may be freed from any module.
+ * The counters are shared atomics, a few nanoseconds each when threads do
+ * not contend for one module's counters. lock(), iterate(), cacheStats(),
+ * spanSizingStats() and the thread hooks are forwarded to both heaps. Only
+ * one ThreadCache can own a thread's context, so put a ThreadCache over
+ * MainHeap, not over both.
+ *
+ * @tparam MainHeap Heap for every module that is not routed
+ * @tparam SubHeap  Heap for routed modules; must stamp an owner id
+ *                  (OwnedHeap)
+ */
+template<typename MainHeap, typename SubHeap>
+class ModuleHeap {
+  static_assert(OwnedHeap<SubHeap>, "SubHeap must stamp an owner id (OwnedHeap)");
+
+  MainHeap main_;
+  SubHeap sub_;
+
+public:
+  ALLOC8_ALWAYS_INLINE
+  void* malloc(size_t sz) {
+    return mallocFrom(__builtin_return_address(0), sz);
+  }
+
+  ALLOC8_ALWAYS_INLINE
+  void* memalign(size_t alignment, size_t sz) {
+    return memalignFrom(__builtin_return_address(0), alignment, sz);
+  }
+
+  ALLOC8_ALWAYS_INLINE
+  void free(void* ptr) {
+    freeFrom(__builtin_return_address(0), ptr);
+  }
+
+  /**
+   * malloc() on behalf of code at `caller`.
+   */
+  ALLOC8_ALWAYS_INLINE
+  void* mallocFrom(const void* caller, size_t sz) {
+    ModuleTable& modules = ModuleTable::instance();
+    uint32_t id = modules.find(caller);
+    modules.chargeMalloc(id, sz);
+    return modules.routed(id) ? sub_.malloc(sz) : main_.malloc(sz);
+  }
+
+  /**
+   * memalign() on behalf of code at `caller`.
+   */
+  ALLOC8_ALWAYS_INLINE
+  void* memalignFrom(const void* caller, size_t alignment, size_t sz) {
+    ModuleTable& modules = ModuleTable::instance();
+    uint32_t id = modules.find(caller);
+    modules.chargeMalloc(id, sz);
+    return modules.routed(id) ? sub_.memalign(alignment, sz) : main_.memalign(alignment, sz);
+  }
+
+  /**
+   * free() on behalf of code at `caller`.
+   */
+  ALLOC8_ALWAYS_INLINE
+  void freeFrom(const void* caller, void* ptr) {
+    ModuleTable& modules = ModuleTable::instance();
+    modules.chargeFree(modules.find(caller));
+    if (ownedBySub(ptr)) {
+      sub_.free(ptr);
+    } else {
+      main_.free(ptr);
+    }
+  }
+
+  ALLOC8_ALWAYS_INLINE
+  size_t getSize(void* ptr) {
+    Span* span = pageMap().get(ptr);
+    if (span && span->owner == sub_.owner()) {
+      return span->objectSize;
+    }
+    return main_.getSize(ptr);
+  }
+
+  /**
+   * Grow `ptr` in place if its heap supports it (see SpanHeap).
+   */
+  bool resizeInPlace(void* ptr, size_t sz) {
+    if (ownedBySub(ptr)) {
+      if constexpr (requires { sub_.resizeInPlace(ptr, sz); }) {
+        return sub_.resizeInPlace(ptr, sz);
+      }
+    } else {
+      if constexpr (requires { main_.resizeInPlace(ptr, sz); }) {
+        return main_.resizeInPlace(ptr, sz);
+      }
+    }
+    return false;
+  }
+
+  /**
+   * Route allocations from modules named `name` to SubHeap (see
+   * ModuleTable::route()).
+   */
+  bool route(const char* name) {
+    return ModuleTable::instance().route(name);
+  }
+
+  MainHeap& mainHeap() {
+    return main_;
+  }
+
+  SubHeap& subHeap() {
+    return sub_;
+  }
+
+  // The module table first: a lookup inside malloc may rebuild it before
+  // either heap is entered
+  void lock() {
+    ModuleTable::instance().lock();
+    main_.lock();
+    sub_.lock();
+  }
+
+  void unlock() {
+    sub_.unlock();
+    main_.unlock();
+    ModuleTable::instance().unlock();
+  }
+
+  void iterate(IterateCallback cb, void* ctx) {
+    forBoth([&](auto& h) {
+      if constexpr (requires { h.iterate(cb, ctx); }) {
+        h.iterate(cb, ctx);
+      }
+    });
+  }
+
+  void cacheStats(CacheStatsCallback cb, void* ctx) {
+    forBoth([&](auto& h) {
+      if constexpr (requires { h.cacheStats(cb, ctx); }) {
+        h.cacheStats(cb, ctx);
+      }
+    });
+  }
+
+  void spanSizingStats(SpanSizingStatsCallback cb, void* ctx) {
+    forBoth([&](auto& h) {
+      if constexpr (requires { h.spanSizingStats(cb, ctx); }) {
+        h.spanSizingStats(cb, ctx);
+      }
+    });
+  }
+
+  void threadInit() {
+    forBoth([](auto& h) {
+      if constexpr (requires { h.threadInit(); }) {
+        h.threadInit();
+      }
+    });
+  }
+
+  void threadCleanup() {
+    forBoth([](auto& h) {
+      if constexpr (requires { h.threadCleanup(); }) {
+        h.threadCleanup();
+      }
+    });
+  }
+
+  void threadIdle() {
+    forBoth([](auto& h) {
+      if constexpr (requires { h.threadIdle(); }) {
+        h.threadIdle();
+      }
+    });
+  }
+
+  void threadBusy() {
+    forBoth([](auto& h) {
+      if constexpr (requires { h.threadBusy(); }) {
+        h.threadBusy();
+      }
+    });
+  }
+
+private:
+  ALLOC8_ALWAYS_INLINE
+  bool ownedBySub(void* ptr) {
+    Span* span = pageMap().get(ptr);
+    return span && span->owner == sub_.owner();
+  }
+
+  template<typename Fn>
+  void forBoth(Fn&& fn) {
+    fn(main_);
+    fn(sub_);
+  }
+};
+
+#endif // ALLOC8_LINUX
+
+} // namespace alloc8
+
+#if defined(ALLOC8_LINUX)
+
+/**
+ * Export the process-wide ModuleTable as alloc8_module_usage(cb, ctx) and
+ * alloc8_route_module(name), next to ALLOC8_REDIRECT in an allocator built
+ * over ModuleHeap. (A function named alloc8_module_stats would clash with
+ * the struct's typedef.)
+ */
+#define ALLOC8_MODULE_REDIRECT() \
+  extern "C" { \
+    ALLOC8_EXPORT int alloc8_module_usage(alloc8_module_stats_callback cb, void* ctx) { \
+      return static_cast<int>(alloc8::ModuleTable::instance().forEachModule(cb, ctx)); \
+    } \
+    \
+    ALLOC8_EXPORT int alloc8_route_module(const char* name) { \
+      return alloc8::ModuleTable::instance().route(name) ? 0 : -1; \
+    } \
+  }
+
+#endif // ALLOC8_LINUX
@@ -0,0 +1,156 @@
+// alloc8/os_memory.h - Thin wrappers over the OS virtual memory interface
+#pragma once
+
+#include "platform.h"
+#include <cstddef>
+#include <cstdint>
+
+#if defined(ALLOC8_WINDOWS)
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#endif
+
+namespace alloc8 {
+
+// ─── OS MEMORY PRIMITIVES ─────────────────────────────────────────────────────
+//
+// Components built on alloc8 obtain memory from the OS through these helpers
+// rather than calling mmap/VirtualAlloc directly, so every component shares
+// one notion of reserve/commit/decommit. None of these call malloc, which
+// makes them safe to use from inside an interposed allocator.
+
+/**
+ * Round a size up to a multiple of a power-of-two alignment.
+ */
+ALLOC8_ALWAYS_INLINE
+constexpr size_t alignUp(size_t sz, size_t alignment) {
+  return (sz + alignment - 1) & ~(alignment - 1);
+}
+
+/**
+ * Floor of log2(x) for x > 0.
+ */
+ALLOC8_ALWAYS_INLINE
+constexpr size_t log2Floor(size_t x) {
+  size_t r = 0;
+  while (x >>= 1) r++;
+  return r;
+}
+
+/**
+ * Map committed, zero-filled, read-write memory.
+ * @return Page-aligned pointer, or nullptr on failure
+ */
+inline void* osMap(size_t sz) {
+#if defined(ALLOC8_WINDOWS)
+  return VirtualAlloc(nullptr, sz, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE);
+#else
+  void* p = mmap(nullptr, sz, PROT_READ | PROT_WRITE,
+                 MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  return (p == MAP_FAILED) ? nullptr : p;
+#endif
+}
+
+/**
+ * Map committed memory whose start is aligned to `alignment` (a power of two
+ * that is a multiple of the page size). Over-maps and trims the excess.
+ */
+inline void* osMapAligned(size_t sz, size_t alignment) {
+  if (alignment <= ALLOC8_PAGE_SIZE) {
+    return osMap(sz);
+  }
+#if defined(ALLOC8_WINDOWS)
+  // Windows cannot partially release a reservation, so retry at a hinted
+  // aligned address inside an over-sized reservation.
+  for (int attempt = 0; attempt < 8; attempt++) {
+    void* probe = VirtualAlloc(nullptr, sz + alignment, MEM_RESERVE, PAGE_NOACCESS);
+    if (!probe) return nullptr;
+    uintptr_t aligned = alignUp(reinterpret_cast<uintptr_t>(probe), alignment);
+    VirtualFree(probe, 0, MEM_RELEASE);
+    void* p = VirtualAlloc(reinterpret_cast<void*>(aligned), sz,
+                           MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE);
+    if (p) return p;
+  }
+  return nullptr;
+#else
+  size_t total = sz + alignment;
+  char* raw = static_cast<char*>(osMap(total));
+  if (!raw) return nullptr;
+  uintptr_t start = reinterpret_cast<uintptr_t>(raw);
+  uintptr_t aligned = alignUp(start, alignment);
+  size_t head = aligned - start;
+  size_t tail = total - head - sz;
+  if (head) munmap(raw, head);
+  if (tail) munmap(reinterpret_cast<char*>(aligned) + sz, tail);
+  return reinterpret_cast<void*>(aligned);
+#endif
+}
+
+/**
+ * Release memory obtained from osMap/osMapAligned/osReserve.
+ */
+inline void osUnmap(void* ptr, size_t sz) {
+#if defined(ALLOC8_WINDOWS)
+  (void)sz;
+  VirtualFree(ptr, 0, MEM_RELEASE);
+#else
+  munmap(ptr, sz);
+#endif
+}
+
+/**
+ * Reserve address space without committing it. Touching reserved memory
+ * faults until the range is committed with osCommit().
+ */
+inline void* osReserve(size_t sz) {
+#if defined(ALLOC8_WINDOWS)
+  return VirtualAlloc(nullptr, sz, MEM_RESERVE, PAGE_NOACCESS);
+#else
+  void* p = mmap(nullptr, sz, PROT_NONE,
+                 MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+  return (p == MAP_FAILED) ? nullptr : p;
+#endif
+}
+
+/**
+ * Commit (make read-write) a page-aligned range inside a reservation.
+ */
+inline bool osCommit(void* ptr, size_t sz) {
+#if defined(ALLOC8_WINDOWS)
+  return VirtualAlloc(ptr, sz, MEM_COMMIT, PAGE_READWRITE) != nullptr;
+#else
+  return mprotect(ptr, sz, PROT_READ | PROT_WRITE) == 0;
+#endif
+}
+
+/**
+ * Return the physical pages backing a range to the OS while keeping the
+ * address range reserved. On Linux the next touch sees zero-filled memory,
+ * on macOS the contents are undefined, and on Windows the range must be
+ * re-committed with osCommit() first.
+ */
+inline void osDecommit(void* ptr, size_t sz) {
+#if defined(ALLOC8_WINDOWS)
+  VirtualFree(ptr, sz, MEM_DECOMMIT);
+#elif defined(ALLOC8_LINUX)
+  madvise(ptr, sz, MADV_DONTNEED);
+#else
+  madvise(ptr, sz, MADV_FREE);
+#endif
+}
+
+/**
+ * Ask the OS to back a range with huge pages where it can (Linux THP in
+ * "madvise" mode). Advisory only; a no-op on other platforms.
+ */
+inline void osHugePageHint(void* ptr, size_t sz) {
+#if defined(ALLOC8_LINUX) && defined(MADV_HUGEPAGE)
+  madvise(ptr, sz, MADV_HUGEPAGE);
+#else
+  (void)ptr;
+  (void)sz;
+#endif
+}
+
+} // namespace alloc8
@@ -0,0 +1,188 @@
+// alloc8/page_map.h - Process-wide radix map from pages to span descriptors
+#pragma once
+
+#include "platform.h"
+#include "os_memory.h"
+#include "span.h"
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <new>
+
+namespace alloc8 {
+
+// ─── PAGE MAP ─────────────────────────────────────────────────────────────────
+
+/**
+ * PageMap: Two-level radix tree mapping every page handed out by an alloc8
+ * component to its Span descriptor.
+ *
+ * Lookups are lock-free (two dependent loads). Leaves are mapped from the OS
+ * on first use and never released, so concurrent readers never touch freed
+ * memory. Pages outside the covered address range, or never registered,
+ * map to nullptr.
+ *
+ * All components in a process share one map (see pageMap()), which is what
+ * lets layers route free() and getSize() to the right component by reading
+ * Span::owner instead of re-deriving sizes.
+ */
+class PageMap {
+public:
+  static constexpr size_t kPageShift = log2Floor(ALLOC8_PAGE_SIZE);
+  static constexpr size_t kAddressBits = (sizeof(void*) == 8) ? 48 : 32;
+  static constexpr size_t kPageNumberBits = kAddressBits - kPageShift;
+  static constexpr size_t kLeafBits = (kPageNumberBits < 18) ? kPageNumberBits : 18;
+  static constexpr size_t kRootBits = kPageNumberBits - kLeafBits;
+  static constexpr size_t kLeafLength = size_t(1) << kLeafBits;
+  static constexpr size_t kRootLength = size_t(1) << kRootBits;
+
+  struct Leaf {
+    std::atomic<Span*> spans[kLeafLength];
+  };
+
+  PageMap() {
+    root_ = static_cast<std::atomic<Leaf*>*>(
+        osMap(kRootLength * sizeof(std::atomic<Leaf*>)));
+  }
+
+  /**
+   * Find the span containing `ptr`, or nullptr if none is registered.
+   */
+  ALLOC8_ALWAYS_INLINE
+  Span* get(const void* ptr) const {
+    uintptr_t page = reinterpret_cast<uintptr_t>(ptr) >> kPageShift;
+    if (ALLOC8_UNLIKELY((page >> kLeafBits) >= kRootLength)) {
+      return nullptr;
+    }
+    Leaf* leaf = root_[page >> kLeafBits].load(std::memory_order_acquire);
+    if (ALLOC8_UNLIKELY(leaf == nullptr)) {
+      return nullptr;
+    }
+    return leaf->spans[page & (kLeafLength - 1)].load(std::memory_order_acquire);
+  }
+
+  /**
+   * Register `span` for every page it covers.
+   * @return false if a leaf could not be mapped
+   */
+  bool insert(Span* span) {
+    return setRange(span->start, span->npages, span);
+  }
+
+  /**
+   * Unregister every page covered by `span`.
+   */
+  void erase(Span* span) {
+    setRange(span->start, span->npages, nullptr);
+  }
+
+  /**
+   * Point `npages` pages starting at `start` to `span` (may be nullptr).
+   */
+  bool setRange(uintptr_t start, size_t npages, Span* span) {
+    uintptr_t page = start >> kPageShift;
+    for (size_t i = 0; i < npages; i++, page++) {
+      if ((page >> kLeafBits) >= kRootLength) {
+        return false;
+      }
+      Leaf* leaf = ensureLeaf(page >> kLeafBits);
+      if (!leaf) {
+        return false;
+      }
+      leaf->spans[page & (kLeafLength - 1)].store(span, std::memory_order_release);
+    }
+    return true;
+  }
+
+  /**
+   * Visit each registered span once, in address order, by walking span
+   * heads. The visitor receives the head address it was found at and the
+   * descriptor; since the walk takes no locks the visitor must revalidate
+   * (`pageMap().get(addr) == span && span->start == addr`) under the
+   * owning component's lock before trusting the descriptor.
+   */
+  template<typename Visitor>
+  void forEachSpan(Visitor&& visit) const {
+    forEachSpanFrom(0, [&](uintptr_t addr, Span* span) {
+      visit(addr, span);
+      return true;
+    });
+  }
+
+  /**
+   * Resumable forEachSpan(): visit span heads at or after address `from`,
+   * for walks spread over several calls. The visitor returns false to stop
+   * after the span it was just given.
+   * @return Address to resume from, or 0 once the whole map has been walked
+   */
+  template<typename Visitor>
+  uintptr_t forEachSpanFrom(uintptr_t from, Visitor&& visit) const {
+    size_t first = from >> kPageShift;
+    for (size_t r = first >> kLeafBits; r < kRootLength; r++) {
+      Leaf* leaf = root_[r].load(std::memory_order_acquire);
+      if (!leaf) continue;
+      size_t i = (r == (first >> kLeafBits)) ? first & (kLeafLength - 1) : 0;
+      for (; i < kLeafLength; i++) {
+        Span* span = leaf->spans[i].load(std::memory_order_acquire);
+        if (!span) continue;
+        uintptr_t addr = ((r << kLeafBits) | i) << kPageShift;
+        if (span->start != addr) continue;  // interior page or stale entry
+        size_t npages = span->npages;
+        if (!visit(addr, span)) {
+          return addr + (npages ? npages : 1) * ALLOC8_PAGE_SIZE;
+        }
+        // Skip the rest of this span's pages (the descriptor may have been
+        // recycled by the visitor, so use the snapshot taken above).
+        if (npages > 1) {
+          i += npages - 1;
+        }
+      }
+    }
+    return 0;
+  }
+
+private:
+  std::atomic<Leaf*>* root_;
+
+  Leaf* ensureLeaf(size_t index) {
+    Leaf* leaf = root_[index].load(std::memory_order_acquire);
+    if (ALLOC8_LIKELY(leaf != nullptr)) {
+      return leaf;
+    }
+    Leaf* fresh = static_cast<Leaf*>(osMap(sizeof(Leaf)));
+    if (!fresh) {
+      return nullptr;
+    }
+    if (!root_[index].compare_exchange_strong(leaf, fresh,
+                                              std::memory_order_acq_rel)) {
+      osUnmap(fresh, sizeof(Leaf));
+      return leaf;
+    }
+    return fresh;
+  }
+};
+
+/**
+ * The process-wide page map shared by every alloc8 component.
+ * Constructed on first use into static storage that is never destroyed.
+ */
+ALLOC8_ALWAYS_INLINE
+PageMap& pageMap() {
+  alignas(PageMap) static char buffer[sizeof(PageMap)];
+  static PageMap* map = new (buffer) PageMap;
+  return *map;
+}
+
+// ─── COMPONENT OWNERSHIP ──────────────────────────────────────────────────────
+
+/**
+ * Allocate a process-unique owner id for a component instance. Stored in
+ * Span::owner so layers can route a pointer to the component that owns it.
+ * Id 0 is never returned and means "unowned".
+ */
+inline uint16_t registerOwner() {
+  static std::atomic<uint16_t> nextOwner{1};
+  return nextOwner.fetch_add(1, std::memory_order_relaxed);
+}
+
+} // namespace alloc8
@@ -0,0 +1,158 @@
+// alloc8/page_source.h - Page-granularity memory sources for span components
+#pragma once
+
+#include "platform.h"
+#include "os_memory.h"
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+
+namespace alloc8 {
+
+// ─── PAGE SOURCE INTERFACE ────────────────────────────────────────────────────
+//
+// Span-based components obtain whole page runs from a PageSource template
+// parameter, so the policy for talking to the OS (direct mmap, huge-page
+// packing, chunk caching...) can be swapped without touching the component.
+//
+// A PageSource provides:
+//   void* allocPages(size_t npages, size_t alignment)  // page-aligned run
+//   void  freePages(void* ptr, size_t npages)
+//   void  lock()                                      // fork safety
+//   void  unlock()
+//
+// Sources must be thread-safe and must never call malloc.
+
+/**
+ * OSPageSource: Every page run is a fresh OS mapping.
+ *
+ * The simplest possible source; each freePages() returns memory to the OS
+ * immediately.
+ */
+class OSPageSource {
+public:
+  void* allocPages(size_t npages, size_t alignment = ALLOC8_PAGE_SIZE) {
+    return osMapAligned(npages * ALLOC8_PAGE_SIZE, alignment);
+  }
+
+  void freePages(void* ptr, size_t npages) {
+    osUnmap(ptr, npages * ALLOC8_PAGE_SIZE);
+  }
+
+  void lock() {}
+  void unlock() {}
+};
+
+/**
+ * RegionPageSource: Page runs carved from one fixed region mapped up front.
+ *
+ * For memory that must stay at known addresses for its whole life, e.g.
+ * buffers registered with the kernel once (see FixedBufferHeap). The
+ * region is split into segments of SegmentBytes, and no run crosses a
+ * segment boundary. Free pages are tracked in a bitmap and allocated
+ * first-fit, lowest address first. Freed pages are never returned to the
+ * OS: a registration may have pinned them.
+ *
+ * @tparam RegionBytes  Size of the region (multiple of SegmentBytes)
+ * @tparam SegmentBytes Largest run, and the boundary runs never cross
+ */
+template<size_t RegionBytes, size_t SegmentBytes = RegionBytes>
+class RegionPageSource {
+  static_assert(SegmentBytes % ALLOC8_PAGE_SIZE == 0 && SegmentBytes > 0,
+                "Segments must be whole pages");
+  static_assert(RegionBytes % SegmentBytes == 0,
+                "Region must be a whole number of segments");
+
+  static constexpr size_t kPages = RegionBytes / ALLOC8_PAGE_SIZE;
+  static constexpr size_t kSegmentPages = SegmentBytes / ALLOC8_PAGE_SIZE;
+
+  std::mutex lock_;
+  char* base_;
+  uint64_t used_[(kPages + 63) / 64] = {};
+
+  bool isUsed(size_t page) const {
+    return used_[page / 64] & (uint64_t(1) << (page % 64));
+  }
+
+  // First page at or after `page` whose address is aligned to `alignment`
+  size_t alignPage(size_t page, size_t alignment) const {
+    uintptr_t b = reinterpret_cast<uintptr_t>(base_);
+    return (alignUp(b + page * ALLOC8_PAGE_SIZE, alignment) - b) / ALLOC8_PAGE_SIZE;
+  }
+
+  void mark(size_t first, size_t npages, bool used) {
+    for (size_t p = first; p < first + npages; p++) {
+      if (used) {
+        used_[p / 64] |= uint64_t(1) << (p % 64);
+      } else {
+        used_[p / 64] &= ~(uint64_t(1) << (p % 64));
+      }
+    }
+  }
+
+public:
+  static constexpr size_t kRegionBytes = RegionBytes;
+  static constexpr size_t kSegmentBytes = SegmentBytes;
+
+  RegionPageSource() : base_(static_cast<char*>(osMap(RegionBytes))) {}
+
+  RegionPageSource(const RegionPageSource&) = delete;
+  RegionPageSource& operator=(const RegionPageSource&) = delete;
+
+  ~RegionPageSource() {
+    if (base_) {
+      osUnmap(base_, RegionBytes);
+    }
+  }
+
+  /**
+   * Start of the region, or nullptr if it could not be mapped.
+   */
+  char* base() const { return base_; }
+
+  bool contains(const void* ptr) const {
+    auto p = reinterpret_cast<uintptr_t>(ptr);
+    auto b = reinterpret_cast<uintptr_t>(base_);
+    return base_ && p >= b && p < b + RegionBytes;
+  }
+
+  void* allocPages(size_t npages, size_t alignment = ALLOC8_PAGE_SIZE) {
+    if (!base_ || npages == 0 || npages > kSegmentPages) {
+      return nullptr;
+    }
+    std::lock_guard<std::mutex> guard(lock_);
+    size_t page = alignPage(0, alignment);
+    while (page + npages <= kPages) {
+      if (page % 64 == 0 && used_[page / 64] == ~uint64_t(0)) {
+        page = alignPage(page + 64, alignment);  // Skip full words
+        continue;
+      }
+      size_t segmentEnd = (page / kSegmentPages + 1) * kSegmentPages;
+      if (page + npages > segmentEnd) {
+        page = alignPage(segmentEnd, alignment);  // Would straddle a segment
+        continue;
+      }
+      size_t run = 0;
+      while (run < npages && !isUsed(page + run)) {
+        run++;
+      }
+      if (run == npages) {
+        mark(page, npages, true);
+        return base_ + page * ALLOC8_PAGE_SIZE;
+      }
+      page = alignPage(page + run + 1, alignment);
+    }
+    return nullptr;
+  }
+
+  void freePages(void* ptr, size_t npages) {
+    size_t first = (static_cast<char*>(ptr) - base_) / ALLOC8_PAGE_SIZE;
+    std::lock_guard<std::mutex> guard(lock_);
+    mark(first, npages, false);
+  }
+
+  void lock() { lock_.lock(); }
+  void unlock() { lock_.unlock(); }
+};
+
+} // namespace alloc8
@@ -67,6 +67,17 @@
   #define ALLOC8_FLATTEN __attribute__((flatten))
 #endif
 
+// ─── THREAD-LOCAL STORAGE ─────────────────────────────────────────────────────
+// Static TLS for allocator fast paths. initial-exec avoids a __tls_get_addr
+// call per access; preloaded allocators are loaded at startup, so the static
+// TLS block always has room for them.
+
+#if defined(ALLOC8_MSVC)
+  #define ALLOC8_TLS __declspec(thread)
+#else
+  #define ALLOC8_TLS __attribute__((tls_model("initial-exec"))) __thread
+#endif
+
 // ─── LIKELY/UNLIKELY HINTS ────────────────────────────────────────────────────
 // Use __builtin_expect for portability (C++20 [[likely]]/[[unlikely]] have
 // different syntax requirements that make macro usage difficult)
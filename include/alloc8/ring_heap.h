@@ -0,0 +1,280 @@
+// alloc8/ring_heap.h - FIFO ring allocator for queue-lifetime objects
+#pragma once
+
+#include "platform.h"
+#include "allocator_traits.h"
+#include "os_memory.h"
+#include "span_heap.h"
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+
+namespace alloc8 {
+
+// ─── RING HEAP ────────────────────────────────────────────────────────────────
+
+/**
+ * RingHeap: Allocates at the head of a ring and reclaims at its tail, for
+ * objects freed in about the order they were allocated (message payloads,
+ * queue entries, per-request buffers).
+ *
+ * A general-purpose heap scatters such objects over partly used spans as
+ * the queue drains. Here allocation bumps the head past a 16-byte block
+ * header, free() marks the block done with one atomic store (it never
+ * takes a lock, so consumers on other threads never wait for the
+ * producer), and the tail advances over done blocks when the head needs
+ * room. Memory is reused strictly in ring order.
+ *
+ * A block that stays live while the ones after it are freed (a straggler)
+ * does not hold the tail back: the tail pins it and moves on, and the head
+ * steps over it on its next lap if it is still live. Up to 256 stragglers
+ * can be pinned. When the ring has no room (too many stragglers, or more
+ * data in flight than the ring holds) allocations spill to the Fallback
+ * heap; spills() counts them. Requests above an eighth of the ring, and
+ * alignments above 16 bytes, always go to the Fallback.
+ *
+ *   using Queue = alloc8::ANSIWrapper<alloc8::RingHeap<(16 << 20)>>;
+ *
+ * free() and getSize() tell ring blocks from Fallback blocks by address.
+ * The ring is mapped on first use and stays committed once the head has
+ * gone round it. malloc() takes one lock, so the ring suits one producer
+ * (or a few) and any number of consumers. It is not an OwnedHeap and
+ * cannot be a SizeRouterN tier below the last.
+ *
+ * @tparam RingBytes Size of the ring (multiple of the page size)
+ * @tparam Fallback  Heap for spills, large and over-aligned requests; must
+ *                   be safe to call from any thread
+ */
+template<size_t RingBytes = size_t(16) << 20, typename Fallback = SpanHeap<>>
+class RingHeap {
+  static_assert(RingBytes % ALLOC8_PAGE_SIZE == 0 && RingBytes > 0,
+                "The ring must be whole pages");
+  static_assert(RingBytes <= UINT32_MAX, "Block sizes are 32-bit");
+
+public:
+  static constexpr size_t kAlignment = 16;
+  static constexpr size_t kMaxBlock = RingBytes / 8;
+
+  RingHeap() = default;
+
+  RingHeap(const RingHeap&) = delete;
+  RingHeap& operator=(const RingHeap&) = delete;
+
+  ~RingHeap() {
+    if (char* base = base_.load(std::memory_order_relaxed)) {
+      osUnmap(base, RingBytes);
+    }
+  }
+
+  void* malloc(size_t sz) {
+    if (ALLOC8_UNLIKELY(sz > kMaxBlock)) {
+      return fallback_.malloc(sz);
+    }
+    size_t need = alignUp(sz + sizeof(Block), kAlignment);
+    {
+      std::lock_guard<std::mutex> guard(lock_);
+      if (ALLOC8_UNLIKELY(ring_ == nullptr) && !mapLocked()) {
+        return fallback_.malloc(sz);
+      }
+      for (;;) {
+        size_t offset = head_ % RingBytes;
+        size_t pad = (offset + need > RingBytes) ? RingBytes - offset : 0;
+        uint64_t end = head_ + pad + need;
+        if (end > tail_ + RingBytes) {
+          reclaimLocked();
+          if (end > tail_ + RingBytes) {
+            break;  // Full
+          }
+        }
+        if (ALLOC8_UNLIKELY(pinCount_ != 0 && end > pins_[pinFirst_].pos)) {
+          // A pinned straggler is in the way: step over it if it is still
+          // live, else its space is free
+          Pin pin = pins_[pinFirst_];
+          pinFirst_ = (pinFirst_ + 1) % kMaxPins;
+          pinCount_--;
+          if (blockAt(pin.pos)->state.load(std::memory_order_acquire) == kLive) {
+            if (pin.pos != head_) {
+              skipLocked(pin.pos - head_);
+            }
+            head_ = pin.pos + pin.size;
+          }
+          continue;
+        }
+        if (pad) {
+          skipLocked(pad);  // The block does not fit before the ring's end
+        }
+        Block* block = blockAt(head_);
+        block->size = static_cast<uint32_t>(need);
+        block->state.store(kLive, std::memory_order_relaxed);
+        head_ += need;
+        return block + 1;
+      }
+    }
+    spills_.fetch_add(1, std::memory_order_relaxed);
+    return fallback_.malloc(sz);
+  }
+
+  void* memalign(size_t alignment, size_t sz) {
+    if (alignment <= kAlignment) {
+      return malloc(sz);
+    }
+    return fallback_.memalign(alignment, sz);
+  }
+
+  void free(void* ptr) {
+    if (ALLOC8_LIKELY(inRing(ptr))) {
+      Block* block = static_cast<Block*>(ptr) - 1;
+      // Release: the tail may reuse the block as soon as it sees kDone
+      block->state.store(kDone, std::memory_order_release);
+      return;
+    }
+    fallback_.free(ptr);
+  }
+
+  size_t getSize(void* ptr) {
+    if (inRing(ptr)) {
+      return (static_cast<Block*>(ptr) - 1)->size - sizeof(Block);
+    }
+    return fallback_.getSize(ptr);
+  }
+
+  /**
+   * Bytes between the tail and the head, after reclaiming done blocks,
+   * plus the stragglers the head will step over.
+   */
+  size_t usedBytes() {
+    std::lock_guard<std::mutex> guard(lock_);
+    if (!ring_) {
+      return 0;
+    }
+    reclaimLocked(false);
+    size_t used = head_ - tail_;
+    for (size_t i = 0; i < pinCount_; i++) {
+      const Pin& pin = pins_[(pinFirst_ + i) % kMaxPins];
+      if (blockAt(pin.pos)->state.load(std::memory_order_acquire) == kLive) {
+        used += pin.size;
+      }
+    }
+    return used;
+  }
+
+  /**
+   * Allocations that went to the Fallback because the ring was full.
+   */
+  size_t spills() const {
+    return spills_.load(std::memory_order_relaxed);
+  }
+
+  Fallback& fallback() { return fallback_; }
+
+  void lock() {
+    lock_.lock();
+    fallback_.lock();
+  }
+
+  void unlock() {
+    fallback_.unlock();
+    lock_.unlock();
+  }
+
+  /**
+   * Visit every live allocation (see alloc8_iterate_callback): ring blocks
+   * from oldest to newest, then the Fallback's if it can iterate. The ring
+   * lock is held while its blocks are visited.
+   */
+  void iterate(IterateCallback cb, void* ctx) {
+    {
+      std::lock_guard<std::mutex> guard(lock_);
+      for (uint64_t pos = tail_; pos != head_;) {
+        Block* block = blockAt(pos);
+        if (block->state.load(std::memory_order_acquire) == kLive) {
+          cb(block + 1, block->size - sizeof(Block), ctx);
+        }
+        pos += block->size;
+      }
+      for (size_t i = 0; i < pinCount_; i++) {
+        Block* block = blockAt(pins_[(pinFirst_ + i) % kMaxPins].pos);
+        if (block->state.load(std::memory_order_acquire) == kLive) {
+          cb(block + 1, block->size - sizeof(Block), ctx);
+        }
+      }
+    }
+    if constexpr (requires { fallback_.iterate(cb, ctx); }) {
+      fallback_.iterate(cb, ctx);
+    }
+  }
+
+private:
+  static constexpr uint32_t kLive = 1;
+  static constexpr uint32_t kDone = 2;
+  static constexpr uint32_t kSkip = 3;  // Padding written by the head
+
+  static constexpr size_t kMaxPins = 256;
+
+  struct alignas(kAlignment) Block {
+    std::atomic<uint32_t> state;
+    uint32_t size;  // Bytes including this header
+  };
+
+  // A live block the tail moved past, at its position one lap later
+  struct Pin {
+    uint64_t pos;
+    uint32_t size;
+  };
+
+  std::mutex lock_;
+  std::atomic<char*> base_{nullptr};  // Read without the lock by free()
+  char* ring_ = nullptr;               // base_, for the lock holder
+  uint64_t head_ = 0;  // Ring positions; the offset is position % RingBytes
+  uint64_t tail_ = 0;
+  Pin pins_[kMaxPins] = {};  // FIFO, ascending positions, all >= head_
+  size_t pinFirst_ = 0;
+  size_t pinCount_ = 0;
+  std::atomic<size_t> spills_{0};
+  Fallback fallback_;
+
+  bool inRing(const void* ptr) const {
+    char* base = base_.load(std::memory_order_acquire);
+    return base && reinterpret_cast<uintptr_t>(ptr) - reinterpret_cast<uintptr_t>(base) < RingBytes;
+  }
+
+  Block* blockAt(uint64_t pos) const {
+    return reinterpret_cast<Block*>(ring_ + pos % RingBytes);
+  }
+
+  bool mapLocked() {
+    ring_ = static_cast<char*>(osMap(RingBytes));
+    base_.store(ring_, std::memory_order_release);
+    return ring_ != nullptr;
+  }
+
+  // Fill `bytes` at the head with padding the tail can pass
+  void skipLocked(uint64_t bytes) {
+    Block* skip = blockAt(head_);
+    skip->size = static_cast<uint32_t>(bytes);
+    skip->state.store(kSkip, std::memory_order_relaxed);
+    head_ += bytes;
+  }
+
+  // Advance the tail over blocks that are done. When `pin` is set, a live
+  // block followed by one that is not (a straggler) is pinned and the tail
+  // moves on; a run of live blocks (messages still in flight) stops it.
+  void reclaimLocked(bool pin = true) {
+    while (tail_ != head_) {
+      Block* block = blockAt(tail_);
+      if (block->state.load(std::memory_order_acquire) == kLive) {
+        uint64_t next = tail_ + block->size;
+        if (!pin || pinCount_ == kMaxPins || next == head_ ||
+            blockAt(next)->state.load(std::memory_order_acquire) == kLive) {
+          break;
+        }
+        pins_[(pinFirst_ + pinCount_) % kMaxPins] = Pin{tail_ + RingBytes, block->size};
+        pinCount_++;
+      }
+      tail_ += block->size;
+    }
+  }
+};
+
+} // namespace alloc8
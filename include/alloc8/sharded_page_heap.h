@@ -0,0 +1,609 @@
+// alloc8/sharded_page_heap.h - Thread-owned pages with per-page free lists
+#pragma once
+
+#include "platform.h"
+#include "alloc_context.h"
+#include "metadata.h"
+#include "mmap_cache_heap.h"
+#include "os_memory.h"
+#include "page_map.h"
+#include "page_source.h"
+#include "size_classes.h"
+#include "span.h"
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+
+namespace alloc8 {
+
+// ─── SHARDED PAGE HEAP ────────────────────────────────────────────────────────
+
+/**
+ * ShardedPageHeap: Free lists sharded per page, in the style of mimalloc.
+ *
+ * Every thread (every AllocContext) owns its pages outright. A page is one
+ * span of a single size class, and it keeps three lists instead of the
+ * heap keeping one per class:
+ *
+ *  - free:        objects malloc() pops (owner thread only, no atomics)
+ *  - local free:  objects the owner freed; they become the free list when
+ *                 it runs dry, so a burst of frees does not disturb the
+ *                 allocation order of the current burst of mallocs
+ *  - thread free: objects other threads freed, pushed with one
+ *                 compare-and-swap; the owner takes the whole list with
+ *                 one exchange when the page runs dry
+ *
+ * Allocation stays on one page until it is exhausted, so objects allocated
+ * together are adjacent, and a cross-thread free never takes a lock or
+ * touches the owner's lists.
+ *
+ * Full pages leave the allocation queue and are not looked at again until
+ * a free arrives: the first remote free into a full page pushes the page
+ * onto its owner's reclaim stack (mimalloc's delayed free), and the owner
+ * moves it back on its next slow path. Empty pages are retired lazily: the
+ * slow path prefers partly used pages, keeps one empty page per class as a
+ * spare and returns the rest to the page source. When a thread exits, its
+ * pages with live objects are abandoned; the first thread that runs out of
+ * pages of that class adopts one instead of mapping a new page.
+ *
+ * Requests above the largest class, and over-aligned requests, go to a
+ * large-object heap. The result is a complete heap for HeapRedirect:
+ *
+ *   using MyHeap = alloc8::ANSIWrapper<alloc8::ShardedPageHeap<>>;
+ *   using MyRedirect = alloc8::HeapRedirect<MyHeap>;
+ *   ALLOC8_REDIRECT_WITH_THREADS(MyRedirect);
+ *
+ * A context belongs to the first thread-aware layer that touches it (see
+ * ThreadCache); calls from a context that belongs to another layer, or
+ * from a thread after threadCleanup(), use one shared page set under a
+ * lock. iterate() is not provided: the free lists of running threads are
+ * not safe to walk from another thread.
+ *
+ * @tparam Classes    Size-class map
+ * @tparam PageBytes  Smallest page (span) size; large classes get room for
+ *                    at least 8 objects
+ * @tparam LargeHeap  Heap for large and over-aligned requests (an OwnedHeap)
+ * @tparam PageSource Where pages come from (see page_source.h)
+ */
+template<typename Classes = SizeClasses, size_t PageBytes = 64 * 1024,
+         typename LargeHeap = MmapCacheHeap<>, typename PageSource = OSPageSource>
+class ShardedPageHeap {
+  static_assert(PageBytes % ALLOC8_PAGE_SIZE == 0, "PageBytes must be whole OS pages");
+
+  struct Local;
+
+  // State word: owning Local (nullptr while abandoned) | kDelayed
+  static constexpr uintptr_t kDelayed = 1;
+
+  struct Page {
+    Span span;                          // First member: pageMap() yields &page->span
+    void* free;                         // Owner: allocation list
+    void* localFree;                    // Owner: its own frees
+    std::atomic<void*> threadFree;      // Other threads' frees
+    std::atomic<uintptr_t> state;       // Owner | kDelayed once retired as full
+    std::atomic<Page*> reclaimNext;     // Link on the owner's reclaim stack
+    Page* unfullNext;                   // Owner: link on Local::unfull
+    bool inFull;                        // Owner: on Local::full, not in a queue
+    bool onUnfull;                      // Owner: on Local::unfull
+  };
+
+  struct Local {
+    ShardedPageHeap* heap;
+    std::atomic<Page*> reclaim;            // Full pages that got a remote free
+    Page* unfull;                          // Full pages that got a local free
+    SpanList full;                         // Retired full pages
+    SpanList queue[Classes::kNumClasses];  // Pages with room; front is current
+  };
+
+  // Tag for a thread's default context after threadCleanup() (see ThreadCache)
+  static void* retired() {
+    static char marker;
+    return &marker;
+  }
+
+  static Page* pageOf(Span* span) {
+    return reinterpret_cast<Page*>(span);
+  }
+
+  static size_t pageBytes(size_t cls) {
+    size_t bytes = Classes::classToSize(cls) * 8;
+    bytes = bytes < PageBytes ? PageBytes : alignUp(bytes, ALLOC8_PAGE_SIZE);
+    while (bytes / Classes::classToSize(cls) > Span::kMaxObjects) {
+      bytes -= ALLOC8_PAGE_SIZE;
+    }
+    return bytes;
+  }
+
+public:
+  ShardedPageHeap() : owner_(registerOwner()) {
+    shared_.heap = this;
+  }
+
+  /**
+   * Owner id stamped into every page this heap creates.
+   */
+  uint16_t owner() const { return owner_; }
+
+  /**
+   * The heap serving large and over-aligned requests.
+   */
+  LargeHeap& largeHeap() { return large_; }
+
+  ALLOC8_ALWAYS_INLINE
+  void* malloc(size_t sz) {
+    size_t cls = Classes::sizeToClass(sz);
+    if (ALLOC8_UNLIKELY(cls == 0)) {
+      return large_.malloc(sz);
+    }
+    Local* local = localFor(current_context());
+    if (ALLOC8_UNLIKELY(local == nullptr)) {
+      return mallocShared(cls);
+    }
+    Span* span = local->queue[cls].front();
+    if (ALLOC8_LIKELY(span != nullptr)) {
+      Page* page = pageOf(span);
+      if (void* obj = page->free) {
+        page->free = *static_cast<void**>(obj);
+        span->allocated++;
+        return obj;
+      }
+    }
+    return mallocSlow(local, cls);
+  }
+
+  ALLOC8_ALWAYS_INLINE
+  void free(void* ptr) {
+    Span* span = pageMap().get(ptr);
+    if (ALLOC8_UNLIKELY(span == nullptr || span->owner != owner_)) {
+      large_.free(ptr);
+      return;
+    }
+    Page* page = pageOf(span);
+    AllocContext* ctx = current_context();
+    uintptr_t state = page->state.load(std::memory_order_relaxed);
+    // Only the owner ever moves a page away from itself, so a match is final
+    if (ALLOC8_LIKELY(ctx->heap == this &&
+                      (state & ~kDelayed) == reinterpret_cast<uintptr_t>(ctx->threadCache))) {
+      *static_cast<void**>(ptr) = page->localFree;
+      page->localFree = ptr;
+      span->allocated--;
+      if (ALLOC8_UNLIKELY(page->inFull && !page->onUnfull)) {
+        Local* local = static_cast<Local*>(ctx->threadCache);
+        page->onUnfull = true;
+        page->unfullNext = local->unfull;
+        local->unfull = page;
+      }
+      return;
+    }
+    remoteFree(page, ptr);
+  }
+
+  void* memalign(size_t alignment, size_t sz) {
+    if (alignment <= ALLOC8_MIN_ALIGNMENT) {
+      // A multiple of the alignment lands in a class that is one too (with
+      // TinySizeClasses, the 8-byte class is only 8-byte aligned)
+      return malloc(sz <= Classes::kMaxSmallSize ? alignUp(sz, alignment) : sz);
+    }
+    if (alignment <= ALLOC8_PAGE_SIZE) {
+      // Power-of-two classes no larger than a page are naturally aligned,
+      // because pages start on a page boundary.
+      size_t rounded = (sz > alignment) ? sz : alignment;
+      rounded = size_t(1) << log2Floor(rounded * 2 - 1);
+      if (rounded <= ALLOC8_PAGE_SIZE && rounded <= Classes::kMaxSmallSize &&
+          Classes::classToSize(Classes::sizeToClass(rounded)) == rounded) {
+        return malloc(rounded);
+      }
+    }
+    return large_.memalign(alignment, sz);
+  }
+
+  ALLOC8_ALWAYS_INLINE
+  size_t getSize(void* ptr) {
+    Span* span = pageMap().get(ptr);
+    if (ALLOC8_UNLIKELY(span == nullptr || span->owner != owner_)) {
+      return large_.getSize(ptr);
+    }
+    return span->objectSize;
+  }
+
+  /**
+   * Pages currently mapped for small objects (owned, shared or abandoned).
+   */
+  size_t pages() const {
+    return pages_.load(std::memory_order_relaxed);
+  }
+
+  /**
+   * Pages of exited threads waiting to be adopted.
+   */
+  size_t abandonedPages() {
+    std::lock_guard<std::mutex> guard(abandonLock_);
+    return abandonedCount_;
+  }
+
+  void lock() {
+    sharedLock_.lock();
+    abandonLock_.lock();
+    large_.lock();
+    source_.lock();
+  }
+
+  void unlock() {
+    source_.unlock();
+    large_.unlock();
+    abandonLock_.unlock();
+    sharedLock_.unlock();
+  }
+
+  /**
+   * Thread exit: abandon the thread's default-context pages. Fiber
+   * contexts are released with release_context().
+   */
+  void threadCleanup() {
+    AllocContext& ctx = thread_context();
+    if (ctx.heap == this) {
+      release_context(&ctx);
+      ctx.heap = retired();
+    }
+    if constexpr (requires(LargeHeap& h) { h.threadCleanup(); }) {
+      large_.threadCleanup();
+    }
+  }
+
+private:
+  Local shared_{};            // Contexts owned by another layer (sharedLock_)
+  std::mutex sharedLock_;
+  std::mutex abandonLock_;    // Guards abandoned_ and abandonedCount_
+  SpanList abandoned_[Classes::kNumClasses];
+  size_t abandonedCount_ = 0;
+  std::atomic<size_t> pages_{0};
+  LargeHeap large_;
+  PageSource source_;
+  MetadataArena<Page> descriptors_;
+  MetadataArena<Local> locals_;
+  uint16_t owner_;
+
+  ALLOC8_ALWAYS_INLINE
+  Local* localFor(AllocContext* ctx) {
+    if (ALLOC8_LIKELY(ctx->heap == this)) {
+      return static_cast<Local*>(ctx->threadCache);
+    }
+    if (ctx->heap == nullptr) {
+      return attach(ctx);
+    }
+    return nullptr;  // Bound to another layer, or retired
+  }
+
+  ALLOC8_NOINLINE
+  Local* attach(AllocContext* ctx) {
+    Local* local = locals_.allocate();
+    if (!local) {
+      return nullptr;
+    }
+    local->heap = this;
+    ctx->threadCache = local;
+    ctx->release = &releaseLocal;
+    ctx->heap = this;
+    return local;
+  }
+
+  ALLOC8_NOINLINE
+  void* mallocShared(size_t cls) {
+    std::lock_guard<std::mutex> guard(sharedLock_);
+    return mallocSlow(&shared_, cls);
+  }
+
+  // Push onto the page's thread-free list, then notify the owner if the
+  // page was retired as full
+  ALLOC8_NOINLINE
+  void remoteFree(Page* page, void* ptr) {
+    void* head = page->threadFree.load(std::memory_order_relaxed);
+    do {
+      *static_cast<void**>(ptr) = head;
+    } while (!page->threadFree.compare_exchange_weak(head, ptr, std::memory_order_seq_cst,
+                                                     std::memory_order_relaxed));
+    // seq_cst pairs with retire(): either it sees this push, or this load
+    // sees the flag it set
+    uintptr_t state = page->state.load(std::memory_order_seq_cst);
+    if ((state & kDelayed) &&
+        page->state.compare_exchange_strong(state, state & ~kDelayed,
+                                            std::memory_order_acq_rel)) {
+      Local* local = reinterpret_cast<Local*>(state & ~kDelayed);
+      Page* top = local->reclaim.load(std::memory_order_relaxed);
+      do {
+        page->reclaimNext.store(top, std::memory_order_relaxed);
+      } while (!local->reclaim.compare_exchange_weak(top, page, std::memory_order_release,
+                                                     std::memory_order_relaxed));
+    }
+  }
+
+  // Owner: refill the free list from the local and thread free lists
+  static void collect(Page* page) {
+    if (page->free == nullptr) {
+      page->free = page->localFree;
+      page->localFree = nullptr;
+    }
+    if (page->threadFree.load(std::memory_order_relaxed) == nullptr) {
+      return;
+    }
+    void* list = page->threadFree.exchange(nullptr, std::memory_order_acquire);
+    void* tail = list;
+    uint32_t count = 1;
+    while (void* next = *static_cast<void**>(tail)) {
+      tail = next;
+      count++;
+    }
+    *static_cast<void**>(tail) = page->free;
+    page->free = list;
+    page->span.allocated -= count;
+  }
+
+  // Owner: thread never-used slots onto the free list, about one OS page
+  // of objects at a time
+  static void extend(Page* page) {
+    Span& span = page->span;
+    size_t step = ALLOC8_PAGE_SIZE / span.objectSize;
+    size_t count = span.capacity - span.carved;
+    count = count < step ? count : (step ? step : 1);
+    void* head = page->free;
+    for (size_t i = count; i-- > 0;) {
+      void* obj = span.objectAt(span.carved + i);
+      *static_cast<void**>(obj) = head;
+      head = obj;
+    }
+    span.carved += static_cast<uint32_t>(count);
+    page->free = head;
+  }
+
+  // Owner: move pages that got a remote free while retired back into queues
+  static void drainReclaim(Local* local) {
+    if (local->reclaim.load(std::memory_order_relaxed) == nullptr) {
+      return;
+    }
+    Page* page = local->reclaim.exchange(nullptr, std::memory_order_acquire);
+    while (page) {
+      Page* next = page->reclaimNext.load(std::memory_order_relaxed);
+      if (page->inFull) {
+        local->full.remove(&page->span);
+        page->inFull = false;
+        local->queue[page->span.sizeClass].push(&page->span);
+      }
+      page = next;
+    }
+  }
+
+  // Owner: move retired pages it freed into back into queues. A page whose
+  // notification a remote freer already claimed is left for drainReclaim(),
+  // so a page is never on a reclaim stack twice.
+  static void drainUnfull(Local* local) {
+    uintptr_t self = reinterpret_cast<uintptr_t>(local);
+    while (Page* page = local->unfull) {
+      local->unfull = page->unfullNext;
+      page->onUnfull = false;
+      uintptr_t expected = self | kDelayed;
+      if (page->inFull &&
+          page->state.compare_exchange_strong(expected, self, std::memory_order_acq_rel)) {
+        local->full.remove(&page->span);
+        page->inFull = false;
+        local->queue[page->span.sizeClass].push(&page->span);
+      }
+    }
+  }
+
+  // Owner: take a full page out of its queue until a free arrives. Returns
+  // false (with the page back in its queue and refilled) when a remote free
+  // already did.
+  static bool retire(Local* local, Page* page) {
+    local->queue[page->span.sizeClass].remove(&page->span);
+    local->full.push(&page->span);
+    page->inFull = true;
+    uintptr_t self = reinterpret_cast<uintptr_t>(local);
+    page->state.store(self | kDelayed, std::memory_order_seq_cst);
+    if (page->threadFree.load(std::memory_order_seq_cst) == nullptr) {
+      return true;
+    }
+    uintptr_t expected = self | kDelayed;
+    if (!page->state.compare_exchange_strong(expected, self, std::memory_order_acq_rel)) {
+      return true;  // The freer took the notification; the page comes back via reclaim
+    }
+    local->full.remove(&page->span);
+    page->inFull = false;
+    local->queue[page->span.sizeClass].push(&page->span);
+    collect(page);
+    return false;
+  }
+
+  ALLOC8_NOINLINE
+  void* mallocSlow(Local* local, size_t cls) {
+    drainReclaim(local);
+    drainUnfull(local);
+    SpanList& queue = local->queue[cls];
+    // Prefer partly used pages; keep one empty page as a spare and retire
+    // the other empty ones
+    Page* spare = nullptr;
+    Span* span = queue.front();
+    while (span) {
+      Page* page = pageOf(span);
+      Span* next = span->next;
+      collect(page);
+      if (page->span.allocated == 0) {
+        if (spare) {
+          queue.remove(span);
+          releasePage(page);
+        } else {
+          spare = page;
+        }
+      } else {
+        if (page->free == nullptr && page->span.carved < page->span.capacity) {
+          extend(page);
+        }
+        if (page->free || !retire(local, page)) {
+          return popFront(queue, page);
+        }
+      }
+      span = next;
+    }
+    if (spare) {
+      if (spare->free == nullptr) {
+        extend(spare);
+      }
+      return popFront(queue, spare);
+    }
+
+    Page* page = adopt(local, cls);
+    if (!page && !(page = newPage(local, cls))) {
+      return nullptr;
+    }
+    queue.push(&page->span);
+    return pop(page);
+  }
+
+  // Make `page` the class's current page and allocate from it
+  static void* popFront(SpanList& queue, Page* page) {
+    if (&page->span != queue.front()) {
+      queue.remove(&page->span);
+      queue.push(&page->span);
+    }
+    return pop(page);
+  }
+
+  static void* pop(Page* page) {
+    void* obj = page->free;
+    page->free = *static_cast<void**>(obj);
+    page->span.allocated++;
+    return obj;
+  }
+
+  // Take over an abandoned page of class `cls`, if one has room
+  Page* adopt(Local* local, size_t cls) {
+    for (;;) {
+      Page* page;
+      {
+        std::lock_guard<std::mutex> guard(abandonLock_);
+        Span* span = abandoned_[cls].front();
+        if (span == nullptr) {
+          return nullptr;
+        }
+        abandoned_[cls].remove(span);
+        abandonedCount_--;
+        page = pageOf(span);
+      }
+      page->state.store(reinterpret_cast<uintptr_t>(local), std::memory_order_seq_cst);
+      collect(page);
+      if (page->free == nullptr && page->span.carved < page->span.capacity) {
+        extend(page);
+      }
+      if (page->free) {
+        return page;
+      }
+      // Still full: keep it as ours, retired until a remote free arrives
+      local->queue[cls].push(&page->span);
+      if (!retire(local, page)) {
+        local->queue[cls].remove(&page->span);
+        return page;
+      }
+    }
+  }
+
+  Page* newPage(Local* local, size_t cls) {
+    size_t bytes = pageBytes(cls);
+    void* mem = source_.allocPages(bytes / ALLOC8_PAGE_SIZE, ALLOC8_PAGE_SIZE);
+    if (!mem) {
+      return nullptr;
+    }
+    Page* page = descriptors_.allocate();
+    if (!page) {
+      source_.freePages(mem, bytes / ALLOC8_PAGE_SIZE);
+      return nullptr;
+    }
+    Span& span = page->span;
+    span.start = reinterpret_cast<uintptr_t>(mem);
+    span.npages = bytes / ALLOC8_PAGE_SIZE;
+    span.objectSize = Classes::classToSize(cls);
+    span.sizeClass = static_cast<uint32_t>(cls);
+    span.capacity = static_cast<uint32_t>(bytes / span.objectSize);
+    span.owner = owner_;
+    page->state.store(reinterpret_cast<uintptr_t>(local), std::memory_order_relaxed);
+    if (!pageMap().insert(&span)) {
+      descriptors_.deallocate(page);
+      source_.freePages(mem, bytes / ALLOC8_PAGE_SIZE);
+      return nullptr;
+    }
+    pages_.fetch_add(1, std::memory_order_relaxed);
+    extend(page);
+    return page;
+  }
+
+  void releasePage(Page* page) {
+    void* mem = reinterpret_cast<void*>(page->span.start);
+    size_t npages = page->span.npages;
+    pageMap().erase(&page->span);
+    descriptors_.deallocate(page);
+    source_.freePages(mem, npages);
+    pages_.fetch_sub(1, std::memory_order_relaxed);
+  }
+
+  // Owner gone: its pages become ownerless, empty ones are released
+  void abandon(Page* page) {
+    page->inFull = false;
+    page->state.store(0, std::memory_order_seq_cst);
+    collect(page);
+    if (page->span.allocated == 0) {
+      releasePage(page);
+      return;
+    }
+    std::lock_guard<std::mutex> guard(abandonLock_);
+    abandoned_[page->span.sizeClass].push(&page->span);
+    abandonedCount_++;
+  }
+
+  static void releaseLocal(AllocContext* ctx) {
+    Local* local = static_cast<Local*>(ctx->threadCache);
+    ShardedPageHeap* self = local->heap;
+
+    local->unfull = nullptr;  // Every such page is on `full` as well
+
+    // Retired pages: clear the owner unless a remote freer has already
+    // claimed the notification, in which case wait for its reclaim push so
+    // no freer is left holding a pointer to this Local.
+    size_t pending = 0;
+    while (Span* span = local->full.front()) {
+      Page* page = pageOf(span);
+      local->full.remove(span);
+      uintptr_t expected = reinterpret_cast<uintptr_t>(local) | kDelayed;
+      if (page->state.compare_exchange_strong(expected, 0, std::memory_order_acq_rel)) {
+        self->abandon(page);
+      } else {
+        page->inFull = false;
+        pending++;
+      }
+    }
+    while (pending) {
+      Page* page = local->reclaim.exchange(nullptr, std::memory_order_acquire);
+      if (page == nullptr) {
+        std::this_thread::yield();
+        continue;
+      }
+      while (page) {
+        Page* next = page->reclaimNext.load(std::memory_order_relaxed);
+        if (!page->inFull) {
+          self->abandon(page);
+          pending--;
+        }
+        page = next;
+      }
+    }
+
+    for (SpanList& queue : local->queue) {
+      while (Span* span = queue.front()) {
+        queue.remove(span);
+        self->abandon(pageOf(span));
+      }
+    }
+    self->locals_.deallocate(local);
+  }
+};
+
+} // namespace alloc8
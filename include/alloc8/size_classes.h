@@ -0,0 +1,158 @@
+// alloc8/size_classes.h - Compile-time size-class tables
+#pragma once
+
+#include "platform.h"
+#include "os_memory.h"
+#include "span.h"
+#include <cstddef>
+#include <cstdint>
+
+namespace alloc8 {
+
+// ─── SIZE CLASS MAP ───────────────────────────────────────────────────────────
+
+/**
+ * SizeClassMap: Maps request sizes to a small set of object sizes.
+ *
+ * Classes step by ALLOC8_MIN_ALIGNMENT up to 128 bytes, then by quarter
+ * powers of two (160, 192, 224, 256, 320, ...) up to MaxSmallSize, which
+ * bounds internal fragmentation at 25%. Class 0 is reserved to mean
+ * "large" (served by whole spans). All tables are built at compile time.
+ *
+ * With a TinyGranularity of 8, an 8-byte class comes before 16 (8, 16,
+ * 32, 48, ...). Spans start on a page boundary, so every other class still
+ * hands out 16-byte aligned objects; only the 8-byte class is 8-byte
+ * aligned, which is all an object of 8 bytes or less can need. There are
+ * no 24-, 40- or 56-byte classes: a request of that size may hold a
+ * 16-aligned member, and ANSIWrapper rounds it to 16. Pair it with an
+ * ANSIWrapper whose TinyLimit sends 8-byte requests there (see
+ * TinySizeClasses).
+ *
+ * Each class also fixes how many pages its spans hold: at least 16 KB and
+ * room for at least 8 objects, capped at Span::kMaxObjects objects.
+ *
+ * @tparam MaxSmallSize    Largest size served from size-classed spans
+ * @tparam TinyGranularity Smallest class, and class step below kTinyLimit
+ */
+template<size_t MaxSmallSize = 32768, size_t TinyGranularity = ALLOC8_MIN_ALIGNMENT>
+class SizeClassMap {
+  static_assert(MaxSmallSize % ALLOC8_MIN_ALIGNMENT == 0,
+                "MaxSmallSize must be a multiple of the minimum alignment");
+  static_assert(TinyGranularity >= sizeof(void*) &&
+                ALLOC8_MIN_ALIGNMENT % TinyGranularity == 0,
+                "TinyGranularity must divide the minimum alignment");
+
+  static constexpr size_t kGranularity = TinyGranularity;
+  static constexpr size_t kLinearLimit = 128;
+  static constexpr size_t kIndexLength = MaxSmallSize / kGranularity + 1;
+  static constexpr size_t kMinSpanBytes = 16 * 1024;
+  static constexpr size_t kMinObjectsPerSpan = 8;
+
+  // Next class size after `size` (the ladder described above).
+  static constexpr size_t nextSize(size_t size) {
+    if (size < kTinyLimit) {
+      return size + kGranularity;
+    }
+    if (size < kLinearLimit) {
+      return size + ALLOC8_MIN_ALIGNMENT;
+    }
+    return size + (size_t(1) << log2Floor(size)) / 4;
+  }
+
+  static constexpr size_t countClasses() {
+    size_t n = 1;  // class 0 = large
+    for (size_t s = kGranularity; s <= MaxSmallSize; s = nextSize(s)) {
+      n++;
+    }
+    return n;
+  }
+
+public:
+  static constexpr size_t kTinyLimit = ALLOC8_MIN_ALIGNMENT;
+  static constexpr size_t kMaxSmallSize = MaxSmallSize;
+  static constexpr size_t kNumClasses = countClasses();
+
+private:
+  struct Tables {
+    uint32_t size[kNumClasses] = {};
+    uint32_t pages[kNumClasses] = {};
+    uint8_t index[kIndexLength] = {};
+  };
+
+  static_assert(kNumClasses <= 256, "Class index must fit in uint8_t");
+
+  static constexpr Tables buildTables() {
+    Tables t;
+    size_t cls = 1;
+    for (size_t s = kGranularity; s <= MaxSmallSize; s = nextSize(s), cls++) {
+      t.size[cls] = static_cast<uint32_t>(s);
+      size_t bytes = s * kMinObjectsPerSpan;
+      if (bytes < kMinSpanBytes) bytes = kMinSpanBytes;
+      size_t pages = alignUp(bytes, ALLOC8_PAGE_SIZE) / ALLOC8_PAGE_SIZE;
+      while (pages > 1 &&
+             (pages * ALLOC8_PAGE_SIZE) / s > Span::kMaxObjects) {
+        pages--;
+      }
+      t.pages[cls] = static_cast<uint32_t>(pages);
+    }
+    // Index every granule to the smallest class that fits it.
+    cls = 1;
+    for (size_t i = 0; i < kIndexLength; i++) {
+      size_t sz = i * kGranularity;
+      while (t.size[cls] < sz) cls++;
+      t.index[i] = static_cast<uint8_t>(cls);
+    }
+    return t;
+  }
+
+  static constexpr Tables kTables = buildTables();
+
+public:
+  /**
+   * Size class for a request, or 0 if it must be served as a large object.
+   */
+  ALLOC8_ALWAYS_INLINE
+  static constexpr size_t sizeToClass(size_t sz) {
+    if (ALLOC8_UNLIKELY(sz > MaxSmallSize)) {
+      return 0;
+    }
+    return kTables.index[(sz + kGranularity - 1) / kGranularity];
+  }
+
+  /**
+   * Object size for a class (0 for the large class).
+   */
+  ALLOC8_ALWAYS_INLINE
+  static constexpr size_t classToSize(size_t cls) {
+    return kTables.size[cls];
+  }
+
+  /**
+   * Pages per span for a class.
+   */
+  ALLOC8_ALWAYS_INLINE
+  static constexpr size_t classToPages(size_t cls) {
+    return kTables.pages[cls];
+  }
+
+  /**
+   * Objects per span for a class.
+   */
+  ALLOC8_ALWAYS_INLINE
+  static constexpr size_t classCapacity(size_t cls) {
+    return (classToPages(cls) * ALLOC8_PAGE_SIZE) / classToSize(cls);
+  }
+};
+
+/**
+ * Default size-class map used by alloc8 components.
+ */
+using SizeClasses = SizeClassMap<>;
+
+/**
+ * SizeClasses plus an 8-byte class, for heaps wrapped in an ANSIWrapper
+ * with a TinyLimit of 8.
+ */
+using TinySizeClasses = SizeClassMap<32768, 8>;
+
+} // namespace alloc8
@@ -0,0 +1,305 @@
+// alloc8/size_router.h - Compile-time size routing between composed heaps
+#pragma once
+
+#include "platform.h"
+#include "allocator_traits.h"
+#include "page_map.h"
+#include "span.h"
+#include <cstddef>
+#include <cstdint>
+#include <tuple>
+#include <utility>
+
+namespace alloc8 {
+
+// ─── SIZE ROUTER ──────────────────────────────────────────────────────────────
+
+/**
+ * A heap that stamps its page-map spans with an owner id (see
+ * registerOwner()), e.g. SpanHeap or MmapCacheHeap. Layers can route any
+ * pointer to such a heap with one page-map lookup.
+ */
+template<typename H>
+concept OwnedHeap = requires(const H& heap) {
+  { heap.owner() } -> std::convertible_to<uint16_t>;
+};
+
+/**
+ * One tier of a SizeRouterN: requests of at most MaxSize bytes that no
+ * earlier tier took go to Heap.
+ */
+template<size_t MaxSize, typename Heap>
+struct Route {
+  static constexpr size_t kMaxSize = MaxSize;
+  using HeapType = Heap;
+};
+
+/**
+ * SizeRouterN: Composes heaps by request size, alloc8's counterpart to
+ * Heap-Layers' CombineHeap / StrictSegHeap.
+ *
+ * malloc() and memalign() pick a tier with a chain of comparisons against
+ * compile-time thresholds, so the whole path inlines into the chosen heap.
+ * free(), getSize() and resizeInPlace() never re-derive a size: one
+ * page-map lookup yields the span's owner id, which names the tier. Every
+ * tier but the last must therefore be an OwnedHeap. The last tier takes
+ * all larger requests and every pointer no other tier owns, so it may be
+ * any heap.
+ *
+ *   using Tiered = alloc8::ANSIWrapper<alloc8::SizeRouterN<
+ *       alloc8::Route<1024, alloc8::ThreadCache<alloc8::SpanHeap<>>>,
+ *       alloc8::Route<256 * 1024, alloc8::SpanHeap<alloc8::OSPageSource,
+ *                                                  alloc8::SizeClassMap<256 * 1024>>>,
+ *       alloc8::Route<SIZE_MAX, alloc8::MmapCacheHeap<>>>>;
+ *
+ * getSize() of an owned pointer is Span::objectSize, which every page-map
+ * component keeps as the usable size. lock(), iterate(), cacheStats(),
+ * spanSizingStats() and the thread hooks (threadInit() ... threadBusy())
+ * are forwarded to every tier that has them.
+ *
+ * @tparam Routes Route<MaxSize, Heap> tiers, in ascending MaxSize order
+ */
+template<typename... Routes>
+class SizeRouterN {
+  static constexpr size_t kTiers = sizeof...(Routes);
+  static constexpr size_t kMax[] = {Routes::kMaxSize...};
+
+  static constexpr bool ascending() {
+    for (size_t i = 1; i < kTiers; i++) {
+      if (kMax[i] <= kMax[i - 1]) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  template<size_t... I>
+  static constexpr bool ownedBeforeLast(std::index_sequence<I...>) {
+    return (OwnedHeap<std::tuple_element_t<I, std::tuple<typename Routes::HeapType...>>> && ...);
+  }
+
+  static_assert(kTiers >= 2, "A router needs at least two tiers");
+  static_assert(ascending(), "Route thresholds must be strictly ascending");
+  static_assert(ownedBeforeLast(std::make_index_sequence<kTiers - 1>()),
+                "Every tier but the last must stamp an owner id (OwnedHeap)");
+
+  std::tuple<typename Routes::HeapType...> heaps_;
+
+public:
+  /**
+   * The heap serving tier `I`.
+   */
+  template<size_t I>
+  auto& tier() {
+    return std::get<I>(heaps_);
+  }
+
+  ALLOC8_ALWAYS_INLINE
+  void* malloc(size_t sz) {
+    return mallocFrom<0>(sz);
+  }
+
+  ALLOC8_ALWAYS_INLINE
+  void free(void* ptr) {
+    Span* span = pageMap().get(ptr);
+    freeFrom<0>(ptr, span ? span->owner : 0);
+  }
+
+  ALLOC8_ALWAYS_INLINE
+  size_t getSize(void* ptr) {
+    Span* span = pageMap().get(ptr);
+    return sizeFrom<0>(ptr, span);
+  }
+
+  void* memalign(size_t alignment, size_t sz) {
+    return memalignFrom<0>(alignment, sz);
+  }
+
+  /**
+   * Grow `ptr` in place if its tier supports it (see SpanHeap).
+   */
+  bool resizeInPlace(void* ptr, size_t sz) {
+    Span* span = pageMap().get(ptr);
+    return resizeFrom<0>(ptr, sz, span ? span->owner : 0);
+  }
+
+  void lock() {
+    std::apply([](auto&... heap) { (heap.lock(), ...); }, heaps_);
+  }
+
+  void unlock() {
+    unlockFrom<kTiers - 1>();
+  }
+
+  void iterate(IterateCallback cb, void* ctx) {
+    std::apply([&](auto&... heap) {
+      ([&](auto& h) {
+        if constexpr (requires { h.iterate(cb, ctx); }) {
+          h.iterate(cb, ctx);
+        }
+      }(heap), ...);
+    }, heaps_);
+  }
+
+  void cacheStats(CacheStatsCallback cb, void* ctx) {
+    std::apply([&](auto&... heap) {
+      ([&](auto& h) {
+        if constexpr (requires { h.cacheStats(cb, ctx); }) {
+          h.cacheStats(cb, ctx);
+        }
+      }(heap), ...);
+    }, heaps_);
+  }
+
+  void spanSizingStats(SpanSizingStatsCallback cb, void* ctx) {
+    std::apply([&](auto&... heap) {
+      ([&](auto& h) {
+        if constexpr (requires { h.spanSizingStats(cb, ctx); }) {
+          h.spanSizingStats(cb, ctx);
+        }
+      }(heap), ...);
+    }, heaps_);
+  }
+
+  void threadInit() {
+    std::apply([](auto&... heap) {
+      ([](auto& h) {
+        if constexpr (requires { h.threadInit(); }) {
+          h.threadInit();
+        }
+      }(heap), ...);
+    }, heaps_);
+  }
+
+  void threadCleanup() {
+    std::apply([](auto&... heap) {
+      ([](auto& h) {
+        if constexpr (requires { h.threadCleanup(); }) {
+          h.threadCleanup();
+        }
+      }(heap), ...);
+    }, heaps_);
+  }
+
+  void threadIdle() {
+    std::apply([](auto&... heap) {
+      ([](auto& h) {
+        if constexpr (requires { h.threadIdle(); }) {
+          h.threadIdle();
+        }
+      }(heap), ...);
+    }, heaps_);
+  }
+
+  void threadBusy() {
+    std::apply([](auto&... heap) {
+      ([](auto& h) {
+        if constexpr (requires { h.threadBusy(); }) {
+          h.threadBusy();
+        }
+      }(heap), ...);
+    }, heaps_);
+  }
+
+private:
+  template<size_t I>
+  static constexpr bool isLast = (I + 1 == kTiers);
+
+  template<size_t I>
+  ALLOC8_ALWAYS_INLINE void* mallocFrom(size_t sz) {
+    if constexpr (isLast<I>) {
+      return std::get<I>(heaps_).malloc(sz);
+    } else {
+      if (sz <= kMax[I]) {
+        return std::get<I>(heaps_).malloc(sz);
+      }
+      return mallocFrom<I + 1>(sz);
+    }
+  }
+
+  template<size_t I>
+  ALLOC8_ALWAYS_INLINE void* memalignFrom(size_t alignment, size_t sz) {
+    if constexpr (isLast<I>) {
+      return std::get<I>(heaps_).memalign(alignment, sz);
+    } else {
+      if (sz <= kMax[I]) {
+        return std::get<I>(heaps_).memalign(alignment, sz);
+      }
+      return memalignFrom<I + 1>(alignment, sz);
+    }
+  }
+
+  template<size_t I>
+  ALLOC8_ALWAYS_INLINE void freeFrom(void* ptr, uint16_t owner) {
+    auto& heap = std::get<I>(heaps_);
+    if constexpr (isLast<I>) {
+      heap.free(ptr);
+    } else {
+      if (owner == heap.owner()) {
+        heap.free(ptr);
+        return;
+      }
+      freeFrom<I + 1>(ptr, owner);
+    }
+  }
+
+  template<size_t I>
+  ALLOC8_ALWAYS_INLINE size_t sizeFrom(void* ptr, Span* span) {
+    auto& heap = std::get<I>(heaps_);
+    if constexpr (isLast<I>) {
+      if constexpr (OwnedHeap<std::remove_reference_t<decltype(heap)>>) {
+        return (span && span->owner == heap.owner()) ? span->objectSize : 0;
+      } else {
+        return heap.getSize(ptr);
+      }
+    } else {
+      if (span && span->owner == heap.owner()) {
+        return span->objectSize;
+      }
+      return sizeFrom<I + 1>(ptr, span);
+    }
+  }
+
+  template<size_t I>
+  bool resizeFrom(void* ptr, size_t sz, uint16_t owner) {
+    auto& heap = std::get<I>(heaps_);
+    bool mine;
+    if constexpr (isLast<I>) {
+      mine = true;
+    } else {
+      mine = (owner == heap.owner());
+    }
+    if (mine) {
+      if constexpr (requires { heap.resizeInPlace(ptr, sz); }) {
+        return heap.resizeInPlace(ptr, sz);
+      } else {
+        return false;
+      }
+    }
+    if constexpr (!isLast<I>) {
+      return resizeFrom<I + 1>(ptr, sz, owner);
+    } else {
+      return false;
+    }
+  }
+
+  template<size_t I>
+  void unlockFrom() {
+    std::get<I>(heaps_).unlock();
+    if constexpr (I > 0) {
+      unlockFrom<I - 1>();
+    }
+  }
+};
+
+/**
+ * SizeRouter: Two-way SizeRouterN. Requests of at most Threshold bytes go
+ * to Small (which must be an OwnedHeap), everything else to Large.
+ *
+ *   using Heap = alloc8::SizeRouter<32 * 1024, alloc8::SpanHeap<>,
+ *                                   alloc8::MmapCacheHeap<>>;
+ */
+template<size_t Threshold, typename Small, typename Large>
+using SizeRouter = SizeRouterN<Route<Threshold, Small>, Route<SIZE_MAX, Large>>;
+
+} // namespace alloc8
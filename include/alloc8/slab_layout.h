@@ -0,0 +1,245 @@
+// alloc8/slab_layout.h - Where span components keep their free-slot state
+#pragma once
+
+#include "platform.h"
+#include "metadata.h"
+#include "os_memory.h"
+#include "span.h"
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+
+namespace alloc8 {
+
+// ─── SLAB LAYOUT INTERFACE ────────────────────────────────────────────────────
+//
+// A slab layout decides how a small-object span records which slots are
+// free. Span components (e.g. SpanHeap) take the layout as a template
+// parameter and call it with the span's lock held:
+//
+//   bool  attach(Span* span)            // span created; set up metadata
+//   void  detach(Span* span)            // span about to be released
+//   void* pop(Span* span)               // take a free slot (span not full)
+//   void  push(Span* span, void* ptr)   // return a slot
+//   void  sortFree(Span* span)          // make pop() go in address order
+//
+// Both layouts below keep Span::forEachLive() (and so heap iteration)
+// working. Neither calls sortFree() on its own; wrap a layout in
+// AddressOrderedRefill to have batch refills use it.
+
+namespace detail {
+
+// Mark each returned slot of `span` in `bits` (Span::kMaxObjects wide)
+inline void markFreeSlots(const Span* span, uint64_t* bits) {
+  if (span->freeIndex) {
+    for (uint32_t i = 0; i < span->freeCount; i++) {
+      size_t index = span->freeIndex[i];
+      bits[index / 64] |= uint64_t(1) << (index % 64);
+    }
+  }
+  for (void* obj = span->freeList; obj; obj = *static_cast<void**>(obj)) {
+    size_t index = span->indexOf(obj);
+    bits[index / 64] |= uint64_t(1) << (index % 64);
+  }
+}
+
+// Call visit(index) for every set bit below `limit`, lowest first
+template<typename Visitor>
+inline void forEachSetBit(const uint64_t* bits, size_t limit, Visitor&& visit) {
+  for (size_t word = 0; word * 64 < limit; word++) {
+    for (uint64_t m = bits[word]; m; m &= m - 1) {
+      visit(word * 64 + static_cast<size_t>(std::countr_zero(m)));
+    }
+  }
+}
+
+} // namespace detail
+
+/**
+ * InBandFreeList: Classic intrusive free list.
+ *
+ * Freed objects store the next-pointer in their first word. No metadata
+ * beyond the Span descriptor, but every free() writes to the object's page.
+ */
+class InBandFreeList {
+public:
+  bool attach(Span*) { return true; }
+  void detach(Span*) {}
+
+  ALLOC8_ALWAYS_INLINE
+  void* pop(Span* span) {
+    if (span->freeList) {
+      void* obj = span->freeList;
+      span->freeList = *static_cast<void**>(obj);
+      return obj;
+    }
+    return span->objectAt(span->carved++);
+  }
+
+  ALLOC8_ALWAYS_INLINE
+  void push(Span* span, void* ptr) {
+    *static_cast<void**>(ptr) = span->freeList;
+    span->freeList = ptr;
+  }
+
+  /**
+   * Relink the free list in ascending address order: mark every listed
+   * slot in a bitmap, then rebuild the list by scanning it. Rewrites the
+   * link word of every free object.
+   */
+  void sortFree(Span* span) {
+    if (span->freeList == nullptr) {
+      return;
+    }
+    uint64_t bits[Span::kMaxObjects / 64] = {};
+    detail::markFreeSlots(span, bits);
+    void** tail = &span->freeList;
+    detail::forEachSetBit(bits, span->carved, [&](size_t index) {
+      void* obj = span->objectAt(index);
+      *tail = obj;
+      tail = static_cast<void**>(obj);
+    });
+    *tail = nullptr;
+  }
+};
+
+/**
+ * OutOfBandSlab: Free-slot state kept entirely outside object memory.
+ *
+ * Each span gets a stack of free slot indices (and, optionally, per-page
+ * live counts) from a MetadataRegion, reached via pageMap() -> Span. A
+ * free() therefore never writes to the object's page, which:
+ *  - keeps pages shared after fork() when a child frees inherited objects,
+ *    instead of triggering a copy-on-write fault per freed object;
+ *  - lets fully-free pages inside partially used spans be returned to the
+ *    OS without the allocator re-dirtying them.
+ *
+ * @tparam ReleaseEmptyPages When true, a page whose last live object is
+ *         freed is returned to the OS immediately (osDecommit). Costs one
+ *         madvise per emptied page; POSIX only (ignored on Windows, where
+ *         decommitted pages would need re-committing before reuse).
+ */
+template<bool ReleaseEmptyPages = false>
+class OutOfBandSlab {
+  static constexpr bool kReleasePages =
+#if defined(ALLOC8_WINDOWS)
+    false;
+#else
+    ReleaseEmptyPages;
+#endif
+
+  MetadataRegion meta_;
+
+  static size_t metadataBytes(const Span* span) {
+    size_t bytes = span->capacity * sizeof(uint16_t);
+    if constexpr (kReleasePages) {
+      bytes += span->npages * sizeof(uint16_t);
+    }
+    return bytes;
+  }
+
+  // First and last page index (within the span) touched by an object.
+  static void pageRange(const Span* span, const void* obj,
+                        size_t& first, size_t& last) {
+    uintptr_t offset = reinterpret_cast<uintptr_t>(obj) - span->start;
+    first = offset / ALLOC8_PAGE_SIZE;
+    last = (offset + span->objectSize - 1) / ALLOC8_PAGE_SIZE;
+  }
+
+public:
+  bool attach(Span* span) {
+    auto* mem = static_cast<uint16_t*>(meta_.allocate(metadataBytes(span)));
+    if (!mem) {
+      return false;
+    }
+    span->freeIndex = mem;
+    span->freeCount = 0;
+    if constexpr (kReleasePages) {
+      span->pageLive = mem + span->capacity;
+    }
+    return true;
+  }
+
+  void detach(Span* span) {
+    meta_.deallocate(span->freeIndex, metadataBytes(span));
+    span->freeIndex = nullptr;
+    span->pageLive = nullptr;
+  }
+
+  ALLOC8_ALWAYS_INLINE
+  void* pop(Span* span) {
+    size_t index = span->freeCount
+                   ? span->freeIndex[--span->freeCount]
+                   : span->carved++;
+    void* obj = span->objectAt(index);
+    if constexpr (kReleasePages) {
+      size_t first, last;
+      pageRange(span, obj, first, last);
+      for (size_t p = first; p <= last; p++) {
+        span->pageLive[p]++;
+      }
+    }
+    return obj;
+  }
+
+  ALLOC8_ALWAYS_INLINE
+  void push(Span* span, void* ptr) {
+    span->freeIndex[span->freeCount++] = static_cast<uint16_t>(span->indexOf(ptr));
+    if constexpr (kReleasePages) {
+      size_t first, last;
+      pageRange(span, ptr, first, last);
+      for (size_t p = first; p <= last; p++) {
+        if (--span->pageLive[p] == 0) {
+          osDecommit(reinterpret_cast<void*>(span->start + p * ALLOC8_PAGE_SIZE),
+                     ALLOC8_PAGE_SIZE);
+        }
+      }
+    }
+  }
+
+  /**
+   * Reorder the index stack so the lowest free slot is on top. Touches
+   * only metadata, never object pages.
+   */
+  void sortFree(Span* span) {
+    if (span->freeCount < 2) {
+      return;
+    }
+    uint64_t bits[Span::kMaxObjects / 64] = {};
+    detail::markFreeSlots(span, bits);
+    uint32_t top = span->freeCount;
+    detail::forEachSetBit(bits, span->carved, [&](size_t index) {
+      span->freeIndex[--top] = static_cast<uint16_t>(index);
+    });
+  }
+};
+
+// ─── ADDRESS-ORDERED REFILL ───────────────────────────────────────────────────
+
+/**
+ * AddressOrderedRefill: Hand out each span's free slots lowest address first
+ * when refilling in batches.
+ *
+ * A long-running heap returns slots in LIFO free order, so consecutive
+ * allocations land all over a span (and then all over many pages). With
+ * this wrapper, SpanHeap::mallocBatch() calls prepareBatch() on each span
+ * it draws from, which sorts the span's free slots. Objects handed out
+ * together are then adjacent in memory, and a structure built from them
+ * (a list, a tree level) is walked with fewer cache and TLB misses. The
+ * sort costs O(capacity / 64 + free slots) per span per batch. Single-object
+ * malloc() is unaffected.
+ *
+ *   using Heap = alloc8::SpanHeap<alloc8::OSPageSource, alloc8::SizeClasses,
+ *                                 alloc8::AddressOrderedRefill<alloc8::InBandFreeList>>;
+ *
+ * @tparam Layout Underlying slab layout (must provide sortFree())
+ */
+template<typename Layout>
+class AddressOrderedRefill : public Layout {
+public:
+  void prepareBatch(Span* span) {
+    Layout::sortFree(span);
+  }
+};
+
+} // namespace alloc8
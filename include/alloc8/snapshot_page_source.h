@@ -0,0 +1,611 @@
+// alloc8/snapshot_page_source.h - memfd-backed pages with fork-free snapshots
+#pragma once
+
+#include "platform.h"
+#include "os_memory.h"
+#include <atomic>
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+
+#if defined(ALLOC8_LINUX)
+#include <fcntl.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+extern "C" {
+/**
+ * A read-only, point-in-time copy of a SnapshotPageSource's pages (see
+ * alloc8_snapshot). `data` holds the `bytes` bytes that started at `heap`
+ * when the snapshot was taken: a heap pointer p reads as
+ * data + (p - heap).
+ */
+typedef struct alloc8_snapshot_view {
+  const char* data;  // Read-only view, nullptr if there is none
+  const char* heap;  // Live address of data[0]
+  size_t bytes;      // Pages the heap had handed out, in bytes
+} alloc8_snapshot_view;
+}
+
+namespace alloc8 {
+
+using SnapshotView = alloc8_snapshot_view;
+
+/**
+ * Snapshot of a SnapshotPageSource (see SnapshotPageSource::stats()).
+ */
+struct SnapshotStats {
+  size_t heapBytes;       // Pages handed out at least once (what a view covers)
+  size_t snapshots;       // Views taken so far
+  size_t mergedBytes;     // Pages copied back to the file by merges, in total
+  size_t lastMergeBytes;  // ... by the last merge
+  bool open;              // A view is out or not yet merged back
+};
+
+// ─── SNAPSHOT PAGE SOURCE ─────────────────────────────────────────────────────
+
+/**
+ * SnapshotPageSource: A PageSource whose pages live in one memfd, so the
+ * heap can be snapshotted for a background save without fork().
+ *
+ * fork() gives a Redis-style save a consistent image of memory, but it
+ * copies the page tables of the whole process (tens of milliseconds for a
+ * multi-GB heap, with the caller stopped) and then copies every page
+ * either side writes while the child runs. This source maps its region
+ * from a memfd and gets the same copy-on-write image from the kernel by
+ * remapping:
+ *
+ * - Between snapshots the heap maps the file MAP_SHARED, so writes go
+ *   straight to the file.
+ * - snapshot() maps the file read-only elsewhere as the view, moves the
+ *   heap's page tables aside with mremap(MREMAP_DONTUNMAP) and maps the
+ *   file MAP_PRIVATE over the heap's address, which stays mapped the whole
+ *   time. From then on the heap's writes land on private copies of the
+ *   pages they touch and the file, which is the snapshot, no longer
+ *   changes. The heap is 2 MiB aligned, so the kernel moves whole page
+ *   tables: the call takes microseconds whatever the heap's size, and
+ *   both mappings fault pages back in from the file as they are touched.
+ * - release() unmaps the view and the old page tables; any thread may
+ *   call it.
+ * - merge() writes the pages the heap copied back into the file (it finds
+ *   them in /proc/self/pagemap) and remaps the heap MAP_SHARED. The next
+ *   snapshot() merges first if it has to.
+ *
+ * The view is mapped PROT_READ, so a write through it faults instead of
+ * changing the heap. merge() costs a pagemap scan and a copy of the pages
+ * written since the snapshot, so the pause moves from the start of the
+ * save, where fork() pays for the heap's size, to the end, where it is
+ * paid for what changed. Other threads may read the heap throughout. Like
+ * fork(), the image is consistent only if no other thread is writing heap
+ * memory at that moment, so call both where fork() would have been
+ * called (the main loop of an event-driven server). merge() additionally
+ * loses writes other threads make while it runs: it needs that quiet
+ * point, not just a consistent one.
+ *
+ *   static alloc8::ANSIWrapper<alloc8::ThreadCache<
+ *       alloc8::SpanHeap<alloc8::SnapshotPageSource<>>>> heap;
+ *
+ *   auto& pages = heap.pageSource();
+ *   alloc8::SnapshotView view;
+ *   if (pages.snapshot(&view) == 0) {
+ *     std::thread([&pages, view]() mutable {
+ *       save(view);
+ *       pages.release(&view);
+ *     }).detach();
+ *   }
+ *   ...
+ *   pages.merge();  // Back in the main loop, once the save is done
+ *
+ * Runs are allocated first-fit from the region, lowest address first.
+ * Freed runs are punched out of the file (returned to the OS) between
+ * snapshots, and kept while a snapshot is open since the view may still
+ * show them. A forked child gets a private copy-on-write mapping of the
+ * file, so it never writes into the parent's heap; it should exec soon,
+ * as the parent's later writes show through pages the child has not
+ * written.
+ *
+ * Linux only: elsewhere the region is ordinary anonymous memory and
+ * snapshot() returns -ENOSYS.
+ *
+ * @tparam RegionBytes Address space and file size reserved up front
+ *                     (sparse: only used pages take memory)
+ */
+template<size_t RegionBytes = size_t(16) << 30>
+class SnapshotPageSource {
+  static_assert(RegionBytes % ALLOC8_PAGE_SIZE == 0 && RegionBytes > 0,
+                "The region must be whole pages");
+
+  static constexpr size_t kPages = RegionBytes / ALLOC8_PAGE_SIZE;
+
+  // Heap mapping of the file
+  static constexpr int kShared = 0;    // MAP_SHARED: no snapshot
+  static constexpr int kOpen = 1;      // MAP_PRIVATE, view out
+  static constexpr int kReleased = 2;  // MAP_PRIVATE, view released
+  static constexpr int kForked = 3;    // In a forked child: file not ours
+
+  std::mutex lock_;
+  char* base_ = nullptr;
+  int fd_ = -1;
+  std::atomic<int> state_{kShared};
+  const char* view_ = nullptr;
+  size_t viewBytes_ = 0;
+  char* stale_ = nullptr;  // The heap's page tables from before the snapshot
+  size_t staleBytes_ = 0;
+  size_t firstFree_ = 0;  // No free page below this one
+  size_t highWater_ = 0;  // No page at or above this one was ever used
+  size_t snapshots_ = 0;
+  size_t mergedBytes_ = 0;
+  size_t lastMergeBytes_ = 0;
+  uint64_t used_[(kPages + 63) / 64] = {};
+
+  bool isUsed(size_t page) const {
+    return used_[page / 64] & (uint64_t(1) << (page % 64));
+  }
+
+  size_t alignPage(size_t page, size_t alignment) const {
+    uintptr_t b = reinterpret_cast<uintptr_t>(base_);
+    return (alignUp(b + page * ALLOC8_PAGE_SIZE, alignment) - b) / ALLOC8_PAGE_SIZE;
+  }
+
+  void mark(size_t first, size_t npages, bool used) {
+    for (size_t p = first; p < first + npages; p++) {
+      if (used) {
+        used_[p / 64] |= uint64_t(1) << (p % 64);
+      } else {
+        used_[p / 64] &= ~(uint64_t(1) << (p % 64));
+      }
+    }
+  }
+
+public:
+  static constexpr size_t kRegionBytes = RegionBytes;
+
+  SnapshotPageSource() {
+#if defined(ALLOC8_LINUX)
+    fd_ = memfd_create("alloc8-heap", MFD_CLOEXEC);
+    if (fd_ >= 0 && ftruncate(fd_, RegionBytes) == 0) {
+      base_ = reserveAligned(RegionBytes);
+      if (base_ && !mapHeapLocked(MAP_SHARED)) {
+        osUnmap(base_, RegionBytes);
+        base_ = nullptr;
+      }
+    }
+    if (base_) {
+      registerForFork(this);
+    }
+#else
+    base_ = static_cast<char*>(osMap(RegionBytes));
+#endif
+  }
+
+  SnapshotPageSource(const SnapshotPageSource&) = delete;
+  SnapshotPageSource& operator=(const SnapshotPageSource&) = delete;
+
+  ~SnapshotPageSource() {
+#if defined(ALLOC8_LINUX)
+    if (base_) {
+      unregisterForFork(this);
+    }
+    if (view_) {
+      munmap(const_cast<char*>(view_), viewBytes_);
+    }
+    if (stale_) {
+      munmap(stale_, staleBytes_);
+    }
+    if (fd_ >= 0) {
+      close(fd_);
+    }
+#endif
+    if (base_) {
+      osUnmap(base_, RegionBytes);
+    }
+  }
+
+  /**
+   * Start of the region, or nullptr if it could not be mapped.
+   */
+  char* base() const { return base_; }
+
+  bool contains(const void* ptr) const {
+    auto p = reinterpret_cast<uintptr_t>(ptr);
+    auto b = reinterpret_cast<uintptr_t>(base_);
+    return base_ && p >= b && p < b + RegionBytes;
+  }
+
+  void* allocPages(size_t npages, size_t alignment = ALLOC8_PAGE_SIZE) {
+    if (!base_ || npages == 0 || npages > kPages) {
+      return nullptr;
+    }
+    std::lock_guard<std::mutex> guard(lock_);
+    size_t page = alignPage(firstFree_, alignment);
+    while (page + npages <= kPages) {
+      if (page % 64 == 0 && used_[page / 64] == ~uint64_t(0)) {
+        page = alignPage(page + 64, alignment);  // Skip full words
+        continue;
+      }
+      size_t run = 0;
+      while (run < npages && !isUsed(page + run)) {
+        run++;
+      }
+      if (run == npages) {
+        mark(page, npages, true);
+        if (page == firstFree_) {
+          firstFree_ = page + npages;
+        }
+        if (page + npages > highWater_) {
+          highWater_ = page + npages;
+        }
+        return base_ + page * ALLOC8_PAGE_SIZE;
+      }
+      page = alignPage(page + run + 1, alignment);
+    }
+    return nullptr;
+  }
+
+  void freePages(void* ptr, size_t npages) {
+    size_t first = (static_cast<char*>(ptr) - base_) / ALLOC8_PAGE_SIZE;
+    std::lock_guard<std::mutex> guard(lock_);
+    mark(first, npages, false);
+    if (first < firstFree_) {
+      firstFree_ = first;
+    }
+#if defined(ALLOC8_LINUX)
+    if (state_.load(std::memory_order_relaxed) == kShared) {
+      // Drops the pages from the file and from the heap's mapping
+      fallocate(fd_, FALLOC_FL_PUNCH_HOLE | FALLOC_FL_KEEP_SIZE,
+                static_cast<off_t>(first * ALLOC8_PAGE_SIZE),
+                static_cast<off_t>(npages * ALLOC8_PAGE_SIZE));
+    }
+#endif
+  }
+
+  /**
+   * Freeze the heap's pages and map them read-only into `out`.
+   *
+   * Merges the previous snapshot first if it was released. Call where no
+   * other thread writes heap memory (see the class comment); readers may
+   * carry on.
+   *
+   * @return 0, -EBUSY while the previous view is still out, -EPERM in a
+   *         forked child, or -errno
+   */
+  int snapshot(SnapshotView* out) {
+    *out = SnapshotView{nullptr, base_, 0};
+#if defined(ALLOC8_LINUX)
+    if (!base_) {
+      return -ENOMEM;
+    }
+    std::lock_guard<std::mutex> guard(lock_);
+    int state = state_.load(std::memory_order_acquire);
+    if (state == kOpen || state == kForked) {
+      return state == kOpen ? -EBUSY : -EPERM;
+    }
+    if (state == kReleased) {
+      int rc = mergeLocked();
+      if (rc != 0) {
+        return rc;
+      }
+    }
+    // Map the file read-only as the view and the heap MAP_PRIVATE over its
+    // shared mapping. The heap's addresses stay mapped throughout, so other
+    // threads may keep reading it.
+    size_t bytes = highWater_ * ALLOC8_PAGE_SIZE;
+    size_t viewBytes = bytes ? bytes : ALLOC8_PAGE_SIZE;
+    void* view = mmap(nullptr, viewBytes, PROT_READ, MAP_SHARED | MAP_NORESERVE, fd_, 0);
+    if (view == MAP_FAILED) {
+      return -errno;
+    }
+    char* stale = bytes ? moveTablesAsideLocked(bytes) : nullptr;
+    if (!mapHeapLocked(MAP_PRIVATE)) {
+      int rc = -errno;
+      munmap(view, viewBytes);
+      if (stale) {
+        munmap(stale, bytes);
+      }
+      return rc;
+    }
+    stale_ = stale;
+    staleBytes_ = stale ? bytes : 0;
+    view_ = static_cast<const char*>(view);
+    viewBytes_ = viewBytes;
+    snapshots_++;
+    state_.store(kOpen, std::memory_order_release);
+    *out = SnapshotView{view_, base_, bytes};
+    return 0;
+#else
+    return -ENOSYS;
+#endif
+  }
+
+  /**
+   * Unmap a view returned by snapshot(). Any thread may call this.
+   */
+  void release(SnapshotView* view) {
+#if defined(ALLOC8_LINUX)
+    char* mapped = nullptr;
+    size_t bytes = 0;
+    char* stale = nullptr;
+    size_t staleBytes = 0;
+    {
+      std::lock_guard<std::mutex> guard(lock_);
+      if (view->data && view->data == view_) {
+        mapped = const_cast<char*>(view_);
+        bytes = viewBytes_;
+        stale = stale_;
+        staleBytes = staleBytes_;
+        view_ = nullptr;
+        stale_ = nullptr;
+        state_.store(kReleased, std::memory_order_release);
+      }
+    }
+    // Unmapped without the lock: tearing down a large mapping takes a while
+    if (mapped) {
+      munmap(mapped, bytes);
+    }
+    if (stale) {
+      munmap(stale, staleBytes);
+    }
+#endif
+    view->data = nullptr;
+  }
+
+  /**
+   * Copy the pages written since the last snapshot back into the file and
+   * map the heap MAP_SHARED again, which frees the copies and stops further
+   * copy-on-write faults. Call where no other thread writes heap memory.
+   *
+   * Runs freed while the snapshot was open are punched out of the file.
+   *
+   * @return 0 (also when there is nothing to merge), -EBUSY while a view is
+   *         out, or -errno
+   */
+  int merge() {
+#if defined(ALLOC8_LINUX)
+    std::lock_guard<std::mutex> guard(lock_);
+    int state = state_.load(std::memory_order_acquire);
+    if (state != kReleased) {
+      return state == kOpen ? -EBUSY : state == kForked ? -EPERM : 0;
+    }
+    return mergeLocked();
+#else
+    return 0;
+#endif
+  }
+
+  SnapshotStats stats() {
+    std::lock_guard<std::mutex> guard(lock_);
+    SnapshotStats s;
+    s.heapBytes = highWater_ * ALLOC8_PAGE_SIZE;
+    s.snapshots = snapshots_;
+    s.mergedBytes = mergedBytes_;
+    s.lastMergeBytes = lastMergeBytes_;
+    s.open = state_.load(std::memory_order_relaxed) != kShared;
+    return s;
+  }
+
+  void lock() { lock_.lock(); }
+  void unlock() { lock_.unlock(); }
+
+private:
+#if defined(ALLOC8_LINUX)
+  static constexpr uint64_t kPagePresent = uint64_t(1) << 63;
+  static constexpr uint64_t kPageSwapped = uint64_t(1) << 62;
+  static constexpr uint64_t kPageFile = uint64_t(1) << 61;
+
+  int mergeLocked() {
+    int rc = writeBackLocked();
+    if (rc != 0) {
+      return rc;
+    }
+    if (!mapHeapLocked(MAP_SHARED)) {
+      return -errno;
+    }
+    state_.store(kShared, std::memory_order_release);
+    punchFreeLocked();
+    return 0;
+  }
+
+  // Address space aligned to a page-table page (2 MiB), so mremap() between
+  // two such ranges moves whole page tables instead of single entries
+  static char* reserveAligned(size_t bytes) {
+    constexpr size_t kTableSpan = size_t(2) << 20;
+    char* raw = static_cast<char*>(osReserve(bytes + kTableSpan));
+    if (!raw) {
+      return nullptr;
+    }
+    char* aligned = reinterpret_cast<char*>(alignUp(reinterpret_cast<uintptr_t>(raw), kTableSpan));
+    if (aligned != raw) {
+      osUnmap(raw, aligned - raw);
+    }
+    osUnmap(aligned + bytes, raw + kTableSpan - aligned);
+    return aligned;
+  }
+
+  // Mapping over the heap drops every page-table entry it has, which for a
+  // large resident heap costs more than fork(). Move the entries to a
+  // scratch range first (microseconds: whole tables move) and leave the
+  // heap mapped but empty, so readers fault pages back in from the file;
+  // release() unmaps the scratch range off the caller's path. Returns
+  // nullptr, and the caller pays for the drop, on kernels before 5.13.
+  char* moveTablesAsideLocked(size_t bytes) {
+    char* stale = reserveAligned(bytes);
+    if (stale && mremap(base_, bytes, bytes, MREMAP_MAYMOVE | MREMAP_FIXED | MREMAP_DONTUNMAP,
+                        stale) == MAP_FAILED) {
+      osUnmap(stale, bytes);
+      stale = nullptr;
+    }
+    return stale;
+  }
+
+  bool mapHeapLocked(int flags) {
+    void* p = mmap(base_, RegionBytes, PROT_READ | PROT_WRITE,
+                   flags | MAP_FIXED | MAP_NORESERVE, fd_, 0);
+    return p != MAP_FAILED;
+  }
+
+  // Write the heap's private copies of used pages (present pages that are
+  // not the file's, and swapped ones) back into the file. A clean page
+  // written back by mistake costs a copy; a dirty page missed would be
+  // lost, so anything swapped counts as dirty.
+  int writeBackLocked() {
+    int pagemap = open("/proc/self/pagemap", O_RDONLY | O_CLOEXEC);
+    if (pagemap < 0) {
+      return -errno;
+    }
+    constexpr size_t kBatch = 512;
+    uint64_t entries[kBatch];
+    size_t first = reinterpret_cast<uintptr_t>(base_) / ALLOC8_PAGE_SIZE;
+    size_t runStart = 0;
+    size_t runLength = 0;
+    size_t written = 0;
+    int rc = 0;
+    for (size_t page = 0; page < highWater_ && rc == 0; page += kBatch) {
+      size_t n = highWater_ - page < kBatch ? highWater_ - page : kBatch;
+      ssize_t got = pread(pagemap, entries, n * sizeof(uint64_t),
+                          static_cast<off_t>((first + page) * sizeof(uint64_t)));
+      if (got != static_cast<ssize_t>(n * sizeof(uint64_t))) {
+        rc = got < 0 ? -errno : -EIO;
+        break;
+      }
+      for (size_t i = 0; i < n; i++) {
+        uint64_t e = entries[i];
+        bool dirty = isUsed(page + i) &&
+                     ((e & kPageSwapped) || ((e & kPagePresent) && !(e & kPageFile)));
+        if (dirty && runLength != 0 && runStart + runLength == page + i) {
+          runLength++;
+          continue;
+        }
+        if (runLength != 0) {
+          rc = writeRun(runStart, runLength);
+          written += runLength;
+          runLength = 0;
+          if (rc != 0) {
+            break;
+          }
+        }
+        if (dirty) {
+          runStart = page + i;
+          runLength = 1;
+        }
+      }
+    }
+    if (rc == 0 && runLength != 0) {
+      rc = writeRun(runStart, runLength);
+      written += runLength;
+    }
+    close(pagemap);
+    lastMergeBytes_ = written * ALLOC8_PAGE_SIZE;
+    mergedBytes_ += lastMergeBytes_;
+    return rc;
+  }
+
+  int writeRun(size_t page, size_t npages) {
+    const char* src = base_ + page * ALLOC8_PAGE_SIZE;
+    size_t left = npages * ALLOC8_PAGE_SIZE;
+    off_t offset = static_cast<off_t>(page * ALLOC8_PAGE_SIZE);
+    while (left != 0) {
+      ssize_t n = pwrite(fd_, src, left, offset);
+      if (n < 0) {
+        if (errno == EINTR) {
+          continue;
+        }
+        return -errno;
+      }
+      src += n;
+      offset += n;
+      left -= static_cast<size_t>(n);
+    }
+    return 0;
+  }
+
+  // Return free pages below the high-water mark to the OS
+  void punchFreeLocked() {
+    size_t page = 0;
+    while (page < highWater_) {
+      if (isUsed(page)) {
+        page++;
+        continue;
+      }
+      size_t run = 1;
+      while (page + run < highWater_ && !isUsed(page + run)) {
+        run++;
+      }
+      fallocate(fd_, FALLOC_FL_PUNCH_HOLE | FALLOC_FL_KEEP_SIZE,
+                static_cast<off_t>(page * ALLOC8_PAGE_SIZE),
+                static_cast<off_t>(run * ALLOC8_PAGE_SIZE));
+      page += run;
+    }
+  }
+
+  // Sources alive in this process. A forked child must not write to the
+  // parent's file: a shared heap mapping becomes private, and a private
+  // one (mid-snapshot) already is.
+  static constexpr size_t kMaxForkSources = 16;
+
+  static std::atomic<SnapshotPageSource*>* forkTable() {
+    static std::atomic<SnapshotPageSource*> table[kMaxForkSources];
+    return table;
+  }
+
+  static void atforkChild() {
+    for (size_t i = 0; i < kMaxForkSources; i++) {
+      if (SnapshotPageSource* s = forkTable()[i].load(std::memory_order_acquire)) {
+        if (s->state_.load(std::memory_order_relaxed) == kShared) {
+          s->mapHeapLocked(MAP_PRIVATE);
+        }
+        s->state_.store(kForked, std::memory_order_relaxed);
+      }
+    }
+  }
+
+  static void registerForFork(SnapshotPageSource* source) {
+    static bool registered = (pthread_atfork(nullptr, nullptr, atforkChild), true);
+    (void)registered;
+    for (size_t i = 0; i < kMaxForkSources; i++) {
+      SnapshotPageSource* expected = nullptr;
+      if (forkTable()[i].compare_exchange_strong(expected, source)) {
+        return;
+      }
+    }
+  }
+
+  static void unregisterForFork(SnapshotPageSource* source) {
+    for (size_t i = 0; i < kMaxForkSources; i++) {
+      SnapshotPageSource* expected = source;
+      if (forkTable()[i].compare_exchange_strong(expected, nullptr)) {
+        return;
+      }
+    }
+  }
+#endif
+};
+
+} // namespace alloc8
+
+/**
+ * ALLOC8_SNAPSHOT_REDIRECT: Export alloc8_snapshot(), alloc8_snapshot_release()
+ * and alloc8_snapshot_merge() for the SnapshotPageSource `source` (an
+ * expression; evaluated on each call).
+ *
+ * Place it next to ALLOC8_REDIRECT:
+ *
+ *   ALLOC8_REDIRECT(MyRedirect);
+ *   ALLOC8_SNAPSHOT_REDIRECT(getHeap()->pageSource());
+ */
+#define ALLOC8_SNAPSHOT_REDIRECT(source) \
+  extern "C" { \
+    ALLOC8_EXPORT int alloc8_snapshot(alloc8_snapshot_view* out) { \
+      return (source).snapshot(out); \
+    } \
+    \
+    ALLOC8_EXPORT void alloc8_snapshot_release(alloc8_snapshot_view* view) { \
+      (source).release(view); \
+    } \
+    \
+    ALLOC8_EXPORT int alloc8_snapshot_merge(void) { \
+      return (source).merge(); \
+    } \
+  }
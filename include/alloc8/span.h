@@ -0,0 +1,136 @@
+// alloc8/span.h - Span descriptors shared by page-map based components
+#pragma once
+
+#include "platform.h"
+#include <cstddef>
+#include <cstdint>
+
+namespace alloc8 {
+
+// ─── SPAN DESCRIPTOR ──────────────────────────────────────────────────────────
+
+/**
+ * Span: A run of contiguous pages owned by one component.
+ *
+ * Small-object spans are carved into `capacity` objects of `objectSize`
+ * bytes. Objects are handed out first by bumping `carved`, then from the
+ * returned objects: either the in-band `freeList` threaded through the
+ * objects themselves, or the out-of-band `freeIndex` stack (see
+ * slab_layout.h). Large-object spans hold exactly one object
+ * (`sizeClass == 0`, `capacity == 1`).
+ *
+ * Descriptors live outside the span's pages (see MetadataArena) and are
+ * registered in the PageMap for every page they cover, so any interior
+ * pointer can be mapped back to its span and owning component.
+ */
+struct Span {
+  uintptr_t start;        // Address of the first page
+  size_t    npages;       // Number of pages in the span
+  size_t    objectSize;   // Bytes per object (whole usable size for large spans)
+  uint32_t  sizeClass;    // Size class, or 0 for a large-object span
+  uint32_t  capacity;     // Objects the span can hold
+  uint32_t  allocated;    // Objects currently live
+  uint32_t  carved;       // Objects ever handed out by bump allocation
+  uint16_t  owner;        // Owning component id (see registerOwner)
+  void*     freeList;     // In-band list of returned objects
+  uint16_t* freeIndex;    // Out-of-band stack of free slot indices, if used
+  uint32_t  freeCount;    // Entries in freeIndex
+  uint16_t* pageLive;     // Out-of-band live-object count per page, if used
+  size_t    reserved;     // Large spans: bytes reserved to grow in place, or 0
+  Span*     next;         // SpanList links
+  Span*     prev;
+
+  /**
+   * Maximum objects per span. Bounds the scratch bitmap used by
+   * forEachLive() so iteration never needs to allocate.
+   */
+  static constexpr uint32_t kMaxObjects = 4096;
+
+  size_t bytes() const {
+    return npages * ALLOC8_PAGE_SIZE;
+  }
+
+  bool isLarge() const {
+    return sizeClass == 0;
+  }
+
+  bool contains(const void* ptr) const {
+    uintptr_t p = reinterpret_cast<uintptr_t>(ptr);
+    return p >= start && p < start + bytes();
+  }
+
+  void* objectAt(size_t index) const {
+    return reinterpret_cast<void*>(start + index * objectSize);
+  }
+
+  size_t indexOf(const void* ptr) const {
+    return (reinterpret_cast<uintptr_t>(ptr) - start) / objectSize;
+  }
+
+  /**
+   * Visit every live object in this span, in address order.
+   *
+   * Marks free slots (from the out-of-band index stack, or by walking the
+   * in-band free list) in a stack bitmap, then reports every carved slot
+   * that is not free. The caller must hold the lock that protects this
+   * span. Never allocates.
+   */
+  template<typename Visitor>
+  void forEachLive(Visitor&& visit) const {
+    if (isLarge()) {
+      if (allocated) {
+        visit(reinterpret_cast<void*>(start), objectSize);
+      }
+      return;
+    }
+
+    uint64_t freeBits[kMaxObjects / 64] = {};
+    if (freeIndex) {
+      for (uint32_t i = 0; i < freeCount; i++) {
+        size_t index = freeIndex[i];
+        freeBits[index / 64] |= uint64_t(1) << (index % 64);
+      }
+    }
+    size_t steps = 0;
+    for (void* obj = freeList; obj && contains(obj) && steps < carved; steps++) {
+      size_t index = indexOf(obj);
+      freeBits[index / 64] |= uint64_t(1) << (index % 64);
+      obj = *static_cast<void**>(obj);
+    }
+
+    for (size_t i = 0; i < carved; i++) {
+      if (!(freeBits[i / 64] & (uint64_t(1) << (i % 64)))) {
+        visit(objectAt(i), objectSize);
+      }
+    }
+  }
+};
+
+// ─── SPAN LIST ────────────────────────────────────────────────────────────────
+
+/**
+ * SpanList: Intrusive doubly-linked list of spans. Not thread-safe.
+ */
+class SpanList {
+  Span* head_ = nullptr;
+
+public:
+  bool empty() const { return head_ == nullptr; }
+  Span* front() const { return head_; }
+
+  void push(Span* span) {
+    span->prev = nullptr;
+    span->next = head_;
+    if (head_) head_->prev = span;
+    head_ = span;
+  }
+
+  void remove(Span* span) {
+    if (span->prev) span->prev->next = span->next;
+    else head_ = span->next;
+    if (span->next) span->next->prev = span->prev;
+    span->next = span->prev = nullptr;
+  }
+};
+
+} // namespace alloc8
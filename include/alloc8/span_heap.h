@@ -0,0 +1,468 @@
+// alloc8/span_heap.h - Size-classed span heap built on the alloc8 page map
+#pragma once
+
+#include "platform.h"
+#include "heap_iteration.h"
+#include "metadata.h"
+#include "os_memory.h"
+#include "page_map.h"
+#include "page_source.h"
+#include "size_classes.h"
+#include "slab_layout.h"
+#include "span.h"
+#include "span_sizing.h"
+#include "virtual_buffer.h"
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+
+namespace alloc8 {
+
+// ─── SPAN HEAP ────────────────────────────────────────────────────────────────
+
+/**
+ * SpanHeap: A complete, general-purpose heap made of alloc8 components.
+ *
+ * Small requests are rounded to a size class and carved from per-class
+ * spans (one lock per class). Requests above the largest class, and
+ * alignments above the page size, get a dedicated large span. Every span is
+ * registered in pageMap(), so free() and getSize() need no object headers.
+ *
+ * SpanHeap satisfies the Allocator concept and the optional iterate()
+ * member, so it can be used directly with HeapRedirect:
+ *
+ *   using MyRedirect = alloc8::HeapRedirect<alloc8::ANSIWrapper<alloc8::SpanHeap<>>>;
+ *   ALLOC8_REDIRECT(MyRedirect);
+ *
+ * The slab layout selects where free-slot state lives: InBandFreeList
+ * threads it through freed objects, OutOfBandSlab keeps it in a separate
+ * metadata region so free() never touches object pages.
+ *
+ * mallocBatch()/freeBatch() move several objects per lock acquisition, for
+ * caching layers such as ThreadCache. With an AddressOrderedRefill layout,
+ * each batch is taken from a span in ascending address order.
+ *
+ * With GrowInPlaceMin set, large allocations of at least that size reserve
+ * extra address space the way VirtualBuffer does, and resizeInPlace() (used
+ * by ANSIWrapper::realloc) grows them by committing more pages instead of
+ * copying.
+ *
+ * The sizing policy picks how many pages each new span of a class gets:
+ * FixedSpanSizing keeps the size-class map's choice, AdaptiveSpanSizing
+ * grows and shrinks it per class as the workload moves (see
+ * span_sizing.h and spanSizingStats()).
+ *
+ * @tparam PageSource     Where span pages come from (see page_source.h)
+ * @tparam Classes        Size-class map (see size_classes.h)
+ * @tparam Layout         Free-slot bookkeeping (see slab_layout.h)
+ * @tparam GrowInPlaceMin Smallest large allocation made growable (0 = off)
+ * @tparam Sizing         Pages per span, per class (see span_sizing.h)
+ */
+template<typename PageSource = OSPageSource, typename Classes = SizeClasses,
+         typename Layout = InBandFreeList, size_t GrowInPlaceMin = 0,
+         typename Sizing = FixedSpanSizing>
+class SpanHeap {
+public:
+  SpanHeap() : owner_(registerOwner()) {}
+
+  /**
+   * Owner id stamped into every span this heap creates.
+   */
+  uint16_t owner() const { return owner_; }
+
+  /**
+   * The page source spans are carved from.
+   */
+  PageSource& pageSource() { return source_; }
+
+  ALLOC8_ALWAYS_INLINE
+  void* malloc(size_t sz) {
+    size_t cls = Classes::sizeToClass(sz);
+    if (ALLOC8_UNLIKELY(cls == 0)) {
+      return mallocLarge(sz, ALLOC8_PAGE_SIZE);
+    }
+    return mallocSmall(cls);
+  }
+
+  ALLOC8_ALWAYS_INLINE
+  void free(void* ptr) {
+    Span* span = pageMap().get(ptr);
+    if (ALLOC8_UNLIKELY(span == nullptr || span->owner != owner_)) {
+      return;  // Not ours
+    }
+    if (ALLOC8_UNLIKELY(span->isLarge())) {
+      freeLarge(span);
+      return;
+    }
+    freeSmall(span, ptr);
+  }
+
+  void* memalign(size_t alignment, size_t sz) {
+    if (alignment <= ALLOC8_MIN_ALIGNMENT) {
+      // A multiple of the alignment lands in a class that is one too (with
+      // TinySizeClasses, the 8-byte class is only 8-byte aligned)
+      return malloc(sz <= Classes::kMaxSmallSize ? alignUp(sz, alignment) : sz);
+    }
+    if (alignment <= ALLOC8_PAGE_SIZE) {
+      // Power-of-two classes no larger than a page are naturally aligned,
+      // because spans start on a page boundary.
+      size_t rounded = (sz > alignment) ? sz : alignment;
+      rounded = size_t(1) << log2Floor(rounded * 2 - 1);
+      if (rounded <= ALLOC8_PAGE_SIZE && rounded <= Classes::kMaxSmallSize) {
+        return malloc(rounded);
+      }
+    }
+    return mallocLarge(sz, alignment);
+  }
+
+  /**
+   * Allocate up to `n` objects of the class serving `sz` under one lock
+   * acquisition. Returns how many were stored in `out` (0 for large sizes
+   * or when out of memory).
+   */
+  size_t mallocBatch(size_t sz, void** out, size_t n) {
+    size_t cls = Classes::sizeToClass(sz);
+    if (cls == 0) {
+      return 0;
+    }
+    ClassState& state = classes_[cls];
+    std::lock_guard<std::mutex> guard(state.lock);
+    size_t got = 0;
+    [[maybe_unused]] Span* prepared = nullptr;
+    while (got < n) {
+      if constexpr (requires(Layout& l, Span* s) { l.prepareBatch(s); }) {
+        Span* span = state.partial.front();
+        if (span && span != prepared) {
+          layout_.prepareBatch(span);
+          prepared = span;
+        }
+      }
+      void* obj = mallocSmallLocked(state, cls);
+      if (!obj) {
+        break;
+      }
+      out[got++] = obj;
+    }
+    return got;
+  }
+
+  /**
+   * Free `n` objects, taking each class lock once per run of same-class
+   * objects.
+   */
+  void freeBatch(void** ptrs, size_t n) {
+    size_t i = 0;
+    while (i < n) {
+      Span* span = pageMap().get(ptrs[i]);
+      if (span == nullptr || span->owner != owner_ || span->isLarge()) {
+        free(ptrs[i++]);
+        continue;
+      }
+      uint32_t cls = span->sizeClass;
+      ClassState& state = classes_[cls];
+      std::lock_guard<std::mutex> guard(state.lock);
+      do {
+        freeSmallLocked(state, span, ptrs[i]);
+        span = (++i < n) ? pageMap().get(ptrs[i]) : nullptr;
+      } while (span && span->owner == owner_ && span->sizeClass == cls);
+    }
+  }
+
+  /**
+   * Grow a growable large allocation to at least `sz` bytes without moving
+   * it. Returns false when the block is not growable or its reservation is
+   * exhausted; the caller then falls back to allocate-copy-free.
+   */
+  bool resizeInPlace(void* ptr, size_t sz) {
+    if constexpr (GrowInPlaceMin == 0) {
+      (void)ptr;
+      (void)sz;
+      return false;
+    } else {
+      Span* span = pageMap().get(ptr);
+      if (span == nullptr || span->owner != owner_ || span->reserved == 0 ||
+          span->start != reinterpret_cast<uintptr_t>(ptr)) {
+        return false;
+      }
+      if (sz <= span->objectSize) {
+        return true;
+      }
+      if (sz > span->reserved) {
+        return false;
+      }
+      size_t npages = alignUp(sz, ALLOC8_PAGE_SIZE) / ALLOC8_PAGE_SIZE;
+      std::lock_guard<std::mutex> guard(largeLock_);
+      uintptr_t tail = span->start + span->npages * ALLOC8_PAGE_SIZE;
+      size_t extra = npages - span->npages;
+      if (!osCommit(reinterpret_cast<void*>(tail), extra * ALLOC8_PAGE_SIZE) ||
+          !pageMap().setRange(tail, extra, span)) {
+        return false;
+      }
+      span->npages = npages;
+      span->objectSize = npages * ALLOC8_PAGE_SIZE;
+      return true;
+    }
+  }
+
+  ALLOC8_ALWAYS_INLINE
+  size_t getSize(void* ptr) {
+    Span* span = pageMap().get(ptr);
+    if (ALLOC8_UNLIKELY(span == nullptr || span->owner != owner_)) {
+      return 0;
+    }
+    return span->objectSize;
+  }
+
+  void lock() {
+    for (size_t cls = 1; cls < Classes::kNumClasses; cls++) {
+      classes_[cls].lock.lock();
+    }
+    largeLock_.lock();
+    source_.lock();
+  }
+
+  void unlock() {
+    source_.unlock();
+    largeLock_.unlock();
+    for (size_t cls = Classes::kNumClasses - 1; cls >= 1; cls--) {
+      classes_[cls].lock.unlock();
+    }
+  }
+
+  /**
+   * Visit every live allocation (see alloc8_iterate_callback). Locks one
+   * span at a time; the callback must not allocate.
+   */
+  void iterate(IterateCallback cb, void* ctx) {
+    iterateOwnedSpans(owner_, [this](Span* span) -> std::mutex& {
+      return lockFor(span);
+    }, cb, ctx);
+  }
+
+  /**
+   * The sizing policy's state and decisions for class `cls` (1 to
+   * Classes::kNumClasses - 1), with an adaptive policy.
+   */
+  SpanSizingStats spanSizingStats(size_t cls) requires AdaptiveSizing<Sizing> {
+    ClassState& state = classes_[cls];
+    std::lock_guard<std::mutex> guard(state.lock);
+    return Sizing::template stats<Classes>(state.sizing, cls);
+  }
+
+  /**
+   * Report every class that has made a span (see alloc8_span_sizing_stats),
+   * with an adaptive policy. Takes each class lock in turn; `cb` runs with
+   * none held.
+   */
+  void spanSizingStats(SpanSizingStatsCallback cb, void* ctx) requires AdaptiveSizing<Sizing> {
+    for (size_t cls = 1; cls < Classes::kNumClasses; cls++) {
+      SpanSizingStats s = spanSizingStats(cls);
+      if (s.refills == 0) {
+        continue;
+      }
+      alloc8_span_sizing_stats stats = {};
+      stats.owner = owner_;
+      stats.size = static_cast<uint32_t>(Classes::classToSize(cls));
+      stats.shift = s.shift;
+      stats.pages = s.pages;
+      stats.base = s.basePages;
+      stats.refills = s.refills;
+      stats.releases = s.releases;
+      stats.grows = s.grows;
+      stats.shrinks = s.shrinks;
+      stats.live = s.liveObjects;
+      stats.slots = s.slots;
+      cb(&stats, ctx);
+    }
+  }
+
+private:
+  struct alignas(ALLOC8_CACHE_LINE_SIZE) ClassState {
+    std::mutex lock;
+    SpanList partial;  // Spans with at least one free object
+    [[no_unique_address]] typename Sizing::ClassState sizing;
+  };
+
+  ClassState classes_[Classes::kNumClasses];
+  std::mutex largeLock_;
+  PageSource source_;
+  Layout layout_;
+  MetadataArena<Span> spans_;
+  uint16_t owner_;
+
+  std::mutex& lockFor(Span* span) {
+    size_t cls = span->sizeClass;
+    if (cls == 0 || cls >= Classes::kNumClasses) {
+      return largeLock_;
+    }
+    return classes_[cls].lock;
+  }
+
+  void* mallocSmall(size_t cls) {
+    ClassState& state = classes_[cls];
+    std::lock_guard<std::mutex> guard(state.lock);
+    return mallocSmallLocked(state, cls);
+  }
+
+  void* mallocSmallLocked(ClassState& state, size_t cls) {
+    Span* span = state.partial.front();
+    if (ALLOC8_UNLIKELY(span == nullptr)) {
+      span = newSpan(state, cls);
+      if (!span) {
+        return nullptr;
+      }
+      state.partial.push(span);
+    }
+    void* obj = layout_.pop(span);
+    if (++span->allocated == span->capacity) {
+      state.partial.remove(span);  // Full spans live in no list
+    }
+    if constexpr (AdaptiveSizing<Sizing>) {
+      Sizing::onMalloc(state.sizing);
+    }
+    return obj;
+  }
+
+  void freeSmall(Span* span, void* ptr) {
+    ClassState& state = classes_[span->sizeClass];
+    std::lock_guard<std::mutex> guard(state.lock);
+    freeSmallLocked(state, span, ptr);
+  }
+
+  void freeSmallLocked(ClassState& state, Span* span, void* ptr) {
+    if (span->allocated-- == span->capacity) {
+      state.partial.push(span);
+    }
+    layout_.push(span, ptr);
+    if constexpr (AdaptiveSizing<Sizing>) {
+      Sizing::onFree(state.sizing);
+    }
+    // Release empty spans, but keep the last partial span of each class to
+    // avoid map/unmap churn on alloc/free ping-pong.
+    if (span->allocated == 0 &&
+        !(state.partial.front() == span && span->next == nullptr)) {
+      state.partial.remove(span);
+      if constexpr (AdaptiveSizing<Sizing>) {
+        Sizing::onReleaseSpan(state.sizing, span);
+      }
+      releaseSpan(span);
+    }
+  }
+
+  Span* newSpan(ClassState& state, size_t cls) {
+    size_t npages = Sizing::template pages<Classes>(state.sizing, cls);
+    void* mem = source_.allocPages(npages, ALLOC8_PAGE_SIZE);
+    if (!mem) {
+      return nullptr;
+    }
+    Span* span = spans_.allocate();
+    if (!span) {
+      source_.freePages(mem, npages);
+      return nullptr;
+    }
+    span->start = reinterpret_cast<uintptr_t>(mem);
+    span->npages = npages;
+    span->objectSize = Classes::classToSize(cls);
+    span->sizeClass = static_cast<uint32_t>(cls);
+    span->capacity = static_cast<uint32_t>(npages * ALLOC8_PAGE_SIZE / span->objectSize);
+    span->owner = owner_;
+    if (!layout_.attach(span)) {
+      spans_.deallocate(span);
+      source_.freePages(mem, npages);
+      return nullptr;
+    }
+    if (!pageMap().insert(span)) {
+      layout_.detach(span);
+      spans_.deallocate(span);
+      source_.freePages(mem, npages);
+      return nullptr;
+    }
+    if constexpr (AdaptiveSizing<Sizing>) {
+      Sizing::template onRefill<Classes>(state.sizing, cls);
+      Sizing::onNewSpan(state.sizing, span);
+    }
+    return span;
+  }
+
+  void releaseSpan(Span* span) {
+    void* mem = reinterpret_cast<void*>(span->start);
+    size_t npages = span->npages;
+    pageMap().erase(span);
+    layout_.detach(span);
+    spans_.deallocate(span);
+    source_.freePages(mem, npages);
+  }
+
+  // Address space reserved for a growable allocation of `bytes`
+  static size_t growReserve(size_t bytes) {
+    constexpr size_t kMinReserve = VirtualBuffer::kMaxCommitStep;
+    size_t reserve = (bytes > SIZE_MAX / 8) ? bytes : bytes * 8;
+    return alignUp(reserve > kMinReserve ? reserve : kMinReserve, ALLOC8_PAGE_SIZE);
+  }
+
+  void* mallocLarge(size_t sz, size_t alignment) {
+    if (ALLOC8_UNLIKELY(sz > SIZE_MAX - ALLOC8_PAGE_SIZE)) {
+      return nullptr;
+    }
+    size_t npages = alignUp(sz ? sz : 1, ALLOC8_PAGE_SIZE) / ALLOC8_PAGE_SIZE;
+    size_t reserved = 0;
+    void* mem;
+    if (GrowInPlaceMin != 0 && sz >= GrowInPlaceMin && alignment <= ALLOC8_PAGE_SIZE) {
+      reserved = growReserve(npages * ALLOC8_PAGE_SIZE);
+      mem = osReserve(reserved);
+      if (mem && !osCommit(mem, npages * ALLOC8_PAGE_SIZE)) {
+        osUnmap(mem, reserved);
+        mem = nullptr;
+      }
+    } else {
+      mem = source_.allocPages(npages, alignment);
+    }
+    if (!mem) {
+      return nullptr;
+    }
+    Span* span = spans_.allocate();
+    if (!span) {
+      releaseLarge(mem, npages, reserved);
+      return nullptr;
+    }
+    span->start = reinterpret_cast<uintptr_t>(mem);
+    span->npages = npages;
+    span->objectSize = npages * ALLOC8_PAGE_SIZE;
+    span->sizeClass = 0;
+    span->capacity = 1;
+    span->allocated = 1;
+    span->carved = 1;
+    span->owner = owner_;
+    span->reserved = reserved;
+    if (!pageMap().insert(span)) {
+      spans_.deallocate(span);
+      releaseLarge(mem, npages, reserved);
+      return nullptr;
+    }
+    return mem;
+  }
+
+  void freeLarge(Span* span) {
+    void* mem = reinterpret_cast<void*>(span->start);
+    size_t npages;
+    size_t reserved;
+    {
+      std::lock_guard<std::mutex> guard(largeLock_);
+      npages = span->npages;
+      reserved = span->reserved;
+      pageMap().erase(span);
+      spans_.deallocate(span);
+    }
+    releaseLarge(mem, npages, reserved);
+  }
+
+  void releaseLarge(void* mem, size_t npages, size_t reserved) {
+    if (reserved) {
+      osUnmap(mem, reserved);
+    } else {
+      source_.freePages(mem, npages);
+    }
+  }
+};
+
+} // namespace alloc8
@@ -0,0 +1,198 @@
+// alloc8/span_sizing.h - Per-class span sizing policies for SpanHeap
+#pragma once
+
+#include "platform.h"
+#include "os_memory.h"
+#include "span.h"
+#include <cstddef>
+#include <cstdint>
+
+namespace alloc8 {
+
+// ─── SPAN SIZING ──────────────────────────────────────────────────────────────
+
+/**
+ * Snapshot of one size class under AdaptiveSpanSizing (see
+ * SpanHeap::spanSizingStats()).
+ */
+struct SpanSizingStats {
+  size_t pages;        // Pages of the class's current span size
+  size_t basePages;    // Pages the size-class map chose
+  int shift;           // log2(pages / basePages), before clamping
+  size_t refills;      // Spans created
+  size_t releases;     // Empty spans released
+  size_t grows;        // Times the span size doubled
+  size_t shrinks;      // Times it halved
+  size_t liveObjects;  // Objects allocated from the class's spans
+  size_t slots;        // Objects the class's spans can hold
+};
+
+/**
+ * FixedSpanSizing: Every span of a class gets the pages the size-class map
+ * fixed for it (the default).
+ */
+struct FixedSpanSizing {
+  struct ClassState {};
+
+  template<typename Classes>
+  static size_t pages(const ClassState&, size_t cls) {
+    return Classes::classToPages(cls);
+  }
+};
+
+/**
+ * A sizing policy that keeps per-class state and wants to hear about every
+ * allocation, free and span the heap makes or releases. All hooks run under
+ * the class lock.
+ */
+template<typename S>
+concept AdaptiveSizing = requires(typename S::ClassState& state, const Span* span) {
+  S::onMalloc(state);
+  S::onFree(state);
+  S::onNewSpan(state, span);
+  S::onReleaseSpan(state, span);
+};
+
+/**
+ * AdaptiveSpanSizing: Grows or shrinks each class's spans within bounds,
+ * from how often the class needs a new span and how full its spans stay.
+ *
+ * The size a class's spans should have only matters when the heap makes
+ * one, so every decision is taken at a refill (all of the class's spans
+ * are full by then, or SpanHeap would not need a new one):
+ *
+ * - If the class's live objects fell below a quarter of its slots at some
+ *   point since the previous refill, its demand swings: large spans would
+ *   strand memory half-empty, so the span size halves.
+ * - Otherwise, after GrowAfter such refills in a row the class is filling
+ *   spans as fast as it gets them, so the span size doubles and the slow
+ *   path runs half as often.
+ *
+ * Releasing an empty span restarts the count. Span sizes stay between
+ * basePages >> MaxShrinkShift and basePages << MaxGrowShift, hold at least
+ * one object and at most Span::kMaxObjects. Tracking costs a counter update
+ * per malloc and free, under the lock the heap already holds. Spans made
+ * before a change keep their size, so a class can hold spans of several
+ * sizes at once.
+ *
+ *   using Heap = alloc8::SpanHeap<alloc8::OSPageSource, alloc8::SizeClasses,
+ *                                 alloc8::InBandFreeList, 0,
+ *                                 alloc8::AdaptiveSpanSizing<>>;
+ *
+ * @tparam MaxGrowShift   Spans grow to at most basePages << MaxGrowShift
+ * @tparam MaxShrinkShift Spans shrink to at least basePages >> MaxShrinkShift
+ * @tparam GrowAfter      Refills in a row at steady occupancy before growing
+ */
+template<unsigned MaxGrowShift = 3, unsigned MaxShrinkShift = 2, unsigned GrowAfter = 4>
+struct AdaptiveSpanSizing {
+  static_assert(GrowAfter > 0, "GrowAfter must be positive");
+
+  struct ClassState {
+    int shift = 0;
+    uint32_t streak = 0;  // Refills in a row without a dip in occupancy
+    size_t live = 0;
+    size_t slots = 0;
+    size_t lowWater = SIZE_MAX;  // Fewest live objects after a free since the
+                                 // last refill (SIZE_MAX: no free yet)
+    size_t refills = 0;
+    size_t releases = 0;
+    size_t grows = 0;
+    size_t shrinks = 0;
+  };
+
+  /**
+   * Pages the next span of `cls` gets, as decided from the state now.
+   */
+  template<typename Classes>
+  static size_t pages(const ClassState& state, size_t cls) {
+    return pagesAt<Classes>(cls, decide<Classes>(state, cls).shift);
+  }
+
+  ALLOC8_ALWAYS_INLINE
+  static void onMalloc(ClassState& state) {
+    state.live++;
+  }
+
+  ALLOC8_ALWAYS_INLINE
+  static void onFree(ClassState& state) {
+    if (--state.live < state.lowWater) {
+      state.lowWater = state.live;
+    }
+  }
+
+  /**
+   * Commit the decision pages() took, once the span it sized exists (before
+   * onNewSpan()), so a refill that fails leaves the state as it was.
+   */
+  template<typename Classes>
+  static void onRefill(ClassState& state, size_t cls) {
+    Decision next = decide<Classes>(state, cls);
+    state.refills++;
+    state.streak = next.streak;
+    if (next.shift < state.shift) {
+      state.shrinks++;
+    } else if (next.shift > state.shift) {
+      state.grows++;
+    }
+    state.shift = next.shift;
+  }
+
+  static void onNewSpan(ClassState& state, const Span* span) {
+    state.slots += span->capacity;
+    state.lowWater = SIZE_MAX;
+  }
+
+  static void onReleaseSpan(ClassState& state, const Span* span) {
+    state.slots -= span->capacity;
+    state.releases++;
+    state.streak = 0;
+  }
+
+  template<typename Classes>
+  static SpanSizingStats stats(const ClassState& state, size_t cls) {
+    return SpanSizingStats{pagesAt<Classes>(cls, state.shift), Classes::classToPages(cls),
+                           state.shift, state.refills, state.releases, state.grows,
+                           state.shrinks, state.live, state.slots};
+  }
+
+private:
+  struct Decision {
+    int shift;
+    uint32_t streak;
+  };
+
+  template<typename Classes>
+  static Decision decide(const ClassState& state, size_t cls) {
+    int shift = state.shift;
+    size_t now = pagesAt<Classes>(cls, shift);
+    if (state.lowWater != SIZE_MAX && state.lowWater * 4 < state.slots) {
+      if (shift > -static_cast<int>(MaxShrinkShift) &&
+          pagesAt<Classes>(cls, shift - 1) < now) {
+        shift--;
+      }
+      return Decision{shift, 0};
+    }
+    uint32_t streak = state.streak + 1;
+    if (streak < GrowAfter) {
+      return Decision{shift, streak};
+    }
+    if (shift < static_cast<int>(MaxGrowShift) && pagesAt<Classes>(cls, shift + 1) > now) {
+      shift++;
+    }
+    return Decision{shift, 0};
+  }
+
+  template<typename Classes>
+  static size_t pagesAt(size_t cls, int shift) {
+    size_t base = Classes::classToPages(cls);
+    size_t size = Classes::classToSize(cls);
+    size_t pages = (shift >= 0) ? base << shift : base >> -shift;
+    size_t maxPages = Span::kMaxObjects * size / ALLOC8_PAGE_SIZE;
+    size_t minPages = alignUp(size, ALLOC8_PAGE_SIZE) / ALLOC8_PAGE_SIZE;
+    if (pages > maxPages) pages = maxPages;
+    if (pages < minPages) pages = minPages;
+    return pages;
+  }
+};
+
+} // namespace alloc8
@@ -0,0 +1,649 @@
+// alloc8/thread_cache.h - Per-context object caches over a shared heap
+#pragma once
+
+#include "platform.h"
+#include "alloc_context.h"
+#include "allocator_traits.h"
+#include "heap_iteration.h"
+#include "maintenance.h"
+#include "metadata.h"
+#include "size_classes.h"
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+
+namespace alloc8 {
+
+// ─── THREAD CACHE ─────────────────────────────────────────────────────────────
+
+/**
+ * ThreadCache: Lock-free per-context free lists in front of a shared heap.
+ *
+ * Small objects are served from singly-linked per-class lists and refilled
+ * from / flushed to the underlying heap in batches (through mallocBatch()
+ * and freeBatch() when the heap has them, e.g. SpanHeap). The cache is not
+ * found through TLS but through current_context()->threadCache, so a fiber
+ * that switches in its own AllocContext carries its cache with it across OS
+ * threads; threads that never switch use their default context.
+ *
+ *   using MyHeap = alloc8::ANSIWrapper<alloc8::ThreadCache<alloc8::SpanHeap<>>>;
+ *   using MyRedirect = alloc8::HeapRedirect<MyHeap>;
+ *   ALLOC8_REDIRECT_WITH_THREADS(MyRedirect);
+ *
+ * A context belongs to the first ThreadCache that touches it; other
+ * ThreadCache instances bypass it and go straight to their heap. Only
+ * objects whose getSize() is exactly a class size are cached, so pointers
+ * the heap does not own (or serves as large objects) are never captured.
+ * iterate() leaves cached objects out of the heap's walk, except those in
+ * other threads' unbudgeted caches (see iterate()).
+ *
+ * With AddressOrdered set, each refill batch is sorted by address before it
+ * is cached, so consecutive mallocs after a refill return ascending
+ * addresses even when the heap hands the batch out in free order. Pair it
+ * with an AddressOrderedRefill slab layout to order slots within each span
+ * as well.
+ *
+ * With a BudgetBytes budget, all caches of this heap together hold at most
+ * that many bytes. Each cache owns a share of the budget (its capacity) and
+ * grows in kCapacityStep steps, first from the unclaimed pool, then by taking
+ * capacity from a larger cache; when neither is possible it flushes instead.
+ * rebalance() drains caches that saw no operations since its previous call
+ * and returns their capacity to the pool, so threads that go quiet do not
+ * sit on memory the busy ones could use. It is registered with the
+ * Maintenance thread on first use; start that thread (or call rebalance()
+ * yourself) to get idle draining. Budgeting makes every cache operation take
+ * an uncontended per-cache lock, so the default is off.
+ *
+ * cacheStats() reports every cache's size and capacity (exported as
+ * xxmalloc_cache_stats). threadIdle() empties the running context's cache
+ * ahead of a long block (exported as alloc8_thread_idle).
+ *
+ * @tparam Heap           Underlying heap; must be safe to call from any thread
+ * @tparam Classes        Size-class map (should match the heap's)
+ * @tparam ClassBytes     Bytes cached per class before half is flushed
+ * @tparam AddressOrdered Sort refill batches by address
+ * @tparam BudgetBytes    Initial byte budget shared by all caches (0 = none)
+ */
+template<typename Heap, typename Classes = SizeClasses,
+         size_t ClassBytes = 64 * 1024, bool AddressOrdered = false,
+         size_t BudgetBytes = 0>
+class ThreadCache : public Heap {
+  static constexpr size_t kMinCount = 4;
+  static constexpr size_t kMaxCount = 256;
+  static constexpr bool kBudgeted = BudgetBytes != 0;
+
+  struct FreeList {
+    void*    head;
+    uint32_t count;
+  };
+
+  // Budget share of one cache. The owner holds `busy` across each of its
+  // operations; other threads only ever try-lock it.
+  struct Share {
+    std::atomic<bool>     busy{false};
+    std::atomic<size_t>   capacity{0};
+    std::atomic<uint64_t> ops{0};
+    std::atomic<bool>     idle{false};
+    uint64_t              seenOps = 0;  // rebalance() only
+  };
+  struct NoShare {};
+
+  struct Cache {
+    ThreadCache* owner;
+    Cache* prev;  // Registry links (registryLock_)
+    Cache* next;
+    uint32_t id;
+    bool walked;  // Read by the running iterate() (registryLock_)
+    std::atomic<size_t> bytes;  // Written by whoever holds the cache
+    [[no_unique_address]] std::conditional_t<kBudgeted, Share, NoShare> share;
+    FreeList lists[Classes::kNumClasses];
+  };
+
+  // Holds a cache for one operation (free when unbudgeted)
+  class Hold {
+    Cache* cache_;
+
+  public:
+    ALLOC8_ALWAYS_INLINE explicit Hold(Cache* cache) : cache_(cache) {
+      if constexpr (kBudgeted) {
+        Share& share = cache->share;
+        while (ALLOC8_UNLIKELY(share.busy.exchange(true, std::memory_order_acquire))) {
+          std::this_thread::yield();
+        }
+        share.ops.store(share.ops.load(std::memory_order_relaxed) + 1,
+                        std::memory_order_relaxed);
+      }
+    }
+    ALLOC8_ALWAYS_INLINE ~Hold() {
+      if constexpr (kBudgeted) {
+        cache_->share.busy.store(false, std::memory_order_release);
+      }
+    }
+    Hold(const Hold&) = delete;
+    Hold& operator=(const Hold&) = delete;
+  };
+
+  MetadataArena<Cache> caches_;
+
+  std::mutex registryLock_;  // Guards the registry, nextId_ and taskAdded_
+  Cache* registry_ = nullptr;
+  uint32_t nextId_ = 0;
+  bool taskAdded_ = false;
+
+  std::atomic<size_t> budget_{BudgetBytes};
+  std::atomic<long long> unclaimed_{static_cast<long long>(BudgetBytes)};
+
+  // Tag for a thread's default context after threadCleanup(): the thread
+  // may still free during TLS teardown, and must not build a new cache.
+  static void* retired() {
+    static char marker;
+    return &marker;
+  }
+
+public:
+  /**
+   * Granularity in which caches claim budget.
+   */
+  static constexpr size_t kCapacityStep = 64 * 1024;
+
+  ThreadCache() = default;
+
+  ~ThreadCache() {
+    if constexpr (kBudgeted) {
+      if (taskAdded_) {
+        Maintenance::instance().remove(&rebalanceTask, this);
+      }
+    }
+  }
+
+  /**
+   * Objects a class may cache before a flush; refills fetch half of this.
+   */
+  static constexpr size_t limit(size_t cls) {
+    size_t n = ClassBytes / Classes::classToSize(cls);
+    return n < kMinCount ? kMinCount : (n > kMaxCount ? kMaxCount : n);
+  }
+
+  ALLOC8_ALWAYS_INLINE
+  void* malloc(size_t sz) {
+    size_t cls = Classes::sizeToClass(sz);
+    if (ALLOC8_LIKELY(cls != 0)) {
+      if (Cache* cache = cacheFor(current_context())) {
+        Hold hold(cache);
+        FreeList& list = cache->lists[cls];
+        if (ALLOC8_LIKELY(list.head != nullptr)) {
+          void* obj = list.head;
+          list.head = *static_cast<void**>(obj);
+          list.count--;
+          charge(cache, -static_cast<ptrdiff_t>(Classes::classToSize(cls)));
+          return obj;
+        }
+        return refill(cache, list, cls);
+      }
+    }
+    return Heap::malloc(sz);
+  }
+
+  ALLOC8_ALWAYS_INLINE
+  void free(void* ptr) {
+    if (Cache* cache = cacheFor(current_context())) {
+      size_t sz = Heap::getSize(ptr);
+      size_t cls = Classes::sizeToClass(sz);
+      if (ALLOC8_LIKELY(cls != 0 && Classes::classToSize(cls) == sz)) {
+        Hold hold(cache);
+        FreeList& list = cache->lists[cls];
+        *static_cast<void**>(ptr) = list.head;
+        list.head = ptr;
+        charge(cache, static_cast<ptrdiff_t>(sz));
+        if (ALLOC8_UNLIKELY(++list.count > limit(cls))) {
+          flush(cache, list, cls, limit(cls) / 2);
+        } else if constexpr (kBudgeted) {
+          if (ALLOC8_UNLIKELY(cache->bytes.load(std::memory_order_relaxed) >
+                              cache->share.capacity.load(std::memory_order_relaxed))) {
+            overBudget(cache);
+          }
+        }
+        return;
+      }
+    }
+    Heap::free(ptr);
+  }
+
+  /**
+   * Objects currently cached by `ctx` for this heap (0 if `ctx` belongs to
+   * another layer or has no cache yet).
+   */
+  size_t cachedObjects(const AllocContext* ctx) const {
+    if (ctx->heap != this) {
+      return 0;
+    }
+    return countOf(static_cast<const Cache*>(ctx->threadCache));
+  }
+
+  /**
+   * Visit every live allocation of the heap beneath, leaving out objects
+   * sitting in caches: the running context's cache, and with a budget
+   * every other cache that is not in use at that moment. Unbudgeted caches
+   * of other threads are read without a lock by their owners and cannot be
+   * walked safely; their objects are still visited, and cacheStats()
+   * reports their bytes. Caches are read before the heap is walked, so
+   * objects cached or handed out meanwhile may be misreported, as with any
+   * walk of a running heap.
+   */
+  void iterate(IterateCallback cb, void* ctx)
+    requires requires(Heap& h, IterateCallback f, void* c) { h.iterate(f, c); }
+  {
+    AllocContext* current = current_context();
+    Cache* own = (current->heap == this) ? static_cast<Cache*>(current->threadCache)
+                                         : nullptr;
+    std::unique_lock<std::mutex> guard(registryLock_);
+    size_t count = 0;
+    for (Cache* c = registry_; c; c = c->next) {
+      if constexpr (kBudgeted) {
+        c->walked = tryHold(c);
+      } else {
+        c->walked = (c == own);
+      }
+      count += c->walked ? countOf(c) : 0;
+    }
+    ExcludedObjects cached(count);
+    for (Cache* c = registry_; c; c = c->next) {
+      if (!c->walked) {
+        continue;
+      }
+      for (size_t cls = 1; cls < Classes::kNumClasses; cls++) {
+        for (void* obj = c->lists[cls].head; obj; obj = *static_cast<void**>(obj)) {
+          cached.add(obj);
+        }
+      }
+      if constexpr (kBudgeted) {
+        release(c);
+      }
+    }
+    guard.unlock();
+    cached.iterate([this](IterateCallback f, void* c) { Heap::iterate(f, c); }, cb, ctx);
+  }
+
+  /**
+   * Report every cache of this heap (see alloc8_cache_stats). The callback
+   * runs with the cache registry locked and must not allocate.
+   */
+  void cacheStats(CacheStatsCallback cb, void* ctx) {
+    std::lock_guard<std::mutex> guard(registryLock_);
+    for (Cache* c = registry_; c; c = c->next) {
+      alloc8_cache_stats stats = {};
+      stats.id = c->id;
+      stats.bytes = c->bytes.load(std::memory_order_relaxed);
+      if constexpr (kBudgeted) {
+        stats.capacity = c->share.capacity.load(std::memory_order_relaxed);
+        stats.ops = c->share.ops.load(std::memory_order_relaxed);
+        stats.idle = c->share.idle.load(std::memory_order_relaxed) ? 1 : 0;
+      }
+      cb(&stats, ctx);
+    }
+  }
+
+  /**
+   * Bytes held by all caches together.
+   */
+  size_t cachedBytes() {
+    std::lock_guard<std::mutex> guard(registryLock_);
+    size_t total = 0;
+    for (Cache* c = registry_; c; c = c->next) {
+      total += c->bytes.load(std::memory_order_relaxed);
+    }
+    return total;
+  }
+
+  /**
+   * Current total budget (0 when unbudgeted).
+   */
+  size_t budget() const {
+    return kBudgeted ? budget_.load(std::memory_order_relaxed) : 0;
+  }
+
+  /**
+   * Change the total budget. Capacity above a lowered budget is reclaimed
+   * by the next rebalance().
+   */
+  void setBudget(size_t bytes) requires kBudgeted {
+    size_t old = budget_.exchange(bytes, std::memory_order_relaxed);
+    unclaimed_.fetch_add(static_cast<long long>(bytes) - static_cast<long long>(old),
+                         std::memory_order_relaxed);
+  }
+
+  /**
+   * Drain caches that saw no operations since the previous call, returning
+   * their objects to the heap and their capacity to the pool, and reclaim
+   * capacity above a lowered budget. Caches that are in use right now are
+   * skipped. Called by the Maintenance thread; safe from any thread.
+   */
+  void rebalance() {
+    if constexpr (kBudgeted) {
+      std::lock_guard<std::mutex> guard(registryLock_);
+      for (Cache* c = registry_; c; c = c->next) {
+        if (!tryHold(c)) {
+          continue;
+        }
+        Share& share = c->share;
+        uint64_t ops = share.ops.load(std::memory_order_relaxed);
+        if (ops == share.seenOps) {
+          trim(c, 0);
+          giveBack(c, share.capacity.load(std::memory_order_relaxed));
+          share.idle.store(true, std::memory_order_relaxed);
+        } else {
+          share.seenOps = ops;
+          share.idle.store(false, std::memory_order_relaxed);
+        }
+        release(c);
+      }
+      // Over budget after setBudget(): shrink whichever caches are free
+      for (Cache* c = registry_; c; c = c->next) {
+        long long deficit = -unclaimed_.load(std::memory_order_relaxed);
+        if (deficit <= 0) {
+          break;
+        }
+        if (!tryHold(c)) {
+          continue;
+        }
+        size_t capacity = c->share.capacity.load(std::memory_order_relaxed);
+        size_t take = std::min(capacity, static_cast<size_t>(deficit));
+        giveBack(c, take);
+        trim(c, capacity - take);
+        release(c);
+      }
+    }
+  }
+
+  /**
+   * Fork safety (xxmalloc_lock): the registry lock is taken inside malloc
+   * (attaching a cache, stealing capacity) and held around heap calls by
+   * rebalance(), so it is taken before the heap's locks.
+   */
+  void lock() {
+    registryLock_.lock();
+    Heap::lock();
+  }
+
+  void unlock() {
+    Heap::unlock();
+    registryLock_.unlock();
+  }
+
+  /**
+   * Thread exit: return the thread's default-context cache to the heap.
+   * Fiber contexts are returned with release_context().
+   */
+  void threadCleanup() {
+    AllocContext& ctx = thread_context();
+    if (ctx.heap == this) {
+      release_context(&ctx);
+      ctx.heap = retired();
+    }
+    if constexpr (requires(Heap& h) { h.threadCleanup(); }) {
+      Heap::threadCleanup();
+    }
+  }
+
+  /**
+   * The running context is about to block for a long time: return its
+   * cache's objects to the heap (and, when budgeted, its capacity to the
+   * pool) so an idle thread pins no memory. The cache stays attached and
+   * refills on demand once the thread allocates again.
+   */
+  void threadIdle() {
+    AllocContext* ctx = current_context();
+    if (ctx->heap == this) {
+      Cache* cache = static_cast<Cache*>(ctx->threadCache);
+      Hold hold(cache);
+      trim(cache, 0);
+      if constexpr (kBudgeted) {
+        giveBack(cache, cache->share.capacity.load(std::memory_order_relaxed));
+        cache->share.idle.store(true, std::memory_order_relaxed);
+      }
+    }
+    if constexpr (requires(Heap& h) { h.threadIdle(); }) {
+      Heap::threadIdle();
+    }
+  }
+
+  /**
+   * The running context is back at work after threadIdle(). Nothing is
+   * prefetched: the next mallocs refill the cache lazily.
+   */
+  void threadBusy() {
+    if constexpr (kBudgeted) {
+      AllocContext* ctx = current_context();
+      if (ctx->heap == this) {
+        static_cast<Cache*>(ctx->threadCache)->share.idle.store(false, std::memory_order_relaxed);
+      }
+    }
+    if constexpr (requires(Heap& h) { h.threadBusy(); }) {
+      Heap::threadBusy();
+    }
+  }
+
+private:
+  ALLOC8_ALWAYS_INLINE
+  Cache* cacheFor(AllocContext* ctx) {
+    if (ALLOC8_LIKELY(ctx->heap == this)) {
+      return static_cast<Cache*>(ctx->threadCache);
+    }
+    if (ctx->heap == nullptr) {
+      return attach(ctx);
+    }
+    return nullptr;  // Bound to another layer, or retired
+  }
+
+  ALLOC8_NOINLINE
+  Cache* attach(AllocContext* ctx) {
+    Cache* cache = caches_.allocate();
+    if (!cache) {
+      return nullptr;
+    }
+    cache->owner = this;
+    {
+      std::lock_guard<std::mutex> guard(registryLock_);
+      cache->id = nextId_++;
+      cache->prev = nullptr;
+      cache->next = registry_;
+      if (registry_) {
+        registry_->prev = cache;
+      }
+      registry_ = cache;
+      if constexpr (kBudgeted) {
+        if (!taskAdded_) {
+          taskAdded_ = Maintenance::instance().add(&rebalanceTask, this);
+        }
+      }
+    }
+    ctx->threadCache = cache;
+    ctx->release = &releaseCache;
+    ctx->heap = this;
+    return cache;
+  }
+
+  static void releaseCache(AllocContext* ctx) {
+    Cache* cache = static_cast<Cache*>(ctx->threadCache);
+    ThreadCache* self = cache->owner;
+    {
+      std::lock_guard<std::mutex> guard(self->registryLock_);
+      (cache->prev ? cache->prev->next : self->registry_) = cache->next;
+      if (cache->next) {
+        cache->next->prev = cache->prev;
+      }
+    }
+    {
+      Hold hold(cache);  // Waits out a thief that found it before the unlink
+      self->trim(cache, 0);
+      if constexpr (kBudgeted) {
+        self->giveBack(cache, cache->share.capacity.load(std::memory_order_relaxed));
+      }
+    }
+    self->caches_.deallocate(cache);
+  }
+
+  static size_t countOf(const Cache* cache) {
+    size_t total = 0;
+    for (size_t cls = 1; cls < Classes::kNumClasses; cls++) {
+      total += cache->lists[cls].count;
+    }
+    return total;
+  }
+
+  ALLOC8_ALWAYS_INLINE
+  static void charge(Cache* cache, ptrdiff_t delta) {
+    cache->bytes.store(cache->bytes.load(std::memory_order_relaxed) + delta,
+                       std::memory_order_relaxed);
+  }
+
+  // Other threads' access to a cache (registry lock held)
+  static bool tryHold(Cache* cache) {
+    bool expected = false;
+    return cache->share.busy.compare_exchange_strong(
+        expected, true, std::memory_order_acquire, std::memory_order_relaxed);
+  }
+
+  static void release(Cache* cache) {
+    cache->share.busy.store(false, std::memory_order_release);
+  }
+
+  static void rebalanceTask(void* self) {
+    static_cast<ThreadCache*>(self)->rebalance();
+  }
+
+  // Return `bytes` of `cache`'s capacity to the pool
+  void giveBack(Cache* cache, size_t bytes) {
+    cache->share.capacity.fetch_sub(bytes, std::memory_order_relaxed);
+    unclaimed_.fetch_add(static_cast<long long>(bytes), std::memory_order_relaxed);
+  }
+
+  // Free (held) cache is over its capacity: claim more, else flush down to it
+  ALLOC8_NOINLINE
+  void overBudget(Cache* cache) {
+    Share& share = cache->share;
+    size_t bytes = cache->bytes.load(std::memory_order_relaxed);
+    size_t capacity = share.capacity.load(std::memory_order_relaxed);
+    size_t want = (bytes - capacity + kCapacityStep - 1) / kCapacityStep * kCapacityStep;
+
+    long long avail = unclaimed_.load(std::memory_order_relaxed);
+    while (avail > 0) {
+      size_t take = std::min(want, static_cast<size_t>(avail));
+      if (unclaimed_.compare_exchange_weak(avail, avail - static_cast<long long>(take),
+                                           std::memory_order_relaxed)) {
+        share.capacity.fetch_add(take, std::memory_order_relaxed);
+        want -= take;
+        break;
+      }
+    }
+    if (want > 0) {
+      steal(cache, want);
+    }
+    capacity = share.capacity.load(std::memory_order_relaxed);
+    if (cache->bytes.load(std::memory_order_relaxed) > capacity) {
+      trim(cache, capacity);
+    }
+  }
+
+  // Move up to `want` bytes of capacity from caches larger than `cache`,
+  // never leaving a victim smaller than the thief
+  void steal(Cache* cache, size_t want) {
+    std::lock_guard<std::mutex> guard(registryLock_);
+    for (Cache* victim = registry_; victim && want > 0; victim = victim->next) {
+      if (victim == cache) {
+        continue;
+      }
+      size_t mine = cache->share.capacity.load(std::memory_order_relaxed);
+      size_t theirs = victim->share.capacity.load(std::memory_order_relaxed);
+      if (theirs <= mine || !tryHold(victim)) {
+        continue;
+      }
+      theirs = victim->share.capacity.load(std::memory_order_relaxed);
+      size_t take = theirs > mine ? std::min(want, (theirs - mine + 1) / 2) : 0;
+      victim->share.capacity.fetch_sub(take, std::memory_order_relaxed);
+      trim(victim, theirs - take);
+      release(victim);
+      cache->share.capacity.fetch_add(take, std::memory_order_relaxed);
+      want -= take;
+    }
+  }
+
+  // Flush a held cache's lists, largest classes first, until it holds at
+  // most `target` bytes
+  void trim(Cache* cache, size_t target) {
+    for (size_t cls = Classes::kNumClasses - 1; cls >= 1; cls--) {
+      FreeList& list = cache->lists[cls];
+      size_t sz = Classes::classToSize(cls);
+      while (list.count) {
+        size_t bytes = cache->bytes.load(std::memory_order_relaxed);
+        if (bytes <= target) {
+          return;
+        }
+        size_t n = (bytes - target + sz - 1) / sz;
+        flush(cache, list, cls, n < kMaxCount ? n : kMaxCount);
+      }
+    }
+  }
+
+  ALLOC8_NOINLINE
+  void* refill(Cache* cache, FreeList& list, size_t cls) {
+    void* batch[kMaxCount / 2];
+    size_t want = limit(cls) / 2;
+    size_t sz = Classes::classToSize(cls);
+    if constexpr (kBudgeted) {
+      // Keep the refill within capacity; the first object is not cached
+      size_t bytes = cache->bytes.load(std::memory_order_relaxed);
+      size_t capacity = cache->share.capacity.load(std::memory_order_relaxed);
+      size_t room = capacity > bytes ? (capacity - bytes) / sz + 1 : 1;
+      want = std::min(want, room);
+    }
+    size_t got = 0;
+    if constexpr (requires(Heap& h, void** out) { h.mallocBatch(sz, out, want); }) {
+      got = Heap::mallocBatch(sz, batch, want);
+    } else {
+      while (got < want && (batch[got] = Heap::malloc(sz)) != nullptr) {
+        got++;
+      }
+    }
+    if (got == 0) {
+      return Heap::malloc(sz);
+    }
+    if constexpr (AddressOrdered) {
+      std::sort(batch, batch + got, std::less<void*>());
+    }
+    // Keep the first object, cache the rest in allocation order
+    for (size_t i = got - 1; i >= 1; i--) {
+      *static_cast<void**>(batch[i]) = list.head;
+      list.head = batch[i];
+    }
+    list.count += static_cast<uint32_t>(got - 1);
+    charge(cache, static_cast<ptrdiff_t>((got - 1) * sz));
+    return batch[0];
+  }
+
+  ALLOC8_NOINLINE
+  void flush(Cache* cache, FreeList& list, size_t cls, size_t n) {
+    void* batch[kMaxCount];
+    size_t count = 0;
+    while (count < n && list.head) {
+      batch[count++] = list.head;
+      list.head = *static_cast<void**>(list.head);
+    }
+    list.count -= static_cast<uint32_t>(count);
+    charge(cache, -static_cast<ptrdiff_t>(count * Classes::classToSize(cls)));
+    if constexpr (requires(Heap& h, void** ptrs) { h.freeBatch(ptrs, count); }) {
+      Heap::freeBatch(batch, count);
+    } else {
+      for (size_t i = 0; i < count; i++) {
+        Heap::free(batch[i]);
+      }
+    }
+  }
+};
+
+} // namespace alloc8
@@ -80,6 +80,23 @@ void xxthread_init(void);
  */
 void xxthread_cleanup(void);
 
+/**
+ * alloc8_thread_idle / alloc8_thread_busy - Application idle notifications
+ *
+ * Unlike the hooks above, these are called by the application, not by
+ * alloc8. A worker calls alloc8_thread_idle() before it blocks for a long
+ * time (waiting on a queue, a socket, a condition variable) and
+ * alloc8_thread_busy() when it resumes. ALLOC8_THREAD_REDIRECT forwards
+ * them to the allocator's optional threadIdle()/threadBusy() members;
+ * alloc8::ThreadCache returns the thread's cached objects to the shared
+ * heap on idle and refills lazily once the thread allocates again.
+ *
+ * Both are cheap to call when there is nothing to release. Declare them
+ * weak in code that may run without an alloc8 allocator preloaded.
+ */
+void alloc8_thread_idle(void);
+void alloc8_thread_busy(void);
+
 /**
  * xxthread_created_flag - Global flag set when first thread is created
  *
@@ -0,0 +1,152 @@
+// alloc8/virtual_buffer.h - Growable buffer that never moves
+#pragma once
+
+#include "platform.h"
+#include "os_memory.h"
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+namespace alloc8 {
+
+// ─── VIRTUAL BUFFER ───────────────────────────────────────────────────────────
+
+/**
+ * VirtualBuffer: A contiguous byte buffer that grows in place.
+ *
+ * The whole maximum size is reserved up front as inaccessible address space
+ * (osReserve), and pages are committed (osCommit) only as the buffer grows.
+ * Growth never copies and never moves the data, so pointers into the buffer
+ * stay valid, and memory use never doubles during growth the way it does
+ * with realloc or std::vector.
+ *
+ * Commits happen in geometrically growing steps, capped at kMaxCommitStep,
+ * which keeps the number of mprotect calls logarithmic for small buffers and
+ * linear (at a large step) for huge ones. Committed pages that are never
+ * touched use no physical memory.
+ *
+ * Not thread-safe; synchronize externally if shared.
+ */
+class VirtualBuffer {
+public:
+  static constexpr size_t kDefaultReserve = size_t(1) << 30;       // 1 GiB
+  static constexpr size_t kMinCommitStep = 64 * 1024;
+  static constexpr size_t kMaxCommitStep = 64 * 1024 * 1024;
+
+  /**
+   * Reserve `maxBytes` of address space (rounded up to pages). Check
+   * valid() afterwards: the reservation can fail.
+   */
+  explicit VirtualBuffer(size_t maxBytes = kDefaultReserve)
+    : capacity_(alignUp(maxBytes ? maxBytes : 1, ALLOC8_PAGE_SIZE)) {
+    base_ = static_cast<char*>(osReserve(capacity_));
+    if (!base_) {
+      capacity_ = 0;
+    }
+  }
+
+  ~VirtualBuffer() {
+    if (base_) {
+      osUnmap(base_, capacity_);
+    }
+  }
+
+  VirtualBuffer(const VirtualBuffer&) = delete;
+  VirtualBuffer& operator=(const VirtualBuffer&) = delete;
+
+  VirtualBuffer(VirtualBuffer&& other) noexcept
+    : base_(other.base_), size_(other.size_),
+      committed_(other.committed_), capacity_(other.capacity_) {
+    other.base_ = nullptr;
+    other.size_ = other.committed_ = other.capacity_ = 0;
+  }
+
+  bool valid() const { return base_ != nullptr; }
+  char* data() const { return base_; }
+  size_t size() const { return size_; }
+  size_t committed() const { return committed_; }
+  size_t capacity() const { return capacity_; }
+
+  /**
+   * Set the size, committing pages as needed. Pages committed for the first
+   * time read as zero; bytes re-exposed after a shrink are unspecified.
+   * @return false (and leave the buffer unchanged) if `n` exceeds capacity()
+   *         or the OS refuses to commit
+   */
+  bool resize(size_t n) {
+    if (n > committed_ && !commit(n)) {
+      return false;
+    }
+    size_ = n;
+    return true;
+  }
+
+  /**
+   * Extend the buffer by `n` bytes.
+   * @return Pointer to the new bytes, or nullptr if the buffer is full
+   */
+  void* grow(size_t n) {
+    size_t old = size_;
+    if (n > capacity_ - size_ || !resize(old + n)) {
+      return nullptr;
+    }
+    return base_ + old;
+  }
+
+  /**
+   * Append a copy of `n` bytes from `src`.
+   * @return Pointer to the appended bytes, or nullptr if the buffer is full
+   */
+  void* append(const void* src, size_t n) {
+    void* dst = grow(n);
+    if (dst && n) {
+      std::memcpy(dst, src, n);
+    }
+    return dst;
+  }
+
+  /**
+   * Drop the contents (keeps committed pages for reuse).
+   */
+  void clear() { size_ = 0; }
+
+  /**
+   * Return committed pages beyond size() to the OS. The address range stays
+   * reserved, so the buffer can grow again without moving.
+   */
+  void trim() {
+    size_t keep = alignUp(size_, ALLOC8_PAGE_SIZE);
+    if (keep < committed_) {
+      osDecommit(base_ + keep, committed_ - keep);
+      committed_ = keep;
+    }
+  }
+
+private:
+  char* base_ = nullptr;
+  size_t size_ = 0;
+  size_t committed_ = 0;
+  size_t capacity_;
+
+  bool commit(size_t needed) {
+    if (needed > capacity_) {
+      return false;
+    }
+    size_t step = committed_ < kMinCommitStep ? kMinCommitStep
+                : committed_ > kMaxCommitStep ? kMaxCommitStep : committed_;
+    size_t target = alignUp(needed, ALLOC8_PAGE_SIZE);
+    if (target - committed_ < step) {
+      target = committed_ + step;
+    }
+    if (target > capacity_) {
+      target = capacity_;
+    }
+    if (!osCommit(base_ + committed_, target - committed_)) {
+      return false;
+    }
+    committed_ = target;
+    return true;
+  }
+};
+
+} // namespace alloc8
@@ -0,0 +1,294 @@
+// alloc8/src/common/heap_dump.cpp
+// Compact heap dump built on xxmalloc_iterate
+//
+// Writes a text summary of the live heap: totals, a power-of-two size
+// histogram, and a page occupancy histogram. Everything here is malloc-free
+// (static accumulators, a stack output buffer and raw write()), so it can run
+// inside an interposed process without perturbing the heap it is measuring.
+//
+// Nothing runs until alloc8_heap_dump() is called, or at exit when the
+// ALLOC8_HEAP_DUMP environment variable names an output file.
+
+#include <alloc8/alloc8.h>
+#include <alloc8/mmap_stats.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <mutex>
+
+#if defined(_WIN32)
+#include <io.h>
+#define ALLOC8_WRITE _write
+#define ALLOC8_OPEN _open
+#define ALLOC8_CLOSE _close
+#else
+#include <unistd.h>
+#define ALLOC8_WRITE write
+#define ALLOC8_OPEN open
+#define ALLOC8_CLOSE close
+#endif
+
+#if defined(__linux__)
+// Present when ${ALLOC8_MMAP_SOURCES} is linked in (see mmap_stats.h)
+extern "C" {
+  __attribute__((weak)) int alloc8_mmap_tag_stats(alloc8_mmap_stats_callback, void*);
+  __attribute__((weak)) int alloc8_mmap_site_stats(alloc8_mmap_stats_callback, void*);
+}
+#endif
+
+namespace {
+
+constexpr int kSizeBuckets = 48;   // [2^i, 2^(i+1)) bytes
+constexpr int kFillBuckets = 10;   // 10% occupancy steps
+
+struct DumpState {
+  uint64_t objects;
+  uint64_t bytes;
+  uint64_t pages;
+  uint64_t sizeCount[kSizeBuckets];
+  uint64_t sizeBytes[kSizeBuckets];
+  uint64_t pageFill[kFillBuckets + 1];
+  uintptr_t currentPage;
+  uint64_t currentPageBytes;
+};
+
+// One dump at a time; state is static so the callback never allocates.
+std::mutex g_dumpMutex;
+DumpState g_state;
+
+void flushPage(DumpState& s) {
+  if (s.currentPageBytes == 0) {
+    return;
+  }
+  uint64_t fill = s.currentPageBytes * kFillBuckets / ALLOC8_PAGE_SIZE;
+  if (fill > kFillBuckets) fill = kFillBuckets;
+  s.pageFill[fill]++;
+  s.pages++;
+  s.currentPageBytes = 0;
+}
+
+// Charge [addr, addr + size) to the pages it touches. Objects arrive in
+// address order within a span, so a single "current page" accumulator is
+// enough to build the occupancy histogram.
+void chargePages(DumpState& s, uintptr_t addr, uint64_t size) {
+  while (size > 0) {
+    uintptr_t page = addr & ~(uintptr_t)(ALLOC8_PAGE_SIZE - 1);
+    if (page != s.currentPage) {
+      flushPage(s);
+      s.currentPage = page;
+    }
+    uint64_t chunk = page + ALLOC8_PAGE_SIZE - addr;
+    if (chunk > size) chunk = size;
+    s.currentPageBytes += chunk;
+    addr += chunk;
+    size -= chunk;
+  }
+}
+
+void dumpCallback(void* ptr, size_t size, void* ctx) {
+  DumpState& s = *static_cast<DumpState*>(ctx);
+  s.objects++;
+  s.bytes += size;
+  int bucket = 0;
+  for (size_t v = size; v > 1 && bucket < kSizeBuckets - 1; v >>= 1) {
+    bucket++;
+  }
+  s.sizeCount[bucket]++;
+  s.sizeBytes[bucket] += size;
+  chargePages(s, reinterpret_cast<uintptr_t>(ptr), size);
+}
+
+// ─── MALLOC-FREE OUTPUT ───────────────────────────────────────────────────────
+
+class Writer {
+  int fd_;
+  char buf_[1024];
+  size_t len_ = 0;
+
+public:
+  explicit Writer(int fd) : fd_(fd) {}
+  ~Writer() { flush(); }
+
+  void flush() {
+    size_t off = 0;
+    while (off < len_) {
+      auto n = ALLOC8_WRITE(fd_, buf_ + off, static_cast<unsigned>(len_ - off));
+      if (n <= 0) break;
+      off += static_cast<size_t>(n);
+    }
+    len_ = 0;
+  }
+
+  Writer& str(const char* s) {
+    while (*s) {
+      if (len_ == sizeof(buf_)) flush();
+      buf_[len_++] = *s++;
+    }
+    return *this;
+  }
+
+  Writer& num(uint64_t v) {
+    char tmp[24];
+    int n = 0;
+    do {
+      tmp[n++] = static_cast<char>('0' + v % 10);
+      v /= 10;
+    } while (v);
+    while (n) {
+      if (len_ == sizeof(buf_)) flush();
+      buf_[len_++] = tmp[--n];
+    }
+    return *this;
+  }
+
+  Writer& hex(uint64_t v) {
+    char tmp[16];
+    int n = 0;
+    do {
+      tmp[n++] = "0123456789abcdef"[v & 15];
+      v >>= 4;
+    } while (v);
+    str("0x");
+    while (n) {
+      if (len_ == sizeof(buf_)) flush();
+      buf_[len_++] = tmp[--n];
+    }
+    return *this;
+  }
+};
+
+void cacheCallback(const alloc8_cache_stats* stats, void* ctx) {
+  Writer& out = *static_cast<Writer*>(ctx);
+  out.str("cache ").num(stats->id).str(" ")
+     .num(stats->bytes).str(" ")
+     .num(stats->capacity).str(" ")
+     .num(stats->idle).str("\n");
+}
+
+void spanSizingCallback(const alloc8_span_sizing_stats* stats, void* ctx) {
+  Writer& out = *static_cast<Writer*>(ctx);
+  out.str("span_sizing ").num(stats->owner).str(" ")
+     .num(stats->size).str(" ")
+     .num(stats->pages).str(" ")
+     .num(stats->base).str(" ")
+     .num(stats->grows).str(" ")
+     .num(stats->shrinks).str(" ")
+     .num(stats->refills).str("\n");
+}
+
+void mmapTagCallback(const alloc8_mmap_stats* stats, void* ctx) {
+  Writer& out = *static_cast<Writer*>(ctx);
+  out.str("mmap_tag ").str(stats->tag).str(" ")
+     .num(stats->bytes).str(" ")
+     .num(stats->peak).str(" ")
+     .num(stats->calls).str("\n");
+}
+
+void mmapSiteCallback(const alloc8_mmap_stats* stats, void* ctx) {
+  Writer& out = *static_cast<Writer*>(ctx);
+  out.str("mmap_site ").hex(reinterpret_cast<uintptr_t>(stats->site)).str(" ")
+     .str(stats->tag).str(" ")
+     .num(stats->bytes).str(" ")
+     .num(stats->peak).str(" ")
+     .num(stats->calls).str("\n");
+}
+
+} // anonymous namespace
+
+extern "C" {
+
+/**
+ * Write a heap dump to `fd`.
+ *
+ * Objects held in thread caches and central free lists are left out of
+ * the totals, except those in other threads' unbudgeted caches (see
+ * ThreadCache::iterate()), which the cache lines account for.
+ *
+ * Format (one record per line, space separated):
+ *   objects <n>
+ *   bytes <n>
+ *   pages <n>                               pages holding live data
+ *   size <lo> <hi> <count> <bytes>          per power-of-two size bucket
+ *   page_fill <lo%> <hi%> <pages>           per 10% occupancy bucket
+ *   cache <id> <bytes> <capacity> <idle>    per thread cache, if any
+ *   span_sizing <owner> <size> <pages> <base> <grows> <shrinks> <refills>
+ *                                           per size class, with adaptive
+ *                                           span sizing
+ *   mmap_tag <tag> <bytes> <peak> <calls>   per anonymous-mapping tag, if
+ *                                           mmap accounting is linked in
+ *   mmap_site <pc> <tag> <bytes> <peak> <calls>
+ *                                           per mmap call site, likewise
+ *
+ * @return 0 on success, -1 if the allocator does not support iteration
+ */
+ALLOC8_EXPORT int alloc8_heap_dump(int fd) {
+  std::lock_guard<std::mutex> guard(g_dumpMutex);
+  memset(&g_state, 0, sizeof(g_state));
+  if (xxmalloc_iterate(dumpCallback, &g_state) != 0) {
+    return -1;
+  }
+  flushPage(g_state);
+
+  Writer out(fd);
+  out.str("# alloc8 heap dump\n");
+  out.str("objects ").num(g_state.objects).str("\n");
+  out.str("bytes ").num(g_state.bytes).str("\n");
+  out.str("pages ").num(g_state.pages).str("\n");
+  for (int i = 0; i < kSizeBuckets; i++) {
+    if (g_state.sizeCount[i] == 0) continue;
+    out.str("size ").num(uint64_t(1) << i).str(" ")
+       .num((uint64_t(1) << (i + 1)) - 1).str(" ")
+       .num(g_state.sizeCount[i]).str(" ")
+       .num(g_state.sizeBytes[i]).str("\n");
+  }
+  for (int i = 0; i <= kFillBuckets; i++) {
+    if (g_state.pageFill[i] == 0) continue;
+    uint64_t lo = uint64_t(i) * 100 / kFillBuckets;
+    uint64_t hi = (i == kFillBuckets) ? 100 : uint64_t(i + 1) * 100 / kFillBuckets;
+    out.str("page_fill ").num(lo).str(" ").num(hi).str(" ")
+       .num(g_state.pageFill[i]).str("\n");
+  }
+  xxmalloc_cache_stats(cacheCallback, &out);
+  xxmalloc_span_sizing_stats(spanSizingCallback, &out);
+#if defined(__linux__)
+  if (alloc8_mmap_tag_stats && alloc8_mmap_site_stats) {
+    alloc8_mmap_tag_stats(mmapTagCallback, &out);
+    alloc8_mmap_site_stats(mmapSiteCallback, &out);
+  }
+#endif
+  return 0;
+}
+
+} // extern "C"
+
+// ─── DUMP AT EXIT ─────────────────────────────────────────────────────────────
+
+namespace {
+
+char g_dumpPath[4096];
+
+void dumpAtExit() {
+  int fd = ALLOC8_OPEN(g_dumpPath, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  if (fd < 0) {
+    return;
+  }
+  alloc8_heap_dump(fd);
+  ALLOC8_CLOSE(fd);
+}
+
+struct DumpAtExitRegistrar {
+  DumpAtExitRegistrar() {
+    const char* path = getenv("ALLOC8_HEAP_DUMP");
+    if (path && *path && strlen(path) < sizeof(g_dumpPath)) {
+      strcpy(g_dumpPath, path);
+      atexit(dumpAtExit);
+    }
+  }
+};
+
+DumpAtExitRegistrar g_dumpAtExitRegistrar;
+
+} // anonymous namespace
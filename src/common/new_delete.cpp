@@ -15,10 +15,26 @@ extern "C" {
   void* xxmemalign(size_t, size_t);
 }
 
+// ─── CALLER-AWARE ENTRY POINTS ────────────────────────────────────────────────
+// operator new passes its own return address, so heaps that attribute
+// allocations to callers (ModuleHeap) see the code that called new rather
+// than this file. ALLOC8_REDIRECT defines the strong versions; these weak
+// ones serve allocators that define xxmalloc themselves.
+
+extern "C" {
+  __attribute__((weak)) void* xxmalloc_from(const void*, size_t sz) {
+    return xxmalloc(sz);
+  }
+
+  __attribute__((weak)) void* xxmemalign_from(const void*, size_t alignment, size_t sz) {
+    return xxmemalign(alignment, sz);
+  }
+}
+
 // ─── THROWING VARIANTS ────────────────────────────────────────────────────────
 
 ALLOC8_EXPORT void* operator new(std::size_t sz) {
-  void* ptr = xxmalloc(sz);
+  void* ptr = xxmalloc_from(__builtin_return_address(0), sz);
   if (ALLOC8_UNLIKELY(!ptr)) {
     throw std::bad_alloc();
   }
@@ -26,7 +42,7 @@ ALLOC8_EXPORT void* operator new(std::size_t sz) {
 }
 
 ALLOC8_EXPORT void* operator new[](std::size_t sz) {
-  void* ptr = xxmalloc(sz);
+  void* ptr = xxmalloc_from(__builtin_return_address(0), sz);
   if (ALLOC8_UNLIKELY(!ptr)) {
     throw std::bad_alloc();
   }
@@ -36,11 +52,11 @@ ALLOC8_EXPORT void* operator new[](std::size_t sz) {
 // ─── NON-THROWING VARIANTS ────────────────────────────────────────────────────
 
 ALLOC8_EXPORT void* operator new(std::size_t sz, const std::nothrow_t&) noexcept {
-  return xxmalloc(sz);
+  return xxmalloc_from(__builtin_return_address(0), sz);
 }
 
 ALLOC8_EXPORT void* operator new[](std::size_t sz, const std::nothrow_t&) noexcept {
-  return xxmalloc(sz);
+  return xxmalloc_from(__builtin_return_address(0), sz);
 }
 
 // ─── DELETE OPERATORS ─────────────────────────────────────────────────────────
@@ -80,7 +96,7 @@ ALLOC8_EXPORT void operator delete[](void* ptr, std::size_t) noexcept {
 #if defined(__cpp_aligned_new) && __cpp_aligned_new >= 201606L
 
 ALLOC8_EXPORT void* operator new(std::size_t sz, std::align_val_t al) {
-  void* ptr = xxmemalign(static_cast<std::size_t>(al), sz);
+  void* ptr = xxmemalign_from(__builtin_return_address(0), static_cast<std::size_t>(al), sz);
   if (ALLOC8_UNLIKELY(!ptr)) {
     throw std::bad_alloc();
   }
@@ -88,7 +104,7 @@ ALLOC8_EXPORT void* operator new(std::size_t sz, std::align_val_t al) {
 }
 
 ALLOC8_EXPORT void* operator new[](std::size_t sz, std::align_val_t al) {
-  void* ptr = xxmemalign(static_cast<std::size_t>(al), sz);
+  void* ptr = xxmemalign_from(__builtin_return_address(0), static_cast<std::size_t>(al), sz);
   if (ALLOC8_UNLIKELY(!ptr)) {
     throw std::bad_alloc();
   }
@@ -96,11 +112,11 @@ ALLOC8_EXPORT void* operator new[](std::size_t sz, std::align_val_t al) {
 }
 
 ALLOC8_EXPORT void* operator new(std::size_t sz, std::align_val_t al, const std::nothrow_t&) noexcept {
-  return xxmemalign(static_cast<std::size_t>(al), sz);
+  return xxmemalign_from(__builtin_return_address(0), static_cast<std::size_t>(al), sz);
 }
 
 ALLOC8_EXPORT void* operator new[](std::size_t sz, std::align_val_t al, const std::nothrow_t&) noexcept {
-  return xxmemalign(static_cast<std::size_t>(al), sz);
+  return xxmemalign_from(__builtin_return_address(0), static_cast<std::size_t>(al), sz);
 }
 
 ALLOC8_EXPORT void operator delete(void* ptr, std::align_val_t) noexcept {
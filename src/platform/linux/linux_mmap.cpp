@@ -0,0 +1,539 @@
+// alloc8/src/platform/linux/linux_mmap.cpp
+// Linux mmap/munmap/mremap/brk/sbrk interposition for memory accounting
+//
+// Charges every live anonymous mapping to the call site that made it and to
+// a tag (see alloc8/mmap_stats.h), so RSS that does not come from the heap
+// can be attributed.
+//
+// Like linux_threads.cpp, this avoids dlsym, which can call malloc: the
+// mapping calls go straight to the kernel with syscall(), and sbrk uses
+// glibc's exported __sbrk. The range table that remembers each mapping's
+// owner is itself mapped with raw system calls, so no accounting path can
+// re-enter the interposed functions or the allocator. That table is a skip
+// list, so mmap stays O(log n) however many mappings are live.
+
+#ifndef __linux__
+#error "This file is for Linux only"
+#endif
+
+#include <alloc8/mmap_stats.h>
+#include <alloc8/platform.h>
+
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <atomic>
+#include <cstdarg>
+#include <cstdint>
+#include <cstring>
+#include <thread>
+
+extern "C" {
+  // glibc's sbrk; it keeps the cached program break (__curbrk) current
+  void* __sbrk(intptr_t);
+
+  // Bounds of the image this file is linked into, from the linker. Weak, so
+  // a linker that does not define them just disables the "alloc8" tag.
+  __attribute__((weak, visibility("hidden"))) extern const char __ehdr_start[];
+  __attribute__((weak, visibility("hidden"))) extern const char _end[];
+}
+
+namespace {
+
+// ─── RAW SYSTEM CALLS ────────────────────────────────────────────────────────
+
+void* rawMmap(void* addr, size_t len, int prot, int flags, int fd, off_t off) {
+  return reinterpret_cast<void*>(syscall(SYS_mmap, addr, len, prot, flags, fd, off));
+}
+
+int rawMunmap(void* addr, size_t len) {
+  return static_cast<int>(syscall(SYS_munmap, addr, len));
+}
+
+uintptr_t pageEnd(uintptr_t start, size_t len) {
+  return start + ((len + ALLOC8_PAGE_SIZE - 1) & ~uintptr_t(ALLOC8_PAGE_SIZE - 1));
+}
+
+// ─── TAGS AND CALL SITES ─────────────────────────────────────────────────────
+
+constexpr uint32_t kMaxTags = 64;
+constexpr uint32_t kMaxSites = 1024;      // Power of two (open addressing)
+constexpr uint32_t kOverflowSite = kMaxSites;
+
+// Fixed tags, in g_tags order
+constexpr uint16_t kUntagged = 0;
+constexpr uint16_t kStack = 1;
+constexpr uint16_t kSelf = 2;
+constexpr uint16_t kBrk = 3;
+constexpr uint16_t kOther = 4;
+constexpr uint16_t kFixedTags = 5;
+
+struct Counter {
+  int64_t bytes;
+  uint64_t peak;
+  uint64_t calls;
+
+  void charge(int64_t delta) {
+    bytes += delta;
+    if (bytes > 0 && static_cast<uint64_t>(bytes) > peak) {
+      peak = static_cast<uint64_t>(bytes);
+    }
+  }
+};
+
+struct Tag {
+  const char* name;
+  Counter counter;
+};
+
+struct Site {
+  uintptr_t pc;       // 0 = empty slot
+  uint16_t lastTag;
+  Counter counter;
+};
+
+// A live anonymous mapping [start, end); never overlapping
+struct Range {
+  uintptr_t start;
+  uintptr_t end;
+  uint32_t site;
+  uint16_t tag;
+};
+
+// The range table is a skip list ordered by address, so a mapping made at
+// either end of a long table costs O(log n) rather than shifting an array.
+// Nodes live in one raw mapping and link by index, so growing it is a copy.
+constexpr uint32_t kLevels = 12;          // Levels of 1/4 each: 16M ranges
+constexpr uint32_t kNil = 0;              // Node 0 is the head, never a link
+
+struct Node {
+  Range range;
+  uint32_t next[kLevels];                 // Only the node's own levels are set
+};
+
+std::atomic<bool> g_lock{false};
+Tag g_tags[kMaxTags] = {
+  {"untagged", {}}, {"stack", {}}, {"alloc8", {}}, {"brk", {}}, {"other", {}},
+};
+uint32_t g_tagCount = kFixedTags;
+Site g_sites[kMaxSites + 1];              // Last slot: overflow site
+Node* g_nodes = nullptr;
+uint32_t g_nodeCount = 0;                 // Nodes ever used, head included
+uint32_t g_nodeCapacity = 0;
+uint32_t g_freeNode = kNil;               // Free list, linked through next[0]
+uint64_t g_levelSeed = 0x9e3779b97f4a7c15ull;
+
+ALLOC8_TLS const char* t_tag;
+
+class Guard {
+public:
+  Guard() {
+    while (ALLOC8_UNLIKELY(g_lock.exchange(true, std::memory_order_acquire))) {
+      std::this_thread::yield();
+    }
+  }
+  ~Guard() { g_lock.store(false, std::memory_order_release); }
+};
+
+bool fromSelf(const void* pc) {
+  if (__ehdr_start == nullptr || _end == nullptr) {
+    return false;
+  }
+  const char* p = static_cast<const char*>(pc);
+  return p >= __ehdr_start && p < _end;
+}
+
+// Tag for a new mapping; call with g_lock held
+uint16_t tagLocked(const char* name, bool stack, const void* pc) {
+  if (name == nullptr) {
+    return stack ? kStack : (fromSelf(pc) ? kSelf : kUntagged);
+  }
+  for (uint32_t i = 0; i < g_tagCount; i++) {
+    if (g_tags[i].name == name || strcmp(g_tags[i].name, name) == 0) {
+      return static_cast<uint16_t>(i);
+    }
+  }
+  if (g_tagCount == kMaxTags) {
+    return kOther;
+  }
+  g_tags[g_tagCount].name = name;
+  return static_cast<uint16_t>(g_tagCount++);
+}
+
+// Site slot for a call site; call with g_lock held
+uint32_t siteLocked(const void* pc) {
+  uintptr_t key = reinterpret_cast<uintptr_t>(pc);
+  uint32_t slot = static_cast<uint32_t>((key * 0x9e3779b97f4a7c15ull) >> 54) & (kMaxSites - 1);
+  for (uint32_t probe = 0; probe < kMaxSites; probe++) {
+    Site& site = g_sites[slot];
+    if (site.pc == key) {
+      return slot;
+    }
+    if (site.pc == 0) {
+      site.pc = key;
+      return slot;
+    }
+    slot = (slot + 1) & (kMaxSites - 1);
+  }
+  return kOverflowSite;
+}
+
+void chargeLocked(uint16_t tag, uint32_t site, int64_t delta) {
+  g_tags[tag].counter.charge(delta);
+  g_sites[site].counter.charge(delta);
+  g_sites[site].lastTag = tag;
+}
+
+void countCallLocked(uint16_t tag, uint32_t site) {
+  g_tags[tag].counter.calls++;
+  g_sites[site].counter.calls++;
+}
+
+// ─── RANGE TABLE ─────────────────────────────────────────────────────────────
+
+// First range that ends after `addr`, or kNil. `update` receives the last
+// node before it on every level.
+uint32_t lowerBoundLocked(uintptr_t addr, uint32_t* update) {
+  uint32_t x = 0;
+  for (uint32_t level = kLevels; level-- > 0;) {
+    uint32_t next = g_nodes[x].next[level];
+    while (next != kNil && g_nodes[next].range.end <= addr) {
+      x = next;
+      next = g_nodes[x].next[level];
+    }
+    update[level] = x;
+  }
+  return g_nodes[x].next[0];
+}
+
+// A free node, growing the pool if needed; kNil when out of memory
+uint32_t newNodeLocked() {
+  if (g_freeNode != kNil) {
+    uint32_t node = g_freeNode;
+    g_freeNode = g_nodes[node].next[0];
+    return node;
+  }
+  if (g_nodeCount == g_nodeCapacity) {
+    uint32_t capacity = g_nodeCapacity ? g_nodeCapacity * 2
+                                       : static_cast<uint32_t>(ALLOC8_PAGE_SIZE / sizeof(Node));
+    void* mem = rawMmap(nullptr, capacity * sizeof(Node), PROT_READ | PROT_WRITE,
+                        MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (mem == MAP_FAILED) {
+      return kNil;
+    }
+    if (g_nodes) {
+      memcpy(mem, g_nodes, g_nodeCount * sizeof(Node));
+      rawMunmap(g_nodes, g_nodeCapacity * sizeof(Node));
+    }
+    g_nodes = static_cast<Node*>(mem);
+    g_nodeCapacity = capacity;
+    if (g_nodeCount == 0) {
+      g_nodeCount = 1;  // The head; fresh anonymous memory, so all kNil
+    }
+  }
+  return g_nodeCount++;
+}
+
+uint32_t randomLevelLocked() {
+  g_levelSeed ^= g_levelSeed << 13;
+  g_levelSeed ^= g_levelSeed >> 7;
+  g_levelSeed ^= g_levelSeed << 17;
+  uint64_t bits = g_levelSeed;
+  uint32_t level = 1;
+  while (level < kLevels && (bits & 3) == 0) {
+    level++;
+    bits >>= 2;
+  }
+  return level;
+}
+
+// Link `range` into the table; false when out of memory for bookkeeping
+bool insertLocked(const Range& range) {
+  uint32_t node = newNodeLocked();
+  if (node == kNil) {
+    return false;
+  }
+  uint32_t update[kLevels];
+  lowerBoundLocked(range.start, update);
+  g_nodes[node].range = range;
+  for (uint32_t level = 0, top = randomLevelLocked(); level < top; level++) {
+    g_nodes[node].next[level] = g_nodes[update[level]].next[level];
+    g_nodes[update[level]].next[level] = node;
+  }
+  return true;
+}
+
+// Unlink `node`, whose predecessors are `update`; they stay valid for the
+// node after it
+void eraseLocked(uint32_t node, const uint32_t* update) {
+  for (uint32_t level = 0; level < kLevels; level++) {
+    if (g_nodes[update[level]].next[level] == node) {
+      g_nodes[update[level]].next[level] = g_nodes[node].next[level];
+    }
+  }
+  g_nodes[node].next[0] = g_freeNode;
+  g_freeNode = node;
+}
+
+// Forget [start, end) and uncharge its owners
+void removeLocked(uintptr_t start, uintptr_t end) {
+  if (g_nodes == nullptr) {
+    return;
+  }
+  uint32_t update[kLevels];
+  uint32_t i = lowerBoundLocked(start, update);
+  while (i != kNil && g_nodes[i].range.start < end) {
+    Range& r = g_nodes[i].range;
+    uintptr_t lo = r.start > start ? r.start : start;
+    uintptr_t hi = r.end < end ? r.end : end;
+    chargeLocked(r.tag, r.site, -static_cast<int64_t>(hi - lo));
+    if (r.start < start && r.end > end) {
+      // Hole in the middle: keep both sides
+      Range tail = r;
+      tail.start = end;
+      r.end = start;
+      if (!insertLocked(tail)) {
+        chargeLocked(tail.tag, tail.site, -static_cast<int64_t>(tail.end - tail.start));
+      }
+      return;
+    }
+    if (r.start < start) {
+      r.end = start;
+      i = lowerBoundLocked(start, update);  // Now the node after it
+    } else if (r.end > end) {
+      r.start = end;
+      break;
+    } else {
+      uint32_t next = g_nodes[i].next[0];
+      eraseLocked(i, update);
+      i = next;
+    }
+  }
+}
+
+// Remember [start, end) for its owner and charge it; the space is free
+void addLocked(uintptr_t start, uintptr_t end, uint16_t tag, uint32_t site) {
+  if (!insertLocked(Range{start, end, site, tag})) {
+    return;  // Out of memory for bookkeeping: the mapping goes uncounted
+  }
+  chargeLocked(tag, site, static_cast<int64_t>(end - start));
+}
+
+// Range containing `addr`, or nullptr
+const Range* findLocked(uintptr_t addr) {
+  if (g_nodes == nullptr) {
+    return nullptr;
+  }
+  uint32_t update[kLevels];
+  uint32_t i = lowerBoundLocked(addr, update);
+  if (i != kNil && g_nodes[i].range.start <= addr) {
+    return &g_nodes[i].range;
+  }
+  return nullptr;
+}
+
+// ─── ACCOUNTING ──────────────────────────────────────────────────────────────
+
+void recordMap(void* ptr, size_t len, int flags, const void* pc) {
+  uintptr_t start = reinterpret_cast<uintptr_t>(ptr);
+  uintptr_t end = pageEnd(start, len);
+  Guard guard;
+  removeLocked(start, end);  // MAP_FIXED replaces whatever was there
+  if (flags & MAP_ANONYMOUS) {
+    uint16_t tag = tagLocked(t_tag, (flags & MAP_STACK) != 0, pc);
+    uint32_t site = siteLocked(pc);
+    countCallLocked(tag, site);
+    addLocked(start, end, tag, site);
+  }
+}
+
+void recordUnmap(void* ptr, size_t len) {
+  uintptr_t start = reinterpret_cast<uintptr_t>(ptr);
+  Guard guard;
+  removeLocked(start, pageEnd(start, len));
+}
+
+void recordRemap(void* oldPtr, size_t oldLen, void* newPtr, size_t newLen, int flags) {
+  uintptr_t oldStart = reinterpret_cast<uintptr_t>(oldPtr);
+  uintptr_t newStart = reinterpret_cast<uintptr_t>(newPtr);
+  uintptr_t oldEnd = pageEnd(oldStart, oldLen);
+  uintptr_t newEnd = pageEnd(newStart, newLen);
+  Guard guard;
+  const Range* owner = findLocked(oldStart);
+  if (owner == nullptr) {
+    removeLocked(newStart, newEnd);  // Not anonymous (or not seen being made)
+    return;
+  }
+  uint16_t tag = owner->tag;
+  uint32_t site = owner->site;
+  countCallLocked(tag, site);
+  if (newStart == oldStart) {
+    if (newEnd > oldEnd) {
+      addLocked(oldEnd, newEnd, tag, site);
+    } else {
+      removeLocked(newEnd, oldEnd);
+    }
+    return;
+  }
+  if (oldLen != 0 && !(flags & MREMAP_DONTUNMAP)) {
+    removeLocked(oldStart, oldEnd);
+  }
+  removeLocked(newStart, newEnd);
+  addLocked(newStart, newEnd, tag, site);
+}
+
+void recordBrk(int64_t delta, const void* pc) {
+  Guard guard;
+  uint16_t tag = (t_tag != nullptr) ? tagLocked(t_tag, false, pc) : kBrk;
+  uint32_t site = siteLocked(pc);
+  countCallLocked(tag, site);
+  chargeLocked(tag, site, delta);
+}
+
+alloc8_mmap_stats toStats(const char* tag, const void* site, const Counter& c) {
+  alloc8_mmap_stats stats;
+  stats.tag = tag;
+  stats.site = site;
+  stats.bytes = c.bytes > 0 ? static_cast<uint64_t>(c.bytes) : 0;
+  stats.peak = c.peak;
+  stats.calls = c.calls;
+  return stats;
+}
+
+ALLOC8_ALWAYS_INLINE
+void* mapAndRecord(void* addr, size_t len, int prot, int flags, int fd, off_t off,
+                   const void* pc) {
+  void* ptr = rawMmap(addr, len, prot, flags, fd, off);
+  if (ptr != MAP_FAILED) {
+    recordMap(ptr, len, flags, pc);
+  }
+  return ptr;
+}
+
+// ─── FORK SAFETY ─────────────────────────────────────────────────────────────
+
+// A fork while another thread holds g_lock would leave the child's table
+// locked for good. The heap maps memory under its own locks, so g_lock
+// must be taken after xxmalloc_lock(): prepare handlers run in reverse
+// order of registration, so these register before gnu_wrapper.cpp's
+// (default priority) when both are linked into the same image.
+void forkPrepare() {
+  while (g_lock.exchange(true, std::memory_order_acquire)) {
+    std::this_thread::yield();
+  }
+}
+
+void forkRelease() { g_lock.store(false, std::memory_order_release); }
+
+__attribute__((constructor(101)))
+void registerForkHandlers() {
+  pthread_atfork(forkPrepare, forkRelease, forkRelease);
+}
+
+} // anonymous namespace
+
+// ─── INTERPOSITION ───────────────────────────────────────────────────────────
+
+#define ATTRIBUTE_EXPORT __attribute__((visibility("default")))
+
+extern "C" {
+
+ATTRIBUTE_EXPORT ALLOC8_NOINLINE
+void* mmap(void* addr, size_t len, int prot, int flags, int fd, off_t off) __THROW {
+  return mapAndRecord(addr, len, prot, flags, fd, off, __builtin_return_address(0));
+}
+
+ATTRIBUTE_EXPORT ALLOC8_NOINLINE
+void* mmap64(void* addr, size_t len, int prot, int flags, int fd, off64_t off) __THROW {
+  return mapAndRecord(addr, len, prot, flags, fd, off, __builtin_return_address(0));
+}
+
+ATTRIBUTE_EXPORT int munmap(void* addr, size_t len) __THROW {
+  int result = rawMunmap(addr, len);
+  if (result == 0) {
+    recordUnmap(addr, len);
+  }
+  return result;
+}
+
+ATTRIBUTE_EXPORT void* mremap(void* oldAddr, size_t oldLen, size_t newLen, int flags, ...) __THROW {
+  void* newAddr = nullptr;
+  if (flags & MREMAP_FIXED) {
+    va_list args;
+    va_start(args, flags);
+    newAddr = va_arg(args, void*);
+    va_end(args);
+  }
+  void* result = reinterpret_cast<void*>(
+      syscall(SYS_mremap, oldAddr, oldLen, newLen, flags, newAddr));
+  if (result != MAP_FAILED) {
+    recordRemap(oldAddr, oldLen, result, newLen, flags);
+  }
+  return result;
+}
+
+ATTRIBUTE_EXPORT ALLOC8_NOINLINE void* sbrk(intptr_t delta) __THROW {
+  void* old = __sbrk(delta);
+  if (old != reinterpret_cast<void*>(-1) && delta != 0) {
+    recordBrk(delta, __builtin_return_address(0));
+  }
+  return old;
+}
+
+ATTRIBUTE_EXPORT ALLOC8_NOINLINE int brk(void* addr) __THROW {
+  char* current = static_cast<char*>(__sbrk(0));
+  intptr_t delta = static_cast<char*>(addr) - current;
+  if (__sbrk(delta) == reinterpret_cast<void*>(-1)) {
+    return -1;
+  }
+  if (delta != 0) {
+    recordBrk(delta, __builtin_return_address(0));
+  }
+  return 0;
+}
+
+// ─── STATS ───────────────────────────────────────────────────────────────────
+
+ATTRIBUTE_EXPORT const char* alloc8_mmap_tag(const char* tag) {
+  const char* previous = t_tag;
+  t_tag = tag;
+  return previous;
+}
+
+ATTRIBUTE_EXPORT int alloc8_mmap_tag_stats(alloc8_mmap_stats_callback cb, void* ctx) {
+  for (uint32_t i = 0; i < kMaxTags; i++) {
+    alloc8_mmap_stats stats;
+    {
+      Guard guard;
+      if (i >= g_tagCount) {
+        break;
+      }
+      if (g_tags[i].counter.calls == 0) {
+        continue;
+      }
+      stats = toStats(g_tags[i].name, nullptr, g_tags[i].counter);
+    }
+    cb(&stats, ctx);
+  }
+  return 0;
+}
+
+ATTRIBUTE_EXPORT int alloc8_mmap_site_stats(alloc8_mmap_stats_callback cb, void* ctx) {
+  for (uint32_t i = 0; i <= kMaxSites; i++) {
+    alloc8_mmap_stats stats;
+    {
+      Guard guard;
+      const Site& site = g_sites[i];
+      if (site.counter.calls == 0) {
+        continue;
+      }
+      stats = toStats(g_tags[site.lastTag].name, reinterpret_cast<const void*>(site.pc),
+                      site.counter);
+    }
+    cb(&stats, ctx);
+  }
+  return 0;
+}
+
+} // extern "C"
@@ -4,27 +4,63 @@
 // This file provides pthread_create/pthread_exit interposition that calls
 // the allocator's xxthread_init/xxthread_cleanup hooks.
 //
-// Uses direct calls to __pthread_create/__pthread_exit to avoid dlsym
-// (which can call malloc internally, causing recursion).
+// Uses direct calls to __pthread_create/__pthread_exit where glibc still
+// exports them (before 2.34), to avoid dlsym, which can call malloc. Newer
+// glibc only has the public names, which are resolved with dlsym(RTLD_NEXT)
+// on first use - after malloc is up, so the recursion cannot happen.
 
 #ifndef __linux__
 #error "This file is for Linux only"
 #endif
 
+#include <dlfcn.h>
 #include <pthread.h>
 #include <atomic>
 #include <cstdlib>
 
 // ─── REAL PTHREAD FUNCTIONS ─────────────────────────────────────────────────
-// Direct declarations of glibc internal symbols - avoids dlsym which can malloc
+// Direct declarations of glibc internal symbols - avoids dlsym which can malloc.
+// Weak: glibc 2.34 merged libpthread into libc and stopped exporting them.
 
 extern "C" {
   // glibc provides these as the "real" implementations
-  int __pthread_create(pthread_t*, const pthread_attr_t*,
-                       void* (*)(void*), void*);
-  void __pthread_exit(void*) __attribute__((__noreturn__));
+  __attribute__((weak)) int __pthread_create(pthread_t*, const pthread_attr_t*,
+                                             void* (*)(void*), void*);
+  __attribute__((weak, __noreturn__)) void __pthread_exit(void*);
 }
 
+namespace {
+
+using PthreadCreateFn = int (*)(pthread_t*, const pthread_attr_t*,
+                                void* (*)(void*), void*);
+using PthreadExitFn = void (*)(void*);
+
+PthreadCreateFn real_pthread_create() {
+  static PthreadCreateFn fn = [] {
+    if (&__pthread_create != nullptr) {
+      return &__pthread_create;
+    }
+    void* sym = dlvsym(RTLD_NEXT, "pthread_create", "GLIBC_2.34");
+    if (!sym) {
+      sym = dlsym(RTLD_NEXT, "pthread_create");
+    }
+    return reinterpret_cast<PthreadCreateFn>(sym);
+  }();
+  return fn;
+}
+
+PthreadExitFn real_pthread_exit() {
+  static PthreadExitFn fn = [] {
+    if (&__pthread_exit != nullptr) {
+      return &__pthread_exit;
+    }
+    return reinterpret_cast<PthreadExitFn>(dlsym(RTLD_NEXT, "pthread_exit"));
+  }();
+  return fn;
+}
+
+} // anonymous namespace
+
 // ─── WEAK SYMBOL DETECTION ───────────────────────────────────────────────────
 // These are defined by the allocator if it wants thread awareness.
 // If not defined, they resolve to nullptr and we skip interposition logic.
@@ -122,7 +158,7 @@ static int alloc8_pthread_create(
 {
   // If not ready or no hooks, pass through to real pthread_create
   if (!pthread_hooks_ready() || !has_thread_hooks()) {
-    return __pthread_create(thread, attr, start_routine, arg);
+    return real_pthread_create()(thread, attr, start_routine, arg);
   }
 
   // Mark that threads are being created (for lock optimization)
@@ -134,14 +170,14 @@ static int alloc8_pthread_create(
       xxmalloc(sizeof(ThreadWrapper)));
   if (!wrapper) {
     // Fall back to direct call if allocation fails
-    return __pthread_create(thread, attr, start_routine, arg);
+    return real_pthread_create()(thread, attr, start_routine, arg);
   }
 
   wrapper->user_func = start_routine;
   wrapper->user_arg = arg;
 
   // Create thread with our trampoline
-  int result = __pthread_create(thread, attr, alloc8_thread_trampoline, wrapper);
+  int result = real_pthread_create()(thread, attr, alloc8_thread_trampoline, wrapper);
 
   if (result != 0) {
     // Creation failed, free wrapper
@@ -160,7 +196,8 @@ static void alloc8_pthread_exit(void* value_ptr) {
   }
 
   // Call real pthread_exit (never returns)
-  __pthread_exit(value_ptr);
+  real_pthread_exit()(value_ptr);
+  __builtin_unreachable();
 }
 
 // ─── STRONG SYMBOL ALIASING ─────────────────────────────────────────────────
@@ -168,14 +205,39 @@ static void alloc8_pthread_exit(void* value_ptr) {
 
 #define ATTRIBUTE_EXPORT __attribute__((visibility("default")))
 
-// Strong aliases for pthread functions
-ATTRIBUTE_EXPORT int pthread_create(
+// pthread_create has two versions since glibc 2.34 (GLIBC_2.34 is the
+// default for newly linked programs), and the dynamic linker only binds a
+// reference to a definition of the same version, so export both. The
+// version script must declare a GLIBC_2.34 node.
+//
+// GCC's symver attribute survives LTO; a top-level .symver directive does not.
+#if defined(__has_attribute) && __has_attribute(symver)
+  #define ALLOC8_SYMVER(fn, version) __attribute__((symver(version)))
+  #define ALLOC8_SYMVER_ASM(fn, version)
+#else
+  #define ALLOC8_SYMVER(fn, version)
+  #define ALLOC8_SYMVER_ASM(fn, version) __asm__(".symver " #fn ", " version);
+#endif
+
+ATTRIBUTE_EXPORT ALLOC8_SYMVER(alloc8_pthread_create_2_34, "pthread_create@@GLIBC_2.34")
+int alloc8_pthread_create_2_34(
+    pthread_t* thread,
+    const pthread_attr_t* attr,
+    void* (*start_routine)(void*),
+    void* arg) {
+  return alloc8_pthread_create(thread, attr, start_routine, arg);
+}
+ALLOC8_SYMVER_ASM(alloc8_pthread_create_2_34, "pthread_create@@GLIBC_2.34")
+
+ATTRIBUTE_EXPORT ALLOC8_SYMVER(alloc8_pthread_create_2_2_5, "pthread_create@GLIBC_2.2.5")
+int alloc8_pthread_create_2_2_5(
     pthread_t* thread,
     const pthread_attr_t* attr,
     void* (*start_routine)(void*),
     void* arg) {
   return alloc8_pthread_create(thread, attr, start_routine, arg);
 }
+ALLOC8_SYMVER_ASM(alloc8_pthread_create_2_2_5, "pthread_create@GLIBC_2.2.5")
 
 ATTRIBUTE_EXPORT void pthread_exit(void* value_ptr) {
   alloc8_pthread_exit(value_ptr);
@@ -0,0 +1,35 @@
+// alloc8/tests/module_heap_lib.cpp
+// Shared object that test_module_heap loads with dlopen(): allocates
+// through a callback, so the callback's caller is code in this module.
+// test_module_heap_new allocates through its operator new instead.
+
+#include <cstddef>
+#include <new>
+
+namespace {
+volatile int calls;
+}
+
+extern "C" __attribute__((visibility("default")))
+void* module_heap_lib_alloc(void* (*alloc)(size_t), size_t sz) {
+  void* ptr = alloc(sz);
+  calls = calls + 1;  // Not a tail call: the return address stays in here
+  return ptr;
+}
+
+extern "C" __attribute__((visibility("default")))
+void* module_heap_lib_new(size_t sz, size_t alignment) {
+  void* ptr = alignment ? ::operator new[](sz, std::align_val_t(alignment))
+                        : new char[sz];
+  calls = calls + 1;
+  return ptr;
+}
+
+extern "C" __attribute__((visibility("default")))
+void module_heap_lib_delete(void* ptr, size_t alignment) {
+  if (alignment) {
+    ::operator delete[](ptr, std::align_val_t(alignment));
+  } else {
+    delete[] static_cast<char*>(ptr);
+  }
+}
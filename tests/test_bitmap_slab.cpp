@@ -0,0 +1,193 @@
+// alloc8/tests/test_bitmap_slab.cpp
+// BitmapSlab tests: slot search, batches, cross-thread frees, span reuse
+
+#undef NDEBUG  // Keep assertions active in Release builds
+
+#include <alloc8/ansi_wrapper.h>
+#include <alloc8/bitmap_slab.h>
+#include <alloc8/size_router.h>
+#include <alloc8/span_heap.h>
+#include <alloc8/thread_cache.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <cstdint>
+#include <cassert>
+#include <thread>
+#include <vector>
+
+// Simple test macro
+#define TEST(name) \
+  static void test_##name(); \
+  static struct Test_##name { \
+    Test_##name() { \
+      printf("Running %s... ", #name); \
+      test_##name(); \
+      printf("PASSED\n"); \
+    } \
+  } test_##name##_instance; \
+  static void test_##name()
+
+template<typename Heap>
+static size_t liveObjects(Heap& heap) {
+  size_t count = 0;
+  heap.iterate([](void*, size_t, void* ctx) {
+    ++*static_cast<size_t*>(ctx);
+  }, &count);
+  return count;
+}
+
+// ─── SLOT SEARCH ──────────────────────────────────────────────────────────────
+
+TEST(batch_is_address_ordered_and_distinct) {
+  static alloc8::BitmapSlab<32, 256> heap;
+  void* batch[100];
+  assert(heap.mallocBatch(32, batch, 100) == 100);
+  for (size_t i = 1; i < 100; i++) {
+    assert(static_cast<char*>(batch[i]) - static_cast<char*>(batch[i - 1]) == 32);
+  }
+  for (void* p : batch) {
+    assert(heap.getSize(p) == 32);
+    assert(reinterpret_cast<uintptr_t>(p) % 32 == 0);
+  }
+  assert(liveObjects(heap) == 100);
+  heap.freeBatch(batch, 100);
+  assert(liveObjects(heap) == 0);
+  assert(heap.malloc(33) == nullptr);
+}
+
+TEST(holes_are_refilled_lowest_first) {
+  static alloc8::BitmapSlab<64, 512> heap;
+  std::vector<void*> objs(512);
+  assert(heap.mallocBatch(64, objs.data(), objs.size()) == objs.size());
+  // Free one slot every 37, scattered over all eight bitmap words
+  std::vector<void*> holes;
+  for (size_t i = 5; i < objs.size(); i += 37) {
+    holes.push_back(objs[i]);
+    heap.free(objs[i]);
+  }
+  heap.free(holes[0]);  // Double free is ignored
+  assert(liveObjects(heap) == objs.size() - holes.size());
+  std::vector<void*> refill(holes.size());
+  assert(heap.mallocBatch(64, refill.data(), refill.size()) == refill.size());
+  assert(refill == holes);
+  assert(heap.spanBytes() == 512 * 64);  // Reused, no second span
+  heap.freeBatch(objs.data(), objs.size());
+  assert(heap.releaseEmpty() == 512 * 64);
+  assert(heap.spanBytes() == 0);
+}
+
+TEST(spans_fill_before_new_ones_and_release_empty) {
+  static alloc8::BitmapSlab<128, 64> heap;  // One word per span
+  std::vector<void*> objs(64 * 5);
+  for (void*& p : objs) {
+    p = heap.malloc(100);
+    assert(p != nullptr);
+    memset(p, 0xab, 128);
+  }
+  assert(heap.spanBytes() == 5 * 64 * 128);
+  // Empty one span, half-empty another, then allocate again
+  for (size_t i = 64; i < 128; i++) {
+    heap.free(objs[i]);
+  }
+  for (size_t i = 192; i < 224; i++) {
+    heap.free(objs[i]);
+  }
+  for (size_t i = 0; i < 96; i++) {
+    assert(heap.malloc(128) != nullptr);
+  }
+  assert(heap.spanBytes() == 5 * 64 * 128);
+  void* extra = heap.malloc(128);
+  assert(heap.spanBytes() == 6 * 64 * 128);
+  heap.free(extra);
+  assert(heap.releaseEmpty() == 64 * 128);
+  assert(liveObjects(heap) == objs.size());
+}
+
+// ─── CROSS-THREAD FREES ───────────────────────────────────────────────────────
+
+TEST(remote_frees_race_allocation) {
+  static alloc8::BitmapSlab<48, 4096> heap;
+  constexpr size_t kObjects = 200000;
+  std::vector<void*> handoff(kObjects);
+  std::atomic<size_t> published{0};
+  std::thread consumer([&] {
+    for (size_t i = 0; i < kObjects; i++) {
+      while (published.load(std::memory_order_acquire) <= i) {
+        std::this_thread::yield();
+      }
+      auto* p = static_cast<uint64_t*>(handoff[i]);
+      assert(p[0] == i && p[5] == ~uint64_t(i));
+      heap.free(p);
+    }
+  });
+  for (size_t i = 0; i < kObjects; i += 16) {
+    void* batch[16];
+    assert(heap.mallocBatch(48, batch, 16) == 16);
+    for (size_t j = 0; j < 16; j++) {
+      auto* p = static_cast<uint64_t*>(batch[j]);
+      p[0] = i + j;
+      p[5] = ~uint64_t(i + j);
+      handoff[i + j] = p;
+    }
+    published.store(i + 16, std::memory_order_release);
+  }
+  consumer.join();
+  assert(liveObjects(heap) == 0);
+  // Frees from the other thread made room; the heap never grew past what
+  // was in flight at once (at worst everything, if the consumer never ran)
+  // rounded up to whole spans.
+  assert(heap.spanBytes() <= (kObjects + 4096) * 48);
+  heap.releaseEmpty();
+  assert(heap.spanBytes() == 0);
+}
+
+// ─── COMPOSITION ──────────────────────────────────────────────────────────────
+
+TEST(serves_a_router_tier_under_a_thread_cache) {
+  using Small = alloc8::BitmapSlab<64, 1024>;
+  using Heap = alloc8::ANSIWrapper<alloc8::ThreadCache<alloc8::SizeRouterN<
+      alloc8::Route<64, Small>, alloc8::Route<SIZE_MAX, alloc8::SpanHeap<>>>>>;
+  static Heap heap;
+  std::vector<std::thread> threads;
+  for (int t = 0; t < 4; t++) {
+    threads.emplace_back([] {
+      std::vector<void*> objs;
+      for (int round = 0; round < 50; round++) {
+        for (size_t i = 0; i < 200; i++) {
+          size_t sz = (i % 3 == 0) ? 200 : 16 + i % 48;
+          void* p = heap.malloc(sz);
+          memset(p, 0x5a, sz);
+          objs.push_back(p);
+        }
+        for (void* p : objs) {
+          heap.free(p);
+        }
+        objs.clear();
+      }
+      heap.threadCleanup();
+    });
+  }
+  for (std::thread& t : threads) {
+    t.join();
+  }
+  void* small = heap.malloc(40);
+  void* big = heap.malloc(4000);
+  assert(heap.tier<0>().getSize(small) == 64);
+  assert(heap.tier<0>().getSize(big) == 0);
+  assert(heap.getSize(small) == 64);
+  heap.free(small);
+  heap.free(big);
+  heap.threadCleanup();
+  assert(liveObjects(heap.tier<0>()) == 0);
+}
+
+// ─── MAIN ─────────────────────────────────────────────────────────────────────
+
+int main() {
+  printf("\n=== alloc8 BitmapSlab Tests ===\n\n");
+  // Tests are run automatically via static constructors
+  printf("\n=== All tests passed! ===\n\n");
+  return 0;
+}
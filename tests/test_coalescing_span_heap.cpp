@@ -0,0 +1,222 @@
+// alloc8/tests/test_coalescing_span_heap.cpp
+// CoalescingSpanHeap tests: best fit, splitting, coalescing, chunk decay
+
+#undef NDEBUG  // Keep assertions active in Release builds
+
+#include <alloc8/ansi_wrapper.h>
+#include <alloc8/coalescing_span_heap.h>
+#include <alloc8/mmap_cache_heap.h>
+#include <alloc8/size_router.h>
+#include <alloc8/span_heap.h>
+
+#include <cstdio>
+#include <cstring>
+#include <cstdint>
+#include <cassert>
+#include <thread>
+#include <vector>
+
+// Simple test macro
+#define TEST(name) \
+  static void test_##name(); \
+  static struct Test_##name { \
+    Test_##name() { \
+      printf("Running %s... ", #name); \
+      test_##name(); \
+      printf("PASSED\n"); \
+    } \
+  } test_##name##_instance; \
+  static void test_##name()
+
+constexpr size_t kPage = ALLOC8_PAGE_SIZE;
+
+using Small = alloc8::CoalescingSpanHeap<256 * kPage>;
+
+template<typename Heap>
+static size_t liveObjects(Heap& heap) {
+  size_t count = 0;
+  heap.iterate([](void*, size_t, void* ctx) {
+    ++*static_cast<size_t*>(ctx);
+  }, &count);
+  return count;
+}
+
+static char* at(void* p, size_t pages) {
+  return static_cast<char*>(p) + pages * kPage;
+}
+
+// ─── BEST FIT AND SPLITTING ───────────────────────────────────────────────────
+
+TEST(runs_are_split_from_the_front_of_a_chunk) {
+  static Small heap;
+  void* a = heap.malloc(3 * kPage);
+  void* b = heap.malloc(1);
+  void* c = heap.malloc(5 * kPage - 100);
+  assert(b == at(a, 3) && c == at(b, 1));
+  assert(heap.getSize(a) == 3 * kPage);
+  assert(heap.getSize(b) == kPage);
+  assert(heap.getSize(c) == 5 * kPage);
+  alloc8::CoalescingSpanStats s = heap.stats();
+  assert(s.chunks == 1 && s.mappedBytes == 256 * kPage);
+  assert(s.liveBytes == 9 * kPage);
+  assert(s.largestFreeBytes == 247 * kPage);
+  assert(liveObjects(heap) == 3);
+  heap.free(a);
+  heap.free(b);
+  heap.free(c);
+  assert(liveObjects(heap) == 0);
+}
+
+TEST(best_fit_takes_the_shortest_hole) {
+  static Small heap;
+  // Holes of 40, 10 and 20 pages, each walled in by a live page
+  void* holes[3];
+  std::vector<void*> walls;
+  for (size_t i = 0; i < 3; i++) {
+    holes[i] = heap.malloc((i == 0 ? 40 : i == 1 ? 10 : 20) * kPage);
+    walls.push_back(heap.malloc(kPage));
+  }
+  for (void* h : holes) {
+    heap.free(h);
+  }
+  assert(heap.malloc(15 * kPage) == holes[2]);
+  assert(heap.malloc(10 * kPage) == holes[1]);
+  assert(heap.malloc(5 * kPage) == at(holes[2], 15));  // The split-off rest
+  assert(heap.malloc(30 * kPage) == holes[0]);
+  assert(heap.stats().chunks == 1);
+}
+
+TEST(aligned_runs_return_their_lead_pages) {
+  static Small heap;
+  void* first = heap.malloc(kPage);
+  void* aligned = heap.memalign(32 * kPage, 4 * kPage);
+  assert(reinterpret_cast<uintptr_t>(aligned) % (32 * kPage) == 0);
+  assert(heap.getSize(aligned) == 4 * kPage);
+  assert(heap.stats().liveBytes == 5 * kPage);
+  heap.free(aligned);
+  heap.free(first);
+  alloc8::CoalescingSpanStats s = heap.stats();
+  assert(s.liveBytes == 0 && s.largestFreeBytes == s.mappedBytes);
+}
+
+// ─── COALESCING ───────────────────────────────────────────────────────────────
+
+TEST(freed_neighbours_merge_back_into_one_run) {
+  static Small heap;
+  void* objs[6];
+  for (void*& p : objs) {
+    p = heap.malloc(7 * kPage);
+    memset(p, 0x5a, 7 * kPage);
+  }
+  heap.free(objs[4]);  // Free after a live run
+  heap.free(objs[1]);
+  heap.free(objs[3]);  // Merges with 4
+  heap.free(objs[2]);  // Merges with 1 and 3-4
+  assert(heap.malloc(28 * kPage) == objs[1]);
+  heap.free(objs[1]);
+  heap.free(objs[2]);  // Interior pointer of a free run: ignored
+  heap.free(objs[0]);
+  heap.free(objs[0]);  // Double free: ignored
+  heap.free(objs[5]);
+  alloc8::CoalescingSpanStats s = heap.stats();
+  assert(s.liveBytes == 0 && s.emptyChunks == 1);
+  assert(s.largestFreeBytes == 256 * kPage);
+  assert(heap.malloc(256 * kPage) == objs[0]);
+  heap.free(objs[0]);
+}
+
+TEST(resize_in_place_takes_the_following_free_run) {
+  static Small heap;
+  void* a = heap.malloc(4 * kPage);
+  void* b = heap.malloc(4 * kPage);
+  void* c = heap.malloc(4 * kPage);
+  heap.free(b);
+  assert(heap.resizeInPlace(a, 6 * kPage));
+  assert(heap.getSize(a) == 6 * kPage);
+  assert(heap.resizeInPlace(a, 8 * kPage));  // Takes the whole hole
+  assert(!heap.resizeInPlace(a, 9 * kPage));  // `c` is in the way
+  assert(heap.resizeInPlace(a, kPage));
+  assert(heap.stats().liveBytes == 12 * kPage);
+  heap.free(c);
+  assert(heap.resizeInPlace(a, 100 * kPage));
+  heap.free(a);
+  assert(heap.stats().largestFreeBytes == 256 * kPage);
+}
+
+// ─── CHUNKS AND DECAY ─────────────────────────────────────────────────────────
+
+TEST(empty_chunks_are_released_after_a_full_decay_period) {
+  static Small heap;
+  void* a = heap.malloc(200 * kPage);
+  void* b = heap.malloc(200 * kPage);  // Second chunk
+  void* big = heap.malloc(300 * kPage);  // A chunk of its own
+  assert(heap.stats().chunks == 3);
+  assert(heap.getSize(big) == 300 * kPage);
+  heap.free(a);
+  heap.free(big);
+  assert(heap.decay() == 0);  // Just emptied: kept for one more period
+  // Reusing an empty chunk and emptying it again restarts its period
+  // (best fit skips the 56 free pages beside `b` and the 300-page chunk)
+  heap.free(heap.malloc(100 * kPage));
+  assert(heap.stats().emptyChunks == 2);
+  assert(heap.decay() == 300 * kPage);
+  assert(heap.decay() == 256 * kPage);
+  alloc8::CoalescingSpanStats s = heap.stats();
+  assert(s.chunks == 1 && s.emptyChunks == 0);
+  heap.free(b);
+  assert(heap.releaseEmpty() == 256 * kPage);
+  assert(heap.stats().mappedBytes == 0);
+  assert(heap.getSize(b) == 0);
+}
+
+// ─── COMPOSITION ──────────────────────────────────────────────────────────────
+
+TEST(serves_the_medium_tier_of_a_router) {
+  using Heap = alloc8::ANSIWrapper<alloc8::SizeRouterN<
+      alloc8::Route<64 * 1024, alloc8::SpanHeap<>>,
+      alloc8::Route<(4 << 20), alloc8::CoalescingSpanHeap<(16 << 20)>>,
+      alloc8::Route<SIZE_MAX, alloc8::MmapCacheHeap<>>>>;
+  static Heap heap;
+  std::vector<std::thread> threads;
+  for (int t = 0; t < 4; t++) {
+    threads.emplace_back([t] {
+      std::vector<void*> objs;
+      for (int round = 0; round < 40; round++) {
+        for (size_t i = 0; i < 12; i++) {
+          size_t sz = (size_t(1) << (12 + (i + round + t) % 11)) + i * 100;
+          void* p = heap.malloc(sz);
+          memset(p, t, sz);
+          objs.push_back(p);
+        }
+        for (size_t i = 0; i < objs.size(); i += 2) {
+          objs[i] = heap.realloc(objs[i], heap.getSize(objs[i]) + 5000);
+        }
+        for (void* p : objs) {
+          heap.free(p);
+        }
+        objs.clear();
+      }
+    });
+  }
+  for (std::thread& t : threads) {
+    t.join();
+  }
+  auto& medium = heap.tier<1>();
+  void* p = heap.malloc(1 << 20);
+  assert(medium.getSize(p) == (1 << 20));
+  heap.free(p);
+  assert(liveObjects(medium) == 0);
+  alloc8::CoalescingSpanStats s = medium.stats();
+  assert(s.liveBytes == 0 && s.emptyChunks == s.chunks);
+  medium.releaseEmpty();
+  assert(medium.stats().mappedBytes == 0);
+}
+
+// ─── MAIN ─────────────────────────────────────────────────────────────────────
+
+int main() {
+  printf("\n=== alloc8 CoalescingSpanHeap Tests ===\n\n");
+  // Tests are run automatically via static constructors
+  printf("\n=== All tests passed! ===\n\n");
+  return 0;
+}
@@ -0,0 +1,128 @@
+// alloc8/tests/test_fixed_buffer_heap.cpp
+// RegionPageSource and io_uring FixedBufferHeap tests
+
+#undef NDEBUG  // Keep assertions active in Release builds
+
+#include <alloc8/fixed_buffer_heap.h>
+#include <alloc8/page_source.h>
+
+#include <cstdio>
+#include <cstring>
+#include <cstdint>
+#include <cassert>
+#include <cerrno>
+#include <vector>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+// Simple test macro
+#define TEST(name) \
+  static void test_##name(); \
+  static struct Test_##name { \
+    Test_##name() { \
+      printf("Running %s... ", #name); \
+      test_##name(); \
+      printf("PASSED\n"); \
+    } \
+  } test_##name##_instance; \
+  static void test_##name()
+
+constexpr size_t kMiB = 1024 * 1024;
+
+// ─── REGION PAGE SOURCE ───────────────────────────────────────────────────────
+
+TEST(region_runs_stay_inside_segments) {
+  static alloc8::RegionPageSource<kMiB, 256 * 1024> source;
+  assert(source.base() != nullptr);
+  constexpr size_t kRun = 48;  // 192 KiB: one run per 256 KiB segment
+  std::vector<void*> runs;
+  for (int i = 0; i < 4; i++) {
+    void* p = source.allocPages(kRun);
+    assert(p != nullptr);
+    size_t pos = static_cast<char*>(p) - source.base();
+    assert(pos / (256 * 1024) == (pos + kRun * ALLOC8_PAGE_SIZE - 1) / (256 * 1024));
+    runs.push_back(p);
+  }
+  assert(source.allocPages(kRun) == nullptr);  // Only 64 KiB left per segment
+  assert(source.allocPages(65) == nullptr);    // Larger than a segment's room
+  assert(source.allocPages(16) != nullptr);    // Fits in a segment's tail
+
+  source.freePages(runs[2], kRun);
+  assert(source.allocPages(kRun) == runs[2]);  // Lowest free run is reused
+}
+
+TEST(region_honors_alignment) {
+  static alloc8::RegionPageSource<kMiB> source;
+  void* first = source.allocPages(1);
+  assert(first != nullptr);
+  void* aligned = source.allocPages(2, 64 * 1024);
+  assert(aligned != nullptr);
+  assert(reinterpret_cast<uintptr_t>(aligned) % (64 * 1024) == 0);
+  assert(source.contains(aligned) && !source.contains(&source));
+}
+
+// ─── FIXED BUFFER HEAP ────────────────────────────────────────────────────────
+
+using TestHeap = alloc8::FixedBufferHeap<4 * kMiB, kMiB>;
+
+TEST(allocations_report_index_and_offset) {
+  static TestHeap heap;
+  static_assert(TestHeap::kBufferCount == 4);
+  std::vector<void*> blocks;
+  for (size_t sz : {16, 100, 4096, 65536, 300000, 900000, 700000}) {
+    alloc8::FixedBuffer buf = heap.mallocFixed(sz);
+    assert(buf.data != nullptr);
+    char* expected = heap.base() + buf.index * kMiB + buf.offset;
+    assert(static_cast<char*>(buf.data) == expected);
+    assert(buf.index < TestHeap::kBufferCount);
+    assert(buf.offset + sz <= kMiB);  // Never straddles a registered buffer
+    memset(buf.data, 0xAB, sz);
+    blocks.push_back(buf.data);
+  }
+  assert(heap.mallocFixed(2 * kMiB).data == nullptr);  // Larger than a buffer
+
+  alloc8::FixedBuffer outside;
+  int local = 0;
+  assert(!heap.locate(&local, outside));
+  for (void* p : blocks) {
+    heap.free(p);
+  }
+  alloc8::FixedBuffer again = heap.mallocFixed(900000);
+  assert(again.data != nullptr);
+  heap.free(again.data);
+}
+
+TEST(registers_with_io_uring) {
+  struct {
+    uint32_t sq_entries, cq_entries, flags, sq_thread_cpu, sq_thread_idle;
+    uint32_t features, wq_fd, resv[3];
+    uint64_t sq_off[5], cq_off[5];
+  } params = {};  // struct io_uring_params
+  static_assert(sizeof(params) == 120);
+  int ring = static_cast<int>(syscall(__NR_io_uring_setup, 4, &params));
+  if (ring < 0) {
+    printf("(io_uring unavailable: %s) ", strerror(errno));
+    return;
+  }
+  static TestHeap heap;
+  int rc = heap.registerBuffers(ring);
+  if (rc == -ENOMEM || rc == -EPERM) {
+    printf("(cannot pin buffers: %s) ", strerror(-rc));
+    close(ring);
+    return;
+  }
+  assert(rc == 0);
+  assert(heap.registerBuffers(ring) == -EBUSY);  // Registered once per ring
+  assert(heap.unregisterBuffers(ring) == 0);
+  assert(heap.unregisterBuffers(ring) == -ENXIO);
+  close(ring);
+}
+
+// ─── MAIN ─────────────────────────────────────────────────────────────────────
+
+int main() {
+  printf("\n=== alloc8 FixedBufferHeap Tests ===\n\n");
+  // Tests are run automatically via static constructors
+  printf("\n=== All tests passed! ===\n\n");
+  return 0;
+}
@@ -0,0 +1,225 @@
+// alloc8/tests/test_heap_iterate.cpp
+// Live-heap iteration tests for page-map based components
+
+#undef NDEBUG  // Keep assertions active in Release builds
+
+#include <alloc8/span_heap.h>
+
+#include <cstdio>
+#include <cstring>
+#include <cstdint>
+#include <cassert>
+
+// Simple test macro
+#define TEST(name) \
+  static void test_##name(); \
+  static struct Test_##name { \
+    Test_##name() { \
+      printf("Running %s... ", #name); \
+      test_##name(); \
+      printf("PASSED\n"); \
+    } \
+  } test_##name##_instance; \
+  static void test_##name()
+
+namespace {
+
+struct Tally {
+  size_t objects;
+  size_t bytes;
+  void* expect;
+  bool sawExpected;
+};
+
+void tallyCallback(void* ptr, size_t size, void* ctx) {
+  Tally* t = static_cast<Tally*>(ctx);
+  t->objects++;
+  t->bytes += size;
+  if (ptr == t->expect) {
+    t->sawExpected = true;
+  }
+}
+
+template<typename Heap>
+Tally tally(Heap& heap, void* expect = nullptr) {
+  Tally t = {0, 0, expect, false};
+  heap.iterate(tallyCallback, &t);
+  return t;
+}
+
+} // anonymous namespace
+
+// ─── TESTS ────────────────────────────────────────────────────────────────────
+
+TEST(iterate_empty) {
+  static alloc8::SpanHeap<> heap;
+  assert(tally(heap).objects == 0);
+}
+
+TEST(iterate_small_objects) {
+  static alloc8::SpanHeap<> heap;
+  const int count = 5000;
+  static void* ptrs[count];
+
+  for (int i = 0; i < count; i++) {
+    ptrs[i] = heap.malloc(24 + (i % 7) * 100);
+    assert(ptrs[i] != nullptr);
+    memset(ptrs[i], 0xAB, 24);
+  }
+  Tally t = tally(heap, ptrs[1234]);
+  assert(t.objects == count);
+  assert(t.sawExpected);
+
+  // Free every other object; the free list must hide them from iteration
+  for (int i = 0; i < count; i += 2) {
+    heap.free(ptrs[i]);
+  }
+  t = tally(heap, ptrs[1234]);
+  assert(t.objects == count / 2);
+  assert(!t.sawExpected);
+
+  for (int i = 1; i < count; i += 2) {
+    heap.free(ptrs[i]);
+  }
+  assert(tally(heap).objects == 0);
+}
+
+TEST(iterate_large_objects) {
+  static alloc8::SpanHeap<> heap;
+  void* big = heap.malloc(1 << 20);
+  void* small = heap.malloc(32);
+  assert(big && small);
+
+  Tally t = tally(heap, big);
+  assert(t.objects == 2);
+  assert(t.sawExpected);
+  assert(t.bytes >= (1 << 20) + 32);
+
+  heap.free(big);
+  t = tally(heap, big);
+  assert(t.objects == 1);
+  assert(!t.sawExpected);
+  heap.free(small);
+}
+
+TEST(iterate_separates_owners) {
+  static alloc8::SpanHeap<> a;
+  static alloc8::SpanHeap<> b;
+  void* pa = a.malloc(64);
+  void* pb1 = b.malloc(64);
+  void* pb2 = b.malloc(100000);
+  assert(tally(a).objects == 1);
+  assert(tally(b).objects == 2);
+  a.free(pa);
+  b.free(pb1);
+  b.free(pb2);
+}
+
+TEST(span_heap_get_size) {
+  static alloc8::SpanHeap<> heap;
+  for (size_t sz = 1; sz < 100000; sz = sz * 3 + 1) {
+    void* p = heap.malloc(sz);
+    assert(p != nullptr);
+    assert(heap.getSize(p) >= sz);
+    heap.free(p);
+  }
+}
+
+TEST(span_heap_memalign) {
+  static alloc8::SpanHeap<> heap;
+  for (size_t align = 16; align <= 65536; align *= 2) {
+    void* p = heap.memalign(align, 100);
+    assert(p != nullptr);
+    assert((reinterpret_cast<uintptr_t>(p) % align) == 0);
+    assert(heap.getSize(p) >= 100);
+    heap.free(p);
+  }
+}
+
+using OutOfBandHeap = alloc8::SpanHeap<alloc8::OSPageSource, alloc8::SizeClasses,
+                                       alloc8::OutOfBandSlab<>>;
+using ReleasingHeap = alloc8::SpanHeap<alloc8::OSPageSource, alloc8::SizeClasses,
+                                       alloc8::OutOfBandSlab<true>>;
+
+TEST(out_of_band_iterate_and_reuse) {
+  static OutOfBandHeap heap;
+  const int count = 3000;
+  static void* ptrs[count];
+
+  for (int i = 0; i < count; i++) {
+    ptrs[i] = heap.malloc(48);
+    assert(ptrs[i] != nullptr);
+  }
+  for (int i = 0; i < count; i += 3) {
+    heap.free(ptrs[i]);
+  }
+  Tally t = tally(heap, ptrs[3]);
+  assert(t.objects == count - (count + 2) / 3);
+  assert(!t.sawExpected);
+
+  // Freed slots are reused before new ones are carved
+  for (int i = 0; i < count; i += 3) {
+    ptrs[i] = heap.malloc(48);
+    assert(ptrs[i] != nullptr);
+  }
+  assert(tally(heap).objects == count);
+  for (int i = 0; i < count; i++) {
+    heap.free(ptrs[i]);
+  }
+  assert(tally(heap).objects == 0);
+}
+
+TEST(out_of_band_free_leaves_object_intact) {
+  static OutOfBandHeap heap;
+  void* keep = heap.malloc(64);
+  unsigned char* p = static_cast<unsigned char*>(heap.malloc(64));
+  assert(keep && p);
+  memset(p, 0x5A, 64);
+  heap.free(p);
+  // Free-slot state lives outside the object, so its bytes are untouched
+  for (int i = 0; i < 64; i++) {
+    assert(p[i] == 0x5A);
+  }
+  heap.free(keep);
+}
+
+TEST(out_of_band_release_empty_pages) {
+  static ReleasingHeap heap;
+  const int count = 2048;
+  static void* ptrs[count];
+
+  for (int i = 0; i < count; i++) {
+    ptrs[i] = heap.malloc(256);
+    assert(ptrs[i] != nullptr);
+    memset(ptrs[i], 0xCD, 256);
+  }
+  // Keep one object per 64 so spans stay alive while most pages empty out
+  for (int i = 0; i < count; i++) {
+    if (i % 64 != 0) heap.free(ptrs[i]);
+  }
+  assert(tally(heap).objects == count / 64);
+  for (int i = 0; i < count; i += 64) {
+    assert(*static_cast<unsigned char*>(ptrs[i]) == 0xCD);
+  }
+  // Released pages come back usable
+  for (int i = 0; i < count; i++) {
+    if (i % 64 != 0) {
+      ptrs[i] = heap.malloc(256);
+      assert(ptrs[i] != nullptr);
+      memset(ptrs[i], 0xEF, 256);
+    }
+  }
+  assert(tally(heap).objects == count);
+  for (int i = 0; i < count; i++) {
+    heap.free(ptrs[i]);
+  }
+}
+
+// ─── MAIN ─────────────────────────────────────────────────────────────────────
+
+int main() {
+  printf("\n=== alloc8 Heap Iteration Tests ===\n\n");
+  // Tests are run automatically via static constructors
+  printf("\n=== All tests passed! ===\n\n");
+  return 0;
+}
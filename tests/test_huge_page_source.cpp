@@ -0,0 +1,181 @@
+// alloc8/tests/test_huge_page_source.cpp
+// HugePageSource tests: packing, huge-page-preserving release, coverage
+
+#undef NDEBUG  // Keep assertions active in Release builds
+
+#include <alloc8/huge_page_source.h>
+#include <alloc8/span_heap.h>
+
+#include <cstdio>
+#include <cstring>
+#include <cstdint>
+#include <cassert>
+#include <vector>
+
+// Simple test macro
+#define TEST(name) \
+  static void test_##name(); \
+  static struct Test_##name { \
+    Test_##name() { \
+      printf("Running %s... ", #name); \
+      test_##name(); \
+      printf("PASSED\n"); \
+    } \
+  } test_##name##_instance; \
+  static void test_##name()
+
+using Source = alloc8::HugePageSource<>;
+
+constexpr size_t kHuge = Source::kHugePageSize;
+constexpr size_t kPerHuge = Source::kPagesPerHuge;
+
+static uintptr_t hugePageOf(const void* p) {
+  return reinterpret_cast<uintptr_t>(p) & ~(kHuge - 1);
+}
+
+// ─── FILLER ───────────────────────────────────────────────────────────────────
+
+TEST(small_runs_pack_into_one_huge_page) {
+  static Source source;
+  void* a = source.allocPages(1);
+  void* b = source.allocPages(4);
+  void* c = source.allocPages(16);
+  assert(a && b && c);
+  assert(hugePageOf(a) == hugePageOf(b) && hugePageOf(b) == hugePageOf(c));
+  memset(c, 0xab, 16 * ALLOC8_PAGE_SIZE);
+  alloc8::HugePageStats s = source.stats();
+  assert(s.hugePages == 1 && s.intactHugePages == 1);
+  assert(s.usedBytes == 21 * ALLOC8_PAGE_SIZE);
+  assert(s.backedBytes == kHuge);
+  assert(s.coverage == 1.0);
+  source.freePages(a, 1);
+  source.freePages(b, 4);
+  source.freePages(c, 16);
+  assert(source.stats().usedBytes == 0);
+}
+
+TEST(runs_prefer_tightest_fitting_huge_page) {
+  static Source source;
+  void* nearlyFull = source.allocPages(kPerHuge - 12);
+  void* light = source.allocPages(100);  // Does not fit in the first one
+  assert(hugePageOf(nearlyFull) != hugePageOf(light));
+  void* small = source.allocPages(8);
+  assert(hugePageOf(small) == hugePageOf(nearlyFull));
+  void* aligned = source.allocPages(8, 8 * ALLOC8_PAGE_SIZE);
+  assert(reinterpret_cast<uintptr_t>(aligned) % (8 * ALLOC8_PAGE_SIZE) == 0);
+  source.freePages(aligned, 8);
+  source.freePages(small, 8);
+  source.freePages(light, 100);
+  source.freePages(nearlyFull, kPerHuge - 12);
+}
+
+TEST(large_runs_are_huge_page_aligned) {
+  static Source source;
+  void* p = source.allocPages(kPerHuge + 88);
+  assert(p != nullptr);
+  assert(reinterpret_cast<uintptr_t>(p) % kHuge == 0);
+  memset(p, 1, (kPerHuge + 88) * ALLOC8_PAGE_SIZE);
+  alloc8::HugePageStats s = source.stats();
+  assert(s.hugePages == 1 && s.usedBytes == (kPerHuge + 88) * ALLOC8_PAGE_SIZE);
+  source.freePages(p, kPerHuge + 88);
+  assert(source.stats().usedBytes == 0 && source.stats().backedBytes == 0);
+}
+
+// ─── RELEASE ──────────────────────────────────────────────────────────────────
+
+TEST(empty_huge_pages_are_released_whole_first) {
+  static Source source;
+  void* keep = source.allocPages(kPerHuge / 2);
+  void* drop = source.allocPages(kPerHuge / 2 + 1);  // Needs a second huge page
+  assert(hugePageOf(keep) != hugePageOf(drop));
+  source.freePages(drop, kPerHuge / 2 + 1);
+  alloc8::HugePageStats s = source.stats();
+  assert(s.emptyHugePages == 1 && s.backedBytes == 2 * kHuge);
+  assert(s.subreleasedBytes == 0);
+
+  // One huge page's worth of pressure: the empty one goes, nothing splits
+  assert(source.releaseMemory(kHuge) == kHuge);
+  s = source.stats();
+  assert(s.emptyHugePages == 0 && s.backedBytes == kHuge);
+  assert(s.subreleasedBytes == 0 && s.coverage == 1.0);
+  source.freePages(keep, kPerHuge / 2);
+}
+
+TEST(subrelease_only_under_pressure) {
+  static Source source;
+  void* a = source.allocPages(64);
+  void* b = source.allocPages(64);
+  assert(hugePageOf(a) == hugePageOf(b));
+  source.freePages(b, 64);
+  alloc8::HugePageStats s = source.stats();
+  assert(s.subreleasedBytes == 0 && s.intactHugePages == 1 && s.coverage == 1.0);
+
+  size_t released = source.releaseMemory(SIZE_MAX);
+  assert(released == (kPerHuge - 64) * ALLOC8_PAGE_SIZE);
+  s = source.stats();
+  assert(s.subreleasedBytes == released);
+  assert(s.backedBytes == 64 * ALLOC8_PAGE_SIZE);
+  assert(s.intactHugePages == 0 && s.coverage == 0.0);
+
+  // Reusing subreleased pages brings them back
+  void* c = source.allocPages(32);
+  assert(hugePageOf(c) == hugePageOf(a));
+  memset(c, 0xcd, 32 * ALLOC8_PAGE_SIZE);
+  assert(source.stats().subreleasedBytes == released - 32 * ALLOC8_PAGE_SIZE);
+
+  // A broken huge page that empties is released whole, not cached
+  source.freePages(c, 32);
+  source.freePages(a, 64);
+  s = source.stats();
+  assert(s.backedBytes == 0 && s.subreleasedBytes == 0 && s.emptyHugePages == 0);
+}
+
+TEST(memory_limit_releases_after_free) {
+  static Source source;
+  source.setMemoryLimit(kHuge);
+  void* first = source.allocPages(kPerHuge - 1);
+  void* second = source.allocPages(kPerHuge - 1);
+  source.freePages(second, kPerHuge - 1);  // Cached empty would exceed the limit
+  alloc8::HugePageStats s = source.stats();
+  assert(s.emptyHugePages == 0 && s.backedBytes == kHuge);
+  assert(s.subreleasedBytes == 0);
+  source.freePages(first, kPerHuge - 1);
+}
+
+// ─── SPAN HEAP ────────────────────────────────────────────────────────────────
+
+TEST(span_heap_over_huge_pages) {
+  static alloc8::SpanHeap<Source> heap;
+  std::vector<void*> blocks;
+  for (size_t i = 0; i < 20000; i++) {
+    size_t sz = 16 + (i * 37) % 4000;
+    void* p = heap.malloc(sz);
+    assert(p != nullptr);
+    memset(p, static_cast<int>(i), sz);
+    blocks.push_back(p);
+  }
+  alloc8::HugePageStats s = heap.pageSource().stats();
+  assert(s.usedBytes > 0 && s.coverage == 1.0);
+  for (size_t i = 0; i < blocks.size(); i += 2) {
+    heap.free(blocks[i]);
+  }
+  for (size_t i = 1; i < blocks.size(); i += 2) {
+    heap.free(blocks[i]);
+  }
+  // Released spans left empty huge pages; the cache keeps at most four
+  s = heap.pageSource().stats();
+  assert(s.subreleasedBytes == 0);
+  assert(s.emptyHugePages > 0 && s.emptyHugePages <= 4);
+  size_t empties = s.emptyHugePages * kHuge;
+  assert(heap.pageSource().releaseMemory(empties) == empties);
+  assert(heap.pageSource().stats().subreleasedBytes == 0);
+}
+
+// ─── MAIN ─────────────────────────────────────────────────────────────────────
+
+int main() {
+  printf("\n=== alloc8 HugePageSource Tests ===\n\n");
+  // Tests are run automatically via static constructors
+  printf("\n=== All tests passed! ===\n\n");
+  return 0;
+}
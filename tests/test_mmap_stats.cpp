@@ -0,0 +1,233 @@
+// alloc8/tests/test_mmap_stats.cpp
+// Anonymous memory accounting tests (mmap/munmap/mremap/sbrk interposition)
+//
+// Links ${ALLOC8_MMAP_SOURCES} into the test itself, so the test's own
+// mapping calls are the interposed ones.
+
+#undef NDEBUG  // Keep assertions active in Release builds
+
+#include <alloc8/mmap_stats.h>
+#include <alloc8/platform.h>
+
+#include <atomic>
+#include <cstdio>
+#include <cstring>
+#include <cstdint>
+#include <cassert>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+// Simple test macro
+#define TEST(name) \
+  static void test_##name(); \
+  static struct Test_##name { \
+    Test_##name() { \
+      printf("Running %s... ", #name); \
+      test_##name(); \
+      printf("PASSED\n"); \
+    } \
+  } test_##name##_instance; \
+  static void test_##name()
+
+constexpr size_t kPage = ALLOC8_PAGE_SIZE;
+
+struct Lookup {
+  const char* tag;
+  alloc8_mmap_stats found;
+};
+
+static alloc8_mmap_stats tagStats(const char* tag) {
+  Lookup lookup{tag, {}};
+  alloc8_mmap_tag_stats([](const alloc8_mmap_stats* stats, void* ctx) {
+    Lookup& l = *static_cast<Lookup*>(ctx);
+    if (strcmp(stats->tag, l.tag) == 0) {
+      l.found = *stats;
+    }
+  }, &lookup);
+  return lookup.found;
+}
+
+static size_t siteCount(const char* tag) {
+  struct Count { const char* tag; size_t sites; } count{tag, 0};
+  alloc8_mmap_site_stats([](const alloc8_mmap_stats* stats, void* ctx) {
+    Count& c = *static_cast<Count*>(ctx);
+    if (strcmp(stats->tag, c.tag) == 0 && stats->site != nullptr) {
+      c.sites++;
+    }
+  }, &count);
+  return count.sites;
+}
+
+static void* mapAnon(size_t bytes, int extraFlags = 0) {
+  void* p = mmap(nullptr, bytes, PROT_READ | PROT_WRITE,
+                 MAP_PRIVATE | MAP_ANONYMOUS | extraFlags, -1, 0);
+  assert(p != MAP_FAILED);
+  return p;
+}
+
+// ─── MMAP / MUNMAP ────────────────────────────────────────────────────────────
+
+TEST(tagged_mapping_and_partial_unmap) {
+  const char* previous = alloc8_mmap_tag("jit");
+  char* p = static_cast<char*>(mapAnon(16 * kPage));
+  alloc8_mmap_tag(previous);
+
+  alloc8_mmap_stats s = tagStats("jit");
+  assert(s.bytes == 16 * kPage && s.peak == 16 * kPage && s.calls == 1);
+
+  // A hole in the middle, then the two sides
+  assert(munmap(p + 4 * kPage, 4 * kPage) == 0);
+  assert(tagStats("jit").bytes == 12 * kPage);
+  assert(munmap(p, 4 * kPage) == 0);
+  assert(munmap(p + 8 * kPage, 8 * kPage) == 0);
+  s = tagStats("jit");
+  assert(s.bytes == 0 && s.peak == 16 * kPage);
+}
+
+TEST(unmap_spanning_several_mappings) {
+  alloc8_mmap_tag("span");
+  char* p = static_cast<char*>(mapAnon(12 * kPage));
+  assert(munmap(p, 12 * kPage) == 0);
+  // Three separate mappings reusing the range; one munmap covers them all
+  for (int i = 0; i < 3; i++) {
+    void* q = mmap(p + i * 4 * kPage, 4 * kPage, PROT_READ | PROT_WRITE,
+                   MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED, -1, 0);
+    assert(q == p + i * 4 * kPage);
+  }
+  alloc8_mmap_tag(nullptr);
+  assert(tagStats("span").bytes == 12 * kPage);
+  assert(munmap(p + kPage, 10 * kPage) == 0);
+  assert(tagStats("span").bytes == 2 * kPage);
+  assert(munmap(p, 12 * kPage) == 0);
+  assert(tagStats("span").bytes == 0);
+}
+
+TEST(many_mappings_in_one_table) {
+  constexpr size_t kMappings = 20000;
+  alloc8_mmap_tag("many");
+  std::vector<char*> pages(kMappings);
+  for (char*& p : pages) {
+    p = static_cast<char*>(mapAnon(kPage));
+  }
+  alloc8_mmap_tag(nullptr);
+  assert(tagStats("many").bytes == kMappings * kPage);
+
+  // Every other mapping, then the rest one at a time
+  for (size_t i = 0; i < kMappings; i += 2) {
+    assert(munmap(pages[i], kPage) == 0);
+  }
+  assert(tagStats("many").bytes == kMappings / 2 * kPage);
+  for (size_t i = 1; i < kMappings; i += 2) {
+    assert(munmap(pages[i], kPage) == 0);
+  }
+  alloc8_mmap_stats s = tagStats("many");
+  assert(s.bytes == 0 && s.peak == kMappings * kPage && s.calls == kMappings);
+}
+
+TEST(fixed_file_mapping_replaces_anonymous_pages) {
+  alloc8_mmap_tag("arena");
+  char* p = static_cast<char*>(mapAnon(8 * kPage));
+  alloc8_mmap_tag(nullptr);
+  int fd = open("/dev/zero", O_RDONLY);
+  assert(fd >= 0);
+  void* q = mmap(p + 2 * kPage, 2 * kPage, PROT_READ, MAP_PRIVATE | MAP_FIXED, fd, 0);
+  assert(q == p + 2 * kPage);
+  close(fd);
+  assert(tagStats("arena").bytes == 6 * kPage);
+  assert(munmap(p, 8 * kPage) == 0);
+  assert(tagStats("arena").bytes == 0);
+}
+
+TEST(automatic_tags) {
+  size_t before = tagStats("stack").bytes;
+  void* stack = mapAnon(32 * kPage, MAP_STACK);
+  assert(tagStats("stack").bytes == before + 32 * kPage);
+  assert(munmap(stack, 32 * kPage) == 0);
+  assert(tagStats("stack").bytes == before);
+
+  // File-backed mappings are not anonymous memory
+  int fd = open("/dev/zero", O_RDONLY);
+  alloc8_mmap_tag("file");
+  void* f = mmap(nullptr, 4 * kPage, PROT_READ, MAP_PRIVATE, fd, 0);
+  alloc8_mmap_tag(nullptr);
+  assert(f != MAP_FAILED);
+  close(fd);
+  assert(tagStats("file").calls == 0);
+  munmap(f, 4 * kPage);
+}
+
+// ─── MREMAP ───────────────────────────────────────────────────────────────────
+
+TEST(mremap_keeps_owner) {
+  alloc8_mmap_tag("grow");
+  void* p = mapAnon(4 * kPage);
+  alloc8_mmap_tag(nullptr);
+  // Resized from an untagged thread state, still charged to "grow"
+  void* q = mremap(p, 4 * kPage, 64 * kPage, MREMAP_MAYMOVE);
+  assert(q != MAP_FAILED);
+  alloc8_mmap_stats s = tagStats("grow");
+  assert(s.bytes == 64 * kPage && s.calls == 2);
+  q = mremap(q, 64 * kPage, 2 * kPage, 0);
+  assert(q != MAP_FAILED);
+  assert(tagStats("grow").bytes == 2 * kPage);
+  assert(munmap(q, 2 * kPage) == 0);
+  assert(tagStats("grow").bytes == 0 && tagStats("grow").peak == 64 * kPage);
+}
+
+// ─── BRK AND CALL SITES ───────────────────────────────────────────────────────
+
+TEST(sbrk_is_charged_to_brk) {
+  size_t before = tagStats("brk").bytes;
+  void* old = sbrk(static_cast<intptr_t>(4 * kPage));
+  assert(old != reinterpret_cast<void*>(-1));
+  assert(tagStats("brk").bytes == before + 4 * kPage);
+  assert(sbrk(-static_cast<intptr_t>(4 * kPage)) != reinterpret_cast<void*>(-1));
+  assert(tagStats("brk").bytes == before);
+}
+
+TEST(call_sites_are_separate) {
+  alloc8_mmap_tag("sites");
+  void* a = mapAnon(kPage);
+  void* b = mmap(nullptr, kPage, PROT_READ, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  alloc8_mmap_tag(nullptr);
+  assert(siteCount("sites") == 2);
+  munmap(a, kPage);
+  munmap(b, kPage);
+}
+
+// ─── FORK ─────────────────────────────────────────────────────────────────────
+
+TEST(fork_while_another_thread_maps) {
+  std::atomic<bool> done{false};
+  std::thread mapper([&] {
+    while (!done.load(std::memory_order_relaxed)) {
+      munmap(mapAnon(kPage), kPage);
+    }
+  });
+  for (int i = 0; i < 50; i++) {
+    pid_t pid = fork();
+    if (pid == 0) {
+      alarm(5);  // A table left locked would hang the child here
+      munmap(mapAnon(kPage), kPage);
+      _exit(0);
+    }
+    int status = 0;
+    waitpid(pid, &status, 0);
+    assert(WIFEXITED(status) && WEXITSTATUS(status) == 0);
+  }
+  done.store(true, std::memory_order_relaxed);
+  mapper.join();
+}
+
+// ─── MAIN ─────────────────────────────────────────────────────────────────────
+
+int main() {
+  printf("\n=== alloc8 mmap Accounting Tests ===\n\n");
+  // Tests are run automatically via static constructors
+  printf("\n=== All tests passed! ===\n\n");
+  return 0;
+}
@@ -0,0 +1,260 @@
+// alloc8/tests/test_module_heap.cpp
+// ModuleTable / ModuleHeap tests: attribution to the calling module,
+// modules loaded and unloaded at run time, routing to the sub-heap and
+// frees by ownership, lookups racing table rebuilds, fork during a
+// rebuild
+
+#undef NDEBUG  // Keep assertions active in Release builds
+
+#include <alloc8/ansi_wrapper.h>
+#include <alloc8/module_heap.h>
+#include <alloc8/span_heap.h>
+#include <alloc8/thread_cache.h>
+
+#include <atomic>
+#include <cassert>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <dlfcn.h>
+#include <sys/wait.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+// Simple test macro
+#define TEST(name) \
+  static void test_##name(); \
+  static struct Test_##name { \
+    Test_##name() { \
+      printf("Running %s... ", #name); \
+      test_##name(); \
+      printf("PASSED\n"); \
+    } \
+  } test_##name##_instance; \
+  static void test_##name()
+
+using Heap = alloc8::ANSIWrapper<alloc8::ModuleHeap<
+    alloc8::ThreadCache<alloc8::SpanHeap<>>, alloc8::SpanHeap<>>>;
+
+static Heap& heap() {
+  static Heap instance;
+  return instance;
+}
+
+static alloc8::ModuleTable& modules() {
+  return alloc8::ModuleTable::instance();
+}
+
+// Stats of the module whose path is `name` or ends in "/name"
+static alloc8::ModuleStats statsOf(const char* name) {
+  struct Match {
+    const char* name;
+    alloc8::ModuleStats stats;
+  } match{name, {}};
+  modules().forEachModule([](const alloc8::ModuleStats* s, void* ctx) {
+    Match& m = *static_cast<Match*>(ctx);
+    const char* slash = strrchr(s->name, '/');
+    if (strcmp(s->name, m.name) == 0 || (slash && strcmp(slash + 1, m.name) == 0)) {
+      if (!m.stats.name || s->loaded) {
+        m.stats = *s;
+      }
+    }
+  }, &match);
+  return match.stats;
+}
+
+static void* libAlloc(size_t sz) {
+  return heap().malloc(sz);
+}
+
+using LibAllocFn = void* (*)(void* (*)(size_t), size_t);
+
+static const char* kLibName = strrchr(MODULE_HEAP_LIB, '/') + 1;
+
+// ─── ATTRIBUTION ──────────────────────────────────────────────────────────────
+
+ALLOC8_NOINLINE static void allocateHere(void** out, int count, size_t sz) {
+  for (int i = 0; i < count; i++) {
+    out[i] = heap().malloc(sz);
+  }
+}
+
+ALLOC8_NOINLINE static void freeHere(void** ptrs, int count) {
+  for (int i = 0; i < count; i++) {
+    heap().free(ptrs[i]);
+  }
+}
+
+TEST(calls_are_charged_to_the_calling_module) {
+  void* ptrs[3];
+  allocateHere(ptrs, 1, 8);  // First lookup builds the table
+  freeHere(ptrs, 1);
+
+  alloc8::ModuleStats before = statsOf("");
+  allocateHere(ptrs, 3, 96);
+  freeHere(ptrs, 3);
+  alloc8::ModuleStats after = statsOf("");
+  assert(after.name && after.loaded && !after.routed);
+  assert(after.mallocs - before.mallocs == 3);
+  assert(after.bytes - before.bytes == 288);
+  assert(after.frees - before.frees == 3);
+
+  // libc is a module of its own
+  uint32_t self = modules().find(reinterpret_cast<const void*>(&allocateHere));
+  uint32_t libc = modules().find(reinterpret_cast<const void*>(&strlen));
+  assert(self != alloc8::ModuleTable::kUnknown);
+  assert(libc != alloc8::ModuleTable::kUnknown && libc != self);
+}
+
+// ─── LOADING AND ROUTING ──────────────────────────────────────────────────────
+
+TEST(modules_loaded_later_are_found) {
+  assert(!statsOf(kLibName).name);
+  void* lib = dlopen(MODULE_HEAP_LIB, RTLD_NOW | RTLD_LOCAL);
+  assert(lib);
+  auto alloc = reinterpret_cast<LibAllocFn>(dlsym(lib, "module_heap_lib_alloc"));
+  assert(alloc);
+
+  void* ptr = alloc(&libAlloc, 112);
+  alloc8::ModuleStats s = statsOf(kLibName);
+  assert(s.name && s.loaded && !s.routed);
+  assert(s.mallocs == 1 && s.bytes == 112);
+  // Not routed: the main heap serves it
+  assert(alloc8::pageMap().get(ptr)->owner != heap().subHeap().owner());
+  heap().free(ptr);
+  dlclose(lib);
+}
+
+TEST(routed_modules_allocate_from_the_sub_heap) {
+  // Routing applies to modules loaded after the call, too
+  assert(heap().route(kLibName));
+  void* lib = dlopen(MODULE_HEAP_LIB, RTLD_NOW | RTLD_LOCAL);
+  assert(lib);
+  auto alloc = reinterpret_cast<LibAllocFn>(dlsym(lib, "module_heap_lib_alloc"));
+
+  void* routed = alloc(&libAlloc, 200);
+  void* mine = heap().malloc(200);
+  uint16_t sub = heap().subHeap().owner();
+  assert(alloc8::pageMap().get(routed)->owner == sub);
+  assert(alloc8::pageMap().get(mine)->owner != sub);
+  assert(heap().getSize(routed) >= 200);
+  assert(statsOf(kLibName).routed);
+
+  // Frees go by ownership, whoever makes them: the slot is free again
+  heap().free(routed);
+  void* again = alloc(&libAlloc, 200);
+  assert(again == routed);
+  heap().free(again);
+  heap().free(mine);
+
+  // The main program is still not routed
+  void* main = heap().malloc(64);
+  assert(alloc8::pageMap().get(main)->owner != sub);
+  heap().free(main);
+  dlclose(lib);
+}
+
+TEST(unloaded_modules_keep_their_counts) {
+  void* lib = dlopen(MODULE_HEAP_LIB, RTLD_NOW | RTLD_LOCAL);
+  assert(lib);
+  auto alloc = reinterpret_cast<LibAllocFn>(dlsym(lib, "module_heap_lib_alloc"));
+  heap().free(alloc(&libAlloc, 10));
+  uint64_t mallocs = statsOf(kLibName).mallocs;
+  assert(mallocs >= 4);
+
+  assert(dlclose(lib) == 0);
+  modules().refresh();
+  alloc8::ModuleStats s = statsOf(kLibName);
+  assert(s.name && !s.loaded);
+  assert(s.mallocs == mallocs);
+}
+
+// ─── CONCURRENCY ──────────────────────────────────────────────────────────────
+
+TEST(lookups_race_table_rebuilds) {
+  constexpr int kThreads = 4;
+  constexpr int kCalls = 50000;
+  const void* libc = reinterpret_cast<const void*>(&strlen);
+  uint32_t id = modules().find(libc);
+  Dl_info info;
+  assert(dladdr(libc, &info) && info.dli_fname);
+  uint64_t before = statsOf(info.dli_fname).mallocs;
+
+  std::atomic<bool> stop{false};
+  std::thread loader([&] {
+    while (!stop.load()) {
+      void* lib = dlopen(MODULE_HEAP_LIB, RTLD_NOW | RTLD_LOCAL);
+      modules().refresh();
+      dlclose(lib);
+      modules().refresh();
+    }
+  });
+  std::vector<std::thread> threads;
+  for (int t = 0; t < kThreads; t++) {
+    threads.emplace_back([&] {
+      for (int i = 0; i < kCalls; i++) {
+        assert(modules().find(libc) == id);
+        heap().free(heap().mallocFrom(libc, 32));
+      }
+      heap().threadCleanup();
+    });
+  }
+  for (auto& t : threads) {
+    t.join();
+  }
+  stop.store(true);
+  loader.join();
+  assert(statsOf(info.dli_fname).mallocs - before == uint64_t(kThreads) * kCalls);
+}
+
+// ─── FORK ─────────────────────────────────────────────────────────────────────
+
+TEST(fork_waits_for_a_table_rebuild) {
+  std::atomic<bool> held{false};
+  std::thread rebuilder([&] {
+    modules().lock();  // Stands in for a rebuild in progress
+    held.store(true);
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    modules().unlock();
+  });
+  while (!held.load()) {
+    std::this_thread::yield();
+  }
+  heap().lock();  // What xxmalloc_lock() does before fork()
+  pid_t pid = fork();
+  heap().unlock();
+  if (pid == 0) {
+    alarm(5);  // A table lock left held would hang the child here
+    void* lib = dlopen(MODULE_HEAP_LIB, RTLD_NOW | RTLD_LOCAL);
+    modules().refresh();
+    _exit(lib ? 0 : 1);
+  }
+  int status = 0;
+  waitpid(pid, &status, 0);
+  assert(WIFEXITED(status) && WEXITSTATUS(status) == 0);
+  rebuilder.join();
+}
+
+// ─── UNKNOWN CODE ─────────────────────────────────────────────────────────────
+
+TEST(code_outside_every_module_is_charged_to_unknown) {
+  // Last: a miss holds further miss-driven refreshes back for a while
+  alloc8::ModuleStats before = statsOf("[unknown]");
+  void* ptr = heap().mallocFrom(reinterpret_cast<const void*>(uintptr_t(16)), 24);
+  heap().free(ptr);
+  alloc8::ModuleStats after = statsOf("[unknown]");
+  assert(after.mallocs - before.mallocs == 1);
+  // ANSIWrapper rounds mallocFrom() requests as it does malloc()'s
+  assert(after.bytes - before.bytes == 32);
+}
+
+// ─── MAIN ─────────────────────────────────────────────────────────────────────
+
+int main() {
+  printf("\n=== alloc8 ModuleHeap Tests ===\n\n");
+  // Tests are run automatically via static constructors
+  printf("\n=== All tests passed! ===\n\n");
+  return 0;
+}
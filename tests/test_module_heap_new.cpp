@@ -0,0 +1,119 @@
+// alloc8/tests/test_module_heap_new.cpp
+// operator new over ModuleHeap: ALLOC8_REDIRECT and new_delete.cpp are
+// linked into this executable and exported, so module_heap_lib's operator
+// new calls bind to them. new is charged to, and routed for, the module
+// that calls it, not the module that defines operator new.
+
+#undef NDEBUG  // Keep assertions active in Release builds
+
+#include <alloc8/alloc8.h>
+#include <alloc8/ansi_wrapper.h>
+#include <alloc8/module_heap.h>
+#include <alloc8/span_heap.h>
+#include <alloc8/thread_cache.h>
+
+#include <cassert>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <dlfcn.h>
+
+// Simple test macro
+#define TEST(name) \
+  static void test_##name(); \
+  static struct Test_##name { \
+    Test_##name() { \
+      printf("Running %s... ", #name); \
+      test_##name(); \
+      printf("PASSED\n"); \
+    } \
+  } test_##name##_instance; \
+  static void test_##name()
+
+using Heap = alloc8::ANSIWrapper<alloc8::ModuleHeap<
+    alloc8::ThreadCache<alloc8::SpanHeap<>>, alloc8::SpanHeap<>>>;
+using Redirect = alloc8::HeapRedirect<Heap>;
+
+ALLOC8_REDIRECT(Redirect);
+ALLOC8_MODULE_REDIRECT();
+
+// Stats of the module whose path ends in "/name"
+static alloc8::ModuleStats statsOf(const char* name) {
+  struct Match {
+    const char* name;
+    alloc8::ModuleStats stats;
+  } match{name, {}};
+  alloc8_module_usage([](const alloc8::ModuleStats* s, void* ctx) {
+    Match& m = *static_cast<Match*>(ctx);
+    const char* slash = strrchr(s->name, '/');
+    if (slash && strcmp(slash + 1, m.name) == 0 && s->loaded) {
+      m.stats = *s;
+    }
+  }, &match);
+  return match.stats;
+}
+
+static bool ownedBySub(void* ptr) {
+  return alloc8::pageMap().get(ptr)->owner == Redirect::getHeap()->subHeap().owner();
+}
+
+using LibNewFn = void* (*)(size_t, size_t);
+using LibDeleteFn = void (*)(void*, size_t);
+
+static const char* kLibName = strrchr(MODULE_HEAP_LIB, '/') + 1;
+
+struct Lib {
+  void* handle = dlopen(MODULE_HEAP_LIB, RTLD_NOW | RTLD_LOCAL);
+  LibNewFn allocate = reinterpret_cast<LibNewFn>(dlsym(handle, "module_heap_lib_new"));
+  LibDeleteFn release = reinterpret_cast<LibDeleteFn>(dlsym(handle, "module_heap_lib_delete"));
+};
+
+static Lib& lib() {
+  static Lib instance;
+  assert(instance.allocate && instance.release);
+  return instance;
+}
+
+// ─── ATTRIBUTION ──────────────────────────────────────────────────────────────
+
+TEST(new_is_charged_to_the_calling_module) {
+  void* ptr = lib().allocate(112, 0);
+  alloc8::ModuleStats s = statsOf(kLibName);
+  assert(s.name && !s.routed);
+  assert(s.mallocs == 1 && s.bytes == 112);
+  assert(!ownedBySub(ptr));
+  lib().release(ptr, 0);
+}
+
+TEST(aligned_new_is_charged_to_the_calling_module) {
+  alloc8::ModuleStats before = statsOf(kLibName);
+  void* ptr = lib().allocate(96, 64);
+  assert(reinterpret_cast<uintptr_t>(ptr) % 64 == 0);
+  alloc8::ModuleStats after = statsOf(kLibName);
+  assert(after.mallocs - before.mallocs == 1);
+  assert(after.bytes - before.bytes == 96);
+  lib().release(ptr, 64);
+}
+
+// ─── ROUTING ──────────────────────────────────────────────────────────────────
+
+TEST(routed_modules_new_from_the_sub_heap) {
+  assert(alloc8_route_module(kLibName) == 0);
+  void* routed = lib().allocate(200, 0);
+  void* aligned = lib().allocate(200, 64);
+  char* mine = new char[200];
+  assert(ownedBySub(routed) && ownedBySub(aligned));
+  assert(!ownedBySub(mine));
+  lib().release(aligned, 64);
+  lib().release(routed, 0);
+  delete[] mine;
+}
+
+// ─── MAIN ─────────────────────────────────────────────────────────────────────
+
+int main() {
+  printf("\n=== alloc8 ModuleHeap operator new Tests ===\n\n");
+  // Tests are run automatically via static constructors
+  printf("\n=== All tests passed! ===\n\n");
+  return 0;
+}
@@ -0,0 +1,211 @@
+// alloc8/tests/test_ring_heap.cpp
+// RingHeap tests: FIFO reuse, wrap-around, stragglers and spills,
+// cross-thread frees
+
+#undef NDEBUG  // Keep assertions active in Release builds
+
+#include <alloc8/ansi_wrapper.h>
+#include <alloc8/ring_heap.h>
+
+#include <atomic>
+#include <cstdio>
+#include <cstring>
+#include <cstdint>
+#include <cassert>
+#include <deque>
+#include <thread>
+#include <vector>
+
+// Simple test macro
+#define TEST(name) \
+  static void test_##name(); \
+  static struct Test_##name { \
+    Test_##name() { \
+      printf("Running %s... ", #name); \
+      test_##name(); \
+      printf("PASSED\n"); \
+    } \
+  } test_##name##_instance; \
+  static void test_##name()
+
+constexpr size_t kRing = 64 * 1024;
+
+using Ring = alloc8::RingHeap<kRing>;
+
+template<typename Heap>
+static size_t liveObjects(Heap& heap) {
+  size_t count = 0;
+  heap.iterate([](void*, size_t, void* ctx) {
+    ++*static_cast<size_t*>(ctx);
+  }, &count);
+  return count;
+}
+
+// ─── FIFO REUSE ───────────────────────────────────────────────────────────────
+
+TEST(blocks_are_bumped_back_to_back) {
+  static Ring heap;
+  char* a = static_cast<char*>(heap.malloc(100));
+  char* b = static_cast<char*>(heap.malloc(1));
+  char* c = static_cast<char*>(heap.malloc(48));
+  assert(b - a == 112 + 16);  // 100 bytes and the header, rounded to 16
+  assert(c - b == 32);
+  assert(heap.getSize(a) == 112 && heap.getSize(b) == 16 && heap.getSize(c) == 48);
+  assert(reinterpret_cast<uintptr_t>(a) % 16 == 0);
+  assert(liveObjects(heap) == 3);
+  heap.free(a);
+  heap.free(b);
+  heap.free(c);
+  assert(heap.usedBytes() == 0);
+  assert(liveObjects(heap) == 0);
+}
+
+TEST(fifo_frees_cycle_the_ring_without_spilling) {
+  static Ring heap;
+  std::deque<void*> queue;
+  char* lowest = nullptr;
+  char* highest = nullptr;
+  for (size_t i = 0; i < 20000; i++) {
+    char* p = static_cast<char*>(heap.malloc(16 + (i * 37) % 1000));
+    memset(p, static_cast<int>(i), heap.getSize(p));
+    lowest = (!lowest || p < lowest) ? p : lowest;
+    highest = (!highest || p > highest) ? p : highest;
+    queue.push_back(p);
+    if (queue.size() > 40) {
+      heap.free(queue.front());
+      queue.pop_front();
+    }
+  }
+  assert(heap.spills() == 0);
+  assert(static_cast<size_t>(highest - lowest) < kRing);  // Wrapped, never left
+  assert(heap.usedBytes() <= 42 * 1040);  // 41 blocks and a skipped end
+  while (!queue.empty()) {
+    heap.free(queue.front());
+    queue.pop_front();
+  }
+  assert(heap.usedBytes() == 0);
+}
+
+TEST(a_block_that_does_not_fit_before_the_end_wraps) {
+  static Ring heap;
+  void* first = heap.malloc(kRing / 8 - 16);  // 8 KiB blocks
+  std::vector<void*> blocks{first};
+  for (size_t i = 1; i < 7; i++) {
+    blocks.push_back(heap.malloc(kRing / 8 - 16));
+  }
+  void* tail = heap.malloc(kRing / 8 - 1024);  // Leaves 1008 bytes at the end
+  for (void* p : blocks) {
+    heap.free(p);
+  }
+  // Does not fit in the last 1008 bytes: skips them and starts over at the
+  // front
+  void* wrapped = heap.malloc(2048);
+  assert(wrapped == first);
+  assert(heap.usedBytes() == (kRing / 8 - 1024 + 16) + 1008 + (2048 + 16));
+  heap.free(tail);
+  heap.free(wrapped);
+  assert(heap.usedBytes() == 0);
+}
+
+// ─── SPILLS ───────────────────────────────────────────────────────────────────
+
+TEST(a_straggler_is_stepped_over) {
+  static Ring heap;
+  char* straggler = static_cast<char*>(heap.malloc(64));
+  memset(straggler, 0x77, 64);
+  std::deque<void*> queue;
+  for (size_t i = 0; i < 5000; i++) {
+    void* p = heap.malloc(200);
+    memset(p, 0x11, 200);
+    queue.push_back(p);
+    if (queue.size() > 8) {
+      heap.free(queue.front());
+      queue.pop_front();
+    }
+  }
+  assert(heap.spills() == 0);
+  for (size_t i = 0; i < 64; i++) {
+    assert(straggler[i] == 0x77);
+  }
+  assert(liveObjects(heap) == queue.size() + 1);
+  heap.free(straggler);
+  for (void* p : queue) {
+    heap.free(p);
+  }
+  assert(heap.usedBytes() == 0);
+  assert(liveObjects(heap) == 0);
+}
+
+TEST(live_data_beyond_the_ring_spills) {
+  static Ring heap;
+  std::vector<void*> ring;
+  std::vector<void*> spilled;
+  for (size_t i = 0; i < 2 * kRing / 256; i++) {
+    void* p = heap.malloc(240);
+    (heap.fallback().getSize(p) != 0 ? spilled : ring).push_back(p);
+  }
+  assert(ring.size() == kRing / 256);
+  assert(heap.spills() == spilled.size() && spilled.size() == kRing / 256);
+  assert(heap.getSize(spilled[0]) >= 240);
+  assert(liveObjects(heap) == ring.size() + spilled.size());
+  for (void* p : ring) {
+    heap.free(p);
+  }
+  void* p = heap.malloc(240);
+  assert(heap.fallback().getSize(p) == 0);  // Back in the ring
+  heap.free(p);
+  for (void* q : spilled) {
+    heap.free(q);
+  }
+  assert(liveObjects(heap) == 0);
+}
+
+TEST(large_and_aligned_requests_use_the_fallback) {
+  static Ring heap;
+  void* big = heap.malloc(Ring::kMaxBlock + 1);
+  void* aligned = heap.memalign(64, 100);
+  assert(heap.fallback().getSize(big) >= Ring::kMaxBlock + 1);
+  assert(heap.fallback().getSize(aligned) != 0);
+  assert(reinterpret_cast<uintptr_t>(aligned) % 64 == 0);
+  assert(heap.spills() == 0);
+  heap.free(big);
+  heap.free(aligned);
+}
+
+// ─── CROSS-THREAD FREES ───────────────────────────────────────────────────────
+
+TEST(consumer_thread_frees_in_queue_order) {
+  static alloc8::ANSIWrapper<alloc8::RingHeap<256 * 1024>> heap;
+  constexpr size_t kMessages = 300000;
+  std::vector<uint64_t*> handoff(kMessages);
+  std::atomic<size_t> published{0};
+  std::thread consumer([&] {
+    for (size_t i = 0; i < kMessages; i++) {
+      while (published.load(std::memory_order_acquire) <= i) {
+        std::this_thread::yield();
+      }
+      uint64_t* p = handoff[i];
+      assert(p[0] == i && p[1] == ~uint64_t(i));
+      heap.free(p);
+    }
+  });
+  for (size_t i = 0; i < kMessages; i++) {
+    auto* p = static_cast<uint64_t*>(heap.malloc(16 + (i % 13) * 24));
+    p[0] = i;
+    p[1] = ~uint64_t(i);
+    handoff[i] = p;
+    published.store(i + 1, std::memory_order_release);
+  }
+  consumer.join();
+  assert(heap.usedBytes() == 0);
+  assert(liveObjects(heap) == 0);
+}
+
+// ─── MAIN ─────────────────────────────────────────────────────────────────────
+
+int main() {
+  printf("\n=== alloc8 RingHeap Tests ===\n\n");
+  // Tests are run automatically via static constructors
+  printf("\n=== All tests passed! ===\n\n");
+  return 0;
+}
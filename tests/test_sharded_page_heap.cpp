@@ -0,0 +1,279 @@
+// alloc8/tests/test_sharded_page_heap.cpp
+// ShardedPageHeap tests: per-page lists, remote frees, full-page reclaim,
+// abandonment and adoption
+
+#undef NDEBUG  // Keep assertions active in Release builds
+
+#include <alloc8/ansi_wrapper.h>
+#include <alloc8/sharded_page_heap.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <cstring>
+#include <cstdint>
+#include <cassert>
+#include <thread>
+#include <vector>
+
+// Simple test macro
+#define TEST(name) \
+  static void test_##name(); \
+  static struct Test_##name { \
+    Test_##name() { \
+      printf("Running %s... ", #name); \
+      test_##name(); \
+      printf("PASSED\n"); \
+    } \
+  } test_##name##_instance; \
+  static void test_##name()
+
+using Sharded = alloc8::ShardedPageHeap<>;
+
+constexpr size_t kPageObjects = 64 * 1024 / 64;  // 64-byte objects per page
+
+// Run `fn` on a fresh thread that exits (and abandons its pages) afterwards
+template<typename Heap, typename Fn>
+static void onThread(Heap& heap, Fn fn) {
+  std::thread([&] {
+    fn();
+    heap.threadCleanup();
+  }).join();
+}
+
+// ─── PER-PAGE LISTS ───────────────────────────────────────────────────────────
+
+TEST(page_is_carved_in_address_order) {
+  static Sharded heap;
+  onThread(heap, [] {
+    std::vector<char*> objs(100);
+    for (char*& p : objs) {
+      p = static_cast<char*>(heap.malloc(64));
+    }
+    for (size_t i = 1; i < objs.size(); i++) {
+      assert(objs[i] - objs[i - 1] == 64);
+    }
+    assert(heap.getSize(objs[0]) == 64);
+    assert(heap.pages() == 1);
+    for (char* p : objs) {
+      heap.free(p);
+    }
+  });
+  assert(heap.pages() == 0);
+}
+
+TEST(local_frees_are_reused_after_the_free_list) {
+  static Sharded heap;
+  onThread(heap, [] {
+    void* a = heap.malloc(48);
+    void* b = heap.malloc(48);
+    heap.free(a);
+    // `a` waits on the local-free list while fresh slots remain
+    void* c = heap.malloc(48);
+    assert(c != a && c != b);
+    size_t steps = 1;
+    while (heap.malloc(48) != a) {
+      steps++;
+      assert(steps < kPageObjects);
+    }
+    // Reused only once the slots carved with it (one OS page) ran out
+    assert(steps == ALLOC8_PAGE_SIZE / 48 - 2);
+  });
+  assert(heap.abandonedPages() == 1);
+}
+
+TEST(large_and_aligned_requests_use_the_large_heap) {
+  static Sharded heap;
+  onThread(heap, [] {
+    void* big = heap.malloc(1 << 20);
+    assert(heap.getSize(big) >= (1 << 20));
+    assert(heap.largeHeap().getSize(big) != 0);
+    void* aligned = heap.memalign(256, 200);
+    assert(reinterpret_cast<uintptr_t>(aligned) % 256 == 0);
+    assert(heap.largeHeap().getSize(aligned) == 0);  // A 256-byte class slot
+    void* page = heap.memalign(8192, 100);
+    assert(reinterpret_cast<uintptr_t>(page) % 8192 == 0);
+    heap.free(big);
+    heap.free(aligned);
+    heap.free(page);
+  });
+  assert(heap.pages() == 0);
+}
+
+// ─── CROSS-THREAD FREES ───────────────────────────────────────────────────────
+
+TEST(remote_frees_are_collected_by_the_owner) {
+  static Sharded heap;
+  onThread(heap, [] {
+    std::vector<void*> objs(kPageObjects / 2);
+    for (void*& p : objs) {
+      p = heap.malloc(64);
+    }
+    std::thread([&] {
+      for (void* p : objs) {
+        heap.free(p);
+      }
+    }).join();
+    // Fill the page, then take the remotely freed slots back
+    std::vector<void*> again(kPageObjects);
+    for (void*& p : again) {
+      p = heap.malloc(64);
+    }
+    assert(heap.pages() == 1);
+    for (void* p : again) {
+      heap.free(p);
+    }
+  });
+}
+
+TEST(full_page_comes_back_after_a_remote_free) {
+  static Sharded heap;
+  onThread(heap, [] {
+    std::vector<void*> objs(2 * kPageObjects);
+    for (void*& p : objs) {
+      p = heap.malloc(64);
+    }
+    assert(heap.pages() == 2);
+    // The first page was retired as full; a local free brings it back
+    heap.free(objs[5]);
+    assert(heap.malloc(64) == objs[5]);
+    // Both pages are full: the next malloc retires them and maps a third
+    std::vector<void*> third;
+    third.push_back(heap.malloc(64));
+    assert(heap.pages() == 3);
+    // A remote free into a retired page queues it for its owner, which
+    // takes it back on its next slow path (when the slots carved on the
+    // third page run out)
+    std::thread([&] { heap.free(objs[7]); }).join();
+    void* p;
+    while ((p = heap.malloc(64)) != objs[7]) {
+      third.push_back(p);
+      assert(third.size() <= ALLOC8_PAGE_SIZE / 64);
+    }
+    assert(heap.pages() == 3);
+    for (void* p : third) {
+      heap.free(p);
+    }
+    for (void* p : objs) {
+      heap.free(p);
+    }
+  });
+}
+
+TEST(producer_consumer_stress) {
+  static Sharded heap;
+  constexpr size_t kObjects = 300000;
+  std::vector<uint64_t*> handoff(kObjects);
+  std::atomic<size_t> published{0};
+  std::thread consumer([&] {
+    for (size_t i = 0; i < kObjects; i++) {
+      while (published.load(std::memory_order_acquire) <= i) {
+        std::this_thread::yield();
+      }
+      uint64_t* p = handoff[i];
+      assert(p[0] == i && p[1] == ~uint64_t(i));
+      heap.free(p);
+    }
+    heap.threadCleanup();
+  });
+  onThread(heap, [&] {
+    for (size_t i = 0; i < kObjects; i++) {
+      size_t sz = 16 + (i % 7) * 16;
+      auto* p = static_cast<uint64_t*>(heap.malloc(sz));
+      p[0] = i;
+      p[1] = ~uint64_t(i);
+      handoff[i] = p;
+      published.store(i + 1, std::memory_order_release);
+    }
+  });
+  consumer.join();
+  // The producer's pages were abandoned with objects still in flight; a
+  // new thread adopts them instead of mapping pages
+  size_t abandoned = heap.abandonedPages();
+  size_t pages = heap.pages();
+  onThread(heap, [] {
+    for (size_t sz = 16; sz <= 112; sz += 16) {
+      heap.free(heap.malloc(sz));
+    }
+  });
+  assert(heap.abandonedPages() < abandoned || abandoned == 0);
+  assert(heap.pages() <= pages);
+}
+
+// ─── ABANDON / ADOPT ──────────────────────────────────────────────────────────
+
+TEST(exited_threads_pages_are_adopted) {
+  static Sharded heap;
+  std::vector<void*> survivors;
+  onThread(heap, [&] {
+    for (size_t i = 0; i < kPageObjects; i++) {
+      void* p = heap.malloc(64);
+      if (i % 2 == 0) {
+        survivors.push_back(p);
+      } else {
+        heap.free(p);
+      }
+    }
+  });
+  assert(heap.pages() == 1);
+  assert(heap.abandonedPages() == 1);
+  onThread(heap, [&] {
+    void* p = heap.malloc(64);
+    assert(heap.abandonedPages() == 0);
+    assert(heap.pages() == 1);
+    heap.free(p);
+  });
+  for (void* p : survivors) {
+    heap.free(p);  // Remote frees into an abandoned page
+  }
+  onThread(heap, [] {
+    heap.free(heap.malloc(64));
+  });
+  assert(heap.abandonedPages() == 0);
+  assert(heap.pages() == 0);
+}
+
+TEST(ansi_wrapper_under_many_threads) {
+  static alloc8::ANSIWrapper<Sharded> heap;
+  std::vector<std::thread> threads;
+  std::vector<std::vector<void*>> outboxes(4);
+  for (int t = 0; t < 4; t++) {
+    threads.emplace_back([&, t] {
+      for (int round = 0; round < 200; round++) {
+        for (int i = 0; i < 100; i++) {
+          size_t sz = 8 + static_cast<size_t>((i * 37 + round) % 2000);
+          void* p = heap.malloc(sz);
+          memset(p, t, sz);
+          if (i % 4 == 0) {
+            outboxes[t].push_back(p);
+          } else {
+            heap.free(p);
+          }
+        }
+        if (!outboxes[t].empty()) {
+          void*& q = outboxes[t].back();
+          q = heap.realloc(q, 4096);
+        }
+      }
+      heap.threadCleanup();
+    });
+  }
+  for (std::thread& t : threads) {
+    t.join();
+  }
+  // Free every outbox from this thread: all remote frees
+  for (auto& box : outboxes) {
+    for (void* p : box) {
+      heap.free(p);
+    }
+  }
+}
+
+// ─── MAIN ─────────────────────────────────────────────────────────────────────
+
+int main() {
+  printf("\n=== alloc8 ShardedPageHeap Tests ===\n\n");
+  // Tests are run automatically via static constructors
+  printf("\n=== All tests passed! ===\n\n");
+  return 0;
+}
@@ -0,0 +1,196 @@
+// alloc8/tests/test_size_router.cpp
+// SizeRouter / SizeRouterN composition and MmapCacheHeap tests
+
+#undef NDEBUG  // Keep assertions active in Release builds
+
+#include <alloc8/ansi_wrapper.h>
+#include <alloc8/mmap_cache_heap.h>
+#include <alloc8/size_router.h>
+#include <alloc8/span_heap.h>
+#include <alloc8/thread_cache.h>
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cstdint>
+#include <cassert>
+#include <vector>
+
+// Simple test macro
+#define TEST(name) \
+  static void test_##name(); \
+  static struct Test_##name { \
+    Test_##name() { \
+      printf("Running %s... ", #name); \
+      test_##name(); \
+      printf("PASSED\n"); \
+    } \
+  } test_##name##_instance; \
+  static void test_##name()
+
+constexpr size_t kSmallMax = 1024;
+constexpr size_t kMediumMax = 256 * 1024;
+
+using MediumHeap = alloc8::SpanHeap<alloc8::OSPageSource, alloc8::SizeClassMap<kMediumMax>>;
+using Tiered = alloc8::SizeRouterN<
+    alloc8::Route<kSmallMax, alloc8::ThreadCache<alloc8::SpanHeap<>>>,
+    alloc8::Route<kMediumMax, MediumHeap>,
+    alloc8::Route<SIZE_MAX, alloc8::MmapCacheHeap<>>>;
+using TieredHeap = alloc8::ANSIWrapper<Tiered>;
+
+static uint16_t ownerOf(void* ptr) {
+  alloc8::Span* span = alloc8::pageMap().get(ptr);
+  return span ? span->owner : 0;
+}
+
+// ─── ROUTING ──────────────────────────────────────────────────────────────────
+
+TEST(malloc_routes_by_size) {
+  static TieredHeap heap;
+  void* small = heap.malloc(kSmallMax);
+  void* medium = heap.malloc(kSmallMax + 1);
+  void* mediumTop = heap.malloc(kMediumMax);
+  void* large = heap.malloc(kMediumMax + 1);
+  assert(small && medium && mediumTop && large);
+  assert(ownerOf(small) == heap.tier<0>().owner());
+  assert(ownerOf(medium) == heap.tier<1>().owner());
+  assert(ownerOf(mediumTop) == heap.tier<1>().owner());
+  assert(ownerOf(large) == heap.tier<2>().owner());
+
+  assert(heap.getSize(small) >= kSmallMax);
+  assert(heap.getSize(medium) >= kSmallMax + 1);
+  assert(heap.getSize(mediumTop) == kMediumMax);
+  assert(heap.getSize(large) >= kMediumMax + 1);
+  assert(heap.getSize(large) % ALLOC8_PAGE_SIZE == 0);
+  memset(large, 0x5a, heap.getSize(large));
+
+  heap.free(small);
+  heap.free(medium);
+  heap.free(mediumTop);
+  heap.free(large);
+  assert(heap.tier<2>().cachedBytes() >= kMediumMax + 1);
+}
+
+TEST(free_follows_owner_not_size) {
+  static TieredHeap heap;
+  // A small, over-aligned request lands in the small tier's large spans;
+  // free and getSize must still find that tier.
+  void* aligned = heap.memalign(64 * 1024, 100);
+  assert(aligned && reinterpret_cast<uintptr_t>(aligned) % (64 * 1024) == 0);
+  assert(ownerOf(aligned) == heap.tier<0>().owner());
+  assert(heap.getSize(aligned) >= 100);
+  heap.free(aligned);
+  assert(alloc8::pageMap().get(aligned) == nullptr);
+
+  void* bigAligned = heap.memalign(1 << 20, kMediumMax * 2);
+  assert(reinterpret_cast<uintptr_t>(bigAligned) % (1 << 20) == 0);
+  assert(ownerOf(bigAligned) == heap.tier<2>().owner());
+  heap.free(bigAligned);
+}
+
+TEST(foreign_pointers_are_ignored) {
+  static TieredHeap heap;
+  void* foreign = std::malloc(64);
+  assert(heap.getSize(foreign) == 0);
+  heap.free(foreign);  // Falls to the last tier, which ignores it
+  std::free(foreign);
+  heap.free(nullptr);
+}
+
+TEST(realloc_crosses_tiers) {
+  static TieredHeap heap;
+  char* p = static_cast<char*>(heap.malloc(100));
+  memset(p, 7, 100);
+  p = static_cast<char*>(heap.realloc(p, 64 * 1024));
+  assert(ownerOf(p) == heap.tier<1>().owner());
+  p = static_cast<char*>(heap.realloc(p, 4 << 20));
+  assert(ownerOf(p) == heap.tier<2>().owner());
+  for (size_t i = 0; i < 100; i++) {
+    assert(p[i] == 7);
+  }
+  heap.free(p);
+}
+
+TEST(iterate_visits_every_tier) {
+  static TieredHeap heap;
+  std::vector<void*> blocks;
+  for (size_t sz : {16u, 900u, 5000u, 200000u, 3000000u}) {
+    blocks.push_back(heap.malloc(sz));
+  }
+  heap.lock();
+  heap.unlock();
+  size_t seen = 0;
+  heap.iterate([](void*, size_t, void* ctx) {
+    ++*static_cast<size_t*>(ctx);
+  }, &seen);
+  // The small tier's thread cache may hold extra batch objects
+  assert(seen >= blocks.size());
+  for (void* p : blocks) {
+    heap.free(p);
+  }
+}
+
+// ─── MMAP CACHE HEAP ──────────────────────────────────────────────────────────
+
+TEST(mmap_cache_reuses_close_fits) {
+  static alloc8::MmapCacheHeap<4 << 20> heap;
+  void* a = heap.malloc(1 << 20);
+  heap.free(a);
+  assert(heap.cachedBytes() == 1 << 20);
+
+  // Within a quarter of the cached run: reused, whole run is usable
+  void* b = heap.malloc((1 << 20) - 3 * ALLOC8_PAGE_SIZE);
+  assert(b == a && heap.getSize(b) == 1 << 20);
+  assert(heap.cachedBytes() == 0);
+  heap.free(b);
+
+  // Much smaller: not worth wasting the cached run
+  void* c = heap.malloc(64 * 1024);
+  assert(c != a && heap.cachedBytes() == 1 << 20);
+  heap.free(c);
+  assert(heap.cachedBytes() == (1 << 20) + 64 * 1024);
+  assert(heap.releaseCache() == (1 << 20) + 64 * 1024);
+  assert(heap.cachedBytes() == 0);
+}
+
+TEST(mmap_cache_evicts_oldest_and_skips_oversize) {
+  static alloc8::MmapCacheHeap<2 << 20> heap;
+  void* a = heap.malloc(1 << 20);
+  void* b = heap.malloc(1 << 20);
+  void* c = heap.malloc(1 << 20);
+  void* huge = heap.malloc(3 << 20);
+  heap.free(huge);  // Larger than the cache: released at once
+  assert(heap.cachedBytes() == 0);
+  heap.free(a);
+  heap.free(b);
+  heap.free(c);  // Evicts a
+  assert(heap.cachedBytes() == 2 << 20);
+  void* d = heap.malloc(1 << 20);
+  assert(d == b || d == c);
+  heap.free(d);
+  heap.releaseCache();
+}
+
+// ─── TWO-WAY ROUTER ───────────────────────────────────────────────────────────
+
+TEST(size_router_alias) {
+  static alloc8::ANSIWrapper<alloc8::SizeRouter<
+      32 * 1024, alloc8::SpanHeap<>, alloc8::MmapCacheHeap<>>> heap;
+  void* small = heap.malloc(32 * 1024);
+  void* large = heap.malloc(32 * 1024 + 1);
+  assert(ownerOf(small) == heap.tier<0>().owner());
+  assert(ownerOf(large) == heap.tier<1>().owner());
+  assert(heap.getSize(large) == 36 * 1024);
+  heap.free(small);
+  heap.free(large);
+  assert(heap.tier<1>().cachedBytes() == 36 * 1024);
+}
+
+// ─── MAIN ─────────────────────────────────────────────────────────────────────
+
+int main() {
+  printf("\n=== alloc8 SizeRouter Tests ===\n\n");
+  // Tests are run automatically via static constructors
+  printf("\n=== All tests passed! ===\n\n");
+  return 0;
+}
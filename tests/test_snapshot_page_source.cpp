@@ -0,0 +1,245 @@
+// alloc8/tests/test_snapshot_page_source.cpp
+// SnapshotPageSource tests: frozen views, merging copies back, punched
+// free runs, a read-only view, readers during snapshots, fork safety,
+// saving from a background thread
+
+#undef NDEBUG  // Keep assertions active in Release builds
+
+#include <alloc8/ansi_wrapper.h>
+#include <alloc8/snapshot_page_source.h>
+#include <alloc8/span_heap.h>
+#include <alloc8/thread_cache.h>
+
+#include <atomic>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <cstdint>
+#include <cassert>
+#include <csignal>
+#include <sys/wait.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+// Simple test macro
+#define TEST(name) \
+  static void test_##name(); \
+  static struct Test_##name { \
+    Test_##name() { \
+      printf("Running %s... ", #name); \
+      test_##name(); \
+      printf("PASSED\n"); \
+    } \
+  } test_##name##_instance; \
+  static void test_##name()
+
+constexpr size_t kPage = ALLOC8_PAGE_SIZE;
+
+using Source = alloc8::SnapshotPageSource<(64 << 20)>;
+
+template<typename T>
+static const T* inView(const alloc8::SnapshotView& view, const T* live) {
+  return reinterpret_cast<const T*>(view.data + (reinterpret_cast<const char*>(live) - view.heap));
+}
+
+// ─── SNAPSHOTS ────────────────────────────────────────────────────────────────
+
+TEST(a_view_keeps_the_contents_at_snapshot_time) {
+  static Source source;
+  char* a = static_cast<char*>(source.allocPages(4));
+  char* b = static_cast<char*>(source.allocPages(1));
+  memset(a, 'a', 4 * kPage);
+  memset(b, 'b', kPage);
+
+  alloc8::SnapshotView view;
+  assert(source.snapshot(&view) == 0);
+  assert(view.heap == a && view.bytes == 5 * kPage);
+  a[0] = 'x';
+  b[kPage - 1] = 'y';
+  char* c = static_cast<char*>(source.allocPages(1));  // Beyond the view
+  memset(c, 'c', kPage);
+  assert(*inView(view, a) == 'a' && inView(view, b)[kPage - 1] == 'b');
+  assert(a[0] == 'x' && b[kPage - 1] == 'y');
+  assert(source.stats().open && source.stats().snapshots == 1);
+
+  alloc8::SnapshotView second;
+  assert(source.snapshot(&second) == -EBUSY && second.data == nullptr);
+  assert(source.merge() == -EBUSY);
+  source.release(&view);
+  assert(view.data == nullptr);
+
+  // Only the three pages written since the snapshot are copied back
+  assert(source.merge() == 0);
+  alloc8::SnapshotStats s = source.stats();
+  assert(!s.open && s.lastMergeBytes == 3 * kPage);
+  assert(a[0] == 'x' && a[1] == 'a' && b[kPage - 1] == 'y' && c[0] == 'c');
+
+  assert(source.snapshot(&view) == 0);
+  assert(*inView(view, a) == 'x' && *inView(view, c) == 'c');
+  source.release(&view);
+  assert(source.merge() == 0 && source.stats().lastMergeBytes == 0);
+}
+
+TEST(snapshot_merges_a_released_view_itself) {
+  static Source source;
+  auto* p = static_cast<uint64_t*>(source.allocPages(2));
+  p[0] = 1;
+  alloc8::SnapshotView view;
+  assert(source.snapshot(&view) == 0);
+  p[0] = 2;
+  source.release(&view);
+  assert(source.snapshot(&view) == 0);  // No merge() in between
+  assert(*inView(view, p) == 2);
+  p[0] = 3;
+  assert(*inView(view, p) == 2);
+  source.release(&view);
+  assert(source.merge() == 0);
+  assert(p[0] == 3);
+}
+
+TEST(freed_runs_are_punched_out_between_snapshots) {
+  static Source source;
+  char* keep = static_cast<char*>(source.allocPages(1));
+  char* p = static_cast<char*>(source.allocPages(8));
+  memset(p, 0x5a, 8 * kPage);
+  source.freePages(p, 8);
+  assert(source.allocPages(8) == p);
+  assert(p[0] == 0 && p[8 * kPage - 1] == 0);  // Punched: reads as zero
+
+  // While a view is out, freed pages keep their contents
+  memset(p, 0x5a, 8 * kPage);
+  alloc8::SnapshotView view;
+  assert(source.snapshot(&view) == 0);
+  source.freePages(p, 8);
+  assert(*inView(view, p) == 0x5a);
+  source.release(&view);
+  assert(source.merge() == 0);
+  assert(source.allocPages(8) == p && p[0] == 0);
+  source.freePages(p, 8);
+  source.freePages(keep, 1);
+}
+
+TEST(the_view_is_read_only) {
+  static Source source;
+  auto* p = static_cast<char*>(source.allocPages(1));
+  p[0] = 'p';
+  alloc8::SnapshotView view;
+  assert(source.snapshot(&view) == 0);
+  pid_t pid = fork();
+  if (pid == 0) {
+    *const_cast<char*>(inView(view, p)) = 'x';
+    _exit(0);
+  }
+  int status = 0;
+  waitpid(pid, &status, 0);
+  assert(WIFSIGNALED(status) && WTERMSIG(status) == SIGSEGV);
+  assert(*inView(view, p) == 'p' && p[0] == 'p');
+  source.release(&view);
+  assert(source.merge() == 0);
+}
+
+TEST(readers_carry_on_through_snapshot_and_merge) {
+  static Source source;
+  constexpr size_t kPages = 64;
+  auto* p = static_cast<uint64_t*>(source.allocPages(kPages));
+  constexpr size_t kWords = kPages * kPage / sizeof(uint64_t);
+  for (size_t i = 0; i < kWords; i++) {
+    p[i] = i;
+  }
+
+  // A heap that went unmapped for a moment would crash this reader
+  std::atomic<bool> done{false};
+  std::atomic<size_t> reads{0};
+  std::thread reader([&] {
+    while (!done.load(std::memory_order_acquire)) {
+      for (size_t i = 0; i < kWords; i += 97) {
+        assert(p[i] == i);
+      }
+      reads.fetch_add(1, std::memory_order_relaxed);
+    }
+  });
+  for (int round = 0; round < 200 || reads.load(std::memory_order_relaxed) < 10; round++) {
+    alloc8::SnapshotView view;
+    assert(source.snapshot(&view) == 0);
+    assert(*inView(view, p + kWords - 1) == kWords - 1);
+    source.release(&view);
+    assert(source.merge() == 0);
+    std::this_thread::yield();
+  }
+  done.store(true, std::memory_order_release);
+  reader.join();
+}
+
+// ─── FORK ─────────────────────────────────────────────────────────────────────
+
+TEST(a_forked_child_never_writes_the_parents_heap) {
+  static Source source;
+  auto* p = static_cast<uint64_t*>(source.allocPages(1));
+  p[0] = 42;
+  pid_t pid = fork();
+  if (pid == 0) {
+    p[0] = 7;
+    alloc8::SnapshotView view;
+    _exit(p[0] == 7 && source.snapshot(&view) == -EPERM ? 0 : 1);
+  }
+  int status = 0;
+  waitpid(pid, &status, 0);
+  assert(WIFEXITED(status) && WEXITSTATUS(status) == 0);
+  assert(p[0] == 42);
+}
+
+// ─── HEAP INTEGRATION ─────────────────────────────────────────────────────────
+
+TEST(background_save_sees_a_consistent_heap) {
+  using Heap = alloc8::ANSIWrapper<alloc8::ThreadCache<
+      alloc8::SpanHeap<alloc8::SnapshotPageSource<(256 << 20)>>>>;
+  static Heap heap;
+  constexpr size_t kRecords = 50000;
+  std::vector<uint64_t*> records(kRecords);
+  for (size_t i = 0; i < kRecords; i++) {
+    records[i] = static_cast<uint64_t*>(heap.malloc(16 + (i % 7) * 16));
+    records[i][0] = i;
+    records[i][1] = ~uint64_t(i);
+  }
+
+  auto& pages = heap.pageSource();
+  alloc8::SnapshotView view;
+  assert(pages.snapshot(&view) == 0);
+  std::atomic<bool> saved{false};
+  std::thread saver([&] {
+    for (size_t i = 0; i < kRecords; i++) {
+      const uint64_t* r = inView(view, records[i]);
+      assert(r[0] == i && r[1] == ~uint64_t(i));
+    }
+    pages.release(&view);
+    saved.store(true, std::memory_order_release);
+  });
+
+  // The main thread keeps mutating and allocating meanwhile
+  for (size_t round = 0; !saved.load(std::memory_order_acquire) || round < 3; round++) {
+    for (size_t i = 0; i < kRecords; i += 3) {
+      records[i][0] = i + round + 1;
+      records[i][1] = 0;
+      heap.free(heap.malloc(100));
+    }
+  }
+  saver.join();
+  assert(pages.merge() == 0);
+  assert(pages.stats().lastMergeBytes > 0);
+  for (size_t i = 0; i < kRecords; i += 3) {
+    assert(records[i][0] > i && records[i][1] == 0);
+  }
+  for (uint64_t* r : records) {
+    heap.free(r);
+  }
+}
+
+// ─── MAIN ─────────────────────────────────────────────────────────────────────
+
+int main() {
+  printf("\n=== alloc8 SnapshotPageSource Tests ===\n\n");
+  // Tests are run automatically via static constructors
+  printf("\n=== All tests passed! ===\n\n");
+  return 0;
+}
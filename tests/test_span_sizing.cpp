@@ -0,0 +1,242 @@
+// alloc8/tests/test_span_sizing.cpp
+// Span sizing policy tests: fixed sizes, growth under refills, shrinking
+// after occupancy dips, bounds, failed refills, variable-size spans under
+// both slab layouts, the exported stats
+
+#undef NDEBUG  // Keep assertions active in Release builds
+
+#include <alloc8/allocator_traits.h>
+#include <alloc8/span_heap.h>
+#include <alloc8/span_sizing.h>
+
+#include <cassert>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+// Simple test macro
+#define TEST(name) \
+  static void test_##name(); \
+  static struct Test_##name { \
+    Test_##name() { \
+      printf("Running %s... ", #name); \
+      test_##name(); \
+      printf("PASSED\n"); \
+    } \
+  } test_##name##_instance; \
+  static void test_##name()
+
+using Classes = alloc8::SizeClasses;
+using Adaptive = alloc8::SpanHeap<alloc8::OSPageSource, Classes, alloc8::InBandFreeList, 0,
+                                  alloc8::AdaptiveSpanSizing<>>;
+
+// OSPageSource that fails every request while `failing` is set
+struct FlakyPageSource : alloc8::OSPageSource {
+  static inline bool failing = false;
+
+  void* allocPages(size_t npages, size_t alignment = ALLOC8_PAGE_SIZE) {
+    return failing ? nullptr : OSPageSource::allocPages(npages, alignment);
+  }
+};
+
+static size_t pagesOf(void* ptr) {
+  return alloc8::pageMap().get(ptr)->npages;
+}
+
+// Allocate `count` objects of `size` into `out`
+template<typename Heap>
+static void fill(Heap& heap, std::vector<void*>& out, size_t size, size_t count) {
+  for (size_t i = 0; i < count; i++) {
+    void* p = heap.malloc(size);
+    assert(p);
+    memset(p, 0x5a, size);
+    out.push_back(p);
+  }
+}
+
+template<typename Heap>
+static void drain(Heap& heap, std::vector<void*>& ptrs) {
+  for (void* p : ptrs) {
+    heap.free(p);
+  }
+  ptrs.clear();
+}
+
+// ─── FIXED ────────────────────────────────────────────────────────────────────
+
+TEST(fixed_sizing_uses_the_class_map) {
+  alloc8::SpanHeap<> heap;
+  std::vector<void*> ptrs;
+  size_t cls = Classes::sizeToClass(64);
+  fill(heap, ptrs, 64, Classes::classCapacity(cls) * 20);
+  for (void* p : ptrs) {
+    assert(pagesOf(p) == Classes::classToPages(cls));
+    assert(alloc8::pageMap().get(p)->capacity == Classes::classCapacity(cls));
+  }
+  drain(heap, ptrs);
+}
+
+// ─── ADAPTIVE ─────────────────────────────────────────────────────────────────
+
+TEST(refilling_classes_grow_their_spans) {
+  Adaptive heap;
+  size_t cls = Classes::sizeToClass(64);
+  size_t base = Classes::classToPages(cls);
+  std::vector<void*> ptrs;
+  fill(heap, ptrs, 64, Classes::classCapacity(cls) * 40);
+
+  alloc8::SpanSizingStats s = heap.spanSizingStats(cls);
+  assert(s.basePages == base);
+  assert(s.grows == 3 && s.shrinks == 0);
+  assert(s.pages == base << 3);
+  assert(s.liveObjects == ptrs.size());
+  assert(s.slots >= ptrs.size());
+  // Fewer spans than fixed sizing needs: 4 of each size, then 8x spans
+  assert(s.refills < 40);
+  assert(pagesOf(ptrs.back()) == s.pages);
+  assert(pagesOf(ptrs.front()) == base);
+
+  // Other classes are untouched
+  assert(heap.spanSizingStats(Classes::sizeToClass(256)).refills == 0);
+  drain(heap, ptrs);
+}
+
+TEST(occupancy_dips_shrink_spans) {
+  Adaptive heap;
+  size_t cls = Classes::sizeToClass(512);
+  size_t base = Classes::classToPages(cls);
+  std::vector<void*> ptrs;
+  fill(heap, ptrs, 512, Classes::classCapacity(cls) * 40);
+  assert(heap.spanSizingStats(cls).pages == base << 3);
+
+  // The phase ends: the class empties out, then comes back smaller
+  drain(heap, ptrs);
+  alloc8::SpanSizingStats s = heap.spanSizingStats(cls);
+  assert(s.liveObjects == 0 && s.releases > 0);
+  fill(heap, ptrs, 512, (base << 3) * ALLOC8_PAGE_SIZE / 512 + 1);
+  s = heap.spanSizingStats(cls);
+  assert(s.shrinks == 1);
+  assert(s.pages == base << 2);
+  assert(pagesOf(ptrs.back()) == base << 2);
+  drain(heap, ptrs);
+}
+
+TEST(span_sizes_stay_within_bounds) {
+  Adaptive heap;
+  // Smallest class: growth stops at Span::kMaxObjects objects
+  size_t small = Classes::sizeToClass(16);
+  std::vector<void*> ptrs;
+  fill(heap, ptrs, 16, alloc8::Span::kMaxObjects * 30);
+  alloc8::SpanSizingStats s = heap.spanSizingStats(small);
+  assert(s.pages * ALLOC8_PAGE_SIZE / 16 <= alloc8::Span::kMaxObjects);
+  assert(s.pages > s.basePages);
+  drain(heap, ptrs);
+
+  // Repeated dips: shrinking stops at basePages >> 2
+  size_t big = Classes::sizeToClass(Classes::kMaxSmallSize);
+  for (int cycle = 0; cycle < 8; cycle++) {
+    fill(heap, ptrs, Classes::kMaxSmallSize, Classes::classCapacity(big) + 1);
+    drain(heap, ptrs);
+  }
+  s = heap.spanSizingStats(big);
+  assert(s.shift == -2);
+  assert(s.pages == s.basePages >> 2);
+  assert(s.pages * ALLOC8_PAGE_SIZE >= Classes::kMaxSmallSize);
+}
+
+TEST(failed_refills_change_nothing) {
+  alloc8::SpanHeap<FlakyPageSource, Classes, alloc8::InBandFreeList, 0,
+                   alloc8::AdaptiveSpanSizing<>> heap;
+  size_t cls = Classes::sizeToClass(64);
+  size_t base = Classes::classToPages(cls);
+  std::vector<void*> ptrs;
+  // Three full spans: the next refill grows
+  fill(heap, ptrs, 64, Classes::classCapacity(cls) * 3);
+
+  FlakyPageSource::failing = true;
+  for (int i = 0; i < 8; i++) {
+    assert(heap.malloc(64) == nullptr);
+  }
+  FlakyPageSource::failing = false;
+  alloc8::SpanSizingStats s = heap.spanSizingStats(cls);
+  assert(s.refills == 3 && s.grows == 0 && s.shift == 0);
+  assert(s.pages == base);
+
+  fill(heap, ptrs, 64, 1);
+  s = heap.spanSizingStats(cls);
+  assert(s.refills == 4 && s.grows == 1);
+  assert(pagesOf(ptrs.back()) == base << 1);
+  drain(heap, ptrs);
+}
+
+TEST(variable_spans_work_with_out_of_band_slabs) {
+  alloc8::SpanHeap<alloc8::OSPageSource, Classes, alloc8::OutOfBandSlab<true>, 0,
+                   alloc8::AdaptiveSpanSizing<>> heap;
+  size_t cls = Classes::sizeToClass(96);
+  std::vector<void*> ptrs;
+  fill(heap, ptrs, 96, Classes::classCapacity(cls) * 30);
+  assert(heap.spanSizingStats(cls).grows > 0);
+  // Free every other object, then refill the holes
+  std::vector<void*> kept;
+  for (size_t i = 0; i < ptrs.size(); i++) {
+    if (i % 2) {
+      heap.free(ptrs[i]);
+    } else {
+      kept.push_back(ptrs[i]);
+    }
+  }
+  ptrs.swap(kept);
+  size_t live = 0;
+  heap.iterate([](void*, size_t, void* ctx) { ++*static_cast<size_t*>(ctx); }, &live);
+  assert(live == ptrs.size());
+  assert(heap.spanSizingStats(cls).liveObjects == ptrs.size());
+  fill(heap, ptrs, 96, ptrs.size());
+  for (void* p : ptrs) {
+    assert(heap.getSize(p) == 96);
+  }
+  drain(heap, ptrs);
+  assert(heap.spanSizingStats(cls).liveObjects == 0);
+}
+
+// ─── EXPORTED STATS ───────────────────────────────────────────────────────────
+
+TEST(sizing_stats_reach_the_exported_path) {
+  using Redirect = alloc8::HeapRedirect<Adaptive>;
+  Adaptive& heap = *Redirect::getHeap();
+  size_t cls = Classes::sizeToClass(64);
+  std::vector<void*> ptrs;
+  fill(heap, ptrs, 64, Classes::classCapacity(cls) * 10);
+
+  struct Seen {
+    size_t classes;
+    alloc8_span_sizing_stats stats;
+  } seen = {};
+  assert(Redirect::spanSizingStats([](const alloc8_span_sizing_stats* stats, void* ctx) {
+    Seen& s = *static_cast<Seen*>(ctx);
+    s.classes++;
+    if (stats->size == 64) {
+      s.stats = *stats;
+    }
+  }, &seen) == 0);
+  // Only the class that made spans is reported
+  assert(seen.classes == 1);
+  alloc8::SpanSizingStats s = heap.spanSizingStats(cls);
+  assert(seen.stats.owner == heap.owner());
+  assert(seen.stats.pages == s.pages && seen.stats.base == s.basePages);
+  assert(seen.stats.shift == s.shift && seen.stats.grows == s.grows);
+  assert(seen.stats.refills == s.refills && seen.stats.live == ptrs.size());
+  drain(heap, ptrs);
+
+  // Fixed sizing has nothing to report
+  assert(alloc8::HeapRedirect<alloc8::SpanHeap<>>::spanSizingStats(
+             [](const alloc8_span_sizing_stats*, void*) {}, nullptr) == -1);
+}
+
+// ─── MAIN ─────────────────────────────────────────────────────────────────────
+
+int main() {
+  printf("\n=== alloc8 Span Sizing Tests ===\n\n");
+  // Tests are run automatically via static constructors
+  printf("\n=== All tests passed! ===\n\n");
+  return 0;
+}
@@ -0,0 +1,566 @@
+// alloc8/tests/test_thread_cache.cpp
+// AllocContext switching and ThreadCache tests
+
+#undef NDEBUG  // Keep assertions active in Release builds
+
+#include <alloc8/alloc_context.h>
+#include <alloc8/maintenance.h>
+#include <alloc8/ansi_wrapper.h>
+#include <alloc8/span_heap.h>
+#include <alloc8/thread_cache.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <cstdint>
+#include <cassert>
+#include <random>
+#include <thread>
+#include <vector>
+
+#if !defined(_WIN32)
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
+
+// Simple test macro
+#define TEST(name) \
+  static void test_##name(); \
+  static struct Test_##name { \
+    Test_##name() { \
+      printf("Running %s... ", #name); \
+      test_##name(); \
+      printf("PASSED\n"); \
+    } \
+  } test_##name##_instance; \
+  static void test_##name()
+
+using CachedHeap = alloc8::ANSIWrapper<alloc8::ThreadCache<alloc8::SpanHeap<>>>;
+
+template<typename Heap>
+static size_t liveObjects(Heap& heap) {
+  size_t count = 0;
+  heap.iterate([](void*, size_t, void* ctx) {
+    ++*static_cast<size_t*>(ctx);
+  }, &count);
+  return count;
+}
+
+// ─── ALLOC CONTEXT ────────────────────────────────────────────────────────────
+
+TEST(context_defaults_to_thread_context) {
+  assert(alloc8::current_context() == &alloc8::thread_context());
+  alloc8::AllocContext fiber = {};
+  fiber.tag = 42;
+  alloc8::AllocContext* prev = alloc8::switch_context(&fiber);
+  assert(prev == &alloc8::thread_context());
+  assert(alloc8::current_context() == &fiber);
+  assert(alloc8::current_context()->tag == 42);
+  assert(alloc8::switch_context(nullptr) == &fiber);
+  assert(alloc8::current_context() == &alloc8::thread_context());
+}
+
+TEST(contexts_are_per_thread) {
+  alloc8::AllocContext mine = {};
+  alloc8::switch_context(&mine);
+  alloc8::AllocContext* other = nullptr;
+  std::thread([&] { other = alloc8::current_context(); }).join();
+  assert(other != &mine);
+  assert(other != &alloc8::thread_context());
+  alloc8::switch_context(nullptr);
+}
+
+// ─── THREAD CACHE ─────────────────────────────────────────────────────────────
+
+TEST(cache_reuses_freed_objects) {
+  static CachedHeap heap;
+  alloc8::AllocContext ctx = {};
+  alloc8::switch_context(&ctx);
+  void* a = heap.malloc(100);
+  assert(a != nullptr);
+  assert(ctx.heap != nullptr && ctx.threadCache != nullptr);
+  heap.free(a);
+  assert(heap.malloc(100) == a);  // LIFO reuse from the cache
+  heap.free(a);
+  alloc8::switch_context(nullptr);
+  alloc8::release_context(&ctx);
+  assert(ctx.heap == nullptr && ctx.threadCache == nullptr);
+}
+
+TEST(caches_follow_the_context) {
+  static CachedHeap heap;
+  alloc8::AllocContext a = {};
+  alloc8::AllocContext b = {};
+
+  alloc8::switch_context(&a);
+  std::vector<void*> blocks;
+  for (int i = 0; i < 50; i++) {
+    blocks.push_back(heap.malloc(48));
+  }
+  alloc8::switch_context(&b);
+  for (void* p : blocks) {
+    heap.free(p);  // Lands in b's cache, not a's
+  }
+  alloc8::switch_context(nullptr);
+
+  assert(heap.cachedObjects(&b) == 50);
+
+  // Resuming `b` on another thread finds the same cache
+  void* reused = nullptr;
+  std::thread([&] {
+    alloc8::switch_context(&b);
+    reused = heap.malloc(48);
+    alloc8::switch_context(nullptr);
+  }).join();
+  assert(reused == blocks.back());
+  heap.free(reused);  // Back into this thread's default context cache
+
+  alloc8::release_context(&a);
+  alloc8::release_context(&b);
+  assert(heap.cachedObjects(&a) == 0 && heap.cachedObjects(&b) == 0);
+  heap.threadCleanup();
+  assert(liveObjects(heap) == 0);
+}
+
+TEST(cache_flushes_past_limit) {
+  static CachedHeap heap;
+  alloc8::AllocContext ctx = {};
+  alloc8::switch_context(&ctx);
+  size_t cls = alloc8::SizeClasses::sizeToClass(64);
+  size_t limit = decltype(heap)::limit(cls);
+  std::vector<void*> blocks;
+  for (size_t i = 0; i < limit * 4; i++) {
+    blocks.push_back(heap.malloc(64));
+  }
+  for (void* p : blocks) {
+    heap.free(p);
+  }
+  assert(heap.cachedObjects(&ctx) <= limit);
+  alloc8::switch_context(nullptr);
+  alloc8::release_context(&ctx);
+  assert(liveObjects(heap) == 0);
+}
+
+TEST(large_and_foreign_pointers_bypass_cache) {
+  static CachedHeap heap;
+  alloc8::AllocContext ctx = {};
+  alloc8::switch_context(&ctx);
+  void* big = heap.malloc(1 << 20);
+  assert(big != nullptr);
+  heap.free(big);
+  assert(heap.cachedObjects(&ctx) == 0);
+
+  static CachedHeap other;
+  void* foreign = other.malloc(32);  // ctx belongs to `heap`: no caching
+  assert(other.cachedObjects(&ctx) == 0);
+  heap.free(foreign);                // Not heap's object: ignored
+  assert(heap.cachedObjects(&ctx) == 0);
+  other.free(foreign);
+  alloc8::switch_context(nullptr);
+  alloc8::release_context(&ctx);
+  other.threadCleanup();
+  assert(liveObjects(other) == 0);
+}
+
+TEST(thread_exit_returns_cache) {
+  static CachedHeap heap;
+  std::vector<std::thread> threads;
+  for (int t = 0; t < 4; t++) {
+    threads.emplace_back([] {
+      std::vector<void*> blocks;
+      for (int i = 0; i < 1000; i++) {
+        blocks.push_back(heap.malloc(16 + (i % 64) * 16));
+      }
+      for (void* p : blocks) {
+        heap.free(p);
+      }
+      heap.threadCleanup();
+      void* late = heap.malloc(32);  // Retired context: straight to the heap
+      heap.free(late);
+    });
+  }
+  for (auto& t : threads) {
+    t.join();
+  }
+  assert(liveObjects(heap) == 0);
+}
+
+// ─── ADDRESS-ORDERED REFILL ───────────────────────────────────────────────────
+
+// Allocate `n` objects, then free every other one in shuffled order so the
+// span free lists end up scrambled. Returns the survivors.
+template<typename Heap>
+static std::vector<void*> scatter(Heap& heap, size_t sz, size_t n) {
+  std::vector<void*> blocks;
+  for (size_t i = 0; i < n; i++) {
+    blocks.push_back(heap.malloc(sz));
+  }
+  std::vector<void*> survivors;
+  std::vector<void*> victims;
+  for (size_t i = 0; i < n; i++) {
+    (i % 2 ? victims : survivors).push_back(blocks[i]);
+  }
+  std::shuffle(victims.begin(), victims.end(), std::mt19937(7));
+  for (void* p : victims) {
+    heap.free(p);
+  }
+  return survivors;
+}
+
+template<typename Layout>
+static void checkOrderedBatches() {
+  static alloc8::SpanHeap<alloc8::OSPageSource, alloc8::SizeClasses,
+                          alloc8::AddressOrderedRefill<Layout>> heap;
+  std::vector<void*> survivors = scatter(heap, 64, 1000);
+  void* batch[256];
+  size_t got = heap.mallocBatch(64, batch, 256);
+  assert(got == 256);
+  for (size_t i = 1; i < got; i++) {
+    if (alloc8::pageMap().get(batch[i]) == alloc8::pageMap().get(batch[i - 1])) {
+      assert(batch[i] > batch[i - 1]);  // Ascending within each span
+    }
+  }
+  heap.freeBatch(batch, got);
+  for (void* p : survivors) {
+    heap.free(p);
+  }
+}
+
+TEST(ordered_layouts_refill_in_address_order) {
+  checkOrderedBatches<alloc8::InBandFreeList>();
+  checkOrderedBatches<alloc8::OutOfBandSlab<>>();
+}
+
+TEST(address_ordered_cache_refills_ascending) {
+  using OrderedHeap = alloc8::ANSIWrapper<alloc8::ThreadCache<
+      alloc8::SpanHeap<>, alloc8::SizeClasses, 64 * 1024, true>>;
+  static OrderedHeap heap;
+  alloc8::AllocContext ctx = {};
+  alloc8::switch_context(&ctx);
+  std::vector<void*> survivors = scatter(heap, 64, 2000);
+  alloc8::release_context(&ctx);  // Flush the cache back to the spans
+
+  size_t refill = OrderedHeap::limit(alloc8::SizeClasses::sizeToClass(64)) / 2;
+  std::vector<void*> blocks;
+  for (size_t i = 0; i < refill; i++) {
+    blocks.push_back(heap.malloc(64));
+  }
+  assert(std::is_sorted(blocks.begin(), blocks.end(), std::less<void*>()));
+  for (void* p : blocks) {
+    heap.free(p);
+  }
+  for (void* p : survivors) {
+    heap.free(p);
+  }
+  alloc8::switch_context(nullptr);
+  alloc8::release_context(&ctx);
+  assert(liveObjects(heap) == 0);
+}
+
+// ─── CACHE BUDGET ─────────────────────────────────────────────────────────────
+
+constexpr size_t kTestBudget = 256 * 1024;
+
+using BudgetHeap = alloc8::ANSIWrapper<alloc8::ThreadCache<
+    alloc8::SpanHeap<>, alloc8::SizeClasses, 64 * 1024, false, kTestBudget>>;
+
+struct CacheTotals {
+  size_t caches;
+  size_t bytes;
+  size_t capacity;
+  size_t idle;
+};
+
+template<typename Heap>
+static CacheTotals cacheTotals(Heap& heap) {
+  CacheTotals t = {};
+  heap.cacheStats([](const alloc8_cache_stats* s, void* ctx) {
+    CacheTotals& t = *static_cast<CacheTotals*>(ctx);
+    t.caches++;
+    t.bytes += s->bytes;
+    t.capacity += s->capacity;
+    t.idle += s->idle;
+  }, &t);
+  return t;
+}
+
+// Allocate then free `perSize` objects of each size from 64 bytes to 4 KiB,
+// in the current context
+template<typename Heap>
+static void churn(Heap& heap, size_t perSize) {
+  std::vector<void*> blocks;
+  for (size_t sz = 64; sz <= 4096; sz *= 2) {
+    for (size_t i = 0; i < perSize; i++) {
+      blocks.push_back(heap.malloc(sz));
+    }
+  }
+  for (void* p : blocks) {
+    heap.free(p);
+  }
+}
+
+TEST(budget_caps_cached_bytes) {
+  static BudgetHeap heap;
+  alloc8::AllocContext ctx = {};
+  alloc8::switch_context(&ctx);
+  churn(heap, 200);  // Would cache well over 256 KiB without a budget
+  CacheTotals t = cacheTotals(heap);
+  assert(t.caches == 1);
+  assert(t.bytes > 0);
+  assert(t.bytes <= t.capacity && t.capacity <= kTestBudget);
+  assert(heap.cachedBytes() == t.bytes);
+  alloc8::switch_context(nullptr);
+  alloc8::release_context(&ctx);
+  assert(cacheTotals(heap).caches == 0);
+  assert(liveObjects(heap) == 0);
+}
+
+TEST(busy_cache_takes_capacity_from_larger_one) {
+  static BudgetHeap heap;
+  alloc8::AllocContext first = {};
+  alloc8::AllocContext second = {};
+  alloc8::switch_context(&first);
+  churn(heap, 200);
+  size_t firstBefore = cacheTotals(heap).capacity;
+  assert(firstBefore == kTestBudget);  // Claimed the whole pool
+  alloc8::switch_context(&second);
+  churn(heap, 200);
+  size_t capacity[2] = {};
+  heap.cacheStats([](const alloc8_cache_stats* s, void* ctx) {
+    static_cast<size_t*>(ctx)[s->id] = s->capacity;
+  }, capacity);
+  size_t firstAfter = capacity[0];
+  size_t secondAfter = capacity[1];
+  assert(firstAfter < firstBefore);
+  assert(secondAfter > 0);
+  assert(firstAfter + secondAfter <= kTestBudget);
+  assert(cacheTotals(heap).bytes <= kTestBudget);
+  alloc8::switch_context(nullptr);
+  alloc8::release_context(&first);
+  alloc8::release_context(&second);
+  assert(liveObjects(heap) == 0);
+}
+
+TEST(rebalance_drains_idle_caches) {
+  static BudgetHeap heap;
+  alloc8::AllocContext busy = {};
+  alloc8::AllocContext quiet = {};
+  alloc8::switch_context(&quiet);
+  churn(heap, 50);
+  alloc8::switch_context(&busy);
+  churn(heap, 50);
+  heap.rebalance();  // Records each cache's activity
+  churn(heap, 50);   // Only `busy` stays active
+  heap.rebalance();
+  alloc8_cache_stats stats[2] = {};
+  heap.cacheStats([](const alloc8_cache_stats* s, void* ctx) {
+    static_cast<alloc8_cache_stats*>(ctx)[s->id] = *s;
+  }, stats);
+  // `quiet` (id 0) was drained and gave its capacity back
+  assert(stats[0].idle == 1 && stats[0].bytes == 0 && stats[0].capacity == 0);
+  assert(stats[1].idle == 0 && stats[1].bytes > 0 && stats[1].capacity > 0);
+  alloc8::switch_context(nullptr);
+  alloc8::release_context(&busy);
+  alloc8::release_context(&quiet);
+  assert(liveObjects(heap) == 0);
+}
+
+TEST(maintenance_runs_registered_rebalance) {
+  static BudgetHeap heap;
+  alloc8::AllocContext ctx = {};
+  alloc8::switch_context(&ctx);
+  churn(heap, 50);
+  alloc8::switch_context(nullptr);
+  assert(cacheTotals(heap).bytes > 0);
+  alloc8::Maintenance& maintenance = alloc8::Maintenance::instance();
+  assert(maintenance.start(std::chrono::milliseconds(1)));
+  uint64_t ticks = maintenance.ticks();
+  while (maintenance.ticks() < ticks + 3) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+  maintenance.stop();
+  assert(!maintenance.running());
+  CacheTotals t = cacheTotals(heap);
+  assert(t.bytes == 0 && t.capacity == 0 && t.idle == 1);
+  alloc8::release_context(&ctx);
+  assert(liveObjects(heap) == 0);
+}
+
+#if !defined(_WIN32)
+// fork() is not available on Windows
+
+// Parks the next freeBatch() once armed, so a rebalance() can be held in
+// the middle of draining a cache
+struct GatedSpanHeap : alloc8::SpanHeap<> {
+  std::atomic<int> gate{0};  // 1: armed, 2: parked
+
+  void freeBatch(void** ptrs, size_t n) {
+    int armed = 1;
+    if (gate.compare_exchange_strong(armed, 2)) {
+      while (gate.load() == 2) {
+        std::this_thread::yield();
+      }
+    }
+    alloc8::SpanHeap<>::freeBatch(ptrs, n);
+  }
+};
+
+TEST(fork_during_rebalance) {
+  static alloc8::ANSIWrapper<alloc8::ThreadCache<
+      GatedSpanHeap, alloc8::SizeClasses, 64 * 1024, false, kTestBudget>> heap;
+  alloc8::AllocContext quiet = {};
+  alloc8::switch_context(&quiet);
+  churn(heap, 50);
+  alloc8::switch_context(nullptr);
+  heap.rebalance();  // Records `quiet`'s activity; the next call drains it
+
+  heap.gate.store(1);
+  std::thread rebalancer([] { heap.rebalance(); });
+  while (heap.gate.load() != 2) {
+    std::this_thread::yield();
+  }
+  std::thread opener([] {
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    heap.gate.store(0);
+  });
+  heap.lock();  // What xxmalloc_lock() does before fork(): waits for rebalance()
+  pid_t pid = fork();
+  heap.unlock();
+  if (pid == 0) {
+    alarm(5);  // A registry lock left held would hang the child here
+    heap.rebalance();
+    _exit(0);
+  }
+  int status = 0;
+  waitpid(pid, &status, 0);
+  assert(WIFEXITED(status) && WEXITSTATUS(status) == 0);
+  rebalancer.join();
+  opener.join();
+  alloc8::release_context(&quiet);
+  assert(liveObjects(heap) == 0);
+}
+#endif
+
+TEST(unbudgeted_caches_report_bytes) {
+  static CachedHeap heap;
+  alloc8::AllocContext ctx = {};
+  alloc8::switch_context(&ctx);
+  void* p = heap.malloc(64);
+  heap.free(p);
+  CacheTotals t = cacheTotals(heap);
+  assert(t.caches == 1);
+  assert(t.bytes == alloc8::SizeClasses::classToSize(
+                        alloc8::SizeClasses::sizeToClass(64)) *
+                    heap.cachedObjects(&ctx));
+  assert(t.capacity == 0 && heap.budget() == 0);
+  alloc8::switch_context(nullptr);
+  alloc8::release_context(&ctx);
+}
+
+// ─── ITERATION ────────────────────────────────────────────────────────────────
+
+// Cached objects are free to the program: iterate() leaves out the running
+// context's cache, and other caches when they can be held (budgeted)
+template<typename Heap>
+static void checkCachedObjectsLeftOut(bool othersLeftOut) {
+  static Heap heap;
+  alloc8::AllocContext other = {};
+  alloc8::switch_context(&other);
+  churn(heap, 20);
+  size_t otherObjects = heap.cachedObjects(&other);
+  assert(otherObjects > 0);
+
+  alloc8::AllocContext ctx = {};
+  alloc8::switch_context(&ctx);
+  std::vector<void*> kept;
+  for (int i = 0; i < 100; i++) {
+    kept.push_back(heap.malloc(64));
+  }
+  churn(heap, 20);
+  assert(heap.cachedObjects(&ctx) > 0);
+  assert(liveObjects(heap) == kept.size() + (othersLeftOut ? 0 : otherObjects));
+
+  for (void* p : kept) {
+    heap.free(p);
+  }
+  alloc8::switch_context(nullptr);
+  alloc8::release_context(&ctx);
+  alloc8::release_context(&other);
+  assert(liveObjects(heap) == 0);
+}
+
+TEST(iterate_leaves_cached_objects_out) {
+  checkCachedObjectsLeftOut<CachedHeap>(false);
+  checkCachedObjectsLeftOut<BudgetHeap>(true);
+}
+
+// ─── IDLE / BUSY ──────────────────────────────────────────────────────────────
+
+TEST(idle_empties_only_the_running_cache) {
+  static CachedHeap heap;
+  alloc8::AllocContext other = {};
+  alloc8::switch_context(&other);
+  churn(heap, 20);
+  size_t otherObjects = heap.cachedObjects(&other);
+  assert(otherObjects > 0);
+
+  alloc8::AllocContext ctx = {};
+  alloc8::switch_context(&ctx);
+  churn(heap, 20);
+  assert(heap.cachedObjects(&ctx) > 0);
+  heap.threadIdle();
+  assert(heap.cachedObjects(&ctx) == 0);
+  assert(heap.cachedObjects(&other) == otherObjects);
+  assert(heap.cachedBytes() == cacheTotals(heap).bytes);
+
+  // Busy again: nothing is prefetched, the next malloc refills
+  heap.threadBusy();
+  assert(heap.cachedObjects(&ctx) == 0);
+  void* p = heap.malloc(64);
+  assert(p != nullptr && heap.cachedObjects(&ctx) > 0);
+  heap.free(p);
+  alloc8::switch_context(nullptr);
+  alloc8::release_context(&ctx);
+  alloc8::release_context(&other);
+  assert(liveObjects(heap) == 0);
+}
+
+TEST(idle_returns_budget_capacity) {
+  static BudgetHeap heap;
+  alloc8::AllocContext ctx = {};
+  alloc8::switch_context(&ctx);
+  churn(heap, 50);
+  CacheTotals t = cacheTotals(heap);
+  assert(t.bytes > 0 && t.capacity > 0 && t.idle == 0);
+  heap.threadIdle();
+  t = cacheTotals(heap);
+  assert(t.bytes == 0 && t.capacity == 0 && t.idle == 1);
+  heap.threadBusy();
+  assert(cacheTotals(heap).idle == 0);
+  churn(heap, 50);  // Claims capacity back from the pool
+  t = cacheTotals(heap);
+  assert(t.capacity > 0 && t.bytes <= t.capacity);
+  alloc8::switch_context(nullptr);
+  alloc8::release_context(&ctx);
+}
+
+TEST(idle_without_cache_is_harmless) {
+  static CachedHeap heap;
+  alloc8::AllocContext ctx = {};
+  alloc8::switch_context(&ctx);
+  heap.threadIdle();  // Never allocated: no cache attached
+  heap.threadBusy();
+  assert(heap.cachedObjects(&ctx) == 0);
+  alloc8::switch_context(nullptr);
+}
+
+// ─── MAIN ─────────────────────────────────────────────────────────────────────
+
+int main() {
+  printf("\n=== alloc8 ThreadCache Tests ===\n\n");
+  // Tests are run automatically via static constructors
+  printf("\n=== All tests passed! ===\n\n");
+  return 0;
+}
@@ -0,0 +1,133 @@
+// alloc8/tests/test_thread_hooks.cpp
+// Linux thread hook tests: run with LD_PRELOAD=thread_hooks_lib (the
+// hooks alone, see tests/CMakeLists.txt). This program supplies the
+// allocator side - xxmalloc/xxfree and counting xxthread_init/cleanup -
+// and checks that every way of starting and ending a thread reaches them,
+// whichever pthread_create version the caller bound.
+
+#undef NDEBUG  // Keep assertions active in Release builds
+
+#include <atomic>
+#include <cassert>
+#include <cstdio>
+#include <cstdlib>
+#include <pthread.h>
+#include <thread>
+
+// Simple test macro
+#define TEST(name) \
+  static void test_##name(); \
+  static struct Test_##name { \
+    Test_##name() { \
+      printf("Running %s... ", #name); \
+      test_##name(); \
+      printf("PASSED\n"); \
+    } \
+  } test_##name##_instance; \
+  static void test_##name()
+
+static std::atomic<int> g_inits{0};
+static std::atomic<int> g_cleanups{0};
+
+// Found by the preloaded hooks through the executable's dynamic symbols
+extern "C" {
+  __attribute__((visibility("default"))) void* xxmalloc(size_t sz) {
+    return malloc(sz);
+  }
+
+  __attribute__((visibility("default"))) void xxfree(void* ptr) {
+    free(ptr);
+  }
+
+  __attribute__((visibility("default"))) void xxthread_init() {
+    g_inits++;
+  }
+
+  __attribute__((visibility("default"))) void xxthread_cleanup() {
+    g_cleanups++;
+  }
+}
+
+// The pre-2.34 version, still bound by programs linked against old glibc
+extern "C" int pthread_create_2_2_5(pthread_t*, const pthread_attr_t*,
+                                    void* (*)(void*), void*);
+__asm__(".symver pthread_create_2_2_5, pthread_create@GLIBC_2.2.5");
+
+static void* returnArg(void* arg) {
+  return arg;
+}
+
+static void* exitEarly(void* arg) {
+  pthread_exit(arg);
+}
+
+// Started thread count and exit hooks run, as a pair of deltas
+struct Counts {
+  int inits;
+  int cleanups;
+};
+
+template<typename Start>
+static Counts countAround(Start&& start) {
+  int inits = g_inits.load();
+  int cleanups = g_cleanups.load();
+  start();
+  return Counts{g_inits.load() - inits, g_cleanups.load() - cleanups};
+}
+
+// ─── PTHREAD_CREATE VERSIONS ──────────────────────────────────────────────────
+
+TEST(default_version_runs_hooks) {
+  int value = 7;
+  Counts c = countAround([&] {
+    pthread_t t;
+    assert(pthread_create(&t, nullptr, returnArg, &value) == 0);
+    void* result = nullptr;
+    assert(pthread_join(t, &result) == 0);
+    assert(result == &value);
+  });
+  assert(c.inits == 1 && c.cleanups == 1);
+}
+
+TEST(compat_version_runs_hooks) {
+  int value = 7;
+  Counts c = countAround([&] {
+    pthread_t t;
+    assert(pthread_create_2_2_5(&t, nullptr, returnArg, &value) == 0);
+    void* result = nullptr;
+    assert(pthread_join(t, &result) == 0);
+    assert(result == &value);
+  });
+  assert(c.inits == 1 && c.cleanups == 1);
+}
+
+TEST(std_thread_runs_hooks) {
+  Counts c = countAround([] {
+    std::thread([] {}).join();
+    std::thread([] {}).join();
+  });
+  assert(c.inits == 2 && c.cleanups == 2);
+}
+
+// ─── PTHREAD_EXIT ─────────────────────────────────────────────────────────────
+
+TEST(pthread_exit_runs_cleanup) {
+  int value = 7;
+  Counts c = countAround([&] {
+    pthread_t t;
+    assert(pthread_create(&t, nullptr, exitEarly, &value) == 0);
+    void* result = nullptr;
+    assert(pthread_join(t, &result) == 0);
+    assert(result == &value);
+  });
+  assert(c.inits == 1 && c.cleanups == 1);
+}
+
+// ─── MAIN ─────────────────────────────────────────────────────────────────────
+
+int main() {
+  printf("\n=== alloc8 Thread Hook Tests ===\n\n");
+  // Tests are run automatically via static constructors
+  printf("\n=== All tests passed! ===\n\n");
+  return 0;
+}
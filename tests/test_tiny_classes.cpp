@@ -0,0 +1,218 @@
+// alloc8/tests/test_tiny_classes.cpp
+// Tiny size classes: the 8-byte class, size-based alignment through
+// ANSIWrapper's TinyLimit (16 bytes for anything above 8), memalign on the
+// 8-byte class
+
+#undef NDEBUG  // Keep assertions active in Release builds
+
+#include <alloc8/ansi_wrapper.h>
+#include <alloc8/sharded_page_heap.h>
+#include <alloc8/size_classes.h>
+#include <alloc8/span_heap.h>
+#include <alloc8/thread_cache.h>
+
+#include <cstdio>
+#include <cstring>
+#include <cstdint>
+#include <cassert>
+#include <thread>
+#include <vector>
+
+// Simple test macro
+#define TEST(name) \
+  static void test_##name(); \
+  static struct Test_##name { \
+    Test_##name() { \
+      printf("Running %s... ", #name); \
+      test_##name(); \
+      printf("PASSED\n"); \
+    } \
+  } test_##name##_instance; \
+  static void test_##name()
+
+using Tiny = alloc8::TinySizeClasses;
+using TinySpans = alloc8::SpanHeap<alloc8::OSPageSource, Tiny>;
+using Nodes = alloc8::ANSIWrapper<alloc8::ThreadCache<TinySpans, Tiny>,
+                                  ALLOC8_MIN_ALIGNMENT, 8>;
+using Default = alloc8::ANSIWrapper<alloc8::ThreadCache<alloc8::SpanHeap<>>>;
+
+static uintptr_t addr(void* p) {
+  return reinterpret_cast<uintptr_t>(p);
+}
+
+// ─── CLASS LADDER ─────────────────────────────────────────────────────────────
+
+TEST(tiny_classes_add_only_an_eight_byte_class) {
+  for (size_t sz = 1; sz <= 8; sz++) {
+    assert(Tiny::classToSize(Tiny::sizeToClass(sz)) == 8);
+  }
+  // Above 8 bytes the ladder is the default one: no 24, 40 or 56
+  for (size_t sz = 9; sz <= Tiny::kMaxSmallSize; sz += 7) {
+    assert(Tiny::classToSize(Tiny::sizeToClass(sz)) ==
+           alloc8::SizeClasses::classToSize(alloc8::SizeClasses::sizeToClass(sz)));
+    assert(Tiny::classToSize(Tiny::sizeToClass(sz)) % 16 == 0);
+  }
+  assert(Tiny::kNumClasses == alloc8::SizeClasses::kNumClasses + 1);
+  assert(alloc8::SizeClasses::classToSize(alloc8::SizeClasses::sizeToClass(8)) == 16);
+}
+
+// ─── SIZE-BASED ALIGNMENT ─────────────────────────────────────────────────────
+
+TEST(eight_bytes_or_less_get_eight_byte_blocks) {
+  static Nodes heap;
+  std::vector<void*> objs;
+  for (size_t sz : {0, 1, 7, 8}) {
+    void* p = heap.malloc(sz);
+    assert(heap.getSize(p) == 8);
+    assert(addr(p) % 8 == 0);
+    memset(p, 0x3c, sz);
+    objs.push_back(p);
+  }
+  // Two 8-byte boxes in a row sit 8 bytes apart
+  void* a = heap.malloc(8);
+  void* b = heap.malloc(8);
+  assert(addr(b) > addr(a) ? addr(b) - addr(a) == 8 : addr(a) - addr(b) == 8);
+  heap.free(a);
+  heap.free(b);
+  for (void* p : objs) {
+    heap.free(p);
+  }
+}
+
+TEST(odd_multiples_of_eight_stay_sixteen_byte_aligned) {
+  // Anything that fits must be aligned (DR 445): a 16-aligned header
+  // followed by a few bytes fits in 24
+  struct Header {
+    __int128 h;
+    char data[];
+  };
+  static Nodes heap;
+  std::vector<void*> objs;
+  for (size_t sz : {9, 17, 24, 40, 56}) {
+    void* p = heap.malloc(sz);
+    assert(addr(p) % 16 == 0);
+    assert(heap.getSize(p) == alloc8::alignUp(sz, 16));
+    objs.push_back(p);
+  }
+  for (int i = 0; i < 1000; i++) {
+    auto* h = static_cast<Header*>(heap.malloc(sizeof(Header) + 8));
+    assert(addr(h) % alignof(Header) == 0);
+    h->h = i;
+    objs.push_back(h);
+  }
+  for (void* p : objs) {
+    heap.free(p);
+  }
+}
+
+TEST(multiples_of_sixteen_stay_sixteen_byte_aligned) {
+  static Nodes heap;
+  std::vector<void*> objs;
+  for (size_t i = 0; i < 2000; i++) {
+    size_t sz = 16 * (1 + i % 4);  // 16, 32, 48, 64
+    void* p = heap.malloc(sz);
+    assert(addr(p) % 16 == 0);
+    assert(heap.getSize(p) == sz);
+    objs.push_back(p);
+  }
+  for (size_t i = 0; i < 2000; i++) {
+    void* p = heap.malloc(65 + i % 100);  // Above TinyLimit: rounded to 16
+    assert(addr(p) % 16 == 0 && heap.getSize(p) % 16 == 0);
+    objs.push_back(p);
+  }
+  for (void* p : objs) {
+    heap.free(p);
+  }
+}
+
+TEST(memalign_skips_eight_byte_classes) {
+  static Nodes heap;
+  static alloc8::ANSIWrapper<alloc8::ShardedPageHeap<Tiny>,
+                             ALLOC8_MIN_ALIGNMENT, 8> sharded;
+  std::vector<void*> objs;
+  std::vector<void*> shardedObjs;
+  for (size_t i = 0; i < 100; i++) {
+    void* p = heap.memalign(16, 8);
+    void* q = sharded.memalign(16, 8);
+    void* r = heap.memalign(8, 8);
+    assert(addr(p) % 16 == 0 && heap.getSize(p) >= 8);
+    assert(addr(q) % 16 == 0 && sharded.getSize(q) >= 8);
+    assert(addr(r) % 8 == 0);
+    objs.push_back(p);
+    objs.push_back(r);
+    shardedObjs.push_back(q);
+  }
+  for (void* p : objs) {
+    heap.free(p);
+  }
+  for (void* q : shardedObjs) {
+    sharded.free(q);
+  }
+}
+
+TEST(realloc_moves_between_tiny_and_normal_classes) {
+  static Nodes heap;
+  auto* p = static_cast<unsigned char*>(heap.malloc(8));
+  for (size_t i = 0; i < 8; i++) {
+    p[i] = static_cast<unsigned char>(i);
+  }
+  p = static_cast<unsigned char*>(heap.realloc(p, 24));
+  assert(addr(p) % 16 == 0 && heap.getSize(p) == 32);
+  p = static_cast<unsigned char*>(heap.realloc(p, 200));
+  assert(addr(p) % 16 == 0 && heap.getSize(p) >= 200);
+  p = static_cast<unsigned char*>(heap.realloc(p, 40));
+  for (size_t i = 0; i < 8; i++) {
+    assert(p[i] == i);
+  }
+  heap.free(p);
+}
+
+TEST(default_wrapper_still_rounds_to_sixteen) {
+  static Default heap;
+  void* p = heap.malloc(8);
+  void* q = heap.malloc(24);
+  assert(heap.getSize(p) == 16 && heap.getSize(q) == 32);
+  assert(addr(p) % 16 == 0 && addr(q) % 16 == 0);
+  heap.free(p);
+  heap.free(q);
+}
+
+// ─── THREADS ──────────────────────────────────────────────────────────────────
+
+TEST(threads_share_tiny_classes) {
+  static Nodes heap;
+  std::vector<std::thread> threads;
+  for (int t = 0; t < 4; t++) {
+    threads.emplace_back([t] {
+      std::vector<uint64_t*> objs;
+      for (int round = 0; round < 20; round++) {
+        for (size_t i = 0; i < 1000; i++) {
+          size_t words = 1 + (i + t) % 8;
+          auto* p = static_cast<uint64_t*>(heap.malloc(words * 8));
+          for (size_t w = 0; w < words; w++) {
+            p[w] = i;
+          }
+          objs.push_back(p);
+        }
+        for (size_t i = 0; i < objs.size(); i++) {
+          assert(objs[i][0] == i);
+          heap.free(objs[i]);
+        }
+        objs.clear();
+      }
+      heap.threadCleanup();
+    });
+  }
+  for (std::thread& t : threads) {
+    t.join();
+  }
+}
+
+// ─── MAIN ─────────────────────────────────────────────────────────────────────
+
+int main() {
+  printf("\n=== alloc8 Tiny Size Class Tests ===\n\n");
+  // Tests are run automatically via static constructors
+  printf("\n=== All tests passed! ===\n\n");
+  return 0;
+}
@@ -0,0 +1,149 @@
+// alloc8/tests/test_virtual_buffer.cpp
+// VirtualBuffer and in-place large realloc tests
+
+#undef NDEBUG  // Keep assertions active in Release builds
+
+#include <alloc8/ansi_wrapper.h>
+#include <alloc8/span_heap.h>
+#include <alloc8/virtual_buffer.h>
+
+#include <cstdio>
+#include <cstring>
+#include <cstdint>
+#include <cassert>
+
+// Simple test macro
+#define TEST(name) \
+  static void test_##name(); \
+  static struct Test_##name { \
+    Test_##name() { \
+      printf("Running %s... ", #name); \
+      test_##name(); \
+      printf("PASSED\n"); \
+    } \
+  } test_##name##_instance; \
+  static void test_##name()
+
+// ─── VIRTUAL BUFFER ───────────────────────────────────────────────────────────
+
+TEST(buffer_grows_without_moving) {
+  alloc8::VirtualBuffer buf(256 * 1024 * 1024);
+  assert(buf.valid());
+  assert(buf.size() == 0);
+  char* base = buf.data();
+
+  char chunk[1000];
+  for (size_t i = 0; i < 100000; i++) {
+    memset(chunk, static_cast<int>(i & 0xFF), sizeof(chunk));
+    void* dst = buf.append(chunk, sizeof(chunk));
+    assert(dst == base + i * sizeof(chunk));
+  }
+  assert(buf.data() == base);
+  assert(buf.size() == 100000 * sizeof(chunk));
+  assert(buf.committed() >= buf.size());
+  for (size_t i = 0; i < 100000; i += 997) {
+    assert(static_cast<unsigned char>(base[i * sizeof(chunk)]) == (i & 0xFF));
+  }
+}
+
+TEST(buffer_new_pages_are_zero) {
+  alloc8::VirtualBuffer buf(1 << 20);
+  assert(buf.resize(100000));
+  for (size_t i = 0; i < 100000; i += 4096) {
+    assert(buf.data()[i] == 0);
+  }
+}
+
+TEST(buffer_respects_capacity) {
+  alloc8::VirtualBuffer buf(64 * 1024);
+  assert(buf.capacity() == 64 * 1024);
+  assert(buf.grow(60 * 1024) != nullptr);
+  assert(buf.grow(8 * 1024) == nullptr);   // Would exceed the reservation
+  assert(buf.size() == 60 * 1024);
+  assert(!buf.resize(64 * 1024 + 1));
+  assert(buf.resize(64 * 1024));
+}
+
+TEST(buffer_trim_and_regrow) {
+  alloc8::VirtualBuffer buf(64 * 1024 * 1024);
+  char* base = buf.data();
+  assert(buf.resize(8 * 1024 * 1024));
+  memset(base, 0x11, buf.size());
+  buf.resize(4096);
+  buf.trim();
+  assert(buf.committed() == 4096);
+  assert(base[0] == 0x11);
+  assert(buf.resize(16 * 1024 * 1024));
+  assert(buf.data() == base);
+  base[buf.size() - 1] = 0x22;
+}
+
+// ─── GROWABLE LARGE REALLOC ───────────────────────────────────────────────────
+
+namespace {
+
+constexpr size_t kGrowMin = 256 * 1024;
+
+using GrowHeap = alloc8::ANSIWrapper<
+  alloc8::SpanHeap<alloc8::OSPageSource, alloc8::SizeClasses,
+                   alloc8::InBandFreeList, kGrowMin>>;
+
+size_t countLive(GrowHeap& heap) {
+  size_t n = 0;
+  heap.iterate([](void*, size_t, void* ctx) { ++*static_cast<size_t*>(ctx); }, &n);
+  return n;
+}
+
+} // anonymous namespace
+
+TEST(realloc_grows_large_in_place) {
+  static GrowHeap heap;
+  char* p = static_cast<char*>(heap.malloc(kGrowMin));
+  assert(p != nullptr);
+  memset(p, 0x5C, kGrowMin);
+
+  for (size_t sz = kGrowMin * 2; sz <= 32 * 1024 * 1024; sz *= 2) {
+    char* q = static_cast<char*>(heap.realloc(p, sz));
+    assert(q == p);
+    assert(heap.getSize(q) >= sz);
+    q[sz - 1] = 1;
+  }
+  assert(p[0] == 0x5C && p[kGrowMin - 1] == 0x5C);
+  // Interior pointers in the grown region map back to the same block
+  assert(heap.getSize(p + 20 * 1024 * 1024) == heap.getSize(p));
+  assert(countLive(heap) == 1);
+  heap.free(p);
+  assert(countLive(heap) == 0);
+}
+
+TEST(realloc_falls_back_when_reservation_exhausted) {
+  static GrowHeap heap;
+  char* p = static_cast<char*>(heap.malloc(kGrowMin));
+  assert(p != nullptr);
+  p[0] = 7;
+  // Far beyond the reservation: must move, keeping the contents
+  size_t huge = 1024 * 1024 * 1024;
+  char* q = static_cast<char*>(heap.realloc(p, huge));
+  assert(q != nullptr && q != p);
+  assert(q[0] == 7);
+  assert(heap.getSize(q) >= huge);
+  heap.free(q);
+}
+
+TEST(small_and_unreserved_blocks_still_copy) {
+  static GrowHeap heap;
+  char* p = static_cast<char*>(heap.malloc(1000));
+  memset(p, 3, 1000);
+  char* q = static_cast<char*>(heap.realloc(p, 100000));
+  assert(q != nullptr && q[999] == 3);
+  heap.free(q);
+}
+
+// ─── MAIN ─────────────────────────────────────────────────────────────────────
+
+int main() {
+  printf("\n=== alloc8 VirtualBuffer Tests ===\n\n");
+  // Tests are run automatically via static constructors
+  printf("\n=== All tests passed! ===\n\n");
+  return 0;
+}